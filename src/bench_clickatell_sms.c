@@ -0,0 +1,2113 @@
+/*
+ * bench_clickatell_sms.c
+ *
+ * Benchmark harness for the Clickatell SMS library.
+ * All API calls are made against the loopback transport (see loopback_transport.c), so
+ * only the library's own work is measured. Benchmarks:
+ *   ops       - request construction in local_api_command_execute(), URL encoding and
+ *               response parsing. Each operation is reported per call, with wall-clock
+ *               time and hardware performance counters (cycles, instructions, branch
+ *               misses, L1D and LLC misses) where available.
+ *   serialize - send message request serialization for the HTTP API (URL-encoded GET
+ *               query string) versus the REST API (JSON body), across message lengths
+ *               and recipient counts. Reports ns per message and bytes on the wire.
+ *   charset   - GSM 03.38 classification, GSM 7-bit packing, UCS-2 hex encoding and
+ *               transliteration throughput (GB/s) over ASCII, text with typographic
+ *               punctuation, GSM 7-bit with extension characters, Latin, Cyrillic and
+ *               Chinese text, and hex encoding throughput of binary message data.
+ *   msisdn    - MSISDN normalization to E.164 (click_msisdn_normalize_batch()) over
+ *               numbers in mixed national and international formats, in numbers per second.
+ *   template  - personalised sends: a compiled template rendered into a reused buffer and
+ *               sent with clickatell_sms_message_send_buffer(), versus formatting the text
+ *               with snprintf() into a new ClickSmsString for each message.
+ *   recipients - building and sending to a newline-delimited list of numbers as a
+ *               ClickMsisdn (a ClickSmsString per number) versus a compact ClickRecipients
+ *               list parsed in one pass, and deduplication of a list, in ns per recipient.
+ *   cost      - campaign cost estimates (click_cost_estimate()) of a single text and of a
+ *               template over a large recipient list, on one thread versus all cores.
+ *   callback  - delivery receipt callbacks received by a ClickCallbackServer from a local
+ *               client over keep-alive connections with pipelined requests, in the HTTP
+ *               (GET query string) and REST (JSON POST) formats, and inbound messages with
+ *               UCS-2 text parsed into a ClickMoQueue drained by a consumer thread, in
+ *               callbacks per second.
+ *   poll      - status polling of sent messages with a ClickPollScheduler over several
+ *               handles, against a simulated clock and network in which messages reach a
+ *               final status after varied delays. Reports polls per message and how stale
+ *               final statuses are when seen, versus polling every message every 10 seconds.
+ *   batch     - personalised HTTP API sends: a sendmsg.php request per recipient with
+ *               rendered text (with credentials, then with a session ID), versus a batch
+ *               template sent once and a senditem.php request per recipient with its field
+ *               values, and quicksend.php requests for unpersonalised text. Reports ns and
+ *               bytes on the wire per message.
+ *   post      - HTTP API sends as GET requests (recipients in the URL) versus form POST
+ *               requests (CLICK_SMS_OPTION_HTTP_POST), each with as many recipients as the
+ *               API allows, made over a keep-alive connection to a local stand-in server.
+ *               Reports requests and recipients per second.
+ *   stream    - sends to a large ClickRecipients list with the request body formatted in
+ *               memory versus generated while it is sent (CLICK_SMS_OPTION_STREAM_BODY),
+ *               for the REST API and HTTP API form POSTs. Reports the heap in use by the
+ *               library while the request is sent, and ms per send.
+ *   submit    - sends which keep the whole response (clickatell_sms_message_send()) versus
+ *               fire-and-forget submits which only scan its first bytes
+ *               (clickatell_sms_message_submit()), to 1 and 100 recipients on each API, with
+ *               a response of one result per recipient. Reports ns per message.
+ *   audience  - repeated sends to a 10000 recipient group, a request per 100 recipients, with
+ *               the recipients in ClickMsisdn arrays or ClickRecipients lists (formatted
+ *               into every request) versus a prepared ClickAudience (serialized once), on
+ *               each API. Reports ns per request, and the cost of preparing the audience.
+ *   prepared  - re-sends (ie. retries) of the same message to 1 and 100 recipients, formatted
+ *               by every clickatell_sms_message_send() call versus prepared once and executed
+ *               with clickatell_sms_request_execute(), on each API. Reports ns per request.
+ *
+ * Usage:  ./bench_clickatell_sms [benchmark] [iterations]
+ *         benchmark: all (default), ops, serialize, charset, msisdn, template, recipients,
+ *                    cost, callback, poll, batch, post, stream, submit, audience, prepared
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "curl/curl.h"
+
+#include "clickatell_sms/clickatell_debug.h"
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_charset.h"
+#include "clickatell_sms/clickatell_segment.h"
+#include "clickatell_sms/clickatell_msisdn.h"
+#include "clickatell_sms/clickatell_template.h"
+#include "clickatell_sms/clickatell_recipients.h"
+#include "clickatell_sms/clickatell_audience.h"
+#include "clickatell_sms/clickatell_cost.h"
+#include "clickatell_sms/clickatell_callback.h"
+#include "clickatell_sms/clickatell_poll.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "loopback_transport.h"
+#include "perf_counters.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Fixed Macros/Types                                                            *
+ * ----------------------------------------------------------------------------- */
+
+#define BENCH_DEFAULT_ITERATIONS    200000 // default number of operations per benchmark
+#define BENCH_BATCH_SIZE            1024   // strings prepared per batch for in-place string benchmarks
+
+// sample message text: 150 characters including spaces and URL-unsafe characters
+#define BENCH_MSG_TEXT  "Your verification code is 493021. It expires in 10 minutes & can only be used once; " \
+                        "do not share it with anyone (not even us): reply STOP to opt out!!"
+
+// sample API responses
+#define BENCH_HTTP_SEND_RESPONSE    "ID: 205e85d0578314037a96175249fc6a2b"
+#define BENCH_REST_SEND_RESPONSE    "{\"data\":{\"message\":[{\"accepted\":true,\"to\":\"2991000000\"," \
+                                    "\"apiMessageId\":\"77a4a70428f984d9741001e6f17d02b4\"}]}}"
+
+// message lengths and recipient counts covered by the serialization benchmark
+static const int aBenchTextLens[]  = { 20, 160, 459, 918 };
+static const int aBenchDestCounts[] = { 1, 10, 100, 1000 };
+
+// sample texts for the charset benchmark, repeated up to BENCH_CHARSET_TEXT_LEN bytes
+#define BENCH_CHARSET_TEXT_LEN  65536
+static const char *aBenchCharsetNames[] = { "ascii", "smart punct (ucs2)", "gsm7 + extension", "latin (ucs2)", "cyrillic (ucs2)",
+                                            "chinese (ucs2)" };
+static const char *aBenchCharsetTexts[] = {
+    BENCH_MSG_TEXT,
+    "Don\xe2\x80\x99t miss it \xe2\x80\x94 \xe2\x80\x9c" "50% off\xe2\x80\x9d everything today\xe2\x80\xa6 reply STOP to opt out. ",
+    "Pay \xe2\x82\xac" "12.50 {ref [A-7]} to Andr\xc3\xa9 M\xc3\xbcller ~ \xc3\x85ngstr\xc3\xb6m | caf\xc3\xa9 at 10:30. ",
+    "Gar\xc3\xa7on: votre r\xc3\xa9servation \xc3\xa0 l'h\xc3\xb4tel est confirm\xc3\xa9" "e pour le 12 ao\xc3\xbbt. ",
+    "\xd0\x92\xd0\xb0\xd1\x88 \xd0\xba\xd0\xbe\xd0\xb4 \xd0\xbf\xd0\xbe\xd0\xb4\xd1\x82\xd0\xb2\xd0\xb5\xd1\x80\xd0\xb6\xd0\xb4\xd0\xb5\xd0\xbd\xd0\xb8\xd1\x8f: 493021. ",
+    "\xe6\x82\xa8\xe7\x9a\x84\xe9\xaa\x8c\xe8\xaf\x81\xe7\xa0\x81\xe6\x98\xaf 493021\xef\xbc\x8c\xe8\xaf\xb7\xe5\x9c\xa8 10 \xe5\x88\x86\xe9\x92\x9f\xe5\x86\x85\xe4\xbd\xbf\xe7\x94\xa8\xe3\x80\x82"
+};
+
+// number formats for the MSISDN normalization benchmark, with '#' replaced by random digits
+#define BENCH_MSISDN_COUNT      100000
+static const char *aBenchMsisdnFormats[] = {
+    "278########", "+27 8# ### ####", "08#-###-####", "(08#) ### ####", "00278########", "+44 7### ######", "+1 (###) ###-####"
+};
+
+// personalised message for the template benchmark, as a template and as a printf format
+#define BENCH_TEMPLATE          "Hi {name}, your order {order} of {amount} ships on {date}. Track it at " \
+                                "https://example.com/t/{order} & reply STOP to opt out."
+#define BENCH_TEMPLATE_FORMAT   "Hi %s, your order %s of %s ships on %s. Track it at " \
+                                "https://example.com/t/%s & reply STOP to opt out."
+static const char *aBenchTemplateNames[] = { "name", "order", "amount", "date" };
+
+// size of the delimited number list of the recipients benchmark, and messages sent per list built
+#define BENCH_RECIPIENTS_COUNT  10000
+#define BENCH_RECIPIENTS_SENDS  10
+
+// recipients of the cost benchmark per iteration (10 million by default), and its price table
+#define BENCH_COST_PER_ITERATION    50
+#define BENCH_COST_PRICES           "27,0.21\n2782,0.19\n2783,0.2\n44,0.42\n1,0.08\n91,0.05\n*,0.5\n"
+static const char *aBenchCostNames[] = { "Anna", "Bob", "Chen Wei", "\xd0\x98\xd0\xb2\xd0\xb0\xd0\xbd",
+                                         "Zo\xc3\xab", "Mohammed", "Sipho", "Priya" };
+
+// connections and requests pipelined per write of the callback benchmark's client, and its requests
+#define BENCH_CALLBACK_CONNS        8
+#define BENCH_CALLBACK_PIPELINE     32
+#define BENCH_CALLBACK_RESPONSE_LF  3 // line feeds per response (status line, header and blank line)
+#define BENCH_CALLBACK_MO_QUEUE     4096
+#define BENCH_CALLBACK_MO           "GET /callback?api_id=3518209&moMsgId=b2aee337abd962489b123fda9c3480fa&from=279991235642" \
+                                    "&to=27991233331&timestamp=2008-08-06+09%3A43%3A50&charset=UTF-16BE&text=" \
+                                    "0421043F0430044104380431043E0021002000520065007000650061007400200074006F006D006F" \
+                                    "00720072006F0077003F0020D83DDE00 HTTP/1.1\r\nHost: callback.example.com\r\n\r\n"
+#define BENCH_CALLBACK_HTTP         "GET /callback?api_id=3518209&apiMsgId=996411ad91fa211e7d17bc873aa4a41d&cliMsgId=" \
+                                    "&timestamp=1218007814&to=279995631564&from=27833001171&status=004&charge=0.300000 " \
+                                    "HTTP/1.1\r\nHost: callback.example.com\r\nUser-Agent: Clickatell\r\n\r\n"
+#define BENCH_CALLBACK_REST_BODY    "{\"data\":{\"apiId\":\"3518209\",\"apiMessageId\":\"996411ad91fa211e7d17bc873aa4a41d\"," \
+                                    "\"clientMessageId\":\"\",\"timestamp\":1218007814,\"to\":\"279995631564\"," \
+                                    "\"from\":\"27833001171\",\"charge\":0.3,\"messageStatus\":\"004\"}}"
+
+// client of the callback benchmark, run on its own thread
+typedef struct BenchCallbackClient {
+    ClickCallbackServer *oServer; // server to send callbacks to (stopped when the client is done)
+    const char *chRequest;        // one request, repeated
+    long iRequests;               // requests to send
+    long iAnswered;               // responses received in full
+} BenchCallbackClient;
+
+// consumer of the callback benchmark's inbound message queue, run on its own thread
+typedef struct BenchCallbackConsumer {
+    ClickMoQueue *oQueue;         // queue to drain
+    int bDone;                    // set once the client is done, read atomically
+    long iPopped;                 // messages popped
+} BenchCallbackConsumer;
+
+// batch benchmark: template, recipients per quicksend.php request, and field values
+#define BENCH_BATCH_TEMPLATE        "Hi #field1#, your order #field2# ships today. Reply STOP to opt out."
+#define BENCH_BATCH_TEXT_FORMAT     "Hi %s, your order %ld ships today. Reply STOP to opt out."
+#define BENCH_BATCH_QUICKSEND       100
+static const char *aBenchBatchNames[] = { "Anna", "Bob", "Chen Wei", "Mohammed", "Sipho", "Priya" };
+
+// simulated messages, handles and clock of the poll benchmark
+#define BENCH_POLL_HANDLES          4
+#define BENCH_POLL_TICK_MS          250
+#define BENCH_POLL_SPREAD_MS        60000           // messages are added over the first minute
+#define BENCH_POLL_MAX_AGE_MS       (4L * 3600000)  // age at which undelivered messages expire
+#define BENCH_POLL_FIXED_MS         10000           // interval of the fixed schedule compared against
+
+// simulated network of the poll benchmark: message i was sent at aSentMs[i], reaches the
+// gateway (status 003, or 011 if queued) at aGatewayMs[i] and its final status at aFinalMs[i]
+typedef struct BenchPollWorld {
+    long long iNowMs;             // simulated clock
+    long long *aSentMs;
+    long long *aGatewayMs;
+    long long *aFinalMs;          // or -1 if the message never reaches a final status
+    int *aQueued;                 // 1 if queued for later delivery (status 011 at the gateway)
+    int *aFinalStatus;            // final status (4 received, or 7 error delivering)
+    long iFinalSeen;              // final statuses reported by the scheduler
+    double fStaleMs;              // sum of the delays between final statuses and their reports
+} BenchPollWorld;
+
+// local stand-in for the HTTP API of the post benchmark: answers each request on one keep-alive
+// connection with a line per recipient (recipients are counted from the "to" parameter)
+#define BENCH_POST_LINE             "ID: 205e85d0578314037a96175249fc6a2b To: 27820000000\n"
+#define BENCH_POST_BUFFER           65536
+typedef struct BenchStandin {
+    int  iListenFd;
+    long iRequests;   // requests answered
+} BenchStandin;
+
+// client end of the stand-in connection, used as the post benchmark's transport
+typedef struct BenchStandinConn {
+    int  iFd;
+    char aBuf[BENCH_POST_BUFFER]; // request head, then response
+} BenchStandinConn;
+
+// recipients per send, and recipients per iteration, of the stream benchmark
+#define BENCH_STREAM_RECIPIENTS     50000
+#define BENCH_STREAM_PER_SEND       10000
+#define BENCH_STREAM_READ_SIZE      16384   // libcurl's default upload buffer size
+
+// heap in use when the stream benchmark's transport was called, above the baseline
+typedef struct BenchStreamStats {
+    size_t iBaseline;   // heap in use before the send
+    size_t iPeak;       // most heap in use above the baseline while a request was sent
+    size_t iBodyLen;    // body bytes sent by the last request
+} BenchStreamStats;
+
+// response returned by the submit benchmark's transport, written in chunks as libcurl would
+#define BENCH_SUBMIT_CHUNK          16384   // libcurl's CURL_MAX_WRITE_SIZE
+#define BENCH_SUBMIT_TO_MAX         100
+
+typedef struct BenchSubmitResponse {
+    long   iStatus;     // HTTP status code
+    char  *chData;      // one result per recipient
+    size_t iLen;        // length of 'chData'
+} BenchSubmitResponse;
+
+// recipient group of the audience benchmark, sent a request per CLICK_SMS_HTTP_GET_TO_MAX recipients
+#define BENCH_AUDIENCE_RECIPIENTS   10000
+
+// totals recorded by the serialization benchmark's transport
+typedef struct BenchWireStats {
+    long   iRequests; // requests serialized
+    size_t iBytes;    // estimated bytes on the wire for all requests
+} BenchWireStats;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static ClickMsisdn *bench_msisdns_create(int iNum);
+static void bench_msisdns_destroy(ClickMsisdn *aMsisdns);
+static ClickSmsString *bench_rest_msgid_parse(const ClickSmsString *sResponse);
+static void bench_ops(long iIterations);
+static long bench_wire_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static ClickSmsString *bench_text_create(int iLen);
+static void bench_serialize(long iIterations);
+static void bench_charset(long iIterations);
+static void bench_msisdn(long iIterations);
+static void bench_template(long iIterations);
+static void bench_recipients(long iIterations);
+static void bench_cost(long iIterations);
+static void bench_callback_receipt(void *pContext, const ClickDeliveryReceipt *oReceipt);
+static void *bench_callback_client(void *pContext);
+static void *bench_callback_consumer(void *pContext);
+static void bench_callback(long iIterations);
+static long bench_poll_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void bench_poll_status(void *pContext, const char *chMsgId, int iStatus, eClickPollEvent eEvent);
+static void bench_poll(long iIterations);
+static void bench_batch(long iIterations);
+static long bench_standin_recipients(const char *chRequest);
+static void *bench_standin_server(void *pContext);
+static long bench_standin_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void bench_post(long iIterations);
+static long bench_stream_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void bench_stream(long iIterations);
+static void bench_submit_response(BenchSubmitResponse *oResponse, eClickApi eApiType, int iRecipients);
+static long bench_submit_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void bench_submit(long iIterations);
+static void bench_audience(long iIterations);
+static void bench_prepared(long iIterations);
+
+// benchmarks which can be selected on the command line
+typedef struct BenchEntry {
+    const char *chName;
+    void (*fnBench)(long iIterations);
+} BenchEntry;
+
+static const BenchEntry aBenchmarks[] = {
+    { "ops",        bench_ops },
+    { "serialize",  bench_serialize },
+    { "charset",    bench_charset },
+    { "msisdn",     bench_msisdn },
+    { "template",   bench_template },
+    { "recipients", bench_recipients },
+    { "cost",       bench_cost },
+    { "callback",   bench_callback },
+    { "poll",       bench_poll },
+    { "batch",      bench_batch },
+    { "post",       bench_post },
+    { "stream",     bench_stream },
+    { "submit",     bench_submit },
+    { "audience",   bench_audience },
+    { "prepared",   bench_prepared },
+};
+#define BENCH_COUNT (int)(sizeof(aBenchmarks) / sizeof(aBenchmarks[0]))
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  bench_msisdns_create
+ * Info:      Creates a destination address container with sequential numbers.
+ * Inputs:    iNum - number of destination addresses
+ * Return:    new container
+ */
+static ClickMsisdn *bench_msisdns_create(int iNum)
+{
+    int i = 0;
+    char chMsisdn[16];
+    ClickMsisdn *aMsisdns = (ClickMsisdn *)calloc(1, sizeof(ClickMsisdn));
+
+    aMsisdns->iNum   = iNum;
+    aMsisdns->aDests = calloc(iNum, sizeof(ClickSmsString *));
+
+    for (i = 0; i < iNum; i++) {
+        snprintf(chMsisdn, sizeof(chMsisdn), "2782%07d", i);
+        aMsisdns->aDests[i] = click_string_create(chMsisdn);
+    }
+
+    return aMsisdns;
+}
+
+/*
+ * Function:  bench_msisdns_destroy
+ * Info:      Destroys a container created by bench_msisdns_create().
+ * Inputs:    aMsisdns - container to destroy
+ * Return:    void
+ */
+static void bench_msisdns_destroy(ClickMsisdn *aMsisdns)
+{
+    int i = 0;
+
+    for (i = 0; i < aMsisdns->iNum; i++)
+        click_string_destroy(aMsisdns->aDests[i]);
+
+    free(aMsisdns->aDests);
+    free(aMsisdns);
+}
+
+/*
+ * Function:  bench_rest_msgid_parse
+ * Info:      Extracts the apiMessageId field from a REST send response, the same way
+ *            test_clickatell_sms.c does.
+ * Inputs:    sResponse - REST send message response
+ * Return:    new ClickSmsString containing the message ID, or NULL if not found
+ */
+static ClickSmsString *bench_rest_msgid_parse(const ClickSmsString *sResponse)
+{
+    int iPosStart = -1, iPosEnd = -1;
+    ClickSmsString *sMsgId = NULL;
+
+    if ((iPosStart = click_string_find_cstr(sResponse, "apiMessageId", 0)) > -1 &&
+        (iPosEnd = click_string_find_cstr(sResponse, "\"", (iPosStart + 14))) > -1) {
+        int iMsgIdSize = iPosEnd - 1 - (iPosStart + 14);
+        char *chBuf = calloc(iMsgIdSize + 1, sizeof(char));
+
+        memcpy(chBuf, sResponse->data + iPosStart + 14, iMsgIdSize);
+        sMsgId = click_string_create(chBuf);
+
+        free(chBuf);
+    }
+
+    return sMsgId;
+}
+
+/*
+ * Function:  bench_ops
+ * Info:      Benchmarks request construction for each API call type, URL encoding and
+ *            response parsing, reporting hardware counters per operation.
+ * Inputs:    iIterations - operations per benchmark
+ * Return:    void
+ */
+static void bench_ops(long iIterations)
+{
+    int i = 0, iApi = 0;
+    long iOp = 0, iBatch = 0;
+    PerfCounters oCounters;
+    ClickSmsHandle *aHandles[CLICK_API_COUNT];
+    ClickSmsString *sText     = click_string_create(BENCH_MSG_TEXT);
+    ClickSmsString *sMsgId    = click_string_create("205e85d0578314037a96175249fc6a2b");
+    ClickSmsString *sRestResp = click_string_create(BENCH_REST_SEND_RESPONSE);
+    ClickSmsString *sHttpResp = click_string_create(BENCH_HTTP_SEND_RESPONSE);
+    ClickSmsString *aBatch[BENCH_BATCH_SIZE];
+    ClickMsisdn *aMsisdns1  = bench_msisdns_create(1);
+    ClickMsisdn *aMsisdns10 = bench_msisdns_create(10);
+    char chName[64];
+
+    perf_counters_open(&oCounters);
+    if (!perf_counters_available(&oCounters, PERF_COUNTER_CYCLES))
+        printf("NOTE: hardware performance counters unavailable, reporting wall-clock time only\n");
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++)
+        aHandles[iApi] = loopback_handle_create((eClickApi)iApi);
+
+    printf("\nRequest construction (full API call against loopback transport, %ld calls each)\n", iIterations);
+    perf_counters_report_header();
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        const char *chApi = (iApi == CLICK_API_HTTP ? "HTTP" : "REST");
+
+        snprintf(chName, sizeof(chName), "%s message_send (1 dest)", chApi);
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++)
+            click_string_destroy(clickatell_sms_message_send(aHandles[iApi], sText, aMsisdns1));
+        perf_counters_stop(&oCounters);
+        perf_counters_report(&oCounters, chName, iIterations);
+
+        snprintf(chName, sizeof(chName), "%s message_send (10 dests)", chApi);
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++)
+            click_string_destroy(clickatell_sms_message_send(aHandles[iApi], sText, aMsisdns10));
+        perf_counters_stop(&oCounters);
+        perf_counters_report(&oCounters, chName, iIterations);
+
+        snprintf(chName, sizeof(chName), "%s status_get", chApi);
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++)
+            click_string_destroy(clickatell_sms_status_get(aHandles[iApi], sMsgId));
+        perf_counters_stop(&oCounters);
+        perf_counters_report(&oCounters, chName, iIterations);
+
+        snprintf(chName, sizeof(chName), "%s balance_get", chApi);
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++)
+            click_string_destroy(clickatell_sms_balance_get(aHandles[iApi]));
+        perf_counters_stop(&oCounters);
+        perf_counters_report(&oCounters, chName, iIterations);
+    }
+
+    printf("\nString operations (%ld operations each)\n", iIterations);
+    perf_counters_report_header();
+
+    // URL-encode in batches, so that preparing the strings to encode is not measured
+    double fElapsedNs = 0.0, aTotals[PERF_COUNTER_COUNT];
+    memset(aTotals, 0, sizeof(aTotals));
+    for (iOp = 0; iOp < iIterations; iOp += BENCH_BATCH_SIZE) {
+        iBatch = (iIterations - iOp < BENCH_BATCH_SIZE ? iIterations - iOp : BENCH_BATCH_SIZE);
+
+        for (i = 0; i < iBatch; i++)
+            aBatch[i] = click_string_duplicate(sText);
+
+        perf_counters_start(&oCounters);
+        for (i = 0; i < iBatch; i++)
+            click_string_url_encode(aBatch[i]);
+        perf_counters_stop(&oCounters);
+
+        fElapsedNs += oCounters.fElapsedNs;
+        for (i = 0; i < PERF_COUNTER_COUNT; i++)
+            aTotals[i] += oCounters.aValues[i];
+
+        for (i = 0; i < iBatch; i++)
+            click_string_destroy(aBatch[i]);
+    }
+    oCounters.fElapsedNs = fElapsedNs;
+    memcpy(oCounters.aValues, aTotals, sizeof(aTotals));
+    perf_counters_report(&oCounters, "url_encode (150 chars)", iIterations);
+
+    perf_counters_start(&oCounters);
+    for (iOp = 0; iOp < iIterations; iOp++)
+        click_string_destroy(bench_rest_msgid_parse(sRestResp));
+    perf_counters_stop(&oCounters);
+    perf_counters_report(&oCounters, "REST response parse (msg ID)", iIterations);
+
+    perf_counters_start(&oCounters);
+    for (iOp = 0; iOp < iIterations; iOp++) {
+        ClickSmsString *sResponse = click_string_duplicate(sHttpResp);
+        click_string_trim_prefix(sResponse, 4);
+        click_string_destroy(sResponse);
+    }
+    perf_counters_stop(&oCounters);
+    perf_counters_report(&oCounters, "HTTP response parse (incl. copy)", iIterations);
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++)
+        clickatell_sms_handle_shutdown(aHandles[iApi]);
+
+    perf_counters_close(&oCounters);
+
+    bench_msisdns_destroy(aMsisdns1);
+    bench_msisdns_destroy(aMsisdns10);
+    click_string_destroy(sText);
+    click_string_destroy(sMsgId);
+    click_string_destroy(sRestResp);
+    click_string_destroy(sHttpResp);
+}
+
+/*
+ * Function:  bench_wire_transport
+ * Info:      Transport which discards each request after estimating its size on the
+ *            wire as an HTTP/1.1 request: request line, Host header, the library's
+ *            headers, Content-Length (if there is a body) and body. TLS overhead is
+ *            not included. No response is returned, so that only serialization is
+ *            measured.
+ * Inputs:    pContext - BenchWireStats to update
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long bench_wire_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    BenchWireStats *oStats = (BenchWireStats *)pContext;
+    const struct curl_slist *oHeader = NULL;
+    const char *chTarget = strstr(oRequest->chUrl, "://");
+    size_t iBytes = 0;
+    char chContentLength[48];
+
+    // sessions are opened without being counted
+    if (strstr(oRequest->chUrl, "auth.php") != NULL) {
+        oRequest->fnWrite("OK: 2eda2fe1f07f6e4e96e3e2d39bd1b1b7", 1, 36, oRequest->pWriteData);
+        return 200;
+    }
+
+    // request line uses the path and query only: "GET /http/sendmsg.php?... HTTP/1.1\r\n"
+    chTarget = (chTarget != NULL ? strchr(chTarget + 3, '/') : NULL);
+    iBytes += strlen(oRequest->chMethod) + 1 + strlen(chTarget != NULL ? chTarget : oRequest->chUrl) + strlen(" HTTP/1.1\r\n");
+    iBytes += strlen("Host: api.clickatell.com\r\n");
+
+    // libcurl removes headers without a value (ie. "Expect:") rather than sending them
+    for (oHeader = oRequest->oHeaders; oHeader != NULL; oHeader = oHeader->next)
+        iBytes += (oHeader->data[strlen(oHeader->data) - 1] == ':' ? 0 : strlen(oHeader->data) + 2);
+
+    if (oRequest->chBody != NULL || oRequest->fnRead != NULL)
+        iBytes += snprintf(chContentLength, sizeof(chContentLength), "Content-Length: %zu\r\n", oRequest->iBodyLen);
+
+    iBytes += 2 + oRequest->iBodyLen; // blank line ending the headers, then the body
+
+    oStats->iRequests++;
+    oStats->iBytes += iBytes;
+
+    return 200;
+}
+
+/*
+ * Function:  bench_text_create
+ * Info:      Creates message text of a given length by repeating the sample message.
+ * Inputs:    iLen - length of message text
+ * Return:    new ClickSmsString
+ */
+static ClickSmsString *bench_text_create(int iLen)
+{
+    int i = 0;
+    int iSampleLen = strlen(BENCH_MSG_TEXT);
+    char *chText = malloc(iLen + 1);
+    ClickSmsString *sText = NULL;
+
+    for (i = 0; i < iLen; i++)
+        chText[i] = BENCH_MSG_TEXT[i % iSampleLen];
+    chText[iLen] = '\0';
+
+    sText = click_string_create(chText);
+    free(chText);
+
+    return sText;
+}
+
+/*
+ * Function:  bench_serialize
+ * Info:      Compares send message request serialization for the HTTP and REST APIs,
+ *            across message lengths and recipient counts, with no I/O. The number of
+ *            requests made per configuration is scaled down by the recipient count,
+ *            so that each configuration serializes a similar number of recipients.
+ * Inputs:    iIterations - requests per configuration (for a single recipient)
+ * Return:    void
+ */
+static void bench_serialize(long iIterations)
+{
+    int iLen = 0, iDests = 0, iApi = 0;
+    long iOp = 0, iRequests = 0;
+    PerfCounters oCounters;
+    BenchWireStats aStats[CLICK_API_COUNT];
+    double aNsPerRequest[CLICK_API_COUNT];
+    ClickSmsHandle *aHandles[CLICK_API_COUNT];
+
+    perf_counters_open(&oCounters);
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        aHandles[iApi] = loopback_handle_create((eClickApi)iApi);
+        clickatell_sms_handle_transport_set(aHandles[iApi], bench_wire_transport, &aStats[iApi]);
+    }
+
+    printf("\nSend message serialization, HTTP (GET query string) vs REST (JSON body), no I/O\n");
+    printf("%6s %6s | %12s %12s %10s | %12s %12s %10s | %9s %9s\n", "chars", "dests",
+           "HTTP ns/req", "HTTP ns/msg", "HTTP B/req", "REST ns/req", "REST ns/msg", "REST B/req", "time R/H", "bytes R/H");
+
+    for (iLen = 0; iLen < (int)(sizeof(aBenchTextLens) / sizeof(aBenchTextLens[0])); iLen++) {
+        ClickSmsString *sText = bench_text_create(aBenchTextLens[iLen]);
+
+        for (iDests = 0; iDests < (int)(sizeof(aBenchDestCounts) / sizeof(aBenchDestCounts[0])); iDests++) {
+            ClickMsisdn *aMsisdns = bench_msisdns_create(aBenchDestCounts[iDests]);
+
+            iRequests = iIterations / aBenchDestCounts[iDests];
+            if (iRequests < 20)
+                iRequests = 20;
+
+            for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+                memset(&aStats[iApi], 0, sizeof(BenchWireStats));
+
+                perf_counters_start(&oCounters);
+                for (iOp = 0; iOp < iRequests; iOp++)
+                    click_string_destroy(clickatell_sms_message_send(aHandles[iApi], sText, aMsisdns));
+                perf_counters_stop(&oCounters);
+
+                aNsPerRequest[iApi] = oCounters.fElapsedNs / iRequests;
+            }
+
+            double fHttpBytes = (double)aStats[CLICK_API_HTTP].iBytes / aStats[CLICK_API_HTTP].iRequests;
+            double fRestBytes = (double)aStats[CLICK_API_REST].iBytes / aStats[CLICK_API_REST].iRequests;
+
+            printf("%6d %6d | %12.0f %12.1f %10.0f | %12.0f %12.1f %10.0f | %8.2fx %8.2fx\n",
+                   aBenchTextLens[iLen], aBenchDestCounts[iDests],
+                   aNsPerRequest[CLICK_API_HTTP], aNsPerRequest[CLICK_API_HTTP] / aBenchDestCounts[iDests], fHttpBytes,
+                   aNsPerRequest[CLICK_API_REST], aNsPerRequest[CLICK_API_REST] / aBenchDestCounts[iDests], fRestBytes,
+                   aNsPerRequest[CLICK_API_REST] / aNsPerRequest[CLICK_API_HTTP], fRestBytes / fHttpBytes);
+
+            bench_msisdns_destroy(aMsisdns);
+        }
+
+        click_string_destroy(sText);
+    }
+
+    printf("ns/msg is the time per recipient message; R/H columns are REST relative to HTTP;\n"
+           "bytes are estimated HTTP/1.1 request sizes excluding TLS\n");
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++)
+        clickatell_sms_handle_shutdown(aHandles[iApi]);
+
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_charset
+ * Info:      Measures GSM 03.38 classification (click_charset_classify()), GSM 7-bit
+ *            packing (click_charset_gsm7_pack()), UCS-2 hex encoding
+ *            (click_charset_ucs2_hex_encode()) and transliteration
+ *            (click_charset_transliterate()) throughput, over large texts and per single
+ *            160 byte message, and whether transliteration makes the text GSM 7-bit.
+ *            Also measures hex encoding of binary message data (click_charset_hex_encode()).
+ * Inputs:    iIterations - scales the number of passes over each text
+ * Return:    void
+ */
+static void bench_charset(long iIterations)
+{
+    int iText = 0;
+    long iPass = 0, iPasses = 0, iMsgLen = 0, iSampleLen = 0, iLen = 0, iPacked = 0;
+    volatile long iSink = 0;
+    double fClassifyNs = 0.0, fMsgNs = 0.0, fPackNs = 0.0, fHexNs = 0.0, fTranslitNs = 0.0;
+    char *chText = malloc(BENCH_CHARSET_TEXT_LEN);
+    char *chTranslit = malloc(CLICK_CHARSET_TRANSLIT_SIZE(BENCH_CHARSET_TEXT_LEN));
+    long iTranslitLen = 0;
+    ClickCharsetInfo oTranslitInfo;
+    unsigned char *aPacked = malloc(BENCH_CHARSET_TEXT_LEN);
+    char *chHex = malloc(4 * BENCH_CHARSET_TEXT_LEN + 1);
+    ClickCharsetInfo oInfo;
+    PerfCounters oCounters;
+
+    perf_counters_open(&oCounters);
+
+    // enough passes over the 64 KB texts to take a measurable time
+    iPasses = iIterations / 200;
+    if (iPasses < 10)
+        iPasses = 10;
+
+    printf("\nGSM 03.38 charset classification, packing, UCS-2 hex encoding and transliteration (%d byte texts, %ld passes)\n",
+           BENCH_CHARSET_TEXT_LEN, iPasses);
+    printf("%-18s %8s %10s %12s %14s %10s %10s %13s %10s\n", "text", "charset", "septets/B", "classify GB/s", "ns/160B msg",
+           "pack GB/s", "hex GB/s", "translit GB/s", "translit");
+
+    for (iText = 0; iText < (int)(sizeof(aBenchCharsetTexts) / sizeof(aBenchCharsetTexts[0])); iText++) {
+        // whole copies of the sample only, so that no UTF-8 character is cut
+        iSampleLen = strlen(aBenchCharsetTexts[iText]);
+        for (iLen = 0; iLen + iSampleLen <= BENCH_CHARSET_TEXT_LEN; iLen += iSampleLen)
+            memcpy(chText + iLen, aBenchCharsetTexts[iText], iSampleLen);
+
+        perf_counters_start(&oCounters);
+        for (iPass = 0; iPass < iPasses; iPass++)
+            iSink += click_charset_classify(chText, iLen, &oInfo);
+        perf_counters_stop(&oCounters);
+        fClassifyNs = oCounters.fElapsedNs / iPasses;
+
+        // a typical single message: the first 160 bytes, cut back to a character boundary
+        for (iMsgLen = 160; iMsgLen > 0 && ((unsigned char)chText[iMsgLen] & 0xc0) == 0x80; iMsgLen--)
+            ;
+        perf_counters_start(&oCounters);
+        for (iPass = 0; iPass < iIterations; iPass++)
+            iSink += click_charset_classify(chText, iMsgLen, NULL);
+        perf_counters_stop(&oCounters);
+        fMsgNs = oCounters.fElapsedNs / iIterations;
+
+        fPackNs = 0.0;
+        if (oInfo.eCharset == CLICK_CHARSET_GSM7) {
+            perf_counters_start(&oCounters);
+            for (iPass = 0; iPass < iPasses; iPass++)
+                iPacked = click_charset_gsm7_pack(chText, iLen, 0, aPacked, BENCH_CHARSET_TEXT_LEN);
+            perf_counters_stop(&oCounters);
+            fPackNs = oCounters.fElapsedNs / iPasses;
+            iSink += iPacked;
+        }
+
+        fHexNs = 0.0;
+        if (oInfo.eCharset == CLICK_CHARSET_UCS2) {
+            perf_counters_start(&oCounters);
+            for (iPass = 0; iPass < iPasses; iPass++)
+                iSink += click_charset_ucs2_hex_encode(chText, iLen, chHex, 4 * BENCH_CHARSET_TEXT_LEN + 1);
+            perf_counters_stop(&oCounters);
+            fHexNs = oCounters.fElapsedNs / iPasses;
+        }
+
+        perf_counters_start(&oCounters);
+        for (iPass = 0; iPass < iPasses; iPass++)
+            iTranslitLen = click_charset_transliterate(chText, iLen, chTranslit, CLICK_CHARSET_TRANSLIT_SIZE(iLen), NULL);
+        perf_counters_stop(&oCounters);
+        fTranslitNs = oCounters.fElapsedNs / iPasses;
+        click_charset_classify(chTranslit, iTranslitLen, &oTranslitInfo);
+
+        printf("%-18s %8s %10.2f %12.2f %14.1f ", aBenchCharsetNames[iText],
+               (oInfo.eCharset == CLICK_CHARSET_GSM7 ? "gsm7" : (oInfo.eCharset == CLICK_CHARSET_UCS2 ? "ucs2" : "invalid")),
+               (oInfo.eCharset == CLICK_CHARSET_GSM7 ? (double)oInfo.iSeptets / iLen : 0.0),
+               (double)iLen / fClassifyNs, fMsgNs);
+        if (fPackNs > 0.0)
+            printf("%10.2f ", (double)iLen / fPackNs);
+        else
+            printf("%10s ", "-");
+        if (fHexNs > 0.0)
+            printf("%10.2f ", (double)iLen / fHexNs);
+        else
+            printf("%10s ", "-");
+        printf("%13.2f %10s\n", (double)iLen / fTranslitNs, (oTranslitInfo.eCharset == CLICK_CHARSET_GSM7 ? "-> gsm7" : "-> ucs2"));
+    }
+
+    // binary message data (random octets), hex encoded as it is written into binary send requests
+    srand(1);
+    for (iLen = 0; iLen < BENCH_CHARSET_TEXT_LEN; iLen++)
+        chText[iLen] = (char)rand();
+
+    perf_counters_start(&oCounters);
+    for (iPass = 0; iPass < iPasses; iPass++)
+        iSink += click_charset_hex_encode((const unsigned char *)chText, iLen, chHex, 4 * BENCH_CHARSET_TEXT_LEN + 1);
+    perf_counters_stop(&oCounters);
+    fHexNs = oCounters.fElapsedNs / iPasses;
+
+    perf_counters_start(&oCounters);
+    for (iPass = 0; iPass < iIterations; iPass++)
+        iSink += click_charset_hex_encode((const unsigned char *)chText, CLICK_SEGMENT_DATA_MAX, chHex, 4 * BENCH_CHARSET_TEXT_LEN + 1);
+    perf_counters_stop(&oCounters);
+    fMsgNs = oCounters.fElapsedNs / iIterations;
+
+    printf("%-18s hex encoding %.2f GB/s, %.1f ns per %d octet SMS\n", "binary data", (double)iLen / fHexNs, fMsgNs,
+           CLICK_SEGMENT_DATA_MAX);
+
+    free(chText);
+    free(chTranslit);
+    free(aPacked);
+    free(chHex);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_msisdn
+ * Info:      Measures MSISDN normalization throughput over a list of numbers in mixed
+ *            formats, with South African rules for national numbers.
+ * Inputs:    iIterations - scales the number of passes over the list
+ * Return:    void
+ */
+static void bench_msisdn(long iIterations)
+{
+    ClickMsisdnRules oRules = { 27, "0", "00" };
+    const char **aNumbers = malloc(BENCH_MSISDN_COUNT * sizeof(const char *));
+    char *chNumbers = malloc(BENCH_MSISDN_COUNT * 24);
+    unsigned long long *aValues = malloc(BENCH_MSISDN_COUNT * sizeof(unsigned long long));
+    long i = 0, iPass = 0, iPasses = 0, iValid = 0;
+    char *pNumber = NULL;
+    PerfCounters oCounters;
+
+    perf_counters_open(&oCounters);
+
+    iPasses = iIterations / 20000;
+    if (iPasses < 5)
+        iPasses = 5;
+
+    srand(1);
+    for (i = 0; i < BENCH_MSISDN_COUNT; i++) {
+        pNumber = chNumbers + i * 24;
+        strcpy(pNumber, aBenchMsisdnFormats[i % (sizeof(aBenchMsisdnFormats) / sizeof(aBenchMsisdnFormats[0]))]);
+        for (; *pNumber != '\0'; pNumber++) {
+            if (*pNumber == '#')
+                *pNumber = (char)('0' + rand() % 10);
+        }
+        aNumbers[i] = chNumbers + i * 24;
+    }
+
+    perf_counters_start(&oCounters);
+    for (iPass = 0; iPass < iPasses; iPass++)
+        iValid = click_msisdn_normalize_batch(aNumbers, BENCH_MSISDN_COUNT, &oRules, aValues, NULL);
+    perf_counters_stop(&oCounters);
+
+    printf("\nMSISDN normalization to E.164 (%d numbers in %d formats, %ld passes)\n", BENCH_MSISDN_COUNT,
+           (int)(sizeof(aBenchMsisdnFormats) / sizeof(aBenchMsisdnFormats[0])), iPasses);
+    printf("%-18s %12s %14s %10s\n", "", "ns/number", "numbers/s", "valid");
+    printf("%-18s %12.1f %14.0f %10ld\n", "normalize batch", oCounters.fElapsedNs / (iPasses * (double)BENCH_MSISDN_COUNT),
+           (iPasses * (double)BENCH_MSISDN_COUNT) / (oCounters.fElapsedNs / 1e9), iValid);
+
+    free(aNumbers);
+    free(chNumbers);
+    free(aValues);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_template
+ * Info:      Compares personalised sends to a single recipient: the text rendered from a
+ *            compiled template into a reused buffer, versus formatted with snprintf() into
+ *            a new ClickSmsString, for both APIs with no I/O.
+ * Inputs:    iIterations - messages sent per configuration
+ * Return:    void
+ */
+static void bench_template(long iIterations)
+{
+    int iApi = 0;
+    long iOp = 0;
+    char chName[24], chOrder[24], chText[256];
+    const char *aValues[] = { chName, chOrder, "R 1,249.00", "12 March" };
+    double aNs[CLICK_API_COUNT][2];
+    PerfCounters oCounters;
+    BenchWireStats oStats;
+    ClickSmsBuffer oText = { NULL, 0, 0 };
+    ClickSmsString *sText = NULL;
+    ClickMsisdn *aMsisdns = bench_msisdns_create(1);
+    ClickTemplate *oTemplate = click_template_compile(BENCH_TEMPLATE, aBenchTemplateNames,
+                                                      sizeof(aBenchTemplateNames) / sizeof(aBenchTemplateNames[0]));
+
+    perf_counters_open(&oCounters);
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        ClickSmsHandle *oHandle = loopback_handle_create((eClickApi)iApi);
+        clickatell_sms_handle_transport_set(oHandle, bench_wire_transport, &oStats);
+
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++) {
+            snprintf(chName, sizeof(chName), "User%ld", iOp);
+            snprintf(chOrder, sizeof(chOrder), "A%07ld", iOp);
+            snprintf(chText, sizeof(chText), BENCH_TEMPLATE_FORMAT, aValues[0], aValues[1], aValues[2], aValues[3], aValues[1]);
+            sText = click_string_create(chText);
+            click_string_destroy(clickatell_sms_message_send(oHandle, sText, aMsisdns));
+            click_string_destroy(sText);
+        }
+        perf_counters_stop(&oCounters);
+        aNs[iApi][0] = oCounters.fElapsedNs / iIterations;
+
+        perf_counters_start(&oCounters);
+        for (iOp = 0; iOp < iIterations; iOp++) {
+            snprintf(chName, sizeof(chName), "User%ld", iOp);
+            snprintf(chOrder, sizeof(chOrder), "A%07ld", iOp);
+            click_buffer_reset(&oText);
+            click_template_render(oTemplate, aValues, NULL, CLICK_ENCODING_RAW, &oText);
+            click_string_destroy(clickatell_sms_message_send_buffer(oHandle, &oText, aMsisdns));
+        }
+        perf_counters_stop(&oCounters);
+        aNs[iApi][1] = oCounters.fElapsedNs / iIterations;
+
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+
+    printf("\nPersonalised sends, snprintf + ClickSmsString vs template rendered into a reused buffer, no I/O\n");
+    printf("%-6s %14s %14s %9s\n", "api", "printf ns/msg", "tmpl ns/msg", "speedup");
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++)
+        printf("%-6s %14.0f %14.0f %8.2fx\n", (iApi == CLICK_API_HTTP ? "HTTP" : "REST"),
+               aNs[iApi][0], aNs[iApi][1], aNs[iApi][0] / aNs[iApi][1]);
+
+    click_buffer_free(&oText);
+    click_template_destroy(oTemplate);
+    bench_msisdns_destroy(aMsisdns);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_recipients
+ * Info:      Compares building a recipient list from a newline-delimited buffer of
+ *            numbers, and sending a message to it, as a ClickMsisdn (one ClickSmsString
+ *            per number) versus a ClickRecipients list (reused from pass to pass), for both
+ *            APIs with no I/O. Each list built is sent BENCH_RECIPIENTS_SENDS messages. The
+ *            ClickRecipients list is also normalized and validated as it is built. Also
+ *            measures click_recipients_dedup() on a list of repeated numbers.
+ * Inputs:    iIterations - scales the number of passes over the list
+ * Return:    void
+ */
+static void bench_recipients(long iIterations)
+{
+    int iApi = 0;
+    long i = 0, iPass = 0, iPasses = 0, iListLen = 0;
+    double aNs[CLICK_API_COUNT][4];
+    char *chList = malloc(BENCH_RECIPIENTS_COUNT * 16 + 1), *pNumber = NULL, *pEnd = NULL;
+    ClickMsisdnRules oRules = { 27, "0", "00" };
+    ClickRecipients *oRecipients = click_recipients_create(0);
+    ClickMsisdn oMsisdns = { BENCH_RECIPIENTS_COUNT, calloc(BENCH_RECIPIENTS_COUNT, sizeof(ClickSmsString *)) };
+    ClickSmsString *sText = click_string_create(BENCH_MSG_TEXT);
+    PerfCounters oCounters;
+    BenchWireStats oStats;
+
+    perf_counters_open(&oCounters);
+
+    iPasses = iIterations / 20000;
+    if (iPasses < 5)
+        iPasses = 5;
+
+    for (i = 0; i < BENCH_RECIPIENTS_COUNT; i++)
+        iListLen += sprintf(chList + iListLen, "2782%07ld\n", i);
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        ClickSmsHandle *oHandle = loopback_handle_create((eClickApi)iApi);
+        clickatell_sms_handle_transport_set(oHandle, bench_wire_transport, &oStats);
+        memset(aNs[iApi], 0, sizeof(aNs[iApi]));
+
+        for (iPass = 0; iPass < iPasses; iPass++) {
+            // ClickMsisdn: split the list and create a string per number
+            perf_counters_start(&oCounters);
+            for (i = 0, pNumber = chList; i < BENCH_RECIPIENTS_COUNT; i++, pNumber = pEnd + 1) {
+                pEnd = strchr(pNumber, '\n');
+                *pEnd = '\0';
+                oMsisdns.aDests[i] = click_string_create(pNumber);
+                *pEnd = '\n';
+            }
+            perf_counters_stop(&oCounters);
+            aNs[iApi][0] += oCounters.fElapsedNs;
+
+            perf_counters_start(&oCounters);
+            for (i = 0; i < BENCH_RECIPIENTS_SENDS; i++)
+                click_string_destroy(clickatell_sms_message_send(oHandle, sText, &oMsisdns));
+            perf_counters_stop(&oCounters);
+            aNs[iApi][1] += oCounters.fElapsedNs;
+
+            for (i = 0; i < BENCH_RECIPIENTS_COUNT; i++)
+                click_string_destroy(oMsisdns.aDests[i]);
+
+            // ClickRecipients: parse (and normalize) the list in one pass
+            perf_counters_start(&oCounters);
+            click_recipients_reset(oRecipients);
+            click_recipients_parse(oRecipients, chList, iListLen, &oRules, NULL);
+            perf_counters_stop(&oCounters);
+            aNs[iApi][2] += oCounters.fElapsedNs;
+
+            perf_counters_start(&oCounters);
+            for (i = 0; i < BENCH_RECIPIENTS_SENDS; i++)
+                click_string_destroy(clickatell_sms_message_send_recipients(oHandle, sText->data, -1, oRecipients));
+            perf_counters_stop(&oCounters);
+            aNs[iApi][3] += oCounters.fElapsedNs;
+        }
+
+        for (i = 0; i < 4; i++)
+            aNs[iApi][i] /= (double)iPasses * BENCH_RECIPIENTS_COUNT * (i % 2 == 1 ? BENCH_RECIPIENTS_SENDS : 1);
+
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+
+    printf("\nRecipient lists of %d numbers, ClickMsisdn vs ClickRecipients (parsed and normalized), ns per recipient\n",
+           BENCH_RECIPIENTS_COUNT);
+    printf("%-6s %12s %12s | %12s %12s | %12s\n", "api", "msisdn build", "msisdn send", "recip build", "recip send", "send speedup");
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++)
+        printf("%-6s %12.1f %12.1f | %12.1f %12.1f | %11.2fx\n", (iApi == CLICK_API_HTTP ? "HTTP" : "REST"),
+               aNs[iApi][0], aNs[iApi][1], aNs[iApi][2], aNs[iApi][3], aNs[iApi][1] / aNs[iApi][3]);
+
+    // deduplication of a list in which each number appears twice on average
+    long *aMap = malloc(BENCH_RECIPIENTS_COUNT * sizeof(long));
+    double fDedupNs = 0;
+    long iRemoved = 0;
+
+    srand(1);
+    for (iPass = 0; iPass < iPasses; iPass++) {
+        click_recipients_reset(oRecipients);
+        for (i = 0; i < BENCH_RECIPIENTS_COUNT; i++)
+            click_recipients_add_value(oRecipients, 27820000000ULL + rand() % (BENCH_RECIPIENTS_COUNT / 2));
+
+        perf_counters_start(&oCounters);
+        iRemoved = click_recipients_dedup(oRecipients, aMap);
+        perf_counters_stop(&oCounters);
+        fDedupNs += oCounters.fElapsedNs;
+    }
+    printf("%-6s %12.1f ns per recipient (%ld of %d removed)\n", "dedup", fDedupNs / ((double)iPasses * BENCH_RECIPIENTS_COUNT),
+           iRemoved, BENCH_RECIPIENTS_COUNT);
+    free(aMap);
+
+    click_string_destroy(sText);
+    click_recipients_destroy(oRecipients);
+    free(oMsisdns.aDests);
+    free(chList);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_cost
+ * Info:      Measures campaign cost estimates over a list of BENCH_COST_PER_ITERATION
+ *            recipients per iteration, priced from BENCH_COST_PRICES: a single text (parts
+ *            counted once, each recipient priced), and a template rendered with each
+ *            recipient's name (parts counted per recipient), on one thread and on all
+ *            cores.
+ * Inputs:    iIterations - scales the number of recipients
+ * Return:    void
+ */
+static void bench_cost(long iIterations)
+{
+    static const unsigned long long aPrefixes[] = { 27820000000ULL, 27830000000ULL, 27710000000ULL, 447700000000ULL,
+                                                    12025550000ULL, 919800000000ULL };
+    long i = 0, iNum = iIterations * BENCH_COST_PER_ITERATION;
+    int iRun = 0, iThreads = 0;
+    double fNs = 0.0;
+    const char **aValues = malloc(iNum * sizeof(char *));
+    int *aParts = malloc(iNum * sizeof(int));
+    ClickPriceTable *oPrices = click_price_table_create();
+    ClickRecipients *oRecipients = click_recipients_create(iNum);
+    ClickTemplate *oTemplate = click_template_compile("Hi {name}, your order ships today. Reply STOP to opt out.",
+                                                      aBenchTemplateNames, 1);
+    ClickCostEstimate oEstimate;
+    PerfCounters oCounters;
+
+    perf_counters_open(&oCounters);
+
+    click_price_table_parse(oPrices, BENCH_COST_PRICES, strlen(BENCH_COST_PRICES));
+    for (i = 0; i < iNum; i++) {
+        click_recipients_add_value(oRecipients, aPrefixes[i % 6] + i % 9999991);
+        aValues[i] = aBenchCostNames[i % 8];
+    }
+
+    printf("\nCampaign cost estimates over %ld recipients, ms per estimate\n", iNum);
+    printf("%-9s %8s %10s %14s %12s %10s %14s\n", "message", "threads", "ms", "recipients/s", "parts", "ucs2", "cost");
+    for (iRun = 0; iRun < 4; iRun++) {
+        iThreads = (iRun % 2 == 0 ? 1 : 0);
+        perf_counters_start(&oCounters);
+        if (iRun < 2)
+            click_cost_estimate(oPrices, oRecipients, BENCH_MSG_TEXT, -1, iThreads, &oEstimate, aParts, NULL);
+        else
+            click_cost_estimate_template(oPrices, oRecipients, oTemplate, aValues, NULL, iThreads, &oEstimate, aParts, NULL);
+        perf_counters_stop(&oCounters);
+        fNs = oCounters.fElapsedNs;
+
+        printf("%-9s %8s %10.1f %14.0f %12lld %10ld %14.2f\n", (iRun < 2 ? "text" : "template"),
+               (iThreads == 1 ? "1" : "all"), fNs / 1e6, iNum / (fNs / 1e9), oEstimate.iParts, oEstimate.iUcs2,
+               oEstimate.fCost);
+    }
+
+    click_template_destroy(oTemplate);
+    click_recipients_destroy(oRecipients);
+    click_price_table_destroy(oPrices);
+    free(aParts);
+    free(aValues);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_callback_receipt
+ * Info:      Receipt handler of the callback benchmark: counts delivered messages.
+ * Inputs:    pContext - count of receipts with status 4 (received by recipient)
+ *            oReceipt - delivery receipt
+ * Return:    void
+ */
+static void bench_callback_receipt(void *pContext, const ClickDeliveryReceipt *oReceipt)
+{
+    if (oReceipt->iStatus == 4)
+        (*(long *)pContext)++;
+}
+
+/*
+ * Function:  bench_callback_client
+ * Info:      Client thread of the callback benchmark: sends the request over
+ *            BENCH_CALLBACK_CONNS keep-alive connections in turn, BENCH_CALLBACK_PIPELINE
+ *            requests per write, reading all responses (counted by their line feeds, as
+ *            refusals are longer) before the next write on that connection. Stops the
+ *            server when done.
+ * Inputs:    pContext - BenchCallbackClient
+ * Return:    NULL
+ */
+static void *bench_callback_client(void *pContext)
+{
+    BenchCallbackClient *oClient = (BenchCallbackClient *)pContext;
+    struct sockaddr_in oAddr;
+    int aFds[BENCH_CALLBACK_CONNS];
+    int i = 0, iConn = 0, iBatch = 0;
+    long iReqLen = (long)strlen(oClient->chRequest);
+    long iSent = 0, iLineFeeds = 0;
+    ssize_t iRet = 0, iPos = 0;
+    char *chBatch = malloc(iReqLen * BENCH_CALLBACK_PIPELINE);
+    char aResp[4096];
+
+    for (i = 0; i < BENCH_CALLBACK_PIPELINE; i++)
+        memcpy(chBatch + i * iReqLen, oClient->chRequest, iReqLen);
+
+    memset(&oAddr, 0, sizeof(oAddr));
+    oAddr.sin_family = AF_INET;
+    oAddr.sin_port   = htons((unsigned short)click_callback_server_port(oClient->oServer));
+    inet_pton(AF_INET, "127.0.0.1", &oAddr.sin_addr);
+    for (i = 0; i < BENCH_CALLBACK_CONNS; i++) {
+        aFds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(aFds[i], (struct sockaddr *)&oAddr, sizeof(oAddr)) != 0)
+            goto done;
+    }
+
+    while (iSent < oClient->iRequests) {
+        iBatch = (int)(oClient->iRequests - iSent < BENCH_CALLBACK_PIPELINE ? oClient->iRequests - iSent : BENCH_CALLBACK_PIPELINE);
+        if (send(aFds[iConn], chBatch, iReqLen * iBatch, MSG_NOSIGNAL) != iReqLen * iBatch)
+            goto done;
+        iSent += iBatch;
+
+        for (iLineFeeds = 0; iLineFeeds < BENCH_CALLBACK_RESPONSE_LF * iBatch; ) {
+            if ((iRet = recv(aFds[iConn], aResp, sizeof(aResp), 0)) <= 0)
+                goto done;
+            for (iPos = 0; iPos < iRet; iPos++)
+                iLineFeeds += (aResp[iPos] == '\n');
+        }
+        oClient->iAnswered += iBatch;
+        iConn = (iConn + 1) % BENCH_CALLBACK_CONNS;
+    }
+
+done:
+    for (i = 0; i < BENCH_CALLBACK_CONNS; i++) {
+        if (aFds[i] >= 0)
+            close(aFds[i]);
+    }
+    free(chBatch);
+    click_callback_server_stop(oClient->oServer);
+
+    return NULL;
+}
+
+/*
+ * Function:  bench_callback_consumer
+ * Info:      Consumer thread of the callback benchmark: pops inbound messages until the
+ *            client is done and the queue is empty.
+ * Inputs:    pContext - BenchCallbackConsumer
+ * Return:    NULL
+ */
+static void *bench_callback_consumer(void *pContext)
+{
+    BenchCallbackConsumer *oConsumer = (BenchCallbackConsumer *)pContext;
+    ClickMoMessage oMessage;
+    int bDone = 0;
+
+    for (;;) {
+        bDone = __atomic_load_n(&oConsumer->bDone, __ATOMIC_ACQUIRE);
+        if (click_mo_queue_pop(oConsumer->oQueue, &oMessage) == 1) {
+            oConsumer->iPopped++;
+        }
+        else if (bDone)
+            break;
+        else
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+/*
+ * Function:  bench_callback
+ * Info:      Benchmarks the callback receiver: the server runs on this thread while a
+ *            local client sends delivery receipts in the HTTP and REST formats, then
+ *            inbound messages which a consumer thread pops.
+ * Inputs:    iIterations - number of callbacks per format
+ * Return:    void
+ */
+static void bench_callback(long iIterations)
+{
+    static const char *aNames[] = { "http (get)", "rest (json)", "mo (ucs2)" };
+    ClickCallbackServer *oServer = click_callback_server_create("127.0.0.1", 0, BENCH_CALLBACK_CONNS);
+    ClickMoQueue *oQueue = click_mo_queue_create(BENCH_CALLBACK_MO_QUEUE);
+    BenchCallbackClient oClient;
+    BenchCallbackConsumer oConsumer;
+    ClickCallbackStats oStats;
+    PerfCounters oCounters;
+    pthread_t oThread, oConsumerThread;
+    char aRest[1024];
+    long iDelivered = 0;
+    int iRun = 0;
+
+    if (oServer == NULL || oQueue == NULL) {
+        printf("\nCallback receiver: failed to listen on a local port\n");
+        click_callback_server_destroy(oServer);
+        click_mo_queue_destroy(oQueue);
+        return;
+    }
+    perf_counters_open(&oCounters);
+    click_callback_server_receipt_handler_set(oServer, bench_callback_receipt, &iDelivered);
+    click_callback_server_mo_queue_set(oServer, oQueue);
+    snprintf(aRest, sizeof(aRest), "POST /callback HTTP/1.1\r\nHost: callback.example.com\r\n"
+             "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+             (int)strlen(BENCH_CALLBACK_REST_BODY), BENCH_CALLBACK_REST_BODY);
+
+    printf("\nDelivery receipt and inbound message callbacks over %d keep-alive connections, %d requests pipelined\n",
+           BENCH_CALLBACK_CONNS, BENCH_CALLBACK_PIPELINE);
+    printf("%-12s %10s %10s %14s %10s %10s\n", "format", "callbacks", "ms", "callbacks/s", "ns/call", "delivered");
+    for (iRun = 0; iRun < 3; iRun++) {
+        memset(&oClient, 0, sizeof(oClient));
+        memset(&oConsumer, 0, sizeof(oConsumer));
+        oClient.oServer   = oServer;
+        oClient.chRequest = (iRun == 0 ? BENCH_CALLBACK_HTTP : (iRun == 1 ? aRest : BENCH_CALLBACK_MO));
+        oClient.iRequests = iIterations;
+        oConsumer.oQueue  = oQueue;
+        iDelivered = 0;
+
+        perf_counters_start(&oCounters);
+        pthread_create(&oThread, NULL, bench_callback_client, &oClient);
+        if (iRun == 2)
+            pthread_create(&oConsumerThread, NULL, bench_callback_consumer, &oConsumer);
+        click_callback_server_run(oServer);
+        pthread_join(oThread, NULL);
+        if (iRun == 2) {
+            __atomic_store_n(&oConsumer.bDone, 1, __ATOMIC_RELEASE);
+            pthread_join(oConsumerThread, NULL);
+            iDelivered = oConsumer.iPopped;
+        }
+        perf_counters_stop(&oCounters);
+
+        printf("%-12s %10ld %10.1f %14.0f %10.0f %10ld\n", aNames[iRun], oClient.iAnswered, oCounters.fElapsedNs / 1e6,
+               oClient.iAnswered / (oCounters.fElapsedNs / 1e9), oCounters.fElapsedNs / oClient.iAnswered, iDelivered);
+    }
+
+    click_callback_server_stats_get(oServer, &oStats);
+    printf("connections %ld, requests %ld, receipts %ld, inbound messages %ld (refused while queue full %ld), "
+           "rejected %ld\n", oStats.iConnections, oStats.iRequests, oStats.iReceipts, oStats.iMessages, oStats.iDropped,
+           oStats.iRejected);
+
+    click_callback_server_destroy(oServer);
+    click_mo_queue_destroy(oQueue);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_poll_transport
+ * Info:      Transport of the poll benchmark: answers querymsg.php with the status the
+ *            message (its index is the API Message ID) has on the simulated clock.
+ * Inputs:    pContext - BenchPollWorld
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long bench_poll_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    const BenchPollWorld *oWorld = (const BenchPollWorld *)pContext;
+    const char *chId = strstr(oRequest->chUrl, "apimsgid=");
+    long iMsg = (chId != NULL ? atol(chId + 9) : 0);
+    int iStatus = 2;
+    char chResponse[64];
+
+    if (oWorld->aFinalMs[iMsg] >= 0 && oWorld->iNowMs >= oWorld->aFinalMs[iMsg])
+        iStatus = oWorld->aFinalStatus[iMsg];
+    else if (oWorld->iNowMs >= oWorld->aGatewayMs[iMsg])
+        iStatus = (oWorld->aQueued[iMsg] ? 11 : 3);
+
+    snprintf(chResponse, sizeof(chResponse), "ID: %ld Status: %03d", iMsg, iStatus);
+    oRequest->fnWrite(chResponse, 1, strlen(chResponse), oRequest->pWriteData);
+
+    return 200;
+}
+
+/*
+ * Function:  bench_poll_status
+ * Info:      Status handler of the poll benchmark: sums how late final statuses are seen.
+ * Inputs:    pContext - BenchPollWorld
+ *            chMsgId  - message ID (the message's index)
+ *            iStatus  - status
+ *            eEvent   - event
+ * Return:    void
+ */
+static void bench_poll_status(void *pContext, const char *chMsgId, int iStatus, eClickPollEvent eEvent)
+{
+    BenchPollWorld *oWorld = (BenchPollWorld *)pContext;
+    long iMsg = atol(chMsgId);
+
+    (void)iStatus;
+    if (eEvent == CLICK_POLL_FINAL) {
+        oWorld->iFinalSeen++;
+        oWorld->fStaleMs += (double)(oWorld->iNowMs - oWorld->aFinalMs[iMsg]);
+    }
+}
+
+/*
+ * Function:  bench_poll
+ * Info:      Benchmarks the status poll scheduler: iIterations / 20 messages are sent over
+ *            a minute of simulated time and polled with BENCH_POLL_HANDLES handles until
+ *            all reach a final status or expire, without a rate limit and then within one.
+ *            Most messages are delivered within a minute, some are queued for up to two
+ *            hours, some fail and some never reach a final status. The fixed schedule's
+ *            polls and staleness are calculated from the same delays.
+ * Inputs:    iIterations - scales the number of messages
+ * Return:    void
+ */
+static void bench_poll(long iIterations)
+{
+    static const double aRates[] = { 0, 100 };
+    long i = 0, iNum = (iIterations / 20 > 0 ? iIterations / 20 : 1), iFinal = 0, iFixedPolls = 0;
+    unsigned long long iSeed = 88172645463325252ULL;
+    double fFixedStaleMs = 0.0, fRand = 0.0;
+    int iRun = 0, iHandle = 0;
+    BenchPollWorld oWorld;
+    ClickSmsHandle *aHandles[BENCH_POLL_HANDLES];
+    ClickPollConfig oConfig;
+    ClickPollScheduler *oScheduler = NULL;
+    ClickPollStats oStats;
+    PerfCounters oCounters;
+    char chMsgId[24];
+
+    memset(&oWorld, 0, sizeof(oWorld));
+    oWorld.aSentMs      = malloc(iNum * sizeof(long long));
+    oWorld.aGatewayMs   = malloc(iNum * sizeof(long long));
+    oWorld.aFinalMs     = malloc(iNum * sizeof(long long));
+    oWorld.aQueued      = calloc(iNum, sizeof(int));
+    oWorld.aFinalStatus = malloc(iNum * sizeof(int));
+    for (iHandle = 0; iHandle < BENCH_POLL_HANDLES; iHandle++) {
+        aHandles[iHandle] = loopback_handle_create(CLICK_API_HTTP);
+        clickatell_sms_handle_transport_set(aHandles[iHandle], bench_poll_transport, &oWorld);
+    }
+
+    // delays: 85% delivered in 3-45 s, 10% queued and delivered in 10-120 minutes, 3% failed
+    // in 5-30 s and 2% never final
+    for (i = 0; i < iNum; i++) {
+        iSeed ^= iSeed << 13; iSeed ^= iSeed >> 7; iSeed ^= iSeed << 17;
+        fRand = (iSeed >> 11) / 9007199254740992.0;
+        oWorld.aSentMs[i]      = i * BENCH_POLL_SPREAD_MS / iNum;
+        oWorld.aGatewayMs[i]   = oWorld.aSentMs[i] + 1000 + (long long)(fRand * 2000);
+        oWorld.aFinalStatus[i] = 4;
+        if (fRand < 0.85)
+            oWorld.aFinalMs[i] = oWorld.aSentMs[i] + 3000 + (long long)(fRand / 0.85 * 42000);
+        else if (fRand < 0.95) {
+            oWorld.aQueued[i]  = 1;
+            oWorld.aFinalMs[i] = oWorld.aSentMs[i] + 600000 + (long long)((fRand - 0.85) / 0.10 * 6600000);
+        }
+        else if (fRand < 0.98) {
+            oWorld.aFinalStatus[i] = 7;
+            oWorld.aFinalMs[i] = oWorld.aSentMs[i] + 5000 + (long long)((fRand - 0.95) / 0.03 * 25000);
+        }
+        else
+            oWorld.aFinalMs[i] = -1;
+
+        // fixed schedule: polled every BENCH_POLL_FIXED_MS until the final status is seen
+        if (oWorld.aFinalMs[i] >= 0) {
+            long long iPolls = (oWorld.aFinalMs[i] - oWorld.aSentMs[i] + BENCH_POLL_FIXED_MS - 1) / BENCH_POLL_FIXED_MS;
+            iPolls = (iPolls > 0 ? iPolls : 1);
+            iFixedPolls   += iPolls;
+            fFixedStaleMs += (double)(oWorld.aSentMs[i] + iPolls * BENCH_POLL_FIXED_MS - oWorld.aFinalMs[i]);
+            iFinal++;
+        }
+        else
+            iFixedPolls += BENCH_POLL_MAX_AGE_MS / BENCH_POLL_FIXED_MS;
+    }
+
+    perf_counters_open(&oCounters);
+    printf("\nStatus polling of %ld messages (%ld reach a final status) with %d handles, %d ms ticks, simulated clock\n",
+           iNum, iFinal, BENCH_POLL_HANDLES, BENCH_POLL_TICK_MS);
+    printf("%-18s %12s %10s %12s %10s %10s %10s\n", "schedule", "polls", "polls/msg", "stale s", "deferred", "expired",
+           "ns/poll");
+    printf("%-18s %12ld %10.2f %12.2f %10s %10ld %10s\n", "fixed 10 s", iFixedPolls, (double)iFixedPolls / iNum,
+           fFixedStaleMs / (iFinal > 0 ? iFinal : 1) / 1000, "-", iNum - iFinal, "-");
+
+    for (iRun = 0; iRun < 2; iRun++) {
+        memset(&oConfig, 0, sizeof(oConfig));
+        oConfig.fRate     = aRates[iRun];
+        oConfig.iTickMs   = BENCH_POLL_TICK_MS;
+        oConfig.iMaxAgeMs = BENCH_POLL_MAX_AGE_MS;
+        oWorld.iFinalSeen = 0;
+        oWorld.fStaleMs   = 0.0;
+        oScheduler = click_poll_scheduler_create(aHandles, BENCH_POLL_HANDLES, iNum, &oConfig, bench_poll_status, &oWorld);
+        if (oScheduler == NULL)
+            break;
+
+        perf_counters_start(&oCounters);
+        for (oWorld.iNowMs = 0, i = 0; i < iNum || click_poll_scheduler_pending(oScheduler) > 0;
+             oWorld.iNowMs += BENCH_POLL_TICK_MS) {
+            for ( ; i < iNum && oWorld.aSentMs[i] <= oWorld.iNowMs; i++) {
+                snprintf(chMsgId, sizeof(chMsgId), "%ld", i);
+                click_poll_scheduler_add(oScheduler, chMsgId, oWorld.aSentMs[i]);
+            }
+            click_poll_scheduler_run(oScheduler, oWorld.iNowMs);
+        }
+        perf_counters_stop(&oCounters);
+
+        click_poll_scheduler_stats_get(oScheduler, &oStats);
+        snprintf(chMsgId, sizeof(chMsgId), (iRun == 0 ? "adaptive" : "adaptive %.0f/s"), aRates[iRun]);
+        printf("%-18s %12ld %10.2f %12.2f %10ld %10ld %10.0f\n", chMsgId, oStats.iPolls, (double)oStats.iPolls / iNum,
+               oWorld.fStaleMs / (oWorld.iFinalSeen > 0 ? oWorld.iFinalSeen : 1) / 1000, oStats.iDeferred, oStats.iExpired,
+               oCounters.fElapsedNs / (oStats.iPolls > 0 ? oStats.iPolls : 1));
+        click_poll_scheduler_destroy(oScheduler);
+    }
+
+    for (iHandle = 0; iHandle < BENCH_POLL_HANDLES; iHandle++)
+        clickatell_sms_handle_shutdown(aHandles[iHandle]);
+    free(oWorld.aSentMs);
+    free(oWorld.aGatewayMs);
+    free(oWorld.aFinalMs);
+    free(oWorld.aQueued);
+    free(oWorld.aFinalStatus);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_batch
+ * Info:      Measures personalised HTTP API sends to iIterations recipients: sendmsg.php
+ *            per recipient with the text rendered by snprintf(), with credentials and with
+ *            a session ID; senditem.php per recipient with the name and order number as
+ *            template fields (the template is sent once by startbatch.php); and
+ *            quicksend.php to BENCH_BATCH_QUICKSEND recipients per request.
+ * Inputs:    iIterations - number of messages per run
+ * Return:    void
+ */
+static void bench_batch(long iIterations)
+{
+    static const char *aNames[] = { "sendmsg (credentials)", "sendmsg (session)", "senditem (session)",
+                                    "quicksend (session)" };
+    ClickSmsHandle *oHandle = loopback_handle_create(CLICK_API_HTTP);
+    ClickMsisdn *aMsisdns = bench_msisdns_create(BENCH_BATCH_QUICKSEND);
+    ClickSmsString *sBatch = NULL, oText, oBatchId;
+    BenchWireStats oStats;
+    PerfCounters oCounters;
+    const char *aFields[2];
+    char chText[256], chOrder[24];
+    double fBaseBytes = 0.0, fBytes = 0.0;
+    long i = 0, iMessages = 0;
+    int iRun = 0;
+
+    perf_counters_open(&oCounters);
+    clickatell_sms_handle_transport_set(oHandle, bench_wire_transport, &oStats);
+    oText.data = chText;
+    aFields[1] = chOrder;
+
+    printf("\nPersonalised HTTP API sends to %ld recipients, %d per quicksend request, no I/O\n", iIterations,
+           BENCH_BATCH_QUICKSEND);
+    printf("%-22s %10s %10s %10s %10s %10s\n", "request", "messages", "requests", "ns/msg", "B/msg", "bytes");
+    for (iRun = 0; iRun < 4; iRun++) {
+        clickatell_sms_handle_option_set(oHandle, CLICK_SMS_OPTION_HTTP_SESSION, (iRun == 0 ? 0 : 300));
+        if (iRun == 2) {
+            sBatch = clickatell_sms_batch_start(oHandle, BENCH_BATCH_TEMPLATE, strlen(BENCH_BATCH_TEMPLATE), 2);
+            oBatchId.data = "8c9d6e2a81b6b8f2c4ebd2c2f76d6b1b"; // bench_wire_transport() returns no batch ID
+            click_string_destroy(sBatch);
+        }
+        memset(&oStats, 0, sizeof(oStats));
+
+        perf_counters_start(&oCounters);
+        for (i = 0, iMessages = 0; iMessages < iIterations; i++) {
+            aFields[0] = aBenchBatchNames[i % 6];
+            snprintf(chOrder, sizeof(chOrder), "%ld", 40000 + i);
+            aMsisdns->iNum = 1;
+            if (iRun < 2) {
+                snprintf(chText, sizeof(chText), BENCH_BATCH_TEXT_FORMAT, aFields[0], 40000 + i);
+                click_string_destroy(clickatell_sms_message_send(oHandle, &oText, aMsisdns));
+            }
+            else if (iRun == 2)
+                click_string_destroy(clickatell_sms_batch_item_send(oHandle, &oBatchId, aMsisdns->aDests[0], aFields, 2));
+            else {
+                aMsisdns->iNum = BENCH_BATCH_QUICKSEND;
+                click_string_destroy(clickatell_sms_batch_quicksend(oHandle, &oBatchId, aMsisdns));
+            }
+            iMessages += aMsisdns->iNum;
+        }
+        perf_counters_stop(&oCounters);
+
+        fBytes = (double)oStats.iBytes / iMessages;
+        if (iRun == 0)
+            fBaseBytes = fBytes;
+        printf("%-22s %10ld %10ld %10.0f %10.1f %9.2fx\n", aNames[iRun], iMessages, oStats.iRequests,
+               oCounters.fElapsedNs / iMessages, fBytes, fBytes / fBaseBytes);
+    }
+    printf("bytes are estimated HTTP/1.1 request sizes excluding TLS, relative to sendmsg with credentials\n");
+
+    aMsisdns->iNum = BENCH_BATCH_QUICKSEND;
+    bench_msisdns_destroy(aMsisdns);
+    clickatell_sms_handle_shutdown(oHandle);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_standin_recipients
+ * Info:      Counts the recipients of a request: the numbers in its "to" parameter.
+ * Inputs:    chRequest - request head and body, NUL terminated
+ * Return:    number of recipients, 1 if there is no "to" parameter
+ */
+static long bench_standin_recipients(const char *chRequest)
+{
+    const char *pPos = strstr(chRequest, "&to=");
+    long iRecipients = 1;
+
+    if (pPos == NULL && (pPos = strstr(chRequest, "\r\n\r\nto=")) != NULL)
+        pPos += 3;
+    for (pPos = (pPos != NULL ? pPos + 4 : ""); *pPos != '\0' && *pPos != '&' && *pPos != ' '; pPos++)
+        iRecipients += (*pPos == ',');
+
+    return iRecipients;
+}
+
+/*
+ * Function:  bench_standin_server
+ * Info:      Stand-in HTTP API server thread of the post benchmark: accepts one
+ *            connection and answers each HTTP/1.1 request (its head, then Content-Length
+ *            bytes of body) with BENCH_POST_LINE per recipient, until the client closes
+ *            the connection.
+ * Inputs:    pContext - BenchStandin
+ * Return:    NULL
+ */
+static void *bench_standin_server(void *pContext)
+{
+    BenchStandin *oStandin = (BenchStandin *)pContext;
+    int iFd = accept(oStandin->iListenFd, NULL, NULL), iOne = 1;
+    long iLineLen = (long)strlen(BENCH_POST_LINE);
+    long iLen = 0, iBodyLen = 0, iHeadLen = 0, iRecipients = 0, i = 0;
+    char *chRequest = malloc(BENCH_POST_BUFFER), *chBody = malloc(iLineLen * CLICK_SMS_HTTP_POST_TO_MAX);
+    const char *pHeadEnd = NULL, *pLength = NULL;
+    char chHead[96];
+    struct iovec aIov[2];
+    ssize_t iRet = 0;
+
+    for (i = 0; i < CLICK_SMS_HTTP_POST_TO_MAX; i++)
+        memcpy(chBody + i * iLineLen, BENCH_POST_LINE, iLineLen);
+    setsockopt(iFd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+
+    while (iFd >= 0) {
+        // read a whole request: its head, then its body
+        for (pHeadEnd = NULL, iBodyLen = 0; pHeadEnd == NULL || iLen < iHeadLen + iBodyLen; iLen += iRet) {
+            if ((iRet = recv(iFd, chRequest + iLen, BENCH_POST_BUFFER - 1 - iLen, 0)) <= 0)
+                goto done;
+            chRequest[iLen + iRet] = '\0';
+            if (pHeadEnd == NULL && (pHeadEnd = strstr(chRequest, "\r\n\r\n")) != NULL) {
+                iHeadLen = pHeadEnd + 4 - chRequest;
+                pLength  = strstr(chRequest, "Content-Length: ");
+                iBodyLen = (pLength != NULL && pLength < pHeadEnd ? atol(pLength + 16) : 0);
+            }
+        }
+
+        iRecipients = bench_standin_recipients(chRequest);
+        iRecipients = (iRecipients > CLICK_SMS_HTTP_POST_TO_MAX ? CLICK_SMS_HTTP_POST_TO_MAX : iRecipients);
+        aIov[0].iov_base = chHead;
+        aIov[0].iov_len  = snprintf(chHead, sizeof(chHead), "HTTP/1.1 200 OK\r\nContent-Length: %ld\r\n\r\n",
+                                    iRecipients * iLineLen);
+        aIov[1].iov_base = chBody;
+        aIov[1].iov_len  = iRecipients * iLineLen;
+        if (writev(iFd, aIov, 2) != (ssize_t)(aIov[0].iov_len + aIov[1].iov_len))
+            break;
+        oStandin->iRequests++;
+        iLen = 0; // requests are not pipelined
+    }
+
+done:
+    if (iFd >= 0)
+        close(iFd);
+    free(chRequest);
+    free(chBody);
+
+    return NULL;
+}
+
+/*
+ * Function:  bench_standin_transport
+ * Info:      Transport of the post benchmark: writes the request to the stand-in server
+ *            as HTTP/1.1 (the head is formatted into the connection's buffer, the body is
+ *            written from the library's buffer), then reads the response and passes its
+ *            body to the library. Sessions are opened without a request.
+ * Inputs:    pContext - BenchStandinConn
+ *            oRequest - formatted request
+ * Return:    HTTP status code, or -1 if the request failed
+ */
+static long bench_standin_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    BenchStandinConn *oConn = (BenchStandinConn *)pContext;
+    const struct curl_slist *oHeader = NULL;
+    const char *chTarget = strstr(oRequest->chUrl, "://");
+    const char *pHeadEnd = NULL, *pLength = NULL;
+    long iLen = 0, iHeadLen = 0, iBodyLen = 0;
+    struct iovec aIov[2];
+    ssize_t iRet = 0;
+
+    if (strstr(oRequest->chUrl, "auth.php") != NULL) {
+        oRequest->fnWrite("OK: 2eda2fe1f07f6e4e96e3e2d39bd1b1b7", 1, 36, oRequest->pWriteData);
+        return 200;
+    }
+
+    // request line uses the path and query only: "GET /http/sendmsg.php?... HTTP/1.1\r\n"
+    chTarget = (chTarget != NULL ? strchr(chTarget + 3, '/') : oRequest->chUrl);
+    iLen = snprintf(oConn->aBuf, BENCH_POST_BUFFER, "%s %s HTTP/1.1\r\nHost: api.clickatell.com\r\n", oRequest->chMethod, chTarget);
+    for (oHeader = oRequest->oHeaders; oHeader != NULL && iLen < BENCH_POST_BUFFER; oHeader = oHeader->next)
+        iLen += snprintf(oConn->aBuf + iLen, BENCH_POST_BUFFER - iLen, "%s\r\n", oHeader->data);
+    if (iLen < BENCH_POST_BUFFER && oRequest->chBody != NULL)
+        iLen += snprintf(oConn->aBuf + iLen, BENCH_POST_BUFFER - iLen, "Content-Length: %zu\r\n", oRequest->iBodyLen);
+    if (iLen < BENCH_POST_BUFFER)
+        iLen += snprintf(oConn->aBuf + iLen, BENCH_POST_BUFFER - iLen, "\r\n");
+    if (iLen >= BENCH_POST_BUFFER)
+        return -1;
+
+    aIov[0].iov_base = oConn->aBuf;
+    aIov[0].iov_len  = iLen;
+    aIov[1].iov_base = (void *)oRequest->chBody;
+    aIov[1].iov_len  = (oRequest->chBody != NULL ? oRequest->iBodyLen : 0);
+    if (writev(oConn->iFd, aIov, 2) != (ssize_t)(aIov[0].iov_len + aIov[1].iov_len))
+        return -1;
+
+    // read the response head, then Content-Length bytes of body
+    for (iLen = 0; pHeadEnd == NULL || iLen < iHeadLen + iBodyLen; iLen += iRet) {
+        if ((iRet = recv(oConn->iFd, oConn->aBuf + iLen, BENCH_POST_BUFFER - 1 - iLen, 0)) <= 0)
+            return -1;
+        oConn->aBuf[iLen + iRet] = '\0';
+        if (pHeadEnd == NULL && (pHeadEnd = strstr(oConn->aBuf, "\r\n\r\n")) != NULL) {
+            iHeadLen = pHeadEnd + 4 - oConn->aBuf;
+            pLength  = strstr(oConn->aBuf, "Content-Length: ");
+            iBodyLen = (pLength != NULL && pLength < pHeadEnd ? atol(pLength + 16) : 0);
+        }
+    }
+    oRequest->fnWrite(oConn->aBuf + iHeadLen, 1, iBodyLen, oRequest->pWriteData);
+
+    return atol(oConn->aBuf + 9); // "HTTP/1.1 200"
+}
+
+/*
+ * Function:  bench_post
+ * Info:      Sends iIterations recipients a message over a keep-alive connection to a
+ *            local stand-in HTTP API server, with one recipient per request, then with as
+ *            many as fit: CLICK_SMS_HTTP_GET_TO_MAX per GET request and
+ *            CLICK_SMS_HTTP_POST_TO_MAX per form POST request.
+ * Inputs:    iIterations - number of recipients per run
+ * Return:    void
+ */
+static void bench_post(long iIterations)
+{
+    static const char *aNames[] = { "get", "post", "get", "post", "post" };
+    static const int aPerRequest[] = { 1, 1, CLICK_SMS_HTTP_GET_TO_MAX, CLICK_SMS_HTTP_GET_TO_MAX, CLICK_SMS_HTTP_POST_TO_MAX };
+    ClickSmsHandle *oHandle = loopback_handle_create(CLICK_API_HTTP);
+    ClickMsisdn *aMsisdns = bench_msisdns_create(CLICK_SMS_HTTP_POST_TO_MAX);
+    ClickSmsString oText = { BENCH_MSG_TEXT };
+    ClickSmsString *sResponse = NULL;
+    BenchStandinConn *oConn = calloc(1, sizeof(BenchStandinConn));
+    BenchStandin oStandin = { -1, 0 };
+    struct sockaddr_in oAddr;
+    socklen_t iAddrLen = sizeof(oAddr);
+    PerfCounters oCounters;
+    pthread_t oThread;
+    long iRequests = 0, iSent = 0, iFailed = 0;
+    int iRun = 0, iOne = 1;
+
+    memset(&oAddr, 0, sizeof(oAddr));
+    oAddr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &oAddr.sin_addr);
+    oStandin.iListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    oConn->iFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (bind(oStandin.iListenFd, (struct sockaddr *)&oAddr, sizeof(oAddr)) != 0 || listen(oStandin.iListenFd, 1) != 0 ||
+        getsockname(oStandin.iListenFd, (struct sockaddr *)&oAddr, &iAddrLen) != 0 ||
+        pthread_create(&oThread, NULL, bench_standin_server, &oStandin) != 0)
+    {
+        printf("\nHTTP API GET versus form POST: failed to listen on a local port\n");
+        goto exit;
+    }
+    if (connect(oConn->iFd, (struct sockaddr *)&oAddr, sizeof(oAddr)) != 0) {
+        printf("\nHTTP API GET versus form POST: failed to connect to the stand-in server\n");
+        shutdown(oStandin.iListenFd, SHUT_RDWR);
+        pthread_join(oThread, NULL);
+        goto exit;
+    }
+    setsockopt(oConn->iFd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+    perf_counters_open(&oCounters);
+    clickatell_sms_handle_transport_set(oHandle, bench_standin_transport, oConn);
+    clickatell_sms_handle_option_set(oHandle, CLICK_SMS_OPTION_HTTP_SESSION, 300);
+
+    printf("\nHTTP API sendmsg.php to %ld recipients over a keep-alive connection to a local stand-in server\n", iIterations);
+    printf("%-6s %10s %10s %10s %12s %14s\n", "method", "to/req", "requests", "ms", "requests/s", "recipients/s");
+    for (iRun = 0; iRun < 5; iRun++) {
+        clickatell_sms_handle_option_set(oHandle, CLICK_SMS_OPTION_HTTP_POST, (aNames[iRun][0] == 'p'));
+        iRequests = iSent = iFailed = 0;
+
+        perf_counters_start(&oCounters);
+        while (iSent < iIterations) {
+            aMsisdns->iNum = (int)(iIterations - iSent < aPerRequest[iRun] ? iIterations - iSent : aPerRequest[iRun]);
+            sResponse = clickatell_sms_message_send(oHandle, &oText, aMsisdns);
+            iFailed += (sResponse == NULL || strncmp(sResponse->data, "ID: ", 4) != 0);
+            click_string_destroy(sResponse);
+            iSent += aMsisdns->iNum;
+            iRequests++;
+        }
+        perf_counters_stop(&oCounters);
+
+        printf("%-6s %10d %10ld %10.1f %12.0f %14.0f%s\n", aNames[iRun], aPerRequest[iRun], iRequests,
+               oCounters.fElapsedNs / 1e6, iRequests / (oCounters.fElapsedNs / 1e9), iSent / (oCounters.fElapsedNs / 1e9),
+               (iFailed > 0 ? "  (failed requests)" : ""));
+    }
+
+    close(oConn->iFd); // the stand-in server stops when the connection is closed
+    oConn->iFd = -1;
+    pthread_join(oThread, NULL);
+    perf_counters_close(&oCounters);
+
+exit:
+    if (oConn->iFd >= 0)
+        close(oConn->iFd);
+    if (oStandin.iListenFd >= 0)
+        close(oStandin.iListenFd);
+    aMsisdns->iNum = CLICK_SMS_HTTP_POST_TO_MAX;
+    bench_msisdns_destroy(aMsisdns);
+    clickatell_sms_handle_shutdown(oHandle);
+    free(oConn);
+}
+
+/*
+ * Function:  bench_stream_transport
+ * Info:      Transport of the stream benchmark: records the heap in use above the
+ *            baseline (the request as formatted by the library), then consumes the body as
+ *            a network transport would: from 'chBody', or read through 'fnRead'
+ *            BENCH_STREAM_READ_SIZE bytes at a time.
+ * Inputs:    pContext - BenchStreamStats
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long bench_stream_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    BenchStreamStats *oStats = (BenchStreamStats *)pContext;
+    struct mallinfo2 oInfo = mallinfo2();
+    char aBuffer[BENCH_STREAM_READ_SIZE];
+    size_t iRead = 0, iRet = 0;
+
+    if (oInfo.uordblks > oStats->iBaseline && oInfo.uordblks - oStats->iBaseline > oStats->iPeak)
+        oStats->iPeak = oInfo.uordblks - oStats->iBaseline;
+
+    if (oRequest->fnRead != NULL) {
+        while ((iRet = oRequest->fnRead(aBuffer, 1, sizeof(aBuffer), oRequest->pReadData)) > 0)
+            iRead += iRet;
+    }
+    else
+        iRead = oRequest->iBodyLen;
+    oStats->iBodyLen = iRead;
+
+    return 200;
+}
+
+/*
+ * Function:  bench_stream
+ * Info:      Sends a message to BENCH_STREAM_RECIPIENTS recipients (a ClickRecipients list)
+ *            with the request body formatted in memory, then generated while it is sent, on
+ *            REST and HTTP (form POST) handles.
+ * Inputs:    iIterations - number of recipients per run (in whole sends)
+ * Return:    void
+ */
+static void bench_stream(long iIterations)
+{
+    static const char *aNames[] = { "rest formatted", "rest streamed", "http formatted", "http streamed" };
+    ClickRecipients *oRecipients = click_recipients_create(BENCH_STREAM_RECIPIENTS);
+    ClickSmsHandle *oHandle = NULL;
+    ClickSmsString *sResponse = NULL;
+    BenchStreamStats oStats;
+    PerfCounters oCounters;
+    long i = 0, iSends = (iIterations + BENCH_STREAM_PER_SEND - 1) / BENCH_STREAM_PER_SEND;
+    char chMsisdn[16];
+    int iRun = 0;
+
+    for (i = 0; i < BENCH_STREAM_RECIPIENTS; i++) {
+        snprintf(chMsisdn, sizeof(chMsisdn), "2782%07ld", i);
+        click_recipients_add(oRecipients, chMsisdn, strlen(chMsisdn), NULL);
+    }
+    perf_counters_open(&oCounters);
+
+    printf("\nSends to %d recipients, %ld per run, with the body formatted in memory versus streamed\n",
+           BENCH_STREAM_RECIPIENTS, iSends);
+    printf("%-16s %12s %14s %10s\n", "body", "body bytes", "heap at send", "ms/send");
+    for (iRun = 0; iRun < 4; iRun++) {
+        oHandle = loopback_handle_create(iRun < 2 ? CLICK_API_REST : CLICK_API_HTTP);
+        memset(&oStats, 0, sizeof(oStats));
+        clickatell_sms_handle_transport_set(oHandle, bench_stream_transport, &oStats);
+        clickatell_sms_handle_option_set(oHandle, CLICK_SMS_OPTION_HTTP_POST, 1);
+        clickatell_sms_handle_option_set(oHandle, CLICK_SMS_OPTION_STREAM_BODY, (iRun % 2 == 1 ? 1000 : 0));
+
+        perf_counters_start(&oCounters);
+        for (i = 0; i < iSends; i++) {
+            oStats.iBaseline = mallinfo2().uordblks;
+            sResponse = clickatell_sms_message_send_recipients(oHandle, BENCH_MSG_TEXT, -1, oRecipients);
+            click_string_destroy(sResponse);
+        }
+        perf_counters_stop(&oCounters);
+
+        printf("%-16s %12zu %14zu %10.2f\n", aNames[iRun], oStats.iBodyLen, oStats.iPeak, oCounters.fElapsedNs / 1e6 / iSends);
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+    printf("heap at send is the memory allocated by the library for the request when the transport is called\n");
+
+    click_recipients_destroy(oRecipients);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_submit_response
+ * Info:      Formats the response the API returns to a send to 'iRecipients' recipients:
+ *            an "ID: ... To: ..." line per recipient for HTTP, or a JSON message array for
+ *            REST. Memory for any previous response is freed.
+ * Inputs:    oResponse   - response to format
+ *            eApiType    - API of the response
+ *            iRecipients - number of recipients, at most BENCH_SUBMIT_TO_MAX
+ * Return:    void
+ */
+static void bench_submit_response(BenchSubmitResponse *oResponse, eClickApi eApiType, int iRecipients)
+{
+    size_t iSize = 64 + (size_t)iRecipients * 96;
+    int i = 0;
+
+    free(oResponse->chData);
+    oResponse->chData = malloc(iSize);
+    oResponse->iLen   = 0;
+    oResponse->iStatus = (eApiType == CLICK_API_HTTP ? 200 : 202);
+
+    if (eApiType == CLICK_API_REST)
+        oResponse->iLen += snprintf(oResponse->chData, iSize, "{\"data\":{\"message\":[");
+    for (i = 0; i < iRecipients; i++) {
+        if (eApiType == CLICK_API_HTTP)
+            oResponse->iLen += snprintf(oResponse->chData + oResponse->iLen, iSize - oResponse->iLen,
+                                        "ID: 205e85d0578314037a96175249fc%04x To: 2782%07d\n", i, i);
+        else
+            oResponse->iLen += snprintf(oResponse->chData + oResponse->iLen, iSize - oResponse->iLen,
+                                        "%s{\"accepted\":true,\"to\":\"2782%07d\",\"apiMessageId\":\"205e85d0578314037a96175249fc%04x\"}",
+                                        (i > 0 ? "," : ""), i, i);
+    }
+    if (eApiType == CLICK_API_REST)
+        oResponse->iLen += snprintf(oResponse->chData + oResponse->iLen, iSize - oResponse->iLen, "]}}");
+}
+
+/*
+ * Function:  bench_submit_transport
+ * Info:      Transport of the submit benchmark: passes the prepared response to 'fnWrite'
+ *            BENCH_SUBMIT_CHUNK bytes at a time, as libcurl would.
+ * Inputs:    pContext - BenchSubmitResponse
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long bench_submit_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    const BenchSubmitResponse *oResponse = (const BenchSubmitResponse *)pContext;
+    size_t iOffset = 0, iChunk = 0;
+
+    for (iOffset = 0; iOffset < oResponse->iLen; iOffset += iChunk) {
+        iChunk = (oResponse->iLen - iOffset < BENCH_SUBMIT_CHUNK ? oResponse->iLen - iOffset : BENCH_SUBMIT_CHUNK);
+        if (oRequest->fnWrite(oResponse->chData + iOffset, 1, iChunk, oRequest->pWriteData) != iChunk)
+            return -1;
+    }
+
+    return oResponse->iStatus;
+}
+
+/*
+ * Function:  bench_submit
+ * Info:      Sends a message to 1 and BENCH_SUBMIT_TO_MAX recipients on HTTP and REST
+ *            handles, keeping the whole response, then submits it fire-and-forget.
+ * Inputs:    iIterations - number of messages per run
+ * Return:    void
+ */
+static void bench_submit(long iIterations)
+{
+    static const char *aApiNames[] = { "http", "rest" };
+    static const int aRecipients[] = { 1, BENCH_SUBMIT_TO_MAX };
+    ClickSmsString *sText = click_string_create(BENCH_MSG_TEXT);
+    ClickMsisdn *aMsisdns = bench_msisdns_create(BENCH_SUBMIT_TO_MAX);
+    BenchSubmitResponse oResponse = { 0, NULL, 0 };
+    ClickSmsHandle *oHandle = NULL;
+    ClickSmsString *sResponse = NULL;
+    PerfCounters oCounters;
+    double fSendNs = 0;
+    long i = 0, iAccepted = 0;
+    int iApi = 0, iTo = 0, bSubmit = 0;
+
+    perf_counters_open(&oCounters);
+
+    printf("\nSends which keep the response versus submits which scan its first bytes, %ld messages per run\n", iIterations);
+    printf("%-6s %10s %14s %10s %10s %10s\n", "api", "recipients", "response bytes", "send ns", "submit ns", "speedup");
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        oHandle = loopback_handle_create((eClickApi)iApi);
+        clickatell_sms_handle_transport_set(oHandle, bench_submit_transport, &oResponse);
+
+        for (iTo = 0; iTo < 2; iTo++) {
+            bench_submit_response(&oResponse, (eClickApi)iApi, aRecipients[iTo]);
+            aMsisdns->iNum = aRecipients[iTo];
+
+            for (bSubmit = 0; bSubmit < 2; bSubmit++) {
+                iAccepted = 0;
+                perf_counters_start(&oCounters);
+                for (i = 0; i < iIterations; i++) {
+                    if (bSubmit)
+                        iAccepted += (clickatell_sms_message_submit(oHandle, sText, aMsisdns) == CLICK_SMS_SUBMIT_ACCEPTED);
+                    else {
+                        sResponse = clickatell_sms_message_send(oHandle, sText, aMsisdns);
+                        iAccepted += (sResponse != NULL);
+                        click_string_destroy(sResponse);
+                    }
+                }
+                perf_counters_stop(&oCounters);
+
+                if (iAccepted != iIterations)
+                    printf("WARNING: %ld of %ld messages accepted\n", iAccepted, iIterations);
+                if (!bSubmit)
+                    fSendNs = oCounters.fElapsedNs / iIterations;
+            }
+            printf("%-6s %10d %14zu %10.0f %10.0f %9.2fx\n", aApiNames[iApi], aRecipients[iTo], oResponse.iLen, fSendNs,
+                   oCounters.fElapsedNs / iIterations, fSendNs / (oCounters.fElapsedNs / iIterations));
+        }
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+
+    aMsisdns->iNum = BENCH_SUBMIT_TO_MAX;
+    bench_msisdns_destroy(aMsisdns);
+    click_string_destroy(sText);
+    free(oResponse.chData);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_audience
+ * Info:      Sends a message to BENCH_AUDIENCE_RECIPIENTS recipients over and over, a request
+ *            per CLICK_SMS_HTTP_GET_TO_MAX recipients, on HTTP and REST handles: from a
+ *            ClickMsisdn array and a ClickRecipients list per request, whose numbers are
+ *            formatted into each request, then from the chunks of a prepared ClickAudience.
+ * Inputs:    iIterations - number of requests per run
+ * Return:    void
+ */
+static void bench_audience(long iIterations)
+{
+    static const char *aApiNames[] = { "http", "rest" };
+    static const char *aDestNames[] = { "ClickMsisdn", "ClickRecipients", "ClickAudience" };
+    long iChunks = BENCH_AUDIENCE_RECIPIENTS / CLICK_SMS_HTTP_GET_TO_MAX;
+    ClickSmsString *sText = click_string_create(BENCH_MSG_TEXT);
+    ClickMsisdn *aMsisdns = bench_msisdns_create(BENCH_AUDIENCE_RECIPIENTS);
+    ClickMsisdn oChunkMsisdns = { CLICK_SMS_HTTP_GET_TO_MAX, NULL };
+    ClickRecipients **aLists = calloc(iChunks, sizeof(ClickRecipients *));
+    ClickRecipients *oRecipients = click_recipients_create(BENCH_AUDIENCE_RECIPIENTS);
+    ClickAudience *oAudience = NULL;
+    BenchSubmitResponse oResponse = { 0, NULL, 0 };
+    ClickSmsHandle *oHandle = NULL;
+    ClickSmsString *sResponse = NULL;
+    PerfCounters oCounters;
+    double fBaseNs = 0, fNs = 0;
+    long i = 0, iChunk = 0, iFailed = 0;
+    int iApi = 0, iDests = 0;
+
+    for (i = 0; i < BENCH_AUDIENCE_RECIPIENTS; i++) {
+        if (i % CLICK_SMS_HTTP_GET_TO_MAX == 0)
+            aLists[i / CLICK_SMS_HTTP_GET_TO_MAX] = click_recipients_create(CLICK_SMS_HTTP_GET_TO_MAX);
+        click_recipients_add(aLists[i / CLICK_SMS_HTTP_GET_TO_MAX], aMsisdns->aDests[i]->data, strlen(aMsisdns->aDests[i]->data), NULL);
+        click_recipients_add(oRecipients, aMsisdns->aDests[i]->data, strlen(aMsisdns->aDests[i]->data), NULL);
+    }
+    perf_counters_open(&oCounters);
+
+    perf_counters_start(&oCounters);
+    for (i = 0; i < 100; i++) {
+        click_audience_destroy(oAudience);
+        oAudience = click_audience_create(oRecipients, CLICK_SMS_HTTP_GET_TO_MAX);
+    }
+    perf_counters_stop(&oCounters);
+
+    printf("\nSends to %d recipients, %d per request, %ld requests per run\n", BENCH_AUDIENCE_RECIPIENTS,
+           CLICK_SMS_HTTP_GET_TO_MAX, iIterations);
+    printf("preparing the audience once: %.0f ns (%ld chunks)\n", oCounters.fElapsedNs / 100, oAudience->iChunks);
+    printf("%-6s %-16s %14s %10s\n", "api", "recipients", "ns/request", "speedup");
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        oHandle = loopback_handle_create((eClickApi)iApi);
+        bench_submit_response(&oResponse, (eClickApi)iApi, 1);
+        clickatell_sms_handle_transport_set(oHandle, bench_submit_transport, &oResponse);
+
+        for (iDests = 0; iDests < 3; iDests++) {
+            iFailed = 0;
+            perf_counters_start(&oCounters);
+            for (i = 0; i < iIterations; i++) {
+                iChunk = i % iChunks;
+                if (iDests == 0) {
+                    oChunkMsisdns.aDests = aMsisdns->aDests + iChunk * CLICK_SMS_HTTP_GET_TO_MAX;
+                    sResponse = clickatell_sms_message_send(oHandle, sText, &oChunkMsisdns);
+                }
+                else if (iDests == 1)
+                    sResponse = clickatell_sms_message_send_recipients(oHandle, BENCH_MSG_TEXT, -1, aLists[iChunk]);
+                else
+                    sResponse = clickatell_sms_message_send_audience(oHandle, BENCH_MSG_TEXT, -1, oAudience, iChunk);
+                iFailed += (sResponse == NULL);
+                click_string_destroy(sResponse);
+            }
+            perf_counters_stop(&oCounters);
+
+            if (iFailed > 0)
+                printf("WARNING: %ld of %ld requests failed\n", iFailed, iIterations);
+            fNs = oCounters.fElapsedNs / iIterations;
+            if (iDests == 0)
+                fBaseNs = fNs;
+            printf("%-6s %-16s %14.0f %9.2fx\n", aApiNames[iApi], aDestNames[iDests], fNs, fBaseNs / fNs);
+        }
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+
+    for (i = 0; i < iChunks; i++)
+        click_recipients_destroy(aLists[i]);
+    free(aLists);
+    click_recipients_destroy(oRecipients);
+    click_audience_destroy(oAudience);
+    bench_msisdns_destroy(aMsisdns);
+    click_string_destroy(sText);
+    free(oResponse.chData);
+    perf_counters_close(&oCounters);
+}
+
+/*
+ * Function:  bench_prepared
+ * Info:      Sends the same message to 1 and BENCH_SUBMIT_TO_MAX recipients over and over on
+ *            HTTP and REST handles, formatting it for every send, then from a request prepared
+ *            once.
+ * Inputs:    iIterations - number of requests per run
+ * Return:    void
+ */
+static void bench_prepared(long iIterations)
+{
+    static const char *aApiNames[] = { "http", "rest" };
+    static const int aRecipients[] = { 1, BENCH_SUBMIT_TO_MAX };
+    ClickSmsString *sText = click_string_create(BENCH_MSG_TEXT);
+    ClickMsisdn *aMsisdns = bench_msisdns_create(BENCH_SUBMIT_TO_MAX);
+    BenchSubmitResponse oResponse = { 0, NULL, 0 };
+    ClickSmsHandle *oHandle = NULL;
+    ClickSmsRequest *oRequest = NULL;
+    ClickSmsString *sResponse = NULL;
+    PerfCounters oCounters;
+    double fSendNs = 0, fPrepareNs = 0;
+    long i = 0, iFailed = 0;
+    int iApi = 0, iTo = 0, bPrepared = 0;
+
+    perf_counters_open(&oCounters);
+
+    printf("\nRe-sends of the same message formatted per send versus prepared once, %ld requests per run\n", iIterations);
+    printf("%-6s %10s %10s %12s %10s %10s\n", "api", "recipients", "send ns", "prepare ns", "execute ns", "speedup");
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        oHandle = loopback_handle_create((eClickApi)iApi);
+        bench_submit_response(&oResponse, (eClickApi)iApi, 1);
+        clickatell_sms_handle_transport_set(oHandle, bench_submit_transport, &oResponse);
+
+        for (iTo = 0; iTo < 2; iTo++) {
+            aMsisdns->iNum = aRecipients[iTo];
+
+            perf_counters_start(&oCounters);
+            oRequest = clickatell_sms_request_prepare(oHandle, sText, aMsisdns);
+            perf_counters_stop(&oCounters);
+            fPrepareNs = oCounters.fElapsedNs;
+
+            for (bPrepared = 0; bPrepared < 2; bPrepared++) {
+                iFailed = 0;
+                perf_counters_start(&oCounters);
+                for (i = 0; i < iIterations; i++) {
+                    if (bPrepared)
+                        sResponse = clickatell_sms_request_execute(oHandle, oRequest);
+                    else
+                        sResponse = clickatell_sms_message_send(oHandle, sText, aMsisdns);
+                    iFailed += (sResponse == NULL);
+                    click_string_destroy(sResponse);
+                }
+                perf_counters_stop(&oCounters);
+
+                if (iFailed > 0)
+                    printf("WARNING: %ld of %ld requests failed\n", iFailed, iIterations);
+                if (!bPrepared)
+                    fSendNs = oCounters.fElapsedNs / iIterations;
+            }
+            printf("%-6s %10d %10.0f %12.0f %10.0f %9.2fx\n", aApiNames[iApi], aRecipients[iTo], fSendNs, fPrepareNs,
+                   oCounters.fElapsedNs / iIterations, fSendNs / (oCounters.fElapsedNs / iIterations));
+            clickatell_sms_request_release(oRequest);
+        }
+        clickatell_sms_handle_shutdown(oHandle);
+    }
+
+    aMsisdns->iNum = BENCH_SUBMIT_TO_MAX;
+    bench_msisdns_destroy(aMsisdns);
+    click_string_destroy(sText);
+    free(oResponse.chData);
+    perf_counters_close(&oCounters);
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Main function which benchmarks the Clickatell SMS library                     *
+ * ----------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    const char *chBenchmark = (argc > 1 ? argv[1] : "all");
+    long iIterations = (argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_ITERATIONS);
+    int bAll = (strcmp(chBenchmark, "all") == 0);
+    int i = 0, bFound = bAll;
+
+    for (i = 0; i < BENCH_COUNT; i++)
+        bFound |= (strcmp(chBenchmark, aBenchmarks[i].chName) == 0);
+
+    if (iIterations < 1 || !bFound) {
+        printf("usage: %s [all", argv[0]);
+        for (i = 0; i < BENCH_COUNT; i++)
+            printf("|%s", aBenchmarks[i].chName);
+        printf("] [iterations]\n");
+        return 2;
+    }
+
+    // start using Clickatell library, with debug output disabled
+    clickatell_sms_init();
+    click_debug_init(CLICK_DEBUG_OFF);
+
+    for (i = 0; i < BENCH_COUNT; i++) {
+        if (bAll || strcmp(chBenchmark, aBenchmarks[i].chName) == 0)
+            aBenchmarks[i].fnBench(iIterations);
+    }
+
+    // finished using Clickatell library
+    clickatell_sms_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,1281 @@
+/*
+ * check_clickatell_sms.c
+ *
+ * Output checks for the Clickatell SMS library.
+ * Where the soak, stress and benchmark applications only check that the library keeps
+ * running, this application asserts the exact results of the library's parsers and
+ * formatters on their edge cases: message segmentation at the single and concatenated
+ * part boundaries, MSISDN normalization, message template escaping, and the callback
+ * receiver's answers to malformed and partial requests (sent to it over a local TCP
+ * connection), whether a submitted message's response is taken as accepted (the
+ * responses returned by a canned transport), that a streamed send body is the same
+ * as the one formatted in memory, the requests an HTTP API session sends (its
+ * authentication, use and renewal), and the requests of a prepared send executed on
+ * handles with the same or other credentials, or a session, and the part limit ("concat")
+ * a batch is started with. No network access or Clickatell account is required.
+ *
+ * Usage:  ./check_clickatell_sms
+ *
+ * Each failed check is printed, and the application exits with 1 if any check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "clickatell_sms/clickatell_debug.h"
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "clickatell_sms/clickatell_segment.h"
+#include "clickatell_sms/clickatell_msisdn.h"
+#include "clickatell_sms/clickatell_template.h"
+#include "clickatell_sms/clickatell_callback.h"
+#include "clickatell_sms/clickatell_recipients.h"
+#include "clickatell_sms/clickatell_audience.h"
+#include "loopback_transport.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Fixed Macros/Types                                                            *
+ * ----------------------------------------------------------------------------- */
+
+#define CHECK_TEXT_MAX          1024    // longest message text built by the segment checks (bytes)
+
+// UTF-8 characters used to build message texts
+#define CHECK_GSM7_EXT          "\xE2\x82\xAC"      // euro sign: GSM extension table (escape + code, 2 septets)
+#define CHECK_UCS2              "\xD0\xB6"          // cyrillic zhe: UCS-2, 1 code unit
+#define CHECK_UCS2_PAIR         "\xF0\x9F\x98\x80"  // grinning face: above U+FFFF, a surrogate pair (2 code units)
+
+#define CHECK_CALLBACK_PIECES   4       // most pieces a callback request is sent in
+#define CHECK_CALLBACK_POLL_MS  20      // the callback receiver is polled until idle for this long
+#define CHECK_CALLBACK_OUT_MAX  1024    // most response bytes read per connection
+
+#define CHECK_BODY_MAX          4096    // longest send body captured by the stream checks (bytes)
+#define CHECK_STREAM_CHUNK      3       // most recipients per audience chunk in the stream checks
+
+#define CHECK_CALLS_MAX         4       // most requests recorded per check of the requests sent
+#define CHECK_CALL_URL_MAX      256     // longest request URL or body recorded (bytes)
+
+// HTTP API requests of the session checks, made on a loopback handle (see loopback_handle_create())
+#define CHECK_HTTP_BASE         "https://api.clickatell.com/http/"
+#define CHECK_HTTP_CREDS        "user=loopbackuser&password=loopback+password%26%3d&api_id=3518209"
+#define CHECK_SESSION_1         "2eda2fe1f07f6e4e96e3e2d39bd1b1b7"  // returned by the loopback transport
+#define CHECK_SESSION_2         "5b1e1e0c2ad8e3b6f2c1d0a9e8f7a6b5"
+#define CHECK_AUTH_URL          CHECK_HTTP_BASE "auth.php?" CHECK_HTTP_CREDS
+#define CHECK_SEND_URL          CHECK_HTTP_BASE "sendmsg.php?" CHECK_HTTP_CREDS "&text=Hi&to=2991000000"
+#define CHECK_SEND_SESSION_URL(id) CHECK_HTTP_BASE "sendmsg.php?session_id=" id "&text=Hi&to=2991000000"
+#define CHECK_SEND_POST_URL     CHECK_HTTP_BASE "sendmsg.php?" CHECK_HTTP_CREDS
+#define CHECK_SEND_POST_BODY    "text=Hi&to=2991000000"
+#define CHECK_OTHER_CREDS       "user=otheruser&password=other&api_id=1234567"
+#define CHECK_BATCH_URL(parts)  CHECK_HTTP_BASE "startbatch.php?" CHECK_HTTP_CREDS "&template=Hi+%23field1%23&concat=" parts
+#define CHECK_SEND_ID           "ID: 205e85d0578314037a96175249fc6a2b"  // returned by the loopback transport
+
+// callback receiver responses
+#define CHECK_HTTP_OK           "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"
+#define CHECK_HTTP_OK_CLOSE     "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+#define CHECK_HTTP_BAD          "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n"
+#define CHECK_HTTP_BAD_CLOSE    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+#define CHECK_HTTP_METHOD_CLOSE "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+#define CHECK_HTTP_LENGTH_CLOSE "HTTP/1.1 411 Length Required\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+#define CHECK_HTTP_LARGE_CLOSE  "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+
+// expected part count of a message (see click_segment_count())
+typedef struct CheckSegmentCount {
+    const char *chName;
+    int  iRepeat;           // times 'chRepeat' starts the text
+    const char *chRepeat;
+    const char *chTail;     // text which follows
+    eClickCharset eCharset;
+    int  iParts;
+    long iUnits;
+    long iUnitsPerPart;
+    long iUnitsFree;
+} CheckSegmentCount;
+
+// expected normalization of a number (see click_msisdn_normalize())
+typedef struct CheckMsisdn {
+    const char *chNumber;               // number as entered
+    const ClickMsisdnRules *oRules;
+    eClickMsisdnStatus eStatus;
+    const char *chDigits;               // E.164 digits, "" if invalid
+} CheckMsisdn;
+
+// expected rendering of a template (see click_template_render())
+typedef struct CheckTemplate {
+    const char *chTemplate;
+    int bUnsafe;                        // rendered with aTemplateUnsafe, else aTemplateValues
+    eClickEncoding eEncoding;
+    const char *chExpected;             // rendered text, or NULL if the template does not compile
+} CheckTemplate;
+
+// expected answers of the callback receiver to a request, sent in pieces on a new connection
+typedef struct CheckCallback {
+    const char *chName;
+    const char *aPieces[CHECK_CALLBACK_PIECES];     // request data, NULL after the last piece
+    const char *aResponses[CHECK_CALLBACK_PIECES];  // responses received after each piece
+    int bClosed;                                    // the receiver closes the connection
+    long iReceipts;                                 // delivery receipts passed to the handler
+    const char *chApiMsgId;                         // API Message ID of the last receipt
+    int iStatus;                                    // status of the last receipt
+    eClickApi eFormat;                              // format of the last receipt
+} CheckCallback;
+
+// expected result of a submitted message, given the API's response (see clickatell_sms_message_submit())
+typedef struct CheckSubmit {
+    const char *chName;
+    eClickApi eApiType;
+    long iStatus;                       // HTTP status code returned by the transport
+    const char *chResponse;             // response body returned by the transport
+    eClickSmsSubmit eSubmit;
+} CheckSubmit;
+
+// send body captured by the stream checks' transport
+typedef struct CheckBody {
+    eClickApi eApiType;                 // API type of the handle, for the loopback response
+    size_t iReadSize;                   // bytes asked for per read of a streamed body
+    int  bStreamed;                     // the body was read from 'fnRead', else taken from 'chBody'
+    long iDeclared;                     // body length declared by the request
+    long iLen;                          // body length captured
+    char chBody[CHECK_BODY_MAX + 1];
+} CheckBody;
+
+// requests recorded by the calls checks' transport
+typedef struct CheckCalls {
+    eClickApi eApiType;                 // API type of the handle, for the loopback responses
+    const char *const *aScript;         // responses of consecutive requests (NULL: the loopback response), or NULL
+    int iCalls;                         // requests made
+    char aUrls[CHECK_CALLS_MAX][CHECK_CALL_URL_MAX];
+    char aBodies[CHECK_CALLS_MAX][CHECK_CALL_URL_MAX];
+} CheckCalls;
+
+// expected requests of a send on an HTTP API handle with a session, and its response
+typedef struct CheckSession {
+    const char *chName;
+    long iSession;                      // CLICK_SMS_OPTION_HTTP_SESSION set first, or -1 to keep it
+    const char *aScript[CHECK_CALLS_MAX];   // responses of the requests (NULL: the loopback response)
+    int iCalls;                         // requests sent
+    const char *aUrls[CHECK_CALLS_MAX]; // their URLs
+    const char *chResponse;             // response returned by the send
+} CheckSession;
+
+// expected requests of a prepared HTTP API send, executed on one of the prepared checks' handles
+typedef struct CheckPrepared {
+    const char *chName;
+    int bPost;                          // prepared with CLICK_SMS_OPTION_HTTP_POST
+    int iHandle;                        // executed on: 0 the preparing handle, 1 other credentials, 2 a session
+    int iCalls;                         // requests sent
+    const char *aUrls[CHECK_CALLS_MAX]; // their URLs
+    const char *aBodies[CHECK_CALLS_MAX]; // their bodies
+} CheckPrepared;
+
+// expected request of a batch start (see clickatell_sms_batch_start())
+typedef struct CheckBatch {
+    const char *chName;
+    long iHandleMax;                    // CLICK_SMS_OPTION_MAX_PARTS of the handle
+    long iMaxParts;                     // most parts given by the caller
+    int  bLong;                         // template of two parts, else "Hi #field1#"
+    int  iCalls;                        // requests sent (0 if the batch is rejected)
+    const char *chUrl;                  // URL of the request, or NULL if not checked
+} CheckBatch;
+
+// last delivery receipt received during the callback checks
+typedef struct CheckReceipt {
+    long iReceipts;
+    eClickApi eFormat;
+    char chApiMsgId[64];
+    int iStatus;
+} CheckReceipt;
+
+/* ----------------------------------------------------------------------------- *
+ * Local variables                                                               *
+ * ----------------------------------------------------------------------------- */
+
+static long iChecks   = 0;  // checks made
+static long iFailures = 0;  // checks failed
+
+static const CheckSegmentCount aSegmentCounts[] = {
+    { "gsm7 empty",                     0, "a", "", CLICK_CHARSET_GSM7, 1, 0, 160, 160 },
+    { "gsm7 single part full",        160, "a", "", CLICK_CHARSET_GSM7, 1, 160, 160, 0 },
+    { "gsm7 one over single part",    161, "a", "", CLICK_CHARSET_GSM7, 2, 161, 153, 145 },
+    { "gsm7 two parts full",          306, "a", "", CLICK_CHARSET_GSM7, 2, 306, 153, 0 },
+    { "gsm7 one over two parts",      307, "a", "", CLICK_CHARSET_GSM7, 3, 307, 153, 152 },
+    { "gsm7 extension fills single",  158, "a", CHECK_GSM7_EXT, CLICK_CHARSET_GSM7, 1, 160, 160, 0 },
+    { "gsm7 extension over single",   159, "a", CHECK_GSM7_EXT, CLICK_CHARSET_GSM7, 2, 161, 153, 145 },
+    { "gsm7 extension moved to part", 152, "a", CHECK_GSM7_EXT "aaaaaaaaaa", CLICK_CHARSET_GSM7, 2, 164, 153, 141 },
+    { "ucs2 single part full",         70, CHECK_UCS2, "", CLICK_CHARSET_UCS2, 1, 70, 70, 0 },
+    { "ucs2 one over single part",     71, CHECK_UCS2, "", CLICK_CHARSET_UCS2, 2, 71, 67, 63 },
+    { "ucs2 two parts full",          134, CHECK_UCS2, "", CLICK_CHARSET_UCS2, 2, 134, 67, 0 },
+    { "ucs2 one over two parts",      135, CHECK_UCS2, "", CLICK_CHARSET_UCS2, 3, 135, 67, 66 },
+    { "ucs2 surrogate fills single",   68, CHECK_UCS2, CHECK_UCS2_PAIR, CLICK_CHARSET_UCS2, 1, 70, 70, 0 },
+    { "ucs2 surrogate moved to part",  66, CHECK_UCS2, CHECK_UCS2_PAIR CHECK_UCS2 CHECK_UCS2 CHECK_UCS2 CHECK_UCS2,
+                                                          CLICK_CHARSET_UCS2, 2, 72, 67, 61 },
+};
+#define CHECK_SEGMENT_COUNTS (int)(sizeof(aSegmentCounts) / sizeof(aSegmentCounts[0]))
+
+static const ClickMsisdnRules oRulesZa      = { 27, "0", "00" };    // South Africa
+static const ClickMsisdnRules oRulesNoCc    = { 0, "0", "00" };     // national prefix, but no default country
+static const ClickMsisdnRules oRulesUs      = { 1, NULL, "011" };   // no national prefix, 011 international
+
+static const CheckMsisdn aMsisdns[] = {
+    { "+27 82-123 4567",        &oRulesZa,   CLICK_MSISDN_OK,          "27821234567" },
+    { "(082) 123.4567",         &oRulesZa,   CLICK_MSISDN_OK,          "27821234567" },
+    { "0027821234567",          &oRulesZa,   CLICK_MSISDN_OK,          "27821234567" },
+    { "27821234567",            &oRulesZa,   CLICK_MSISDN_OK,          "27821234567" },
+    { "82/123/4567",            &oRulesZa,   CLICK_MSISDN_OK,          "27821234567" },
+    { "+447700900123",          NULL,        CLICK_MSISDN_OK,          "447700900123" },
+    { "011 44 7700 900123",     &oRulesUs,   CLICK_MSISDN_OK,          "447700900123" },
+    { "212 555 0123",           &oRulesUs,   CLICK_MSISDN_OK,          "12125550123" },
+    { "",                       &oRulesZa,   CLICK_MSISDN_EMPTY,       "" },
+    { " -.() ",                 &oRulesZa,   CLICK_MSISDN_EMPTY,       "" },
+    { "+",                      &oRulesZa,   CLICK_MSISDN_EMPTY,       "" },
+    { "082 123 456a",           &oRulesZa,   CLICK_MSISDN_BAD_CHAR,    "" },
+    { "27+821234567",           &oRulesZa,   CLICK_MSISDN_BAD_CHAR,    "" },
+    { "++27821234567",          &oRulesZa,   CLICK_MSISDN_BAD_CHAR,    "" },
+    { "0821234567",             &oRulesNoCc, CLICK_MSISDN_NO_COUNTRY,  "" },
+    { "0821234567",             NULL,        CLICK_MSISDN_BAD_COUNTRY, "" },
+    { "+0821234567",            &oRulesZa,   CLICK_MSISDN_BAD_COUNTRY, "" },
+    { "+27 82 123 456",         &oRulesZa,   CLICK_MSISDN_BAD_LENGTH,  "" },
+    { "+27 82 123 45678",       &oRulesZa,   CLICK_MSISDN_BAD_LENGTH,  "" },
+    { "+1234567890123456",      &oRulesZa,   CLICK_MSISDN_BAD_LENGTH,  "" },
+};
+#define CHECK_MSISDNS (int)(sizeof(aMsisdns) / sizeof(aMsisdns[0]))
+
+static const char *const aTemplateNames[]  = { "name", "code" };
+static const char *const aTemplateValues[] = { "Ann", "42" };
+static const char *const aTemplateUnsafe[] = { "A&B \"q\"\\\n", "\xC3\xA9" };   // quotes, backslash, newline, UTF-8
+
+static const CheckTemplate aTemplates[] = {
+    { "Hi {name}, code {code}",   0, CLICK_ENCODING_RAW,  "Hi Ann, code 42" },
+    { "{code}{name}",             0, CLICK_ENCODING_RAW,  "42Ann" },
+    { "{{name}} is {name}",       0, CLICK_ENCODING_RAW,  "{name} is Ann" },
+    { "a }} b {{ c",              0, CLICK_ENCODING_RAW,  "a } b { c" },
+    { "{{{name}}}",               0, CLICK_ENCODING_RAW,  "{Ann}" },
+    { "{ref [A-7]} {name}",       0, CLICK_ENCODING_RAW,  "{ref [A-7]} Ann" },
+    { "{}{name}}",                0, CLICK_ENCODING_RAW,  "{}Ann}" },
+    { "x } y {name",              0, CLICK_ENCODING_RAW,  "x } y {name" },
+    { "Hi {nam}",                 0, CLICK_ENCODING_RAW,  NULL },
+    { "{{{name}}}",               0, CLICK_ENCODING_URL,  "%7bAnn%7d" },
+    { "{{{name}}}",               0, CLICK_ENCODING_JSON, "{Ann}" },
+    { "{name} & {code}!",         1, CLICK_ENCODING_RAW,  "A&B \"q\"\\\n & \xC3\xA9!" },
+    { "{name} & {code}!",         1, CLICK_ENCODING_URL,  "A%26B+%22q%22%5c%0a+%26+%c3%a9%21" },
+    { "{name} & {code}!",         1, CLICK_ENCODING_JSON, "A&B \\\"q\\\"\\\\\\n & \xC3\xA9!" },
+    { "\"{name}\"\t",             1, CLICK_ENCODING_JSON, "\\\"A&B \\\"q\\\"\\\\\\n\\\"\\t" },
+};
+#define CHECK_TEMPLATES (int)(sizeof(aTemplates) / sizeof(aTemplates[0]))
+
+static const CheckCallback aCallbacks[] = {
+    { "whole request",
+      { "GET /callback?api_id=3518209&apiMsgId=996411ad91fa211e7d17bc873aa4a41d&cliMsgId=&timestamp=1218007814&"
+        "to=279995631564&from=27833001171&status=003&charge=0.300000 HTTP/1.1\r\nHost: callback.example.com\r\n\r\n" },
+      { CHECK_HTTP_OK }, 0, 1, "996411ad91fa211e7d17bc873aa4a41d", 3, CLICK_API_HTTP },
+    { "split request line and headers",
+      { "GET /callback?apiMsgId=996411ad91fa211e7d17bc873aa4a41d&sta", "tus=004 HTTP/1.1\r\nHo",
+        "st: callback.example.com\r\n\r", "\n" },
+      { "", "", "", CHECK_HTTP_OK }, 0, 1, "996411ad91fa211e7d17bc873aa4a41d", 4, CLICK_API_HTTP },
+    { "split JSON body",
+      { "POST /callback HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: 82\r\n\r\n",
+        "{\"data\":{\"apiMessageId\":\"77a4a704", "28f984d9741001e6f17d02b4\",\"messageStatus\":\"006\"}}" },
+      { "", "", CHECK_HTTP_OK }, 0, 1, "77a4a70428f984d9741001e6f17d02b4", 6, CLICK_API_REST },
+    { "pipelined, second split",
+      { "GET /callback?apiMsgId=a1&status=003 HTTP/1.1\r\n\r\nGET /callback?apiMsgId=a2", "&status=004 HTTP/1.1\r\n\r\n" },
+      { CHECK_HTTP_OK, CHECK_HTTP_OK }, 0, 2, "a2", 4, CLICK_API_HTTP },
+    { "body still to come",
+      { "POST /callback HTTP/1.1\r\nContent-Length: 22\r\n\r\napiMsgId=b2", "&status=005" },
+      { "", CHECK_HTTP_OK }, 0, 1, "b2", 5, CLICK_API_HTTP },
+    { "Content-Length shorter than body",
+      { "POST /callback HTTP/1.1\r\nContent-Length: 13\r\n\r\napiMsgId=b1&status=004" },
+      { CHECK_HTTP_OK }, 0, 1, "b1", -1, CLICK_API_HTTP },
+    { "Content-Length not a number",
+      { "POST /callback HTTP/1.1\r\nContent-Length: abc\r\n\r\n" },
+      { CHECK_HTTP_BAD }, 0, 0, NULL, 0 },
+    { "Content-Length over the limit",
+      { "POST /callback HTTP/1.1\r\nContent-Length: 8193\r\n\r\n" },
+      { CHECK_HTTP_LARGE_CLOSE }, 1, 0, NULL, 0 },
+    { "Content-Length overflow",
+      { "POST /callback HTTP/1.1\r\nContent-Length: 99999999999999999999\r\n\r\n" },
+      { CHECK_HTTP_LARGE_CLOSE }, 1, 0, NULL, 0 },
+    { "headers and body over the limit",
+      { "POST /callback HTTP/1.1\r\nContent-Length: 8192\r\n\r\n" },
+      { CHECK_HTTP_LARGE_CLOSE }, 1, 0, NULL, 0 },
+    { "chunked body",
+      { "POST /callback HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" },
+      { CHECK_HTTP_LENGTH_CLOSE }, 1, 0, NULL, 0 },
+    { "header without colon",
+      { "GET /callback?apiMsgId=c1 HTTP/1.1\r\nHost callback.example.com\r\n\r\n" },
+      { CHECK_HTTP_BAD_CLOSE }, 1, 0, NULL, 0 },
+    { "unsupported method",
+      { "PUT /callback HTTP/1.1\r\n\r\n" },
+      { CHECK_HTTP_METHOD_CLOSE }, 1, 0, NULL, 0 },
+    { "unsupported version",
+      { "GET /callback?apiMsgId=c2 HTTP/2.0\r\n\r\n" },
+      { CHECK_HTTP_BAD_CLOSE }, 1, 0, NULL, 0 },
+    { "missing version",
+      { "GET /callback?apiMsgId=c3\r\n\r\n" },
+      { CHECK_HTTP_BAD_CLOSE }, 1, 0, NULL, 0 },
+    { "HTTP/1.0",
+      { "GET /callback?apiMsgId=c4&status=004 HTTP/1.0\r\n\r\n" },
+      { CHECK_HTTP_OK_CLOSE }, 1, 1, "c4", 4, CLICK_API_HTTP },
+    { "HTTP/1.0 keep-alive",
+      { "GET /callback?apiMsgId=c5&status=004 HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n" },
+      { CHECK_HTTP_OK }, 0, 1, "c5", 4, CLICK_API_HTTP },
+    { "HTTP/1.1 close",
+      { "GET /callback?apiMsgId=c6&status=004 HTTP/1.1\r\nConnection: close\r\n\r\n" },
+      { CHECK_HTTP_OK_CLOSE }, 1, 1, "c6", 4, CLICK_API_HTTP },
+    { "not a receipt",
+      { "GET /callback?api_id=3518209&status=004 HTTP/1.1\r\n\r\n" },
+      { CHECK_HTTP_BAD }, 0, 0, NULL, 0 },
+};
+#define CHECK_CALLBACKS (int)(sizeof(aCallbacks) / sizeof(aCallbacks[0]))
+
+static const CheckSubmit aSubmits[] = {
+    { "REST accepted", CLICK_API_REST, 202,
+      "{\"data\":{\"message\":[{\"accepted\":true,\"to\":\"2991000000\",\"apiMessageId\":\"77a4a70428f984d9741001e6f17d02b4\"}]}}",
+      CLICK_SMS_SUBMIT_ACCEPTED },
+    { "REST not accepted", CLICK_API_REST, 202,
+      "{\"data\":{\"message\":[{\"accepted\":false,\"to\":\"2991000000\",\"apiMessageId\":\"\"}]}}",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST spaced, accepted", CLICK_API_REST, 202,
+      "{\"data\": {\"message\": [{\"accepted\" : true, \"to\": \"2991000000\"}]}}",
+      CLICK_SMS_SUBMIT_ACCEPTED },
+    { "REST spaced, not accepted", CLICK_API_REST, 202,
+      "{\"data\": {\"message\": [{\"accepted\": false, \"to\": \"2991000000\"}]}}",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST pretty-printed, not accepted", CLICK_API_REST, 202,
+      "{\n  \"data\": {\n    \"message\": [{\n      \"accepted\"\t:\r\n false",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST null error", CLICK_API_REST, 202,
+      "{\"error\":null,\"data\":{\"message\":[{\"accepted\":true,\"to\":\"2991000000\"}]}}",
+      CLICK_SMS_SUBMIT_ACCEPTED },
+    { "REST error", CLICK_API_REST, 202,
+      "{\"error\":{\"code\":\"105\",\"description\":\"Invalid Destination Address\"}}",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST spaced error", CLICK_API_REST, 202,
+      "{\"error\" : {\"code\": \"105\", \"description\": \"Invalid Destination Address\"}}",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST error status", CLICK_API_REST, 401,
+      "{\"data\":{\"message\":[{\"accepted\":true}]}}",
+      CLICK_SMS_SUBMIT_REJECTED },
+    { "REST no response", CLICK_API_REST, 202, "", CLICK_SMS_SUBMIT_FAILED },
+    { "HTTP ID", CLICK_API_HTTP, 200, "ID: 205e85d0578314037a96175249fc6a2b", CLICK_SMS_SUBMIT_ACCEPTED },
+    { "HTTP ERR", CLICK_API_HTTP, 200, "ERR: 105, Invalid Destination Address", CLICK_SMS_SUBMIT_REJECTED },
+    { "HTTP ID, error status", CLICK_API_HTTP, 500, "ID: 205e85d0578314037a96175249fc6a2b", CLICK_SMS_SUBMIT_REJECTED },
+};
+#define CHECK_SUBMITS (int)(sizeof(aSubmits) / sizeof(aSubmits[0]))
+
+static const char *const aStreamDests[] = {
+    "27831234567", "447700900123", "12025550143", "27820000001", "491701234567", "33612345678", "2991000000"
+};
+#define CHECK_STREAM_DESTS (int)(sizeof(aStreamDests) / sizeof(aStreamDests[0]))
+
+// consecutive sends on one handle
+static const CheckSession aSessions[] = {
+    { "no session", 0, { NULL }, 1, { CHECK_SEND_URL }, CHECK_SEND_ID },
+    { "session opened", 300, { NULL }, 2, { CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, CHECK_SEND_ID },
+    { "session reused", -1, { NULL }, 1, { CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, CHECK_SEND_ID },
+    { "session expired (ERR: 003)", -1, { "ERR: 003, Session ID expired", "OK: " CHECK_SESSION_2 }, 3,
+      { CHECK_SEND_SESSION_URL(CHECK_SESSION_1), CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_2) }, CHECK_SEND_ID },
+    { "session unknown (ERR: 001)", -1, { "ERR: 001, Authentication failed" }, 3,
+      { CHECK_SEND_SESSION_URL(CHECK_SESSION_2), CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, CHECK_SEND_ID },
+    { "other error, not retried", -1, { "ERR: 105, Invalid Destination Address" }, 1,
+      { CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, "ERR: 105, Invalid Destination Address" },
+    { "rejected again, retried once", -1,
+      { "ERR: 003, Session ID expired", "OK: " CHECK_SESSION_2, "ERR: 003, Session ID expired" }, 3,
+      { CHECK_SEND_SESSION_URL(CHECK_SESSION_1), CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_2) },
+      "ERR: 003, Session ID expired" },
+    { "authentication failed", -1, { "ERR: 001, Authentication failed" }, 1, { CHECK_AUTH_URL },
+      "ERR: 001, Authentication failed" },
+    { "session reopened", -1, { NULL }, 2, { CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, CHECK_SEND_ID },
+    { "session disabled", 0, { NULL }, 1, { CHECK_SEND_URL }, CHECK_SEND_ID },
+    { "session enabled again", 300, { NULL }, 2, { CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, CHECK_SEND_ID },
+};
+#define CHECK_SESSIONS (int)(sizeof(aSessions) / sizeof(aSessions[0]))
+
+static const CheckPrepared aPrepared[] = {
+    { "GET, same handle", 0, 0, 1, { CHECK_SEND_URL }, { "" } },
+    { "GET, other credentials", 0, 1, 1,
+      { CHECK_HTTP_BASE "sendmsg.php?" CHECK_OTHER_CREDS "&text=Hi&to=2991000000" }, { "" } },
+    { "GET, session", 0, 2, 2, { CHECK_AUTH_URL, CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, { "", "" } },
+    { "GET, session reused", 0, 2, 1, { CHECK_SEND_SESSION_URL(CHECK_SESSION_1) }, { "" } },
+    { "GET, same handle again", 0, 0, 1, { CHECK_SEND_URL }, { "" } },
+    { "POST, same handle", 1, 0, 1, { CHECK_SEND_POST_URL }, { CHECK_SEND_POST_BODY } },
+    { "POST, other credentials", 1, 1, 1, { CHECK_HTTP_BASE "sendmsg.php?" CHECK_OTHER_CREDS }, { CHECK_SEND_POST_BODY } },
+    { "POST, session", 1, 2, 1, { CHECK_HTTP_BASE "sendmsg.php?session_id=" CHECK_SESSION_1 }, { CHECK_SEND_POST_BODY } },
+    { "POST, same handle again", 1, 0, 1, { CHECK_SEND_POST_URL }, { CHECK_SEND_POST_BODY } },
+};
+#define CHECK_PREPARED (int)(sizeof(aPrepared) / sizeof(aPrepared[0]))
+
+static const CheckBatch aBatches[] = {
+    { "caller's limit", 0, 3, 0, 1, CHECK_BATCH_URL("3") },
+    { "no limit", 0, 0, 0, 1, CHECK_BATCH_URL("255") },
+    { "handle's limit", 2, 0, 0, 1, CHECK_BATCH_URL("2") },
+    { "caller's limit under the handle's", 4, 2, 0, 1, CHECK_BATCH_URL("2") },
+    { "caller's limit over the handle's", 2, 3, 0, 0, NULL },
+    { "caller's limit over 255", 0, 256, 0, 0, NULL },
+    { "negative limit", 0, -1, 0, 0, NULL },
+    { "template longer than the limit", 0, 1, 1, 0, NULL },
+    { "template within the limit", 0, 2, 1, 1, NULL },
+    { "template longer than the handle's limit", 1, 0, 1, 0, NULL },
+};
+#define CHECK_BATCHES (int)(sizeof(aBatches) / sizeof(aBatches[0]))
+
+static const size_t aStreamReads[] = { 1, 7, CHECK_BODY_MAX };  // bytes asked for per read of a streamed body
+#define CHECK_STREAM_READS (int)(sizeof(aStreamReads) / sizeof(aStreamReads[0]))
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static void check_long(const char *chGroup, const char *chName, const char *chWhat, long iGot, long iExpected);
+static void check_str(const char *chGroup, const char *chName, const char *chWhat, const char *chGot, long iGotLen,
+                      const char *chExpected);
+static long check_text_build(char *chText, int iRepeat, const char *chRepeat, const char *chTail);
+static void check_segment_part(const char *chName, const ClickSegmentPart *oPart, int iUnits, int iUdhLen, int iDataLen,
+                               const unsigned char *aUdh);
+static void check_segment(void);
+static void check_msisdn(void);
+static void check_template(void);
+static void check_callback_receipt(void *pContext, const ClickDeliveryReceipt *oReceipt);
+static void check_callback_exchange(ClickCallbackServer *oServer, CheckReceipt *oReceipt, const CheckCallback *oCase);
+static void check_callback(void);
+static long check_submit_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void check_submit(void);
+static long check_stream_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void check_stream_send(ClickSmsHandle *oClickSms, eClickApi eApiType, int iDests, const ClickSmsString *sText,
+                              ClickMsisdn *aMsisdns, const ClickRecipients *oRecipients, const ClickAudience *oAudience,
+                              long iChunk);
+static void check_stream(void);
+static long check_calls_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static void check_calls(const char *chGroup, const char *chName, const CheckCalls *oCalls, int iCalls,
+                        const char *const *aUrls, const char *const *aBodies);
+static void check_session(void);
+static void check_prepared(void);
+static void check_batch(void);
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  check_long
+ * Info:      Checks a number, printing the check if it failed.
+ * Inputs:    chGroup   - group of checks (ie. "segment")
+ *            chName    - check name
+ *            chWhat    - value checked
+ *            iGot      - value returned by the library
+ *            iExpected - value expected
+ * Return:    void
+ */
+static void check_long(const char *chGroup, const char *chName, const char *chWhat, long iGot, long iExpected)
+{
+    iChecks++;
+    if (iGot == iExpected)
+        return;
+
+    iFailures++;
+    printf("FAIL: %s '%s': %s is %ld, expected %ld\n", chGroup, chName, chWhat, iGot, iExpected);
+}
+
+/*
+ * Function:  check_str
+ * Info:      Checks a string, printing the check if it failed.
+ * Inputs:    chGroup    - group of checks (ie. "msisdn")
+ *            chName     - check name
+ *            chWhat     - value checked
+ *            chGot      - value returned by the library, or NULL
+ *            iGotLen    - length of 'chGot' in bytes, or -1 if it is NUL terminated
+ *            chExpected - value expected
+ * Return:    void
+ */
+static void check_str(const char *chGroup, const char *chName, const char *chWhat, const char *chGot, long iGotLen,
+                      const char *chExpected)
+{
+    iChecks++;
+    if (chGot != NULL && iGotLen < 0)
+        iGotLen = (long)strlen(chGot);
+    if (chGot != NULL && iGotLen == (long)strlen(chExpected) && memcmp(chGot, chExpected, iGotLen) == 0)
+        return;
+
+    iFailures++;
+    printf("FAIL: %s '%s': %s is \"%.*s\", expected \"%s\"\n", chGroup, chName, chWhat, (chGot != NULL ? (int)iGotLen : 4),
+           (chGot != NULL ? chGot : "NULL"), chExpected);
+}
+
+/*
+ * Function:  check_text_build
+ * Info:      Builds a message text from a repeated string and a tail.
+ * Inputs:    iRepeat  - times 'chRepeat' starts the text
+ *            chRepeat - repeated string
+ *            chTail   - string which follows
+ * Outputs:   chText   - NUL terminated text (CHECK_TEXT_MAX bytes)
+ * Return:    length of the text in bytes
+ */
+static long check_text_build(char *chText, int iRepeat, const char *chRepeat, const char *chTail)
+{
+    long iLen = 0, iRepeatLen = (long)strlen(chRepeat);
+    int i = 0;
+
+    for (i = 0; i < iRepeat; i++, iLen += iRepeatLen)
+        memcpy(chText + iLen, chRepeat, iRepeatLen);
+    strcpy(chText + iLen, chTail);
+
+    return iLen + (long)strlen(chTail);
+}
+
+/*
+ * Function:  check_segment_part
+ * Info:      Checks one part of a split message.
+ * Inputs:    chName   - check name
+ *            oPart    - part written by click_segment_split()
+ *            iUnits   - expected septets or code units of the part's text
+ *            iUdhLen  - expected UDH length
+ *            iDataLen - expected user data length in octets
+ *            aUdh     - expected UDH (iUdhLen octets)
+ * Return:    void
+ */
+static void check_segment_part(const char *chName, const ClickSegmentPart *oPart, int iUnits, int iUdhLen, int iDataLen,
+                               const unsigned char *aUdh)
+{
+    check_long("segment", chName, "part units", oPart->iUnits, iUnits);
+    check_long("segment", chName, "part UDH length", oPart->iUdhLen, iUdhLen);
+    check_long("segment", chName, "part data length", oPart->iDataLen, iDataLen);
+    check_long("segment", chName, "part UDH", (iUdhLen > 0 ? memcmp(oPart->aData, aUdh, iUdhLen) : 0), 0);
+}
+
+/*
+ * Function:  check_segment
+ * Info:      Checks the part counts of messages at the single (160 septets, 70 code
+ *            units) and concatenated (153, 67) part boundaries, including characters
+ *            which may not be split between parts, and the UDH and user data of the
+ *            parts they are split into.
+ * Return:    void
+ */
+static void check_segment(void)
+{
+    static const unsigned char aUdh1[] = { 0x05, 0x00, 0x03, 0x42, 0x02, 0x01 };
+    static const unsigned char aUdh2[] = { 0x05, 0x00, 0x03, 0x42, 0x02, 0x02 };
+    const CheckSegmentCount *oCase = NULL;
+    ClickSegmentInfo oInfo;
+    ClickSegmentPart aParts[3];
+    char chText[CHECK_TEXT_MAX];
+    long iLen = 0;
+    int i = 0;
+
+    for (i = 0; i < CHECK_SEGMENT_COUNTS; i++) {
+        oCase = &aSegmentCounts[i];
+        iLen  = check_text_build(chText, oCase->iRepeat, oCase->chRepeat, oCase->chTail);
+
+        memset(&oInfo, 0, sizeof(oInfo));
+        check_long("segment", oCase->chName, "parts", click_segment_count(chText, iLen, &oInfo), oCase->iParts);
+        check_long("segment", oCase->chName, "charset", oInfo.eCharset, oCase->eCharset);
+        check_long("segment", oCase->chName, "units", oInfo.iUnits, oCase->iUnits);
+        check_long("segment", oCase->chName, "units per part", oInfo.iUnitsPerPart, oCase->iUnitsPerPart);
+        check_long("segment", oCase->chName, "units free", oInfo.iUnitsFree, oCase->iUnitsFree);
+    }
+
+    // 160 septets: a single part without a UDH, packed into all 140 octets
+    iLen = check_text_build(chText, 160, "a", "");
+    check_long("segment", "gsm7 split 160", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 1);
+    check_segment_part("gsm7 split 160", &aParts[0], 160, 0, 140, NULL);
+
+    // 161 septets: 153 after the UDH (plus a fill bit) in 140 octets, then 8 septets
+    iLen = check_text_build(chText, 161, "a", "");
+    check_long("segment", "gsm7 split 161", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 2);
+    check_segment_part("gsm7 split 161 part 1", &aParts[0], 153, 6, 140, aUdh1);
+    check_segment_part("gsm7 split 161 part 2", &aParts[1], 8, 6, 14, aUdh2);
+
+    // an escape and its code are never split: the part ends a septet short
+    iLen = check_text_build(chText, 152, "a", CHECK_GSM7_EXT "aaaaaaaaaa");
+    check_long("segment", "gsm7 split extension", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 2);
+    check_segment_part("gsm7 split extension part 1", &aParts[0], 152, 6, 140, aUdh1);
+    check_segment_part("gsm7 split extension part 2", &aParts[1], 12, 6, 17, aUdh2);
+    check_long("segment", "gsm7 split extension part 2", "text offset", aParts[1].iTextOffset, 152);
+
+    // 70 code units: a single part of 140 octets; 71: 67 code units after the UDH, then 4
+    iLen = check_text_build(chText, 70, CHECK_UCS2, "");
+    check_long("segment", "ucs2 split 70", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 1);
+    check_segment_part("ucs2 split 70", &aParts[0], 70, 0, 140, NULL);
+
+    iLen = check_text_build(chText, 71, CHECK_UCS2, "");
+    check_long("segment", "ucs2 split 71", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 2);
+    check_segment_part("ucs2 split 71 part 1", &aParts[0], 67, 6, 140, aUdh1);
+    check_segment_part("ucs2 split 71 part 2", &aParts[1], 4, 6, 14, aUdh2);
+    check_long("segment", "ucs2 split 71 part 2", "text offset", aParts[1].iTextOffset, 134);
+
+    // a surrogate pair is never split: the part ends a code unit short
+    iLen = check_text_build(chText, 66, CHECK_UCS2, CHECK_UCS2_PAIR CHECK_UCS2 CHECK_UCS2 CHECK_UCS2 CHECK_UCS2);
+    check_long("segment", "ucs2 split surrogate", "parts", click_segment_split(chText, iLen, 0x42, aParts, 3), 2);
+    check_segment_part("ucs2 split surrogate part 1", &aParts[0], 66, 6, 138, aUdh1);
+    check_segment_part("ucs2 split surrogate part 2", &aParts[1], 6, 6, 18, aUdh2);
+    check_long("segment", "ucs2 split surrogate part 2", "text offset", aParts[1].iTextOffset, 132);
+}
+
+/*
+ * Function:  check_msisdn
+ * Info:      Checks the normalization of numbers as users enter them: formatting,
+ *            international and national prefixes, default country codes, and each
+ *            reason a number is rejected. Valid numbers are also formatted back from
+ *            their integer form.
+ * Return:    void
+ */
+static void check_msisdn(void)
+{
+    const CheckMsisdn *oCase = NULL;
+    char chDigits[CLICK_MSISDN_MAX_DIGITS + 1], chFormatted[CLICK_MSISDN_MAX_DIGITS + 1];
+    unsigned long long iValue = 0;
+    int i = 0;
+
+    for (i = 0; i < CHECK_MSISDNS; i++) {
+        oCase = &aMsisdns[i];
+
+        check_long("msisdn", oCase->chNumber, "status",
+                   click_msisdn_normalize(oCase->chNumber, (long)strlen(oCase->chNumber), oCase->oRules, chDigits, &iValue),
+                   oCase->eStatus);
+        check_str("msisdn", oCase->chNumber, "digits", chDigits, -1, oCase->chDigits);
+
+        if (oCase->eStatus != CLICK_MSISDN_OK)
+            check_long("msisdn", oCase->chNumber, "value", (long)iValue, 0);
+        else {
+            check_long("msisdn", oCase->chNumber, "formatted length", click_msisdn_format(iValue, chFormatted),
+                       (long)strlen(oCase->chDigits));
+            check_str("msisdn", oCase->chNumber, "formatted", chFormatted, -1, oCase->chDigits);
+        }
+    }
+
+    // the length given is used, so a number need not be NUL terminated
+    check_long("msisdn", "length limited", "status", click_msisdn_normalize("0821234567999", 10, &oRulesZa, chDigits, NULL),
+               CLICK_MSISDN_OK);
+    check_str("msisdn", "length limited", "digits", chDigits, -1, "27821234567");
+}
+
+/*
+ * Function:  check_template
+ * Info:      Checks the rendering of templates: escaped braces, braces which do not
+ *            start a placeholder, unknown placeholders, and literals and values
+ *            encoded for a URL or JSON string.
+ * Return:    void
+ */
+static void check_template(void)
+{
+    static const char *const aEncodings[CLICK_ENCODING_COUNT] = { "raw", "url", "json" };
+    static const long aValueLens[] = { 1, 0 };
+    static const char *const aNullValue[] = { NULL, "42" };
+    const CheckTemplate *oCase = NULL;
+    const char *const *aValues = NULL;
+    ClickTemplate *oTemplate = NULL;
+    ClickSmsBuffer oBuf;
+    int i = 0;
+
+    memset(&oBuf, 0, sizeof(oBuf));
+
+    for (i = 0; i < CHECK_TEMPLATES; i++) {
+        oCase     = &aTemplates[i];
+        aValues   = (oCase->bUnsafe ? aTemplateUnsafe : aTemplateValues);
+        oTemplate = click_template_compile(oCase->chTemplate, aTemplateNames, 2);
+
+        if (oCase->chExpected == NULL) {
+            check_long("template", oCase->chTemplate, "compiled", (oTemplate != NULL), 0);
+            click_template_destroy(oTemplate);
+            continue;
+        }
+        check_long("template", oCase->chTemplate, "compiled", (oTemplate != NULL), 1);
+        if (oTemplate == NULL)
+            continue;
+
+        click_buffer_reset(&oBuf);
+        check_long("template", oCase->chTemplate, aEncodings[oCase->eEncoding],
+                   click_template_render(oTemplate, aValues, NULL, oCase->eEncoding, &oBuf), 0);
+        check_str("template", oCase->chTemplate, aEncodings[oCase->eEncoding], oBuf.data, oBuf.iLen, oCase->chExpected);
+        if (oCase->eEncoding == CLICK_ENCODING_RAW)
+            check_long("template", oCase->chTemplate, "length", click_template_render_len(oTemplate, aValues, NULL),
+                       (long)strlen(oCase->chExpected));
+
+        click_template_destroy(oTemplate);
+    }
+
+    // values of a given length need not be NUL terminated; a NULL value renders as empty text
+    oTemplate = click_template_compile("[{name}|{code}]", aTemplateNames, 2);
+    click_buffer_reset(&oBuf);
+    click_template_render(oTemplate, aTemplateValues, aValueLens, CLICK_ENCODING_RAW, &oBuf);
+    check_str("template", "value lengths", "raw", oBuf.data, oBuf.iLen, "[A|]");
+    click_buffer_reset(&oBuf);
+    click_template_render(oTemplate, aNullValue, NULL, CLICK_ENCODING_RAW, &oBuf);
+    check_str("template", "NULL value", "raw", oBuf.data, oBuf.iLen, "[|42]");
+    click_template_destroy(oTemplate);
+
+    click_buffer_free(&oBuf);
+}
+
+/*
+ * Function:  check_callback_receipt
+ * Info:      Delivery receipt handler of the callback checks: keeps the last receipt.
+ * Inputs:    pContext - CheckReceipt to fill in
+ *            oReceipt - receipt received
+ * Return:    void
+ */
+static void check_callback_receipt(void *pContext, const ClickDeliveryReceipt *oReceipt)
+{
+    CheckReceipt *oLast = (CheckReceipt *)pContext;
+
+    oLast->iReceipts++;
+    oLast->eFormat = oReceipt->eFormat;
+    oLast->iStatus = oReceipt->iStatus;
+    snprintf(oLast->chApiMsgId, sizeof(oLast->chApiMsgId), "%.*s", oReceipt->oApiMsgId.iLen, oReceipt->oApiMsgId.chData);
+}
+
+/*
+ * Function:  check_callback_exchange
+ * Info:      Sends a request to the callback receiver in pieces on a new connection,
+ *            polling the receiver until it is idle after each piece, and checks the
+ *            responses received after each piece and the receipts passed to the handler.
+ * Inputs:    oServer  - callback receiver
+ *            oReceipt - last receipt, filled in by check_callback_receipt()
+ *            oCase    - request and expected answers
+ * Return:    void
+ */
+static void check_callback_exchange(ClickCallbackServer *oServer, CheckReceipt *oReceipt, const CheckCallback *oCase)
+{
+    struct sockaddr_in oAddr;
+    char chOut[CHECK_CALLBACK_OUT_MAX];
+    const char *pData = NULL;
+    long iReceipts = oReceipt->iReceipts;
+    ssize_t iDone = 0;
+    int iFd = -1, iPiece = 0, iOutLen = 0, bClosed = 0;
+    size_t iLeft = 0;
+
+    memset(&oAddr, 0, sizeof(oAddr));
+    oAddr.sin_family      = AF_INET;
+    oAddr.sin_port        = htons((unsigned short)click_callback_server_port(oServer));
+    oAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((iFd = socket(AF_INET, SOCK_STREAM, 0)) < 0 || connect(iFd, (struct sockaddr *)&oAddr, sizeof(oAddr)) != 0) {
+        check_long("callback", oCase->chName, "connected", 0, 1);
+        if (iFd >= 0)
+            close(iFd);
+        return;
+    }
+
+    for (iPiece = 0; iPiece < CHECK_CALLBACK_PIECES && oCase->aPieces[iPiece] != NULL; iPiece++) {
+        for (pData = oCase->aPieces[iPiece], iLeft = strlen(pData); iLeft > 0; pData += iDone, iLeft -= iDone) {
+            if ((iDone = send(iFd, pData, iLeft, MSG_NOSIGNAL)) <= 0)
+                break;
+        }
+        while (click_callback_server_poll(oServer, CHECK_CALLBACK_POLL_MS) > 0)
+            ;
+
+        // responses to the data sent so far: whatever is waiting, or none
+        for (iOutLen = 0; !bClosed && iOutLen < CHECK_CALLBACK_OUT_MAX - 1; iOutLen += (int)iDone) {
+            if ((iDone = recv(iFd, chOut + iOutLen, CHECK_CALLBACK_OUT_MAX - 1 - iOutLen, MSG_DONTWAIT)) <= 0) {
+                bClosed = (iDone == 0);
+                break;
+            }
+        }
+        check_str("callback", oCase->chName, "response", chOut, iOutLen, oCase->aResponses[iPiece]);
+    }
+
+    check_long("callback", oCase->chName, "closed", bClosed, oCase->bClosed);
+    check_long("callback", oCase->chName, "receipts", oReceipt->iReceipts - iReceipts, oCase->iReceipts);
+    if (oCase->chApiMsgId != NULL) {
+        check_str("callback", oCase->chName, "apiMsgId", oReceipt->chApiMsgId, -1, oCase->chApiMsgId);
+        check_long("callback", oCase->chName, "status", oReceipt->iStatus, oCase->iStatus);
+        check_long("callback", oCase->chName, "format", oReceipt->eFormat, oCase->eFormat);
+    }
+
+    close(iFd);
+    while (click_callback_server_poll(oServer, 0) > 0) // let the receiver see the connection close
+        ;
+}
+
+/*
+ * Function:  check_callback
+ * Info:      Checks the callback receiver's answers to requests split at any point,
+ *            pipelined requests, a bad, short, missing or too large Content-Length,
+ *            malformed request and header lines, and an oversized request line.
+ * Return:    void
+ */
+static void check_callback(void)
+{
+    static char chLongLine[CLICK_CALLBACK_REQUEST_MAX + 1];
+    ClickCallbackServer *oServer = click_callback_server_create("127.0.0.1", 0, 0);
+    ClickCallbackStats oStats;
+    CheckCallback oLongLine;
+    CheckReceipt oReceipt;
+    int i = 0;
+
+    if (oServer == NULL) {
+        check_long("callback", "server", "listening", 0, 1);
+        return;
+    }
+    memset(&oReceipt, 0, sizeof(oReceipt));
+    click_callback_server_receipt_handler_set(oServer, check_callback_receipt, &oReceipt);
+
+    for (i = 0; i < CHECK_CALLBACKS; i++)
+        check_callback_exchange(oServer, &oReceipt, &aCallbacks[i]);
+
+    // a request line which fills the connection's buffer without ending
+    memset(chLongLine, 'a', CLICK_CALLBACK_REQUEST_MAX);
+    memcpy(chLongLine, "GET /callback?apiMsgId=", 23);
+    memset(&oLongLine, 0, sizeof(oLongLine));
+    oLongLine.chName        = "oversized request line";
+    oLongLine.aPieces[0]    = chLongLine;
+    oLongLine.aResponses[0] = CHECK_HTTP_LARGE_CLOSE;
+    oLongLine.bClosed       = 1;
+    check_callback_exchange(oServer, &oReceipt, &oLongLine);
+
+    click_callback_server_stats_get(oServer, &oStats);
+    check_long("callback", "server", "open connections", oStats.iOpen, 0);
+
+    click_callback_server_destroy(oServer);
+}
+
+/*
+ * Function:  check_submit_transport
+ * Info:      Transport which returns the response of a submit check, whatever the request.
+ * Inputs:    pContext - CheckSubmit case
+ *            oRequest - formatted request
+ * Return:    HTTP status code of the case
+ */
+static long check_submit_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    const CheckSubmit *oCase = (const CheckSubmit *)pContext;
+    size_t iLen = strlen(oCase->chResponse);
+
+    if (iLen > 0 && oRequest->fnWrite((void *)oCase->chResponse, 1, iLen, oRequest->pWriteData) != iLen)
+        return -1;
+
+    return oCase->iStatus;
+}
+
+/*
+ * Function:  check_submit
+ * Info:      Checks whether a submitted message is taken as accepted, given the API's
+ *            response: compact and spaced REST JSON, with and without an error, and HTTP
+ *            API "ID:" and "ERR:" responses.
+ * Return:    void
+ */
+static void check_submit(void)
+{
+    ClickSmsHandle *aHandles[CLICK_API_COUNT] = { NULL };
+    ClickSmsString *sText = click_string_create("Hello");
+    ClickSmsString *sTo   = click_string_create("2991000000");
+    ClickMsisdn oMsisdns;
+    int i = 0;
+
+    oMsisdns.iNum   = 1;
+    oMsisdns.aDests = &sTo;
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        aHandles[i] = loopback_handle_create((eClickApi)i);
+
+    for (i = 0; i < CHECK_SUBMITS; i++) {
+        const CheckSubmit *oCase = &aSubmits[i];
+        ClickSmsHandle *oClickSms = aHandles[oCase->eApiType];
+
+        if (oClickSms == NULL || clickatell_sms_handle_transport_set(oClickSms, check_submit_transport, (void *)oCase) != 0) {
+            check_long("submit", oCase->chName, "transport set", 0, 1);
+            continue;
+        }
+        check_long("submit", oCase->chName, "result", clickatell_sms_message_submit(oClickSms, sText, &oMsisdns), oCase->eSubmit);
+    }
+
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        clickatell_sms_handle_shutdown(aHandles[i]);
+    click_string_destroy(sText);
+    click_string_destroy(sTo);
+}
+
+/*
+ * Function:  check_stream_transport
+ * Info:      Transport which captures the body of a request, reading a streamed body in
+ *            reads of the context's size, then returns the loopback response.
+ * Inputs:    pContext - CheckBody
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long check_stream_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    CheckBody *oBody = (CheckBody *)pContext;
+    size_t iRead = 0;
+
+    oBody->bStreamed = (oRequest->fnRead != NULL);
+    oBody->iDeclared = (long)oRequest->iBodyLen;
+    oBody->iLen      = 0;
+    if (oRequest->fnRead != NULL) {
+        // read until the stream ends, or past the declared length into the spare byte
+        while (oBody->iLen < CHECK_BODY_MAX + 1) {
+            iRead = CHECK_BODY_MAX + 1 - oBody->iLen;
+            iRead = oRequest->fnRead(oBody->chBody + oBody->iLen, 1, (oBody->iReadSize < iRead ? oBody->iReadSize : iRead),
+                                     oRequest->pReadData);
+            if (iRead == 0)
+                break;
+            oBody->iLen += iRead;
+        }
+    }
+    else if (oRequest->chBody != NULL && oRequest->iBodyLen <= CHECK_BODY_MAX) {
+        memcpy(oBody->chBody, oRequest->chBody, oRequest->iBodyLen);
+        oBody->iLen = (long)oRequest->iBodyLen;
+    }
+    oBody->chBody[oBody->iLen < CHECK_BODY_MAX ? oBody->iLen : CHECK_BODY_MAX] = '\0';
+
+    return loopback_transport(&oBody->eApiType, oRequest);
+}
+
+/*
+ * Function:  check_stream_send
+ * Info:      Sends a message to one of the destination forms, first with its body formatted
+ *            in memory, then with it streamed in reads of each size, and checks that each
+ *            streamed body is the same as the formatted one and as long as declared.
+ * Inputs:    oClickSms   - handle to send on
+ *            eApiType    - API type of the handle
+ *            iDests      - number of recipients sent to
+ *            sText       - message text
+ *            aMsisdns    - recipients as strings, or NULL
+ *            oRecipients - compact recipient list, or NULL
+ *            oAudience   - prepared audience, or NULL
+ *            iChunk      - chunk of the audience sent to
+ * Return:    void
+ */
+static void check_stream_send(ClickSmsHandle *oClickSms, eClickApi eApiType, int iDests, const ClickSmsString *sText,
+                              ClickMsisdn *aMsisdns, const ClickRecipients *oRecipients, const ClickAudience *oAudience,
+                              long iChunk)
+{
+    static CheckBody oBody;
+    static char chFormatted[CHECK_BODY_MAX + 1];
+    char chName[64];
+    ClickSmsString *sResponse = NULL;
+    long iFormattedLen = 0;
+    int i = 0;
+
+    for (i = -1; i < CHECK_STREAM_READS; i++) {
+        // a first send with the body formatted in memory, then streamed sends
+        oBody.eApiType  = eApiType;
+        oBody.iReadSize = (i < 0 ? 0 : aStreamReads[i]);
+        clickatell_sms_handle_option_set(oClickSms, CLICK_SMS_OPTION_STREAM_BODY, (i < 0 ? 0 : 1));
+        clickatell_sms_handle_transport_set(oClickSms, check_stream_transport, &oBody);
+
+        if (aMsisdns != NULL)
+            sResponse = clickatell_sms_message_send(oClickSms, sText, aMsisdns);
+        else if (oRecipients != NULL)
+            sResponse = clickatell_sms_message_send_recipients(oClickSms, sText->data, -1, oRecipients);
+        else
+            sResponse = clickatell_sms_message_send_audience(oClickSms, sText->data, -1, oAudience, iChunk);
+        click_string_destroy(sResponse);
+
+        snprintf(chName, sizeof(chName), "%s %s, %d to%s", (oBody.eApiType == CLICK_API_REST ? "REST" : "HTTP POST"),
+                 (aMsisdns != NULL ? "ClickMsisdn" : (oRecipients != NULL ? "ClickRecipients" : "audience chunk")), iDests,
+                 (i < 0 ? ", formatted" : ""));
+        if (i < 0) {
+            check_long("stream", chName, "streamed", oBody.bStreamed, 0);
+            check_long("stream", chName, "declared length", oBody.iDeclared, oBody.iLen);
+            memcpy(chFormatted, oBody.chBody, oBody.iLen + 1);
+            iFormattedLen = oBody.iLen;
+            continue;
+        }
+        snprintf(chName + strlen(chName), sizeof(chName) - strlen(chName), ", %ld-byte reads", (long)aStreamReads[i]);
+        check_long("stream", chName, "streamed", oBody.bStreamed, 1);
+        check_long("stream", chName, "declared length", oBody.iDeclared, iFormattedLen);
+        check_str("stream", chName, "body", oBody.chBody, oBody.iLen, chFormatted);
+    }
+}
+
+/*
+ * Function:  check_stream
+ * Info:      Checks that a send body streamed from the text and recipients (see
+ *            CLICK_SMS_OPTION_STREAM_BODY) is byte for byte the body formatted in memory,
+ *            with the length declared, for the REST API and HTTP API form POSTs, to
+ *            recipients as strings, in a compact list and in audience chunks.
+ * Return:    void
+ */
+static void check_stream(void)
+{
+    ClickSmsString *sText = click_string_create("Hi \"Ann\" & co, 50% off\\now\n" CHECK_GSM7_EXT);
+    ClickSmsString *aTo[CHECK_STREAM_DESTS];
+    ClickRecipients *oRecipients = click_recipients_create(CHECK_STREAM_DESTS);
+    ClickAudience *oAudience = NULL;
+    ClickSmsHandle *oClickSms = NULL;
+    ClickMsisdn oMsisdns;
+    long iChunk = 0;
+    int i = 0, iApi = 0;
+
+    for (i = 0; i < CHECK_STREAM_DESTS; i++) {
+        aTo[i] = click_string_create(aStreamDests[i]);
+        if (oRecipients != NULL && click_recipients_add(oRecipients, aStreamDests[i], strlen(aStreamDests[i]), &oRulesZa) != 0)
+            check_long("stream", aStreamDests[i], "recipient added", 0, 1);
+    }
+    if (oRecipients != NULL)
+        oAudience = click_audience_create(oRecipients, CHECK_STREAM_CHUNK);
+    if (oAudience == NULL) {
+        check_long("stream", "audience", "created", 0, 1);
+        goto check_stream_done;
+    }
+
+    for (iApi = 0; iApi < CLICK_API_COUNT; iApi++) {
+        if ((oClickSms = loopback_handle_create((eClickApi)iApi)) == NULL) {
+            check_long("stream", "handle", "created", 0, 1);
+            continue;
+        }
+        clickatell_sms_handle_option_set(oClickSms, CLICK_SMS_OPTION_HTTP_POST, 1);
+
+        // one recipient, and several
+        oMsisdns.aDests = aTo;
+        for (oMsisdns.iNum = 1; oMsisdns.iNum <= CHECK_STREAM_DESTS; oMsisdns.iNum += CHECK_STREAM_DESTS - 1)
+            check_stream_send(oClickSms, (eClickApi)iApi, oMsisdns.iNum, sText, &oMsisdns, NULL, NULL, 0);
+        check_stream_send(oClickSms, (eClickApi)iApi, CHECK_STREAM_DESTS, sText, NULL, oRecipients, NULL, 0);
+        for (iChunk = 0; iChunk < oAudience->iChunks; iChunk++)
+            check_stream_send(oClickSms, (eClickApi)iApi, oAudience->aChunks[iChunk].iNum, sText, NULL, NULL, oAudience, iChunk);
+
+        clickatell_sms_handle_shutdown(oClickSms);
+    }
+
+check_stream_done:
+    click_audience_destroy(oAudience);
+    click_recipients_destroy(oRecipients);
+    for (i = 0; i < CHECK_STREAM_DESTS; i++)
+        click_string_destroy(aTo[i]);
+    click_string_destroy(sText);
+}
+
+/*
+ * Function:  check_calls_transport
+ * Info:      Transport which records the URL and body of each request, then returns the
+ *            next scripted response, or else the loopback response.
+ * Inputs:    pContext - CheckCalls
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long check_calls_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    CheckCalls *oCalls = (CheckCalls *)pContext;
+    const char *chResponse = NULL;
+    int iCall = oCalls->iCalls++;
+
+    if (iCall >= CHECK_CALLS_MAX)
+        return loopback_transport(&oCalls->eApiType, oRequest);
+
+    snprintf(oCalls->aUrls[iCall], CHECK_CALL_URL_MAX, "%s", oRequest->chUrl);
+    snprintf(oCalls->aBodies[iCall], CHECK_CALL_URL_MAX, "%.*s", (int)(oRequest->chBody != NULL ? oRequest->iBodyLen : 0),
+             (oRequest->chBody != NULL ? oRequest->chBody : ""));
+
+    if (oCalls->aScript == NULL || (chResponse = oCalls->aScript[iCall]) == NULL)
+        return loopback_transport(&oCalls->eApiType, oRequest);
+    if (oRequest->fnWrite((void *)chResponse, 1, strlen(chResponse), oRequest->pWriteData) != strlen(chResponse))
+        return -1;
+
+    return 200;
+}
+
+/*
+ * Function:  check_calls
+ * Info:      Checks the count of requests recorded by check_calls_transport(), and the URL
+ *            and body of each.
+ * Inputs:    chGroup - group of checks
+ *            chName  - check name
+ *            oCalls  - requests recorded
+ *            iCalls  - requests expected
+ *            aUrls   - URLs expected
+ *            aBodies - bodies expected, or NULL if not checked
+ * Return:    void
+ */
+static void check_calls(const char *chGroup, const char *chName, const CheckCalls *oCalls, int iCalls,
+                        const char *const *aUrls, const char *const *aBodies)
+{
+    char chWhat[32];
+    int i = 0;
+
+    check_long(chGroup, chName, "requests", oCalls->iCalls, iCalls);
+    for (i = 0; i < iCalls && i < oCalls->iCalls && i < CHECK_CALLS_MAX; i++) {
+        snprintf(chWhat, sizeof(chWhat), "request %d URL", i + 1);
+        check_str(chGroup, chName, chWhat, oCalls->aUrls[i], -1, aUrls[i]);
+        if (aBodies != NULL) {
+            snprintf(chWhat, sizeof(chWhat), "request %d body", i + 1);
+            check_str(chGroup, chName, chWhat, oCalls->aBodies[i], -1, aBodies[i]);
+        }
+    }
+}
+
+/*
+ * Function:  check_session
+ * Info:      Checks the requests of consecutive sends on an HTTP API handle as its session
+ *            (see CLICK_SMS_OPTION_HTTP_SESSION) is opened with auth.php, used instead of
+ *            the credentials, renewed and retried once when rejected with ERR: 001 or
+ *            ERR: 003, and dropped when sessions are disabled.
+ * Return:    void
+ */
+static void check_session(void)
+{
+    ClickSmsHandle *oClickSms = loopback_handle_create(CLICK_API_HTTP);
+    ClickSmsString *sText = click_string_create("Hi");
+    ClickSmsString *sTo   = click_string_create("2991000000");
+    ClickSmsString *sResponse = NULL;
+    static CheckCalls oCalls;
+    ClickMsisdn oMsisdns;
+    int i = 0;
+
+    if (oClickSms == NULL) {
+        check_long("session", "handle", "created", 0, 1);
+        goto check_session_done;
+    }
+    oMsisdns.iNum   = 1;
+    oMsisdns.aDests = &sTo;
+    clickatell_sms_handle_transport_set(oClickSms, check_calls_transport, &oCalls);
+
+    for (i = 0; i < CHECK_SESSIONS; i++) {
+        const CheckSession *oCase = &aSessions[i];
+
+        memset(&oCalls, 0, sizeof(oCalls));
+        oCalls.eApiType = CLICK_API_HTTP;
+        oCalls.aScript  = oCase->aScript;
+        if (oCase->iSession >= 0)
+            clickatell_sms_handle_option_set(oClickSms, CLICK_SMS_OPTION_HTTP_SESSION, oCase->iSession);
+
+        sResponse = clickatell_sms_message_send(oClickSms, sText, &oMsisdns);
+        check_calls("session", oCase->chName, &oCalls, oCase->iCalls, oCase->aUrls, NULL);
+        check_str("session", oCase->chName, "response", (CLICK_STR_INVALID(sResponse) ? "" : sResponse->data), -1,
+                  oCase->chResponse);
+        click_string_destroy(sResponse);
+    }
+
+    clickatell_sms_handle_shutdown(oClickSms);
+
+check_session_done:
+    click_string_destroy(sText);
+    click_string_destroy(sTo);
+}
+
+/*
+ * Function:  check_prepared
+ * Info:      Checks the requests of prepared HTTP API sends (GET and form POST) executed
+ *            on the handle which prepared them, which sends the prepared URL; on a handle
+ *            with other credentials, whose URL is formatted again from the prepared query;
+ *            and on a handle with a session, which sends the session ID instead.
+ * Return:    void
+ */
+static void check_prepared(void)
+{
+    static CheckCalls oCalls;
+    ClickSmsHandle *aHandles[3] = { NULL };
+    ClickSmsRequest *aRequests[2] = { NULL };
+    ClickSmsString *sText  = click_string_create("Hi");
+    ClickSmsString *sTo    = click_string_create("2991000000");
+    ClickSmsString *sUser  = click_string_create("otheruser");
+    ClickSmsString *sPass  = click_string_create("other");
+    ClickSmsString *sApiId = click_string_create("1234567");
+    ClickSmsString *sResponse = NULL;
+    ClickMsisdn oMsisdns;
+    int i = 0;
+
+    oMsisdns.iNum   = 1;
+    oMsisdns.aDests = &sTo;
+    aHandles[0] = loopback_handle_create(CLICK_API_HTTP);
+    aHandles[1] = clickatell_sms_handle_init(CLICK_API_HTTP, sUser, sPass, NULL, sApiId, 5, 2);
+    aHandles[2] = loopback_handle_create(CLICK_API_HTTP);
+    for (i = 0; i < 3; i++) {
+        if (aHandles[i] == NULL) {
+            check_long("prepared", "handle", "created", 0, 1);
+            goto check_prepared_done;
+        }
+        clickatell_sms_handle_transport_set(aHandles[i], check_calls_transport, &oCalls);
+    }
+    clickatell_sms_handle_option_set(aHandles[2], CLICK_SMS_OPTION_HTTP_SESSION, 300);
+
+    // a GET request, and a form POST request
+    for (i = 0; i < 2; i++) {
+        clickatell_sms_handle_option_set(aHandles[0], CLICK_SMS_OPTION_HTTP_POST, i);
+        if ((aRequests[i] = clickatell_sms_request_prepare(aHandles[0], sText, &oMsisdns)) == NULL) {
+            check_long("prepared", (i == 0 ? "GET" : "POST"), "prepared", 0, 1);
+            goto check_prepared_done;
+        }
+    }
+
+    for (i = 0; i < CHECK_PREPARED; i++) {
+        const CheckPrepared *oCase = &aPrepared[i];
+
+        memset(&oCalls, 0, sizeof(oCalls));
+        oCalls.eApiType = CLICK_API_HTTP;
+        sResponse = clickatell_sms_request_execute(aHandles[oCase->iHandle], aRequests[oCase->bPost]);
+        check_calls("prepared", oCase->chName, &oCalls, oCase->iCalls, oCase->aUrls, oCase->aBodies);
+        check_str("prepared", oCase->chName, "response", (CLICK_STR_INVALID(sResponse) ? "" : sResponse->data), -1,
+                  CHECK_SEND_ID);
+        click_string_destroy(sResponse);
+    }
+
+check_prepared_done:
+    for (i = 0; i < 2; i++)
+        clickatell_sms_request_release(aRequests[i]);
+    for (i = 0; i < 3; i++) {
+        if (aHandles[i] != NULL)
+            clickatell_sms_handle_shutdown(aHandles[i]);
+    }
+    click_string_destroy(sText);
+    click_string_destroy(sTo);
+    click_string_destroy(sUser);
+    click_string_destroy(sPass);
+    click_string_destroy(sApiId);
+}
+
+/*
+ * Function:  check_batch
+ * Info:      Checks the part limit ("concat") a batch is started with: the caller's, else
+ *            the handle's, else 255, and that limits over the handle's or 255 and templates
+ *            needing more parts are rejected without a request.
+ * Return:    void
+ */
+static void check_batch(void)
+{
+    static CheckCalls oCalls;
+    static char chLong[CHECK_TEXT_MAX];
+    ClickSmsHandle *oClickSms = loopback_handle_create(CLICK_API_HTTP);
+    ClickSmsString *sResponse = NULL;
+    long iLongLen = check_text_build(chLong, 161, "a", " #field1#");
+    int i = 0;
+
+    if (oClickSms == NULL) {
+        check_long("batch", "handle", "created", 0, 1);
+        return;
+    }
+    clickatell_sms_handle_transport_set(oClickSms, check_calls_transport, &oCalls);
+
+    for (i = 0; i < CHECK_BATCHES; i++) {
+        const CheckBatch *oCase = &aBatches[i];
+
+        memset(&oCalls, 0, sizeof(oCalls));
+        oCalls.eApiType = CLICK_API_HTTP;
+        clickatell_sms_handle_option_set(oClickSms, CLICK_SMS_OPTION_MAX_PARTS, oCase->iHandleMax);
+        sResponse = clickatell_sms_batch_start(oClickSms, (oCase->bLong ? chLong : "Hi #field1#"), (oCase->bLong ? iLongLen : 11),
+                                               oCase->iMaxParts);
+        check_long("batch", oCase->chName, "requests", oCalls.iCalls, oCase->iCalls);
+        check_long("batch", oCase->chName, "started", (sResponse != NULL), (oCase->iCalls > 0));
+        if (oCase->chUrl != NULL && oCalls.iCalls > 0)
+            check_str("batch", oCase->chName, "URL", oCalls.aUrls[0], -1, oCase->chUrl);
+        click_string_destroy(sResponse);
+    }
+
+    clickatell_sms_handle_shutdown(oClickSms);
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Main function which checks the Clickatell SMS library's output                *
+ * ----------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    clickatell_sms_init();
+    click_debug_init(CLICK_DEBUG_OFF);
+
+    check_segment();
+    check_msisdn();
+    check_template();
+    check_callback();
+    check_submit();
+    check_stream();
+    check_session();
+    check_prepared();
+    check_batch();
+
+    clickatell_sms_shutdown();
+
+    printf("%ld checks, %ld failed\n", iChecks, iFailures);
+    printf("Check test %s\n", (iFailures > 0 ? "FAILED" : "passed"));
+
+    return (iFailures > 0 ? 1 : 0);
+}
@@ -0,0 +1,115 @@
+/*
+ * clickatell_audience.c
+ *
+ *  Prepared recipient audience: a recipient list split into request-sized chunks, each
+ *  serialized up front in the HTTP and REST wire forms. See clickatell_audience.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_recipients.h"
+#include "clickatell_sms.h"
+#include "clickatell_audience.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_audience_create
+ * Info:      Prepares an audience from a recipient list: the list is split into chunks of
+ *            at most 'iChunkMax' recipients, and each chunk is written in both wire forms
+ *            (ie. 2799900001,2799900002 and "2799900001","2799900002"). The HTTP form is
+ *            copied as it is from the list's buffer; the REST form is written number by
+ *            number. All forms share one allocation.
+ *            Note that the calling function must destroy the returned audience.
+ * Inputs:    oRecipients - recipient list, which is copied
+ *            iChunkMax   - most recipients per chunk (ie. CLICK_SMS_HTTP_POST_TO_MAX), or 0
+ *                          for CLICK_SMS_HTTP_GET_TO_MAX
+ * Return:    new audience, or NULL if invalid parameter or failed to allocate memory
+ */
+ClickAudience *click_audience_create(const ClickRecipients *oRecipients, long iChunkMax)
+{
+    ClickAudience *oAudience = NULL;
+    ClickAudienceChunk *oChunk = NULL;
+    const long *aOffsets = NULL;
+    const char *chDigits = NULL;
+    char *pOut = NULL;
+    long i = 0, iChunk = 0, iDestLen = 0;
+
+    if (oRecipients == NULL || oRecipients->iNum < 1 || iChunkMax < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if (iChunkMax == 0)
+        iChunkMax = CLICK_SMS_HTTP_GET_TO_MAX;
+
+    if ((oAudience = (ClickAudience *)calloc(1, sizeof(ClickAudience))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for audience!\n", __func__);
+        return NULL;
+    }
+    oAudience->iNum      = oRecipients->iNum;
+    oAudience->iChunkMax = iChunkMax;
+    oAudience->iChunks   = (oRecipients->iNum + iChunkMax - 1) / iChunkMax;
+
+    // each form holds the list's digits and separators (the REST form adds 2 quotes per number), plus a NUL per chunk
+    oAudience->aChunks = (ClickAudienceChunk *)calloc(oAudience->iChunks, sizeof(ClickAudienceChunk));
+    oAudience->chData  = malloc(2 * (oRecipients->oDigits.iLen + oAudience->iChunks) + 2 * oRecipients->iNum);
+    if (oAudience->aChunks == NULL || oAudience->chData == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for audience!\n", __func__);
+        click_audience_destroy(oAudience);
+        return NULL;
+    }
+
+    aOffsets = oRecipients->aOffsets;
+    chDigits = oRecipients->oDigits.data;
+    pOut     = oAudience->chData;
+    for (iChunk = 0; iChunk < oAudience->iChunks; iChunk++) {
+        oChunk = &oAudience->aChunks[iChunk];
+        oChunk->iFirst = iChunk * iChunkMax;
+        oChunk->iNum   = (oRecipients->iNum - oChunk->iFirst < iChunkMax ? oRecipients->iNum - oChunk->iFirst : iChunkMax);
+
+        // HTTP: the list's numbers and separators, without the separator after the last
+        oChunk->chHttp   = pOut;
+        oChunk->iHttpLen = aOffsets[oChunk->iFirst + oChunk->iNum] - 1 - aOffsets[oChunk->iFirst];
+        memcpy(pOut, chDigits + aOffsets[oChunk->iFirst], oChunk->iHttpLen);
+        pOut   += oChunk->iHttpLen;
+        *pOut++ = '\0';
+
+        // REST: each number quoted
+        oChunk->chRest = pOut;
+        for (i = oChunk->iFirst; i < oChunk->iFirst + oChunk->iNum; i++) {
+            iDestLen = aOffsets[i + 1] - 1 - aOffsets[i];
+            if (i > oChunk->iFirst)
+                *pOut++ = ',';
+            *pOut++ = '"';
+            memcpy(pOut, chDigits + aOffsets[i], iDestLen);
+            pOut   += iDestLen;
+            *pOut++ = '"';
+        }
+        oChunk->iRestLen = pOut - oChunk->chRest;
+        *pOut++ = '\0';
+    }
+
+    return oAudience;
+}
+
+/*
+ * Function:  click_audience_destroy
+ * Info:      Destroys an audience. No send may be using it.
+ * Inputs:    oAudience - audience to destroy
+ * Return:    void
+ */
+void click_audience_destroy(ClickAudience *oAudience)
+{
+    if (oAudience == NULL)
+        return;
+
+    free(oAudience->aChunks);
+    free(oAudience->chData);
+    free(oAudience);
+}
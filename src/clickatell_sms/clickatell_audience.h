@@ -0,0 +1,48 @@
+#ifndef CLICKATELL_AUDIENCE_H
+#define CLICKATELL_AUDIENCE_H
+
+/*
+ * clickatell_audience.h
+ *
+ *  Prepared recipient audience used by the Clickatell SMS library.
+ *
+ *  Sending many messages to the same large recipient group formats the group's "to"
+ *  parameter into every request. A ClickAudience is prepared once from a ClickRecipients
+ *  list: it is split into chunks of at most as many recipients as one request may take,
+ *  and each chunk is serialized up front in both wire forms, the HTTP API's ','
+ *  separated list and the REST API's array of quoted numbers. A send then splices a
+ *  chunk into its request as it is (see clickatell_sms_message_send_audience()), without
+ *  formatting any recipient.
+ *
+ *  An audience keeps its own copy of the numbers in a single allocation and is never
+ *  changed once created, so it may be sent from any number of handles and threads at
+ *  once, and the list it was prepared from may be reused.
+ */
+
+#include "clickatell_string.h"
+#include "clickatell_recipients.h"
+
+// one request's worth of an audience's recipients, in both wire forms
+typedef struct ClickAudienceChunk {
+    long iFirst;            // index in the audience of the chunk's first recipient
+    long iNum;              // number of recipients in the chunk
+    const char *chHttp;     // HTTP API "to" value: numbers separated by ',' (NUL terminated)
+    long iHttpLen;          // length of 'chHttp'
+    const char *chRest;     // REST API "to" array contents: quoted numbers separated by ',' (NUL terminated)
+    long iRestLen;          // length of 'chRest'
+} ClickAudienceChunk;
+
+// prepared audience (see click_audience_create()); read only once created
+typedef struct ClickAudience {
+    long iNum;                  // number of recipients
+    long iChunkMax;             // most recipients per chunk
+    long iChunks;               // number of chunks
+    ClickAudienceChunk *aChunks;
+    char *chData;               // wire forms of all chunks, in one allocation
+} ClickAudience;
+
+// function declarations
+ClickAudience *click_audience_create(const ClickRecipients *oRecipients, long iChunkMax);
+void click_audience_destroy(ClickAudience *oAudience);
+
+#endif // CLICKATELL_AUDIENCE_H
@@ -0,0 +1,1198 @@
+/*
+ * clickatell_callback.c
+ *
+ *  Callback receiver module: an embedded epoll HTTP/1.1 server which parses Clickatell
+ *  delivery receipt callbacks in place and passes them to a handler, and parses inbound
+ *  message callbacks into a lock-free queue. See clickatell_callback.h.
+ */
+
+#define _GNU_SOURCE // accept4(), memmem()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_charset.h"
+#include "clickatell_callback.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// room for responses not yet sent on a connection, and the longest single response
+#define LOCAL_CALLBACK_OUT_MAX          2048
+#define LOCAL_CALLBACK_RESPONSE_MAX     128
+
+// epoll events handled per epoll_wait() call
+#define LOCAL_CALLBACK_EVENTS           256
+
+// Fields of a callback which the server recognises, in either format
+typedef enum eLocalCallbackField {
+    LOCAL_FIELD_API_ID,
+    LOCAL_FIELD_API_MSG_ID,
+    LOCAL_FIELD_CLI_MSG_ID,
+    LOCAL_FIELD_TO,
+    LOCAL_FIELD_FROM,
+    LOCAL_FIELD_TIMESTAMP,
+    LOCAL_FIELD_STATUS,
+    LOCAL_FIELD_CHARGE,
+    LOCAL_FIELD_MO_MSG_ID,
+    LOCAL_FIELD_TEXT,
+    LOCAL_FIELD_CHARSET,
+    LOCAL_FIELD_COUNT
+} eLocalCallbackField;
+
+// Names of a callback field in the HTTP (query/form) and REST (JSON) formats
+typedef struct LocalCallbackKey {
+    const char *chHttp;     // HTTP API name
+    const char *chRest;     // REST API name
+} LocalCallbackKey;
+
+static const LocalCallbackKey aLocalCallbackKeys[LOCAL_FIELD_COUNT] = {
+    { "api_id",    "apiId" },
+    { "apiMsgId",  "apiMessageId" },
+    { "cliMsgId",  "clientMessageId" },
+    { "to",        "to" },
+    { "from",      "from" },
+    { "timestamp", "timestamp" },
+    { "status",    "messageStatus" },
+    { "charge",    "charge" },
+    { "moMsgId",   "moMessageId" },
+    { "text",      "text" },
+    { "charset",   "charset" },
+};
+
+// One connection to the server
+typedef struct LocalCallbackConn {
+    int iFd;                    // socket, or -1 if the connection is closed
+    int iLen;                   // bytes received into aIn and not yet parsed
+    int iHeaderScan;            // bytes at the start of aIn already searched for the end of the headers
+    int iOutLen;                // bytes of responses in aOut
+    int iOutSent;               // bytes of aOut already sent
+    int bClose;                 // close the connection once aOut is sent
+    int bWriting;               // waiting for the socket to become writable (input is not read)
+    struct LocalCallbackConn *oNextFree; // next closed connection available for reuse
+    char aOut[LOCAL_CALLBACK_OUT_MAX];   // responses not yet sent
+    char aIn[CLICK_CALLBACK_REQUEST_MAX]; // request data, parsed in place
+} LocalCallbackConn;
+
+// internal structure (hidden from public access) of a callback receiver
+struct ClickCallbackServer {
+    int iListenFd;              // listening socket
+    int iEpollFd;               // epoll instance
+    int iWakeFd;                // eventfd which wakes the server's thread (see click_callback_server_stop())
+    int iPort;                  // port listened on
+    int bStop;                  // set by click_callback_server_stop(), read atomically
+    int iMaxConnections;        // limit of open connections
+    int iNumConns;              // connections allocated in aConns
+    LocalCallbackConn **aConns; // all connections allocated, open or closed
+    LocalCallbackConn *oFree;   // closed connections available for reuse
+    ClickReceiptHandler fnReceipt; // delivery receipt handler, or NULL
+    void *pReceiptContext;      // opaque argument passed to 'fnReceipt'
+    ClickMoQueue *oMoQueue;     // queue inbound messages are parsed into, or NULL
+    ClickCallbackStats oStats;  // counters, written by the server's thread and read atomically
+};
+
+// Parsed request: a field's data is NULL if the callback did not carry it
+typedef struct LocalCallbackRequest {
+    eClickApi eFormat;
+    ClickCallbackField aFields[LOCAL_FIELD_COUNT];
+} LocalCallbackRequest;
+
+// count a statistic, which other threads may read
+#define LOCAL_CALLBACK_STAT_ADD(s, n) __atomic_add_fetch(&(s), (n), __ATOMIC_RELAXED)
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static int local_callback_hex_digit(int c);
+static long long local_callback_number(const ClickCallbackField *oField);
+static long long local_callback_timestamp(const ClickCallbackField *oField);
+static void local_callback_copy(char *chOut, int iSize, const ClickCallbackField *oField);
+static eClickMoCharset local_callback_mo_charset(const ClickCallbackField *oField);
+static void local_callback_mo_text(ClickMoMessage *oMessage, const ClickCallbackField *oText);
+static void local_callback_field_set(LocalCallbackRequest *oRequest, const char *chKey, int iKeyLen,
+                                     const char *chVal, int iValLen);
+static int local_callback_url_decode(char *chData, int iLen);
+static void local_callback_form_parse(LocalCallbackRequest *oRequest, char *chForm, int iLen);
+static int local_callback_json_string(char *chData, int iLen, int *iEnd);
+static void local_callback_json_parse(LocalCallbackRequest *oRequest, char *chJson, int iLen);
+static const char *local_callback_dispatch(ClickCallbackServer *oServer, LocalCallbackRequest *oRequest);
+static void local_callback_respond(LocalCallbackConn *oConn, const char *chStatus, int bClose);
+static int local_callback_request_parse(ClickCallbackServer *oServer, LocalCallbackConn *oConn, char *chData, int iLen);
+static void local_callback_conn_close(ClickCallbackServer *oServer, LocalCallbackConn *oConn);
+static int local_callback_conn_flush(ClickCallbackServer *oServer, LocalCallbackConn *oConn);
+static int local_callback_conn_process(ClickCallbackServer *oServer, LocalCallbackConn *oConn);
+static int local_callback_conn_read(ClickCallbackServer *oServer, LocalCallbackConn *oConn);
+static void local_callback_accept(ClickCallbackServer *oServer);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_callback_hex_digit
+ * Info:      Converts a hex digit to its value.
+ * Inputs:    c - character
+ * Return:    value of the digit, or -1 if not a hex digit
+ */
+static int local_callback_hex_digit(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+/*
+ * Function:  local_callback_number
+ * Info:      Converts a field of decimal digits (ie. "004") to a number.
+ * Inputs:    oField - field
+ * Return:    value of the field, or -1 if missing, empty or not all digits
+ */
+static long long local_callback_number(const ClickCallbackField *oField)
+{
+    long long iValue = 0;
+    int i = 0;
+
+    if (oField->chData == NULL || oField->iLen < 1 || oField->iLen > 18)
+        return -1;
+
+    for (i = 0; i < oField->iLen; i++) {
+        if (oField->chData[i] < '0' || oField->chData[i] > '9')
+            return -1;
+        iValue = iValue * 10 + (oField->chData[i] - '0');
+    }
+
+    return iValue;
+}
+
+/*
+ * Function:  local_callback_timestamp
+ * Info:      Converts a timestamp field to UNIX time. Clickatell sends UNIX time in
+ *            seconds (delivery receipts) or milliseconds, or a UTC date and time as
+ *            "YYYY-MM-DD HH:MM:SS" (HTTP API inbound messages).
+ * Inputs:    oField - field
+ * Return:    UNIX time in seconds, or 0 if missing or not a timestamp
+ */
+static long long local_callback_timestamp(const ClickCallbackField *oField)
+{
+    static const char chLayout[] = "0000-00-00 00:00:00";
+    const char *pDate = oField->chData;
+    long long iValue = local_callback_number(oField), iDays = 0;
+    int i = 0, iYear = 0, iMonth = 0, iDay = 0, iDayOfYear = 0, iYearOfEra = 0;
+
+    if (iValue >= 0)
+        return (iValue >= 100000000000LL ? iValue / 1000 : iValue);
+
+    if (pDate == NULL || oField->iLen < 19)
+        return 0;
+    for (i = 0; i < 19; i++) {
+        if (chLayout[i] == '0' ? (pDate[i] < '0' || pDate[i] > '9') : (pDate[i] != chLayout[i] && !(i == 10 && pDate[i] == 'T')))
+            return 0;
+    }
+
+    iYear  = (pDate[0] - '0') * 1000 + (pDate[1] - '0') * 100 + (pDate[2] - '0') * 10 + (pDate[3] - '0');
+    iMonth = (pDate[5] - '0') * 10 + (pDate[6] - '0');
+    iDay   = (pDate[8] - '0') * 10 + (pDate[9] - '0');
+    if (iYear < 1970 || iMonth < 1 || iMonth > 12 || iDay < 1 || iDay > 31)
+        return 0;
+
+    // days since 1970-01-01 of the date, counting years from March so leap days come last
+    iYear -= (iMonth <= 2);
+    iYearOfEra = iYear % 400;
+    iDayOfYear = (153 * (iMonth + (iMonth > 2 ? -3 : 9)) + 2) / 5 + iDay - 1;
+    iDays = (long long)(iYear / 400) * 146097 + iYearOfEra * 365 + iYearOfEra / 4 - iYearOfEra / 100 + iDayOfYear - 719468;
+
+    return iDays * 86400 + ((pDate[11] - '0') * 10 + (pDate[12] - '0')) * 3600 +
+           ((pDate[14] - '0') * 10 + (pDate[15] - '0')) * 60 + (pDate[17] - '0') * 10 + (pDate[18] - '0');
+}
+
+/*
+ * Function:  local_callback_copy
+ * Info:      Copies a field into a fixed-size string, cutting it to fit.
+ * Inputs:    iSize  - size of chOut, including the NUL
+ *            oField - field
+ * Outputs:   chOut  - NUL terminated copy, empty if the field is missing
+ * Return:    void
+ */
+static void local_callback_copy(char *chOut, int iSize, const ClickCallbackField *oField)
+{
+    int iLen = (oField->chData == NULL ? 0 : (oField->iLen < iSize ? oField->iLen : iSize - 1));
+
+    if (iLen > 0)
+        memcpy(chOut, oField->chData, iLen);
+    chOut[iLen] = '\0';
+}
+
+/*
+ * Function:  local_callback_mo_charset
+ * Info:      Identifies the character set an inbound message's text was delivered in.
+ * Inputs:    oField - charset field (ie. "UTF-16BE" or "ISO-8859-1")
+ * Return:    character set, CLICK_MO_CHARSET_UTF8 if missing or not recognised
+ */
+static eClickMoCharset local_callback_mo_charset(const ClickCallbackField *oField)
+{
+    static const struct {
+        const char *chName;
+        eClickMoCharset eCharset;
+    } aCharsets[] = {
+        { "UTF-16", CLICK_MO_CHARSET_UCS2 },   { "UTF16", CLICK_MO_CHARSET_UCS2 },
+        { "UCS-2", CLICK_MO_CHARSET_UCS2 },    { "UCS2", CLICK_MO_CHARSET_UCS2 },
+        { "ISO-8859-1", CLICK_MO_CHARSET_LATIN1 }, { "ISO8859-1", CLICK_MO_CHARSET_LATIN1 },
+        { "LATIN1", CLICK_MO_CHARSET_LATIN1 },
+    };
+    int i = 0, iNameLen = 0;
+
+    for (i = 0; oField->chData != NULL && i < (int)(sizeof(aCharsets) / sizeof(aCharsets[0])); i++) {
+        iNameLen = (int)strlen(aCharsets[i].chName);
+        if (oField->iLen >= iNameLen && strncasecmp(oField->chData, aCharsets[i].chName, iNameLen) == 0)
+            return aCharsets[i].eCharset;
+    }
+
+    return CLICK_MO_CHARSET_UTF8;
+}
+
+/*
+ * Function:  local_callback_mo_text
+ * Info:      Decodes an inbound message's text to UTF-8 into the message, cutting it at a
+ *            character boundary if it does not fit. UCS-2 text is decoded from hex (text
+ *            in that character set which is not hex is taken as UTF-8), and ISO-8859-1
+ *            text of the HTTP format converted (JSON strings are already Unicode).
+ * Inputs:    oMessage - message, with its format and character set set
+ *            oText    - text field
+ * Outputs:   oMessage - chText, iTextLen and bTruncated
+ * Return:    void
+ */
+static void local_callback_mo_text(ClickMoMessage *oMessage, const ClickCallbackField *oText)
+{
+    const char *chText = (oText->chData != NULL ? oText->chData : "");
+    long iLen = (oText->chData != NULL ? oText->iLen : 0), iDecoded = -1;
+
+    if (oMessage->eCharset == CLICK_MO_CHARSET_UCS2 && iLen % 4 == 0) {
+        // 3 bytes of UTF-8 at most per 4 digits; never keep half of a surrogate pair
+        if (iLen > (CLICK_MO_TEXT_MAX - 5) / 3 * 4) {
+            iLen = (CLICK_MO_TEXT_MAX - 5) / 3 * 4;
+            if ((chText[iLen - 4] | 0x20) == 'd' && strchr("89abAB", chText[iLen - 3]) != NULL)
+                iLen -= 4;
+        }
+        iDecoded = click_charset_ucs2_hex_decode(chText, iLen, oMessage->chText, CLICK_MO_TEXT_MAX);
+    }
+    else if (oMessage->eCharset == CLICK_MO_CHARSET_LATIN1 && oMessage->eFormat == CLICK_API_HTTP) {
+        if (iLen > (CLICK_MO_TEXT_MAX - 1) / 2)
+            iLen = (CLICK_MO_TEXT_MAX - 1) / 2;
+        iDecoded = click_charset_latin1_decode(chText, iLen, oMessage->chText, CLICK_MO_TEXT_MAX);
+    }
+
+    // UTF-8 as delivered
+    if (iDecoded < 0) {
+        iLen = (oText->chData != NULL ? oText->iLen : 0);
+        if (iLen > CLICK_MO_TEXT_MAX - 1) {
+            iLen = CLICK_MO_TEXT_MAX - 1;
+            while (iLen > 0 && ((unsigned char)chText[iLen] & 0xc0) == 0x80)
+                iLen--;
+        }
+        memcpy(oMessage->chText, chText, iLen);
+        oMessage->chText[iLen] = '\0';
+        iDecoded = iLen;
+    }
+
+    oMessage->iTextLen   = (int)iDecoded;
+    oMessage->bTruncated = (iLen < (oText->chData != NULL ? oText->iLen : 0));
+}
+
+/*
+ * Function:  local_callback_field_set
+ * Info:      Records a field of a callback, if its name is one the server recognises in
+ *            the request's format.
+ * Inputs:    oRequest - request being parsed
+ *            chKey    - field name
+ *            iKeyLen  - length of name
+ *            chVal    - field value, decoded
+ *            iValLen  - length of value
+ * Return:    void
+ */
+static void local_callback_field_set(LocalCallbackRequest *oRequest, const char *chKey, int iKeyLen,
+                                     const char *chVal, int iValLen)
+{
+    const char *chName = NULL;
+    int i = 0;
+
+    for (i = 0; i < LOCAL_FIELD_COUNT; i++) {
+        chName = (oRequest->eFormat == CLICK_API_HTTP ? aLocalCallbackKeys[i].chHttp : aLocalCallbackKeys[i].chRest);
+        if ((int)strlen(chName) == iKeyLen && memcmp(chName, chKey, iKeyLen) == 0) {
+            oRequest->aFields[i].chData = chVal;
+            oRequest->aFields[i].iLen   = iValLen;
+            return;
+        }
+    }
+}
+
+/*
+ * Function:  local_callback_url_decode
+ * Info:      Decodes URL-encoded data ('+' and %XX escapes) in place.
+ * Inputs:    chData - data, decoded in place
+ *            iLen   - length of data
+ * Return:    length of the decoded data
+ */
+static int local_callback_url_decode(char *chData, int iLen)
+{
+    int iIn = 0, iOut = 0, iHigh = 0, iLow = 0;
+
+    for (iIn = 0; iIn < iLen; iIn++) {
+        if (chData[iIn] == '+')
+            chData[iOut++] = ' ';
+        else if (chData[iIn] == '%' && iIn + 2 < iLen &&
+                 (iHigh = local_callback_hex_digit(chData[iIn + 1])) >= 0 && (iLow = local_callback_hex_digit(chData[iIn + 2])) >= 0) {
+            chData[iOut++] = (char)(iHigh << 4 | iLow);
+            iIn += 2;
+        }
+        else
+            chData[iOut++] = chData[iIn];
+    }
+
+    return iOut;
+}
+
+/*
+ * Function:  local_callback_form_parse
+ * Info:      Parses the fields of an HTTP API callback: a query string or form-urlencoded
+ *            body of key=value pairs separated by '&'. Values are decoded in place.
+ * Inputs:    oRequest - request being parsed
+ *            chForm   - key=value pairs, decoded in place
+ *            iLen     - length of pairs
+ * Return:    void
+ */
+static void local_callback_form_parse(LocalCallbackRequest *oRequest, char *chForm, int iLen)
+{
+    char *pPair = chForm, *pEnd = chForm + iLen, *pNext = NULL, *pEquals = NULL;
+
+    for ( ; pPair < pEnd; pPair = pNext + 1) {
+        if ((pNext = memchr(pPair, '&', pEnd - pPair)) == NULL)
+            pNext = pEnd;
+        if ((pEquals = memchr(pPair, '=', pNext - pPair)) == NULL)
+            continue;
+
+        local_callback_field_set(oRequest, pPair, (int)(pEquals - pPair), pEquals + 1,
+                                 local_callback_url_decode(pEquals + 1, (int)(pNext - pEquals - 1)));
+    }
+}
+
+/*
+ * Function:  local_callback_json_string
+ * Info:      Decodes a JSON string in place: escapes are replaced by the characters they
+ *            stand for (\uXXXX escapes, including surrogate pairs, as UTF-8).
+ * Inputs:    chData - string, starting after its opening quote, decoded in place
+ *            iLen   - bytes available
+ * Outputs:   iEnd   - offset after the closing quote
+ * Return:    length of the decoded string, or -1 if the string is not terminated
+ */
+static int local_callback_json_string(char *chData, int iLen, int *iEnd)
+{
+    int iIn = 0, iOut = 0, i = 0, iDigit = 0;
+    long iCodePoint = 0, iLowSurrogate = 0;
+
+    while (iIn < iLen && chData[iIn] != '"') {
+        if (chData[iIn] != '\\') {
+            chData[iOut++] = chData[iIn++];
+            continue;
+        }
+        if (iIn + 1 >= iLen)
+            return -1;
+
+        switch (chData[iIn + 1]) {
+            case 'b': chData[iOut++] = '\b'; break;
+            case 'f': chData[iOut++] = '\f'; break;
+            case 'n': chData[iOut++] = '\n'; break;
+            case 'r': chData[iOut++] = '\r'; break;
+            case 't': chData[iOut++] = '\t'; break;
+            case 'u':
+                for (iCodePoint = 0, i = 0; i < 4; i++) {
+                    if (iIn + 2 + i >= iLen || (iDigit = local_callback_hex_digit(chData[iIn + 2 + i])) < 0)
+                        return -1;
+                    iCodePoint = iCodePoint << 4 | iDigit;
+                }
+                iIn += 4;
+
+                // a high surrogate followed by an escaped low surrogate makes one character
+                if (iCodePoint >= 0xd800 && iCodePoint < 0xdc00 && iIn + 7 < iLen &&
+                    chData[iIn + 2] == '\\' && chData[iIn + 3] == 'u') {
+                    for (iLowSurrogate = 0, i = 0; i < 4; i++) {
+                        if ((iDigit = local_callback_hex_digit(chData[iIn + 4 + i])) < 0)
+                            break;
+                        iLowSurrogate = iLowSurrogate << 4 | iDigit;
+                    }
+                    if (i == 4 && iLowSurrogate >= 0xdc00 && iLowSurrogate < 0xe000) {
+                        iCodePoint = 0x10000 + ((iCodePoint - 0xd800) << 10) + (iLowSurrogate - 0xdc00);
+                        iIn += 6;
+                    }
+                }
+
+                // the UTF-8 form is never longer than the escape it replaces
+                if (iCodePoint < 0x80)
+                    chData[iOut++] = (char)iCodePoint;
+                else if (iCodePoint < 0x800) {
+                    chData[iOut++] = (char)(0xc0 | iCodePoint >> 6);
+                    chData[iOut++] = (char)(0x80 | (iCodePoint & 0x3f));
+                }
+                else if (iCodePoint < 0x10000) {
+                    chData[iOut++] = (char)(0xe0 | iCodePoint >> 12);
+                    chData[iOut++] = (char)(0x80 | ((iCodePoint >> 6) & 0x3f));
+                    chData[iOut++] = (char)(0x80 | (iCodePoint & 0x3f));
+                }
+                else {
+                    chData[iOut++] = (char)(0xf0 | iCodePoint >> 18);
+                    chData[iOut++] = (char)(0x80 | ((iCodePoint >> 12) & 0x3f));
+                    chData[iOut++] = (char)(0x80 | ((iCodePoint >> 6) & 0x3f));
+                    chData[iOut++] = (char)(0x80 | (iCodePoint & 0x3f));
+                }
+                break;
+            default:  chData[iOut++] = chData[iIn + 1]; break; // \" \\ \/
+        }
+        iIn += 2;
+    }
+
+    if (iIn >= iLen)
+        return -1;
+    *iEnd = iIn + 1;
+
+    return iOut;
+}
+
+/*
+ * Function:  local_callback_json_parse
+ * Info:      Parses the fields of a REST API callback: every "key":value pair of the JSON
+ *            body is considered, whatever object it is nested in (the fields are in the
+ *            "data" object). String values are decoded in place; numbers, true, false and
+ *            null are taken as they are written.
+ * Inputs:    oRequest - request being parsed
+ *            chJson   - JSON body, decoded in place
+ *            iLen     - length of body
+ * Return:    void
+ */
+static void local_callback_json_parse(LocalCallbackRequest *oRequest, char *chJson, int iLen)
+{
+    char *chKey = NULL, *chVal = NULL;
+    int iPos = 0, iEnd = 0, iKeyLen = 0, iValLen = 0;
+
+    while (iPos < iLen) {
+        if (chJson[iPos] != '"') {
+            iPos++;
+            continue;
+        }
+
+        // a string followed by ':' is a key
+        chKey = chJson + iPos + 1;
+        if ((iKeyLen = local_callback_json_string(chKey, iLen - iPos - 1, &iEnd)) < 0)
+            return;
+        iPos += 1 + iEnd;
+        while (iPos < iLen && (chJson[iPos] == ' ' || chJson[iPos] == '\t' || chJson[iPos] == '\r' || chJson[iPos] == '\n'))
+            iPos++;
+        if (iPos >= iLen || chJson[iPos] != ':')
+            continue;
+        iPos++;
+        while (iPos < iLen && (chJson[iPos] == ' ' || chJson[iPos] == '\t' || chJson[iPos] == '\r' || chJson[iPos] == '\n'))
+            iPos++;
+
+        if (iPos < iLen && chJson[iPos] == '"') {
+            chVal = chJson + iPos + 1;
+            if ((iValLen = local_callback_json_string(chVal, iLen - iPos - 1, &iEnd)) < 0)
+                return;
+            iPos += 1 + iEnd;
+        }
+        else if (iPos < iLen && chJson[iPos] != '{' && chJson[iPos] != '[') {
+            for (chVal = chJson + iPos; iPos < iLen && strchr(",}] \t\r\n", chJson[iPos]) == NULL; iPos++)
+                ;
+            iValLen = (int)(chJson + iPos - chVal);
+        }
+        else
+            continue; // an object or array: its pairs are scanned in turn
+
+        local_callback_field_set(oRequest, chKey, iKeyLen, chVal, iValLen);
+    }
+}
+
+/*
+ * Function:  local_callback_dispatch
+ * Info:      Passes a parsed callback on according to its kind: an inbound message (one
+ *            with a moMsgId) is parsed into a slot of the inbound message queue, and a
+ *            delivery receipt (one with an apiMsgId) passed to the receipt handler.
+ *            Inbound messages which do not fit in the queue are refused, so that
+ *            Clickatell sends them again later.
+ * Inputs:    oServer  - callback receiver
+ *            oRequest - parsed request
+ * Return:    status line of the response
+ */
+static const char *local_callback_dispatch(ClickCallbackServer *oServer, LocalCallbackRequest *oRequest)
+{
+    ClickDeliveryReceipt oReceipt;
+    ClickMoMessage *oMessage = NULL;
+
+    if (oRequest->aFields[LOCAL_FIELD_MO_MSG_ID].chData != NULL) {
+        if (oServer->oMoQueue != NULL) {
+            if ((oMessage = click_mo_queue_reserve(oServer->oMoQueue)) == NULL) {
+                LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iDropped, 1);
+                return "503 Service Unavailable";
+            }
+
+            oMessage->eFormat    = oRequest->eFormat;
+            oMessage->eCharset   = local_callback_mo_charset(&oRequest->aFields[LOCAL_FIELD_CHARSET]);
+            oMessage->iTimestamp = local_callback_timestamp(&oRequest->aFields[LOCAL_FIELD_TIMESTAMP]);
+            local_callback_copy(oMessage->chMoMsgId, CLICK_MO_ID_MAX, &oRequest->aFields[LOCAL_FIELD_MO_MSG_ID]);
+            local_callback_copy(oMessage->chFrom, CLICK_MO_ADDRESS_MAX, &oRequest->aFields[LOCAL_FIELD_FROM]);
+            local_callback_copy(oMessage->chTo, CLICK_MO_ADDRESS_MAX, &oRequest->aFields[LOCAL_FIELD_TO]);
+            local_callback_mo_text(oMessage, &oRequest->aFields[LOCAL_FIELD_TEXT]);
+            click_mo_queue_commit(oServer->oMoQueue, oMessage);
+        }
+        LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iMessages, 1);
+        return "200 OK";
+    }
+
+    if (oRequest->aFields[LOCAL_FIELD_API_MSG_ID].chData == NULL)
+        return NULL;
+
+    oReceipt.eFormat    = oRequest->eFormat;
+    oReceipt.oApiId     = oRequest->aFields[LOCAL_FIELD_API_ID];
+    oReceipt.oApiMsgId  = oRequest->aFields[LOCAL_FIELD_API_MSG_ID];
+    oReceipt.oCliMsgId  = oRequest->aFields[LOCAL_FIELD_CLI_MSG_ID];
+    oReceipt.oTo        = oRequest->aFields[LOCAL_FIELD_TO];
+    oReceipt.oFrom      = oRequest->aFields[LOCAL_FIELD_FROM];
+    oReceipt.oStatus    = oRequest->aFields[LOCAL_FIELD_STATUS];
+    oReceipt.oCharge    = oRequest->aFields[LOCAL_FIELD_CHARGE];
+    oReceipt.iStatus    = (int)local_callback_number(&oRequest->aFields[LOCAL_FIELD_STATUS]);
+    oReceipt.iTimestamp = local_callback_timestamp(&oRequest->aFields[LOCAL_FIELD_TIMESTAMP]);
+
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iReceipts, 1);
+    if (oServer->fnReceipt != NULL)
+        oServer->fnReceipt(oServer->pReceiptContext, &oReceipt);
+
+    return "200 OK";
+}
+
+/*
+ * Function:  local_callback_respond
+ * Info:      Queues a response (without a body) on a connection.
+ * Inputs:    oConn    - connection
+ *            chStatus - status line text (ie. "200 OK")
+ *            bClose   - 1 to close the connection once the response is sent
+ * Return:    void
+ */
+static void local_callback_respond(LocalCallbackConn *oConn, const char *chStatus, int bClose)
+{
+    oConn->iOutLen += snprintf(oConn->aOut + oConn->iOutLen, LOCAL_CALLBACK_OUT_MAX - oConn->iOutLen,
+                               "HTTP/1.1 %s\r\nContent-Length: 0\r\n%s\r\n", chStatus, (bClose ? "Connection: close\r\n" : ""));
+    oConn->bClose |= bClose;
+}
+
+/*
+ * Function:  local_callback_request_parse
+ * Info:      Parses and answers the first request of a connection's data, if it has
+ *            been received in full.
+ * Inputs:    oServer - callback receiver
+ *            oConn   - connection
+ *            chData  - data received and not yet parsed
+ *            iLen    - length of data
+ * Return:    bytes of the request, 0 if it has not been received in full, or -1 if it
+ *            was rejected and the connection is to be closed
+ */
+static int local_callback_request_parse(ClickCallbackServer *oServer, LocalCallbackConn *oConn, char *chData, int iLen)
+{
+    LocalCallbackRequest oRequest;
+    const char *chStatus = NULL;
+    char *pHeadersEnd = NULL, *pLine = NULL, *pLineEnd = NULL, *pTarget = NULL, *pTargetEnd = NULL, *pQuery = NULL;
+    char *pBody = NULL, *pValue = NULL;
+    int iSearch = (oConn->iHeaderScan > 3 ? oConn->iHeaderScan - 3 : 0);
+    int iHeadersLen = 0, iBodyLen = 0, bPost = 0, bKeepAlive = 0, iName = 0;
+
+    if ((pHeadersEnd = memmem(chData + iSearch, iLen - iSearch, "\r\n\r\n", 4)) == NULL) {
+        oConn->iHeaderScan = iLen;
+        if (iLen >= CLICK_CALLBACK_REQUEST_MAX)
+            goto too_large;
+        return 0;
+    }
+    iHeadersLen = (int)(pHeadersEnd + 4 - chData);
+    oConn->iHeaderScan = iHeadersLen - 4; // found again straight away if the body is incomplete
+
+    // request line: method, target and version
+    pLineEnd = memchr(chData, '\r', iHeadersLen);
+    if (pLineEnd - chData > 5 && memcmp(chData, "POST ", 5) == 0)
+        bPost = 1;
+    else if (!(pLineEnd - chData > 4 && memcmp(chData, "GET ", 4) == 0))
+        goto bad_method;
+    pTarget = chData + (bPost ? 5 : 4);
+    if ((pTargetEnd = memchr(pTarget, ' ', pLineEnd - pTarget)) == NULL || pLineEnd - pTargetEnd != 9 ||
+        memcmp(pTargetEnd + 1, "HTTP/1.", 7) != 0)
+        goto bad_request;
+    bKeepAlive = (pTargetEnd[8] == '1'); // HTTP/1.1 connections are kept alive unless closed
+
+    // headers: only the body length and keep-alive matter
+    for (pLine = pLineEnd + 2; pLine < pHeadersEnd + 2; pLine = pLineEnd + 2) {
+        pLineEnd = memchr(pLine, '\r', pHeadersEnd + 2 - pLine);
+        if ((pValue = memchr(pLine, ':', pLineEnd - pLine)) == NULL)
+            goto bad_request;
+        iName = (int)(pValue - pLine);
+        for (pValue++; pValue < pLineEnd && (*pValue == ' ' || *pValue == '\t'); pValue++)
+            ;
+
+        if (iName == 14 && strncasecmp(pLine, "Content-Length", 14) == 0) {
+            for (iBodyLen = 0; pValue < pLineEnd && *pValue >= '0' && *pValue <= '9'; pValue++) {
+                iBodyLen = iBodyLen * 10 + (*pValue - '0');
+                if (iBodyLen > CLICK_CALLBACK_REQUEST_MAX)
+                    goto too_large;
+            }
+        }
+        else if (iName == 10 && strncasecmp(pLine, "Connection", 10) == 0) {
+            if (pLineEnd - pValue >= 5 && strncasecmp(pValue, "close", 5) == 0)
+                bKeepAlive = 0;
+            else if (pLineEnd - pValue >= 10 && strncasecmp(pValue, "keep-alive", 10) == 0)
+                bKeepAlive = 1;
+        }
+        else if (iName == 17 && strncasecmp(pLine, "Transfer-Encoding", 17) == 0) {
+            oConn->iHeaderScan = 0;
+            local_callback_respond(oConn, "411 Length Required", 1);
+            LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRejected, 1);
+            return -1;
+        }
+    }
+
+    if (iHeadersLen + iBodyLen > CLICK_CALLBACK_REQUEST_MAX)
+        goto too_large;
+    if (iHeadersLen + iBodyLen > iLen)
+        return 0;
+    oConn->iHeaderScan = 0;
+
+    // fields: the query string of a GET, or the body of a POST (JSON for REST, else a form)
+    memset(&oRequest, 0, sizeof(oRequest));
+    oRequest.eFormat = CLICK_API_HTTP;
+    pBody = pHeadersEnd + 4;
+    while (iBodyLen > 0 && (*pBody == ' ' || *pBody == '\t' || *pBody == '\r' || *pBody == '\n')) {
+        pBody++;
+        iBodyLen--;
+    }
+    if (bPost && iBodyLen > 0 && *pBody == '{') {
+        oRequest.eFormat = CLICK_API_REST;
+        local_callback_json_parse(&oRequest, pBody, iBodyLen);
+    }
+    else if (bPost)
+        local_callback_form_parse(&oRequest, pBody, iBodyLen);
+    else if ((pQuery = memchr(pTarget, '?', pTargetEnd - pTarget)) != NULL)
+        local_callback_form_parse(&oRequest, pQuery + 1, (int)(pTargetEnd - pQuery - 1));
+
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRequests, 1);
+    if ((chStatus = local_callback_dispatch(oServer, &oRequest)) != NULL)
+        local_callback_respond(oConn, chStatus, !bKeepAlive);
+    else {
+        LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRejected, 1);
+        local_callback_respond(oConn, "400 Bad Request", !bKeepAlive);
+    }
+
+    return (int)(pBody + iBodyLen - chData);
+
+bad_method:
+    oConn->iHeaderScan = 0;
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRejected, 1);
+    local_callback_respond(oConn, "405 Method Not Allowed", 1);
+    return -1;
+
+bad_request:
+    oConn->iHeaderScan = 0;
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRejected, 1);
+    local_callback_respond(oConn, "400 Bad Request", 1);
+    return -1;
+
+too_large:
+    oConn->iHeaderScan = 0;
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iRejected, 1);
+    local_callback_respond(oConn, "413 Payload Too Large", 1);
+    return -1;
+}
+
+/*
+ * Function:  local_callback_conn_close
+ * Info:      Closes a connection, keeping its memory for reuse.
+ * Inputs:    oServer - callback receiver
+ *            oConn   - connection
+ * Return:    void
+ */
+static void local_callback_conn_close(ClickCallbackServer *oServer, LocalCallbackConn *oConn)
+{
+    close(oConn->iFd); // also removes it from the epoll set
+    oConn->iFd       = -1;
+    oConn->oNextFree = oServer->oFree;
+    oServer->oFree   = oConn;
+    LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iOpen, -1);
+}
+
+/*
+ * Function:  local_callback_conn_flush
+ * Info:      Sends a connection's queued responses. If the socket cannot take them all,
+ *            the connection waits for it to become writable and stops reading requests.
+ * Inputs:    oServer - callback receiver
+ *            oConn   - connection
+ * Return:    0 if the connection is open, else -1 if it was closed
+ */
+static int local_callback_conn_flush(ClickCallbackServer *oServer, LocalCallbackConn *oConn)
+{
+    struct epoll_event oEvent;
+    ssize_t iSent = 0;
+    int bWriting = 0;
+
+    while (oConn->iOutSent < oConn->iOutLen) {
+        iSent = send(oConn->iFd, oConn->aOut + oConn->iOutSent, oConn->iOutLen - oConn->iOutSent, MSG_NOSIGNAL);
+        if (iSent > 0)
+            oConn->iOutSent += (int)iSent;
+        else if (iSent < 0 && errno == EINTR)
+            continue;
+        else if (iSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            bWriting = 1;
+            break;
+        }
+        else {
+            local_callback_conn_close(oServer, oConn);
+            return -1;
+        }
+    }
+
+    if (!bWriting) {
+        oConn->iOutLen = oConn->iOutSent = 0;
+        if (oConn->bClose) {
+            local_callback_conn_close(oServer, oConn);
+            return -1;
+        }
+    }
+
+    if (bWriting != oConn->bWriting) {
+        oEvent.events   = (bWriting ? EPOLLOUT : EPOLLIN);
+        oEvent.data.ptr = oConn;
+        epoll_ctl(oServer->iEpollFd, EPOLL_CTL_MOD, oConn->iFd, &oEvent);
+        oConn->bWriting = bWriting;
+    }
+
+    return 0;
+}
+
+/*
+ * Function:  local_callback_conn_process
+ * Info:      Parses and answers the requests received in full on a connection (several
+ *            if they were pipelined), then sends the responses. Requests stop being
+ *            parsed while there is no room to queue their responses.
+ * Inputs:    oServer - callback receiver
+ *            oConn   - connection
+ * Return:    0 if the connection is open, else -1 if it was closed
+ */
+static int local_callback_conn_process(ClickCallbackServer *oServer, LocalCallbackConn *oConn)
+{
+    int iPos = 0, iConsumed = 0, bFull = 0;
+
+    do {
+        for (iPos = 0, bFull = 0; !oConn->bClose && iPos < oConn->iLen; iPos += iConsumed) {
+            if (oConn->iOutLen + LOCAL_CALLBACK_RESPONSE_MAX > LOCAL_CALLBACK_OUT_MAX) {
+                bFull = 1;
+                break;
+            }
+            if ((iConsumed = local_callback_request_parse(oServer, oConn, oConn->aIn + iPos, oConn->iLen - iPos)) <= 0)
+                break;
+        }
+
+        // keep the start of the next request at the start of the buffer
+        if (iPos > 0) {
+            memmove(oConn->aIn, oConn->aIn + iPos, oConn->iLen - iPos);
+            oConn->iLen -= iPos;
+        }
+
+        if (local_callback_conn_flush(oServer, oConn) != 0)
+            return -1;
+    } while (bFull && !oConn->bWriting); // parse the requests held back once their responses fit
+
+    return 0;
+}
+
+/*
+ * Function:  local_callback_conn_read
+ * Info:      Reads the data waiting on a connection and processes it.
+ * Inputs:    oServer - callback receiver
+ *            oConn   - connection
+ * Return:    0 if the connection is open, else -1 if it was closed
+ */
+static int local_callback_conn_read(ClickCallbackServer *oServer, LocalCallbackConn *oConn)
+{
+    ssize_t iRead = 0;
+
+    if (oConn->iLen >= CLICK_CALLBACK_REQUEST_MAX)
+        return local_callback_conn_process(oServer, oConn);
+
+    iRead = recv(oConn->iFd, oConn->aIn + oConn->iLen, CLICK_CALLBACK_REQUEST_MAX - oConn->iLen, 0);
+    if (iRead == 0 || (iRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        local_callback_conn_close(oServer, oConn);
+        return -1;
+    }
+    if (iRead < 0)
+        return 0;
+    oConn->iLen += (int)iRead;
+
+    return local_callback_conn_process(oServer, oConn);
+}
+
+/*
+ * Function:  local_callback_accept
+ * Info:      Accepts waiting connections, reusing the memory of closed connections.
+ *            Connections beyond the limit are closed straight away.
+ * Inputs:    oServer - callback receiver
+ * Return:    void
+ */
+static void local_callback_accept(ClickCallbackServer *oServer)
+{
+    struct epoll_event oEvent;
+    LocalCallbackConn *oConn = NULL;
+    int iFd = -1, iOn = 1;
+
+    while ((iFd = accept4(oServer->iListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if ((oConn = oServer->oFree) != NULL)
+            oServer->oFree = oConn->oNextFree;
+        else if (oServer->iNumConns < oServer->iMaxConnections &&
+                 (oConn = (LocalCallbackConn *)malloc(sizeof(LocalCallbackConn))) != NULL)
+            oServer->aConns[oServer->iNumConns++] = oConn;
+        else {
+            click_debug_print("%s ERROR: Connection limit of %d reached!\n", __func__, oServer->iMaxConnections);
+            close(iFd);
+            continue;
+        }
+
+        // responses are small and must not wait for the client's acknowledgements
+        setsockopt(iFd, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+
+        oConn->iFd         = iFd;
+        oConn->iLen        = 0;
+        oConn->iHeaderScan = 0;
+        oConn->iOutLen     = 0;
+        oConn->iOutSent    = 0;
+        oConn->bClose      = 0;
+        oConn->bWriting    = 0;
+
+        oEvent.events   = EPOLLIN;
+        oEvent.data.ptr = oConn;
+        if (epoll_ctl(oServer->iEpollFd, EPOLL_CTL_ADD, iFd, &oEvent) != 0) {
+            LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iOpen, 1);
+            local_callback_conn_close(oServer, oConn);
+            continue;
+        }
+        LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iConnections, 1);
+        LOCAL_CALLBACK_STAT_ADD(oServer->oStats.iOpen, 1);
+    }
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_callback_server_create
+ * Info:      Creates a callback receiver listening on a TCP port. Nothing is received
+ *            until the server is polled or run.
+ *            Note that the calling function must destroy the returned server.
+ * Inputs:    chAddress       - IPv4 address to listen on (ie. "127.0.0.1"), or NULL for all
+ *            iPort           - port to listen on, or 0 for any free port (see
+ *                              click_callback_server_port())
+ *            iMaxConnections - limit of open connections, or 0 for
+ *                              CLICK_CALLBACK_CONNECTIONS_MAX. Each open connection takes
+ *                              about CLICK_CALLBACK_REQUEST_MAX bytes.
+ * Return:    callback receiver, or NULL if invalid parameter, the port could not be
+ *            listened on or failed to allocate memory
+ */
+ClickCallbackServer *click_callback_server_create(const char *chAddress, int iPort, int iMaxConnections)
+{
+    ClickCallbackServer *oServer = NULL;
+    struct sockaddr_in oAddr;
+    socklen_t iAddrLen = sizeof(oAddr);
+    struct epoll_event oEvent;
+    int iOn = 1;
+
+    if (iPort < 0 || iPort > 65535 || iMaxConnections < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    memset(&oAddr, 0, sizeof(oAddr));
+    oAddr.sin_family      = AF_INET;
+    oAddr.sin_port        = htons((unsigned short)iPort);
+    oAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (chAddress != NULL && inet_pton(AF_INET, chAddress, &oAddr.sin_addr) != 1) {
+        click_debug_print("%s ERROR: Invalid address %s!\n", __func__, chAddress);
+        return NULL;
+    }
+
+    if ((oServer = (ClickCallbackServer *)calloc(1, sizeof(ClickCallbackServer))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for callback server!\n", __func__);
+        return NULL;
+    }
+    oServer->iListenFd = oServer->iEpollFd = oServer->iWakeFd = -1;
+    oServer->iMaxConnections = (iMaxConnections > 0 ? iMaxConnections : CLICK_CALLBACK_CONNECTIONS_MAX);
+
+    if ((oServer->aConns = (LocalCallbackConn **)calloc(oServer->iMaxConnections, sizeof(LocalCallbackConn *))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for connections!\n", __func__);
+        goto error;
+    }
+
+    if ((oServer->iListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+        setsockopt(oServer->iListenFd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn)) != 0 ||
+        bind(oServer->iListenFd, (struct sockaddr *)&oAddr, sizeof(oAddr)) != 0 ||
+        listen(oServer->iListenFd, SOMAXCONN) != 0 ||
+        getsockname(oServer->iListenFd, (struct sockaddr *)&oAddr, &iAddrLen) != 0)
+    {
+        click_debug_print("%s ERROR: Failed to listen on port %d: %s!\n", __func__, iPort, strerror(errno));
+        goto error;
+    }
+    oServer->iPort = ntohs(oAddr.sin_port);
+
+    if ((oServer->iEpollFd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+        (oServer->iWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+        click_debug_print("%s ERROR: Failed to create epoll instance: %s!\n", __func__, strerror(errno));
+        goto error;
+    }
+
+    // the listening socket and the wake eventfd are told apart from connections by their data
+    oEvent.events   = EPOLLIN;
+    oEvent.data.ptr = &oServer->iListenFd;
+    if (epoll_ctl(oServer->iEpollFd, EPOLL_CTL_ADD, oServer->iListenFd, &oEvent) != 0)
+        goto error;
+    oEvent.data.ptr = &oServer->iWakeFd;
+    if (epoll_ctl(oServer->iEpollFd, EPOLL_CTL_ADD, oServer->iWakeFd, &oEvent) != 0)
+        goto error;
+
+    return oServer;
+
+error:
+    click_callback_server_destroy(oServer);
+    return NULL;
+}
+
+/*
+ * Function:  click_callback_server_destroy
+ * Info:      Closes a callback receiver and all of its connections. It must not be
+ *            running (see click_callback_server_stop()).
+ * Inputs:    oServer - callback receiver to destroy
+ * Return:    void
+ */
+void click_callback_server_destroy(ClickCallbackServer *oServer)
+{
+    int i = 0;
+
+    if (oServer == NULL)
+        return;
+
+    for (i = 0; i < oServer->iNumConns; i++) {
+        if (oServer->aConns[i]->iFd >= 0)
+            close(oServer->aConns[i]->iFd);
+        free(oServer->aConns[i]);
+    }
+    free(oServer->aConns);
+
+    if (oServer->iWakeFd >= 0)
+        close(oServer->iWakeFd);
+    if (oServer->iEpollFd >= 0)
+        close(oServer->iEpollFd);
+    if (oServer->iListenFd >= 0)
+        close(oServer->iListenFd);
+    free(oServer);
+}
+
+/*
+ * Function:  click_callback_server_port
+ * Info:      Returns the port a callback receiver listens on (ie. the free port chosen
+ *            when it was created with port 0).
+ * Inputs:    oServer - callback receiver
+ * Return:    port, or -1 if invalid parameter
+ */
+int click_callback_server_port(const ClickCallbackServer *oServer)
+{
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    return oServer->iPort;
+}
+
+/*
+ * Function:  click_callback_server_receipt_handler_set
+ * Info:      Sets the handler which delivery receipts are passed to, on the server's
+ *            thread. The receipt's fields are only valid during the call, so a handler
+ *            which keeps them must copy them. Set the handler before the server is run.
+ *            Receipts received without a handler are answered but dropped.
+ * Inputs:    oServer   - callback receiver
+ *            fnHandler - receipt handler, or NULL
+ *            pContext  - opaque argument passed to the handler
+ * Return:    void
+ */
+void click_callback_server_receipt_handler_set(ClickCallbackServer *oServer, ClickReceiptHandler fnHandler, void *pContext)
+{
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    oServer->fnReceipt       = fnHandler;
+    oServer->pReceiptContext = pContext;
+}
+
+/*
+ * Function:  click_callback_server_mo_queue_set
+ * Info:      Sets the queue inbound messages are parsed into, for application threads to
+ *            pop (see click_mo_queue_pop()). While the queue is full, inbound messages
+ *            are refused (503) so that Clickatell sends them again later. Set the queue
+ *            before the server is run. Inbound messages received without a queue are
+ *            answered but dropped.
+ * Inputs:    oServer - callback receiver
+ *            oQueue  - inbound message queue, or NULL. It must outlive the server.
+ * Return:    void
+ */
+void click_callback_server_mo_queue_set(ClickCallbackServer *oServer, ClickMoQueue *oQueue)
+{
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    oServer->oMoQueue = oQueue;
+}
+
+/*
+ * Function:  click_callback_server_poll
+ * Info:      Waits for and handles the server's pending events once: accepts
+ *            connections, and reads, parses and answers requests, calling the handlers.
+ *            Use this to drive the server from an existing event loop, or see
+ *            click_callback_server_run().
+ * Inputs:    oServer    - callback receiver
+ *            iTimeoutMs - longest time to wait for an event in milliseconds, 0 to return
+ *                         straight away or -1 to wait indefinitely
+ * Return:    number of events handled, or -1 if invalid parameter or epoll failed
+ */
+int click_callback_server_poll(ClickCallbackServer *oServer, int iTimeoutMs)
+{
+    struct epoll_event aEvents[LOCAL_CALLBACK_EVENTS];
+    LocalCallbackConn *oConn = NULL;
+    unsigned long long iWake = 0;
+    int i = 0, iEvents = 0;
+
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if ((iEvents = epoll_wait(oServer->iEpollFd, aEvents, LOCAL_CALLBACK_EVENTS, iTimeoutMs)) < 0) {
+        if (errno == EINTR)
+            return 0;
+        click_debug_print("%s ERROR: epoll_wait failed: %s!\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < iEvents; i++) {
+        if (aEvents[i].data.ptr == &oServer->iListenFd) {
+            local_callback_accept(oServer);
+            continue;
+        }
+        if (aEvents[i].data.ptr == &oServer->iWakeFd) {
+            if (read(oServer->iWakeFd, &iWake, sizeof(iWake)) < 0)
+                iWake = 0;
+            continue;
+        }
+
+        oConn = (LocalCallbackConn *)aEvents[i].data.ptr;
+        if (oConn->iFd < 0)
+            continue; // closed while handling an earlier event
+        if (aEvents[i].events & (EPOLLERR | EPOLLHUP) && !(aEvents[i].events & EPOLLIN))
+            local_callback_conn_close(oServer, oConn);
+        else if (oConn->bWriting) {
+            if (local_callback_conn_flush(oServer, oConn) == 0 && !oConn->bWriting)
+                local_callback_conn_process(oServer, oConn); // requests held back while writing
+        }
+        else
+            local_callback_conn_read(oServer, oConn);
+    }
+
+    return iEvents;
+}
+
+/*
+ * Function:  click_callback_server_run
+ * Info:      Handles the server's events on the calling thread until
+ *            click_callback_server_stop() is called.
+ * Inputs:    oServer - callback receiver
+ * Return:    0 if stopped, else -1 if invalid parameter or epoll failed
+ */
+int click_callback_server_run(ClickCallbackServer *oServer)
+{
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    while (!__atomic_load_n(&oServer->bStop, __ATOMIC_ACQUIRE)) {
+        if (click_callback_server_poll(oServer, -1) < 0)
+            return -1;
+    }
+    __atomic_store_n(&oServer->bStop, 0, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * Function:  click_callback_server_stop
+ * Info:      Makes click_callback_server_run() return. May be called from any thread,
+ *            including a handler.
+ * Inputs:    oServer - callback receiver
+ * Return:    void
+ */
+void click_callback_server_stop(ClickCallbackServer *oServer)
+{
+    unsigned long long iWake = 1;
+
+    if (oServer == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    __atomic_store_n(&oServer->bStop, 1, __ATOMIC_RELEASE);
+    if (write(oServer->iWakeFd, &iWake, sizeof(iWake)) < 0)
+        click_debug_print("%s ERROR: Failed to wake callback server!\n", __func__);
+}
+
+/*
+ * Function:  click_callback_server_stats_get
+ * Info:      Reads a callback receiver's counters. May be called from any thread.
+ * Inputs:    oServer - callback receiver
+ * Outputs:   oStats  - counters
+ * Return:    void
+ */
+void click_callback_server_stats_get(const ClickCallbackServer *oServer, ClickCallbackStats *oStats)
+{
+    if (oServer == NULL || oStats == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    oStats->iConnections = __atomic_load_n(&oServer->oStats.iConnections, __ATOMIC_RELAXED);
+    oStats->iOpen        = __atomic_load_n(&oServer->oStats.iOpen, __ATOMIC_RELAXED);
+    oStats->iRequests    = __atomic_load_n(&oServer->oStats.iRequests, __ATOMIC_RELAXED);
+    oStats->iReceipts    = __atomic_load_n(&oServer->oStats.iReceipts, __ATOMIC_RELAXED);
+    oStats->iRejected    = __atomic_load_n(&oServer->oStats.iRejected, __ATOMIC_RELAXED);
+    oStats->iMessages    = __atomic_load_n(&oServer->oStats.iMessages, __ATOMIC_RELAXED);
+    oStats->iDropped     = __atomic_load_n(&oServer->oStats.iDropped, __ATOMIC_RELAXED);
+}
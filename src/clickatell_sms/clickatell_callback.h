@@ -0,0 +1,87 @@
+#ifndef CLICKATELL_CALLBACK_H
+#define CLICKATELL_CALLBACK_H
+
+/*
+ * clickatell_callback.h
+ *
+ *  Callback receiver module used by the Clickatell SMS library.
+ *
+ *  Instead of polling clickatell_sms_status_get() for each message, Clickatell can post
+ *  each message's status changes (delivery receipts) to a callback URL. A
+ *  ClickCallbackServer is a small embedded HTTP/1.1 server which accepts these
+ *  callbacks in both formats:
+ *    HTTP API - GET query string or form-urlencoded POST body, ie.
+ *               api_id=3518209&apiMsgId=996411ad91fa211e7d17bc873aa4a41d&cliMsgId=&
+ *               timestamp=1218007814&to=279995631564&from=27833001171&status=003&charge=0.300000
+ *    REST API - JSON POST body, ie.
+ *               {"data":{"apiId":"3518209","apiMessageId":"996411ad91fa211e7d17bc873aa4a41d",
+ *               "timestamp":1218007814,"to":"279995631564","messageStatus":"003",...}}
+ *
+ *  Inbound (MO) message callbacks (those carrying a moMsgId, or moMessageId in JSON) are
+ *  accepted on the same port. Each is parsed straight into a slot of a ClickMoQueue, with
+ *  its text decoded to UTF-8, for application threads to pop (see clickatell_mo.h).
+ *
+ *  The server is driven by one thread (see click_callback_server_run()) using epoll.
+ *  Connections are kept alive and may pipeline requests; each connection reads into a
+ *  fixed buffer of CLICK_CALLBACK_REQUEST_MAX bytes, so memory is bounded by the
+ *  connection limit. Requests are parsed in place: the fields of a ClickDeliveryReceipt
+ *  point into the connection's buffer (decoded in place where needed) and are only
+ *  valid during the handler call.
+ */
+
+#include "clickatell_string.h"
+#include "clickatell_sms.h"
+#include "clickatell_mo.h"
+
+#define CLICK_CALLBACK_REQUEST_MAX      8192 // largest request (headers and body) a connection accepts
+#define CLICK_CALLBACK_CONNECTIONS_MAX  1024 // default limit of open connections
+
+// A field of a received callback: not NUL terminated, and only valid during the handler call
+typedef struct ClickCallbackField {
+    const char *chData;     // start of the field's value, or NULL if the callback did not carry it
+    int iLen;               // length of the value in bytes
+} ClickCallbackField;
+
+// Delivery receipt (message status callback) received by a ClickCallbackServer
+typedef struct ClickDeliveryReceipt {
+    eClickApi eFormat;              // callback format: CLICK_API_HTTP (query/form) or CLICK_API_REST (JSON)
+    ClickCallbackField oApiId;      // API ID the message was sent with
+    ClickCallbackField oApiMsgId;   // API Message ID returned when the message was sent
+    ClickCallbackField oCliMsgId;   // client message ID set when the message was sent
+    ClickCallbackField oTo;         // destination address
+    ClickCallbackField oFrom;       // source address
+    ClickCallbackField oStatus;     // message status code as sent (ie. "004")
+    ClickCallbackField oCharge;     // charge as sent (ie. "0.300000")
+    int  iStatus;                   // message status code (ie. 4 = received by recipient), or -1 if missing
+    long long iTimestamp;           // UNIX time of the status change, or 0 if missing
+} ClickDeliveryReceipt;
+
+// Delivery receipt handler, called on the server's thread for each receipt received
+typedef void (*ClickReceiptHandler)(void *pContext, const ClickDeliveryReceipt *oReceipt);
+
+// Counters of a ClickCallbackServer (see click_callback_server_stats_get())
+typedef struct ClickCallbackStats {
+    long iConnections;      // connections accepted
+    long iOpen;             // connections open now
+    long iRequests;         // requests answered
+    long iReceipts;         // delivery receipts passed to the handler
+    long iRejected;         // requests answered with an error (malformed, too large or not a callback)
+    long iMessages;         // inbound messages received
+    long iDropped;          // inbound messages refused because the queue was full (resent by Clickatell)
+} ClickCallbackStats;
+
+// callback receiver (opaque)
+typedef struct ClickCallbackServer ClickCallbackServer;
+
+// function declarations
+ClickCallbackServer *click_callback_server_create(const char *chAddress, int iPort, int iMaxConnections);
+void click_callback_server_destroy(ClickCallbackServer *oServer);
+int click_callback_server_port(const ClickCallbackServer *oServer);
+void click_callback_server_receipt_handler_set(ClickCallbackServer *oServer, ClickReceiptHandler fnHandler, void *pContext);
+void click_callback_server_mo_queue_set(ClickCallbackServer *oServer, ClickMoQueue *oQueue);
+int click_callback_server_poll(ClickCallbackServer *oServer, int iTimeoutMs);
+int click_callback_server_run(ClickCallbackServer *oServer);
+void click_callback_server_stop(ClickCallbackServer *oServer);
+void click_callback_server_stats_get(const ClickCallbackServer *oServer, ClickCallbackStats *oStats);
+
+#endif // CLICKATELL_CALLBACK_H
@@ -0,0 +1,1174 @@
+/*
+ * clickatell_charset.c
+ *
+ *  GSM 03.38 character set module: classifies UTF-8 text as GSM 7-bit or UCS-2, counts
+ *  septets and code units, and packs GSM 7-bit text. See clickatell_charset.h.
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "clickatell_debug.h"
+#include "clickatell_charset.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// GSM table entries: the number of septets the character takes (bits 8-9) and its GSM code
+// (bits 0-6). 0 means the character is not in the GSM 03.38 alphabet.
+#define B(iCode)    ((1 << 8) | (iCode)) // default alphabet character
+#define E(iCode)    ((2 << 8) | (iCode)) // extension table character, sent as escape + code
+
+#define LOCAL_GSM_SEPTETS(iEntry)   ((iEntry) >> 8)
+#define LOCAL_GSM_CODE(iEntry)      ((iEntry) & 0x7f)
+
+// GSM 03.38 entries for U+0000 to U+007F
+static const unsigned short aLocalAsciiGsm[128] = {
+           0,        0,        0,        0,        0,        0,        0,        0,  // 0x00
+           0,        0,  B(0x0A),        0,  E(0x0A),  B(0x0D),        0,        0,  // 0x08
+           0,        0,        0,        0,        0,        0,        0,        0,  // 0x10
+           0,        0,        0,        0,        0,        0,        0,        0,  // 0x18
+     B(0x20),  B(0x21),  B(0x22),  B(0x23),  B(0x02),  B(0x25),  B(0x26),  B(0x27),  // 0x20
+     B(0x28),  B(0x29),  B(0x2A),  B(0x2B),  B(0x2C),  B(0x2D),  B(0x2E),  B(0x2F),  // 0x28
+     B(0x30),  B(0x31),  B(0x32),  B(0x33),  B(0x34),  B(0x35),  B(0x36),  B(0x37),  // 0x30
+     B(0x38),  B(0x39),  B(0x3A),  B(0x3B),  B(0x3C),  B(0x3D),  B(0x3E),  B(0x3F),  // 0x38
+     B(0x00),  B(0x41),  B(0x42),  B(0x43),  B(0x44),  B(0x45),  B(0x46),  B(0x47),  // 0x40
+     B(0x48),  B(0x49),  B(0x4A),  B(0x4B),  B(0x4C),  B(0x4D),  B(0x4E),  B(0x4F),  // 0x48
+     B(0x50),  B(0x51),  B(0x52),  B(0x53),  B(0x54),  B(0x55),  B(0x56),  B(0x57),  // 0x50
+     B(0x58),  B(0x59),  B(0x5A),  E(0x3C),  E(0x2F),  E(0x3E),  E(0x14),  B(0x11),  // 0x58
+           0,  B(0x61),  B(0x62),  B(0x63),  B(0x64),  B(0x65),  B(0x66),  B(0x67),  // 0x60
+     B(0x68),  B(0x69),  B(0x6A),  B(0x6B),  B(0x6C),  B(0x6D),  B(0x6E),  B(0x6F),  // 0x68
+     B(0x70),  B(0x71),  B(0x72),  B(0x73),  B(0x74),  B(0x75),  B(0x76),  B(0x77),  // 0x70
+     B(0x78),  B(0x79),  B(0x7A),  E(0x28),  E(0x40),  E(0x29),  E(0x3D),        0,  // 0x78
+};
+
+// GSM 03.38 entries for U+0080 to U+00FF (Latin-1 supplement)
+static const unsigned short aLocalLatin1Gsm[128] = {
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+0080
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+0088
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+0090
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+0098
+           0,  B(0x40),        0,  B(0x01),  B(0x24),  B(0x03),        0,  B(0x5F),  // U+00A0
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+00A8
+           0,        0,        0,        0,        0,        0,        0,        0,  // U+00B0
+           0,        0,        0,        0,        0,        0,        0,  B(0x60),  // U+00B8
+           0,        0,        0,        0,  B(0x5B),  B(0x0E),  B(0x1C),  B(0x09),  // U+00C0
+           0,  B(0x1F),        0,        0,        0,        0,        0,        0,  // U+00C8
+           0,  B(0x5D),        0,        0,        0,        0,  B(0x5C),        0,  // U+00D0
+     B(0x0B),        0,        0,        0,  B(0x5E),        0,        0,  B(0x1E),  // U+00D8
+     B(0x7F),        0,        0,        0,  B(0x7B),  B(0x0F),  B(0x1D),        0,  // U+00E0
+     B(0x04),  B(0x05),        0,        0,  B(0x07),        0,        0,        0,  // U+00E8
+           0,  B(0x7D),  B(0x08),        0,        0,        0,  B(0x7C),        0,  // U+00F0
+     B(0x0C),  B(0x06),        0,        0,  B(0x7E),        0,        0,        0,  // U+00F8
+};
+
+// Transliteration table entry: the GSM 03.38 text (as UTF-8) a character is replaced with
+typedef struct LocalTranslitEntry {
+    unsigned char iLen;     // length of the replacement + 1, or 0 if the character is kept as it is
+    char chText[3];         // replacement, not NUL terminated (copied 3 bytes at a time)
+} LocalTranslitEntry;
+
+// Transliteration table blocks: U+00A0 to U+017F, then U+2000 to U+206F
+#define LOCAL_TL_LATIN          0x00A0
+#define LOCAL_TL_LATIN_COUNT    0xE0
+#define LOCAL_TL_PUNCT          0x2000
+#define LOCAL_TL_PUNCT_COUNT    0x70
+#define LOCAL_TL_SLOT(iCp)      ((iCp) < LOCAL_TL_PUNCT ? (iCp) - LOCAL_TL_LATIN : (iCp) - LOCAL_TL_PUNCT + LOCAL_TL_LATIN_COUNT)
+#define LOCAL_TL_ENTRY(chText)  { sizeof(chText), chText }
+#define LOCAL_TL(iCp, chText)   [LOCAL_TL_SLOT(iCp)] = LOCAL_TL_ENTRY(chText)
+
+// combining diacritical marks (U+0300 to U+036F), dropped from decomposed accented letters
+#define LOCAL_TL_COMBINING      0x0300
+#define LOCAL_TL_COMBINING_COUNT 0x70
+
+// Replacements of characters which are not in the GSM 03.38 alphabet, for which it has a
+// close equivalent. No replacement is more than 3 bytes, nor longer than 1.5 times its
+// character, so text grows by at most half (see CLICK_CHARSET_TRANSLIT_SIZE()).
+static const LocalTranslitEntry aLocalTranslit[LOCAL_TL_LATIN_COUNT + LOCAL_TL_PUNCT_COUNT] = {
+    // U+00A0 to U+00FF (Latin-1 supplement): symbols and accented letters not in GSM 03.38
+    LOCAL_TL(0x00A0, " "), LOCAL_TL(0x00A2, "c"), LOCAL_TL(0x00A6, "|"), LOCAL_TL(0x00A8, "\""),
+    LOCAL_TL(0x00A9, "(c)"), LOCAL_TL(0x00AA, "a"), LOCAL_TL(0x00AB, "\""), LOCAL_TL(0x00AC, "-"),
+    LOCAL_TL(0x00AD, ""), LOCAL_TL(0x00AE, "(R)"), LOCAL_TL(0x00AF, "-"), LOCAL_TL(0x00B0, "o"),
+    LOCAL_TL(0x00B1, "+/-"), LOCAL_TL(0x00B2, "2"), LOCAL_TL(0x00B3, "3"), LOCAL_TL(0x00B4, "'"),
+    LOCAL_TL(0x00B5, "u"), LOCAL_TL(0x00B7, "."), LOCAL_TL(0x00B8, ","), LOCAL_TL(0x00B9, "1"),
+    LOCAL_TL(0x00BA, "o"), LOCAL_TL(0x00BB, "\""), LOCAL_TL(0x00BC, "1/4"), LOCAL_TL(0x00BD, "1/2"),
+    LOCAL_TL(0x00BE, "3/4"), LOCAL_TL(0x00C0, "A"), LOCAL_TL(0x00C1, "A"), LOCAL_TL(0x00C2, "A"),
+    LOCAL_TL(0x00C3, "A"), LOCAL_TL(0x00C8, "E"), LOCAL_TL(0x00CA, "E"), LOCAL_TL(0x00CB, "E"),
+    LOCAL_TL(0x00CC, "I"), LOCAL_TL(0x00CD, "I"), LOCAL_TL(0x00CE, "I"), LOCAL_TL(0x00CF, "I"),
+    LOCAL_TL(0x00D0, "D"), LOCAL_TL(0x00D2, "O"), LOCAL_TL(0x00D3, "O"), LOCAL_TL(0x00D4, "O"),
+    LOCAL_TL(0x00D5, "O"), LOCAL_TL(0x00D7, "x"), LOCAL_TL(0x00D9, "U"), LOCAL_TL(0x00DA, "U"),
+    LOCAL_TL(0x00DB, "U"), LOCAL_TL(0x00DD, "Y"), LOCAL_TL(0x00DE, "Th"), LOCAL_TL(0x00E1, "a"),
+    LOCAL_TL(0x00E2, "a"), LOCAL_TL(0x00E3, "a"), LOCAL_TL(0x00E7, "\xc3\x87"), LOCAL_TL(0x00EA, "e"),
+    LOCAL_TL(0x00EB, "e"), LOCAL_TL(0x00ED, "i"), LOCAL_TL(0x00EE, "i"), LOCAL_TL(0x00EF, "i"),
+    LOCAL_TL(0x00F0, "d"), LOCAL_TL(0x00F3, "o"), LOCAL_TL(0x00F4, "o"), LOCAL_TL(0x00F5, "o"),
+    LOCAL_TL(0x00F7, "/"), LOCAL_TL(0x00FA, "u"), LOCAL_TL(0x00FB, "u"), LOCAL_TL(0x00FD, "y"),
+    LOCAL_TL(0x00FE, "th"), LOCAL_TL(0x00FF, "y"),
+    // U+0100 to U+017F (Latin extended-A): letters without their accents
+    LOCAL_TL(0x0100, "A"), LOCAL_TL(0x0101, "a"), LOCAL_TL(0x0102, "A"), LOCAL_TL(0x0103, "a"),
+    LOCAL_TL(0x0104, "A"), LOCAL_TL(0x0105, "a"), LOCAL_TL(0x0106, "C"), LOCAL_TL(0x0107, "c"),
+    LOCAL_TL(0x0108, "C"), LOCAL_TL(0x0109, "c"), LOCAL_TL(0x010A, "C"), LOCAL_TL(0x010B, "c"),
+    LOCAL_TL(0x010C, "C"), LOCAL_TL(0x010D, "c"), LOCAL_TL(0x010E, "D"), LOCAL_TL(0x010F, "d"),
+    LOCAL_TL(0x0110, "D"), LOCAL_TL(0x0111, "d"), LOCAL_TL(0x0112, "E"), LOCAL_TL(0x0113, "e"),
+    LOCAL_TL(0x0114, "E"), LOCAL_TL(0x0115, "e"), LOCAL_TL(0x0116, "E"), LOCAL_TL(0x0117, "e"),
+    LOCAL_TL(0x0118, "E"), LOCAL_TL(0x0119, "e"), LOCAL_TL(0x011A, "E"), LOCAL_TL(0x011B, "e"),
+    LOCAL_TL(0x011C, "G"), LOCAL_TL(0x011D, "g"), LOCAL_TL(0x011E, "G"), LOCAL_TL(0x011F, "g"),
+    LOCAL_TL(0x0120, "G"), LOCAL_TL(0x0121, "g"), LOCAL_TL(0x0122, "G"), LOCAL_TL(0x0123, "g"),
+    LOCAL_TL(0x0124, "H"), LOCAL_TL(0x0125, "h"), LOCAL_TL(0x0126, "H"), LOCAL_TL(0x0127, "h"),
+    LOCAL_TL(0x0128, "I"), LOCAL_TL(0x0129, "i"), LOCAL_TL(0x012A, "I"), LOCAL_TL(0x012B, "i"),
+    LOCAL_TL(0x012C, "I"), LOCAL_TL(0x012D, "i"), LOCAL_TL(0x012E, "I"), LOCAL_TL(0x012F, "i"),
+    LOCAL_TL(0x0130, "I"), LOCAL_TL(0x0131, "i"), LOCAL_TL(0x0132, "IJ"), LOCAL_TL(0x0133, "ij"),
+    LOCAL_TL(0x0134, "J"), LOCAL_TL(0x0135, "j"), LOCAL_TL(0x0136, "K"), LOCAL_TL(0x0137, "k"),
+    LOCAL_TL(0x0138, "k"), LOCAL_TL(0x0139, "L"), LOCAL_TL(0x013A, "l"), LOCAL_TL(0x013B, "L"),
+    LOCAL_TL(0x013C, "l"), LOCAL_TL(0x013D, "L"), LOCAL_TL(0x013E, "l"), LOCAL_TL(0x013F, "L"),
+    LOCAL_TL(0x0140, "l"), LOCAL_TL(0x0141, "L"), LOCAL_TL(0x0142, "l"), LOCAL_TL(0x0143, "N"),
+    LOCAL_TL(0x0144, "n"), LOCAL_TL(0x0145, "N"), LOCAL_TL(0x0146, "n"), LOCAL_TL(0x0147, "N"),
+    LOCAL_TL(0x0148, "n"), LOCAL_TL(0x0149, "'n"), LOCAL_TL(0x014A, "N"), LOCAL_TL(0x014B, "n"),
+    LOCAL_TL(0x014C, "O"), LOCAL_TL(0x014D, "o"), LOCAL_TL(0x014E, "O"), LOCAL_TL(0x014F, "o"),
+    LOCAL_TL(0x0150, "O"), LOCAL_TL(0x0151, "o"), LOCAL_TL(0x0152, "OE"), LOCAL_TL(0x0153, "oe"),
+    LOCAL_TL(0x0154, "R"), LOCAL_TL(0x0155, "r"), LOCAL_TL(0x0156, "R"), LOCAL_TL(0x0157, "r"),
+    LOCAL_TL(0x0158, "R"), LOCAL_TL(0x0159, "r"), LOCAL_TL(0x015A, "S"), LOCAL_TL(0x015B, "s"),
+    LOCAL_TL(0x015C, "S"), LOCAL_TL(0x015D, "s"), LOCAL_TL(0x015E, "S"), LOCAL_TL(0x015F, "s"),
+    LOCAL_TL(0x0160, "S"), LOCAL_TL(0x0161, "s"), LOCAL_TL(0x0162, "T"), LOCAL_TL(0x0163, "t"),
+    LOCAL_TL(0x0164, "T"), LOCAL_TL(0x0165, "t"), LOCAL_TL(0x0166, "T"), LOCAL_TL(0x0167, "t"),
+    LOCAL_TL(0x0168, "U"), LOCAL_TL(0x0169, "u"), LOCAL_TL(0x016A, "U"), LOCAL_TL(0x016B, "u"),
+    LOCAL_TL(0x016C, "U"), LOCAL_TL(0x016D, "u"), LOCAL_TL(0x016E, "U"), LOCAL_TL(0x016F, "u"),
+    LOCAL_TL(0x0170, "U"), LOCAL_TL(0x0171, "u"), LOCAL_TL(0x0172, "U"), LOCAL_TL(0x0173, "u"),
+    LOCAL_TL(0x0174, "W"), LOCAL_TL(0x0175, "w"), LOCAL_TL(0x0176, "Y"), LOCAL_TL(0x0177, "y"),
+    LOCAL_TL(0x0178, "Y"), LOCAL_TL(0x0179, "Z"), LOCAL_TL(0x017A, "z"), LOCAL_TL(0x017B, "Z"),
+    LOCAL_TL(0x017C, "z"), LOCAL_TL(0x017D, "Z"), LOCAL_TL(0x017E, "z"), LOCAL_TL(0x017F, "s"),
+    // U+2000 to U+206F (general punctuation): spaces, dashes, quotes and invisible characters
+    LOCAL_TL(0x2000, " "), LOCAL_TL(0x2001, " "), LOCAL_TL(0x2002, " "), LOCAL_TL(0x2003, " "),
+    LOCAL_TL(0x2004, " "), LOCAL_TL(0x2005, " "), LOCAL_TL(0x2006, " "), LOCAL_TL(0x2007, " "),
+    LOCAL_TL(0x2008, " "), LOCAL_TL(0x2009, " "), LOCAL_TL(0x200A, " "), LOCAL_TL(0x200B, ""),
+    LOCAL_TL(0x200C, ""), LOCAL_TL(0x200D, ""), LOCAL_TL(0x200E, ""), LOCAL_TL(0x200F, ""),
+    LOCAL_TL(0x2010, "-"), LOCAL_TL(0x2011, "-"), LOCAL_TL(0x2012, "-"), LOCAL_TL(0x2013, "-"),
+    LOCAL_TL(0x2014, "-"), LOCAL_TL(0x2015, "-"), LOCAL_TL(0x2018, "'"), LOCAL_TL(0x2019, "'"),
+    LOCAL_TL(0x201A, "'"), LOCAL_TL(0x201B, "'"), LOCAL_TL(0x201C, "\""), LOCAL_TL(0x201D, "\""),
+    LOCAL_TL(0x201E, "\""), LOCAL_TL(0x201F, "\""), LOCAL_TL(0x2020, "+"), LOCAL_TL(0x2022, "*"),
+    LOCAL_TL(0x2024, "."), LOCAL_TL(0x2025, ".."), LOCAL_TL(0x2026, "..."), LOCAL_TL(0x2028, "\n"),
+    LOCAL_TL(0x2029, "\n"), LOCAL_TL(0x202F, " "), LOCAL_TL(0x2032, "'"), LOCAL_TL(0x2033, "\""),
+    LOCAL_TL(0x2039, "<"), LOCAL_TL(0x203A, ">"), LOCAL_TL(0x2043, "-"), LOCAL_TL(0x2044, "/"),
+    LOCAL_TL(0x205F, " "), LOCAL_TL(0x2060, ""), LOCAL_TL(0x2061, ""), LOCAL_TL(0x2062, ""),
+    LOCAL_TL(0x2063, ""), LOCAL_TL(0x2064, "")
+};
+
+// Replacements of characters outside the table blocks
+static const struct {
+    long iCodePoint;
+    LocalTranslitEntry oEntry;
+} aLocalTranslitOther[] = {
+    { 0x02BC, LOCAL_TL_ENTRY("'") },  { 0x02C6, LOCAL_TL_ENTRY("^") },  { 0x02DC, LOCAL_TL_ENTRY("~") },
+    { 0x2116, LOCAL_TL_ENTRY("No") }, { 0x2122, LOCAL_TL_ENTRY("TM") }, { 0x2212, LOCAL_TL_ENTRY("-") },
+    { 0xFEFF, LOCAL_TL_ENTRY("") },
+};
+
+static const LocalTranslitEntry oLocalTranslitDrop = LOCAL_TL_ENTRY("");
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static unsigned short local_charset_gsm_entry(long iCodePoint);
+static long local_charset_gsm7_ascii_run(const unsigned char *pText, long iLen, long *iSeptets);
+static long local_charset_utf8_run(const unsigned char *pText, long iLen, long *iChars);
+static void local_charset_hex_units(const unsigned short *aUnits, int iNum, char *chOut);
+static int local_charset_hex_unit(const char *chHex);
+static int local_charset_utf8_encode(long iCodePoint, char *chOut);
+static const LocalTranslitEntry *local_charset_translit_entry(long iCodePoint);
+static long local_charset_translit_ascii(char *chText, long iLen);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_charset_gsm_entry
+ * Info:      Looks up the GSM 03.38 table entry of a Unicode character.
+ * Inputs:    iCodePoint - Unicode code point
+ * Return:    table entry (see B() and E()), or 0 if not in the GSM 03.38 alphabet
+ */
+static unsigned short local_charset_gsm_entry(long iCodePoint)
+{
+    if (iCodePoint < 0x80)
+        return aLocalAsciiGsm[iCodePoint];
+    if (iCodePoint < 0x100)
+        return aLocalLatin1Gsm[iCodePoint - 0x80];
+
+    switch (iCodePoint) {
+        case 0x0393: return B(0x13); // GREEK CAPITAL LETTER GAMMA
+        case 0x0394: return B(0x10); // GREEK CAPITAL LETTER DELTA
+        case 0x0398: return B(0x19); // GREEK CAPITAL LETTER THETA
+        case 0x039B: return B(0x14); // GREEK CAPITAL LETTER LAMDA
+        case 0x039E: return B(0x1A); // GREEK CAPITAL LETTER XI
+        case 0x03A0: return B(0x16); // GREEK CAPITAL LETTER PI
+        case 0x03A3: return B(0x18); // GREEK CAPITAL LETTER SIGMA
+        case 0x03A6: return B(0x12); // GREEK CAPITAL LETTER PHI
+        case 0x03A8: return B(0x17); // GREEK CAPITAL LETTER PSI
+        case 0x03A9: return B(0x15); // GREEK CAPITAL LETTER OMEGA
+        case 0x20AC: return E(0x65); // EURO SIGN
+        default:     return 0;
+    }
+}
+
+/*
+ * Function:  local_charset_gsm7_ascii_run
+ * Info:      Skips leading 16 byte blocks of ASCII text which are entirely in the GSM 03.38
+ *            alphabet, counting their septets. Most message text consists of long runs of
+ *            such blocks, so they are checked with SSE2 where available: a block is all
+ *            GSM if no byte has its top bit set, is a control character other than LF, FF
+ *            and CR, or is '`' or DEL. Extension characters (FF and [ \\ ] ^ { | } ~) count
+ *            as two septets. Without SSE2 no blocks are skipped.
+ * Inputs:    pText    - text
+ *            iLen     - length of text in bytes
+ * Outputs:   iSeptets - incremented by the septets of the skipped blocks
+ * Return:    number of bytes skipped, a multiple of 16
+ */
+static long local_charset_gsm7_ascii_run(const unsigned char *pText, long iLen, long *iSeptets)
+{
+    long iPos = 0;
+
+#ifdef __SSE2__
+    // signed compares: bytes with the top bit set are negative, so they count as controls
+    const __m128i vSpace = _mm_set1_epi8(0x20), vLf = _mm_set1_epi8(0x0a), vFf = _mm_set1_epi8(0x0c);
+    const __m128i vCr = _mm_set1_epi8(0x0d), vGrave = _mm_set1_epi8(0x60), vDel = _mm_set1_epi8(0x7f);
+    const __m128i vCaseMask = _mm_set1_epi8((char)0xdf), vExtMin = _mm_set1_epi8(0x5a), vExtMax = _mm_set1_epi8(0x5f);
+    __m128i vChunk, vBad, vExt, vFfEq, vExtCount = _mm_setzero_si128();
+    long iBlockStart = 0;
+    int iBlocks = 0;
+
+    for (; iPos + 16 <= iLen; iPos += 16) {
+        vChunk = _mm_loadu_si128((const __m128i *)(pText + iPos));
+        vFfEq  = _mm_cmpeq_epi8(vChunk, vFf);
+
+        vBad = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vChunk, vLf), vFfEq),
+                                             _mm_cmpeq_epi8(vChunk, vCr)),
+                                _mm_cmplt_epi8(vChunk, vSpace));
+        vBad = _mm_or_si128(vBad, _mm_or_si128(_mm_cmpeq_epi8(vChunk, vGrave), _mm_cmpeq_epi8(vChunk, vDel)));
+        if (_mm_movemask_epi8(vBad) != 0)
+            break;
+
+        // clearing bit 5 maps '{' to '~' onto '[' to '^'; each match is -1, so subtracting
+        // the match mask counts extension characters per byte lane
+        vExt = _mm_and_si128(vChunk, vCaseMask);
+        vExt = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(vExt, vExtMin), _mm_cmplt_epi8(vExt, vExtMax)), vFfEq);
+        vExtCount = _mm_sub_epi8(vExtCount, vExt);
+
+        // fold the per-lane counts into the total before any lane can overflow
+        if (++iBlocks == 255) {
+            vExtCount = _mm_sad_epu8(vExtCount, _mm_setzero_si128());
+            *iSeptets += (iPos + 16 - iBlockStart) + _mm_cvtsi128_si32(vExtCount) + _mm_extract_epi16(vExtCount, 4);
+            vExtCount   = _mm_setzero_si128();
+            iBlockStart = iPos + 16;
+            iBlocks     = 0;
+        }
+    }
+
+    vExtCount = _mm_sad_epu8(vExtCount, _mm_setzero_si128());
+    *iSeptets += (iPos - iBlockStart) + _mm_cvtsi128_si32(vExtCount) + _mm_extract_epi16(vExtCount, 4);
+#else
+    (void)pText;
+    (void)iLen;
+    (void)iSeptets;
+#endif
+
+    return iPos;
+}
+
+/*
+ * Function:  local_charset_utf8_run
+ * Info:      Skips leading 16 byte blocks of valid UTF-8 text made up of 1, 2 and 3 byte
+ *            characters, counting their characters. Checked with SSE2 where available:
+ *            each byte is classified as ASCII, continuation, 2 byte lead (C2-DF) or 3 byte
+ *            lead (E0-EF), and the block is valid if its continuation bytes are exactly
+ *            those the lead bytes (of this and the previous block) call for. The overlong
+ *            and surrogate forms after E0 and ED are rejected by comparing each byte with
+ *            the one before it. Blocks with 4 byte characters or invalid bytes end the run,
+ *            so that they are decoded (or rejected) one character at a time. Without SSE2
+ *            no blocks are skipped.
+ * Inputs:    pText  - text, positioned at the start of a character
+ *            iLen   - length of text in bytes
+ * Outputs:   iChars - incremented by the characters of the skipped blocks
+ * Return:    number of bytes skipped, always ending on a character boundary
+ */
+static long local_charset_utf8_run(const unsigned char *pText, long iLen, long *iChars)
+{
+    long iPos = 0;
+
+#ifdef __SSE2__
+    // signed compares: 0x80-0xBF are -128 to -65, 0xC2-0xDF are -62 to -33, 0xE0-0xEF are -32 to -17
+    const __m128i vContEnd = _mm_set1_epi8(-64), vLead2Min = _mm_set1_epi8(-63), vLead2End = _mm_set1_epi8(-32);
+    const __m128i vLead3Min = _mm_set1_epi8(-33), vLead3End = _mm_set1_epi8(-16), vHighContMin = _mm_set1_epi8(-97);
+    const __m128i vE0 = _mm_set1_epi8((char)0xe0), vEd = _mm_set1_epi8((char)0xed);
+    __m128i vChunk, vPrev, vHighCont;
+    unsigned int iCarry = 0, iAscii = 0, iCont = 0, iLead2 = 0, iLead3 = 0, iExpected = 0, iBad = 0;
+
+    for (; iPos + 16 <= iLen; iPos += 16) {
+        vChunk = _mm_loadu_si128((const __m128i *)(pText + iPos));
+        vPrev  = (iPos > 0 ? _mm_loadu_si128((const __m128i *)(pText + iPos - 1)) : _mm_slli_si128(vChunk, 1));
+
+        iAscii = (unsigned int)_mm_movemask_epi8(vChunk) ^ 0xffff;
+        iCont  = (unsigned int)_mm_movemask_epi8(_mm_cmplt_epi8(vChunk, vContEnd));
+        iLead2 = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(vChunk, vLead2Min), _mm_cmplt_epi8(vChunk, vLead2End)));
+        iLead3 = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(vChunk, vLead3Min), _mm_cmplt_epi8(vChunk, vLead3End)));
+
+        // E0 must be followed by A0-BF (not overlong), ED by 80-9F (not a surrogate). Among
+        // continuation bytes A0-BF are those above -97; any other byte fails the checks below.
+        vHighCont = _mm_cmpgt_epi8(vChunk, vHighContMin);
+        iBad = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_andnot_si128(vHighCont, _mm_cmpeq_epi8(vPrev, vE0)),
+                                                            _mm_and_si128(vHighCont, _mm_cmpeq_epi8(vPrev, vEd))));
+
+        iExpected = ((iLead2 | iLead3) << 1) | (iLead3 << 2) | iCarry;
+        if ((iAscii | iCont | iLead2 | iLead3) != 0xffff || (iExpected & 0xffff) != iCont || iBad != 0)
+            break;
+
+        *iChars += 16 - __builtin_popcount(iCont);
+        iCarry   = iExpected >> 16;
+    }
+
+    // a character which continues into the rejected (or last partial) block is left to the caller
+    if (iCarry != 0) {
+        while ((pText[iPos - 1] & 0xc0) == 0x80)
+            iPos--;
+        iPos--;
+        *iChars -= 1;
+    }
+#else
+    (void)pText;
+    (void)iLen;
+    (void)iChars;
+#endif
+
+    return iPos;
+}
+
+/*
+ * Function:  local_charset_hex_units
+ * Info:      Writes UTF-16 code units as 4 uppercase hex digits each, most significant
+ *            digit first. Eight units are converted at a time with SSE2 where available.
+ * Inputs:    aUnits - UTF-16 code units
+ *            iNum   - number of code units
+ * Outputs:   chOut  - 4 * 'iNum' hex digits (not NUL terminated)
+ * Return:    void
+ */
+static void local_charset_hex_units(const unsigned short *aUnits, int iNum, char *chOut)
+{
+    static const char chHexDigits[] = "0123456789ABCDEF";
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i vNibble = _mm_set1_epi8(0x0f), vNine = _mm_set1_epi8(9);
+    const __m128i vZero = _mm_set1_epi8('0'), vAlpha = _mm_set1_epi8('A' - '0' - 10);
+    __m128i vUnits, vHigh, vLow, vDigits;
+
+    for (; i + 8 <= iNum; i += 8, chOut += 32) {
+        // swap each unit to big-endian byte order, then split every byte into its two nibbles
+        vUnits = _mm_loadu_si128((const __m128i *)(aUnits + i));
+        vUnits = _mm_or_si128(_mm_slli_epi16(vUnits, 8), _mm_srli_epi16(vUnits, 8));
+        vHigh  = _mm_and_si128(_mm_srli_epi16(vUnits, 4), vNibble);
+        vLow   = _mm_and_si128(vUnits, vNibble);
+
+        vDigits = _mm_unpacklo_epi8(vHigh, vLow);
+        vDigits = _mm_add_epi8(_mm_add_epi8(vDigits, vZero), _mm_and_si128(_mm_cmpgt_epi8(vDigits, vNine), vAlpha));
+        _mm_storeu_si128((__m128i *)chOut, vDigits);
+
+        vDigits = _mm_unpackhi_epi8(vHigh, vLow);
+        vDigits = _mm_add_epi8(_mm_add_epi8(vDigits, vZero), _mm_and_si128(_mm_cmpgt_epi8(vDigits, vNine), vAlpha));
+        _mm_storeu_si128((__m128i *)(chOut + 16), vDigits);
+    }
+#endif
+
+    for (; i < iNum; i++, chOut += 4) {
+        chOut[0] = chHexDigits[aUnits[i] >> 12];
+        chOut[1] = chHexDigits[(aUnits[i] >> 8) & 0xf];
+        chOut[2] = chHexDigits[(aUnits[i] >> 4) & 0xf];
+        chOut[3] = chHexDigits[aUnits[i] & 0xf];
+    }
+}
+
+/*
+ * Function:  local_charset_hex_unit
+ * Info:      Reads a UTF-16 code unit written as 4 hex digits (either case).
+ * Inputs:    chHex - 4 hex digits
+ * Return:    code unit, or -1 if not all hex digits
+ */
+static int local_charset_hex_unit(const char *chHex)
+{
+    int i = 0, iUnit = 0, c = 0;
+
+    for (i = 0; i < 4; i++) {
+        c = (unsigned char)chHex[i];
+        if (c >= '0' && c <= '9')
+            iUnit = iUnit << 4 | (c - '0');
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            iUnit = iUnit << 4 | ((c | 0x20) - 'a' + 10);
+        else
+            return -1;
+    }
+
+    return iUnit;
+}
+
+/*
+ * Function:  local_charset_utf8_encode
+ * Info:      Writes a Unicode code point as UTF-8.
+ * Inputs:    iCodePoint - code point (not a surrogate)
+ * Outputs:   chOut      - 1 to 4 bytes (not NUL terminated)
+ * Return:    number of bytes written
+ */
+static int local_charset_utf8_encode(long iCodePoint, char *chOut)
+{
+    if (iCodePoint < 0x80) {
+        chOut[0] = (char)iCodePoint;
+        return 1;
+    }
+    if (iCodePoint < 0x800) {
+        chOut[0] = (char)(0xc0 | iCodePoint >> 6);
+        chOut[1] = (char)(0x80 | (iCodePoint & 0x3f));
+        return 2;
+    }
+    if (iCodePoint < 0x10000) {
+        chOut[0] = (char)(0xe0 | iCodePoint >> 12);
+        chOut[1] = (char)(0x80 | ((iCodePoint >> 6) & 0x3f));
+        chOut[2] = (char)(0x80 | (iCodePoint & 0x3f));
+        return 3;
+    }
+    chOut[0] = (char)(0xf0 | iCodePoint >> 18);
+    chOut[1] = (char)(0x80 | ((iCodePoint >> 12) & 0x3f));
+    chOut[2] = (char)(0x80 | ((iCodePoint >> 6) & 0x3f));
+    chOut[3] = (char)(0x80 | (iCodePoint & 0x3f));
+    return 4;
+}
+
+/*
+ * Function:  local_charset_translit_entry
+ * Info:      Looks up the transliteration of a character which is not 7-bit ASCII.
+ * Inputs:    iCodePoint - Unicode code point
+ * Return:    replacement, or NULL if the character is kept as it is
+ */
+static const LocalTranslitEntry *local_charset_translit_entry(long iCodePoint)
+{
+    const LocalTranslitEntry *oEntry = NULL;
+    int i = 0;
+
+    if ((unsigned long)(iCodePoint - LOCAL_TL_LATIN) < LOCAL_TL_LATIN_COUNT)
+        oEntry = &aLocalTranslit[iCodePoint - LOCAL_TL_LATIN];
+    else if ((unsigned long)(iCodePoint - LOCAL_TL_PUNCT) < LOCAL_TL_PUNCT_COUNT)
+        oEntry = &aLocalTranslit[iCodePoint - LOCAL_TL_PUNCT + LOCAL_TL_LATIN_COUNT];
+    else if ((unsigned long)(iCodePoint - LOCAL_TL_COMBINING) < LOCAL_TL_COMBINING_COUNT)
+        return &oLocalTranslitDrop;
+    else {
+        for (i = 0; i < (int)(sizeof(aLocalTranslitOther) / sizeof(aLocalTranslitOther[0])); i++) {
+            if (aLocalTranslitOther[i].iCodePoint == iCodePoint)
+                return &aLocalTranslitOther[i].oEntry;
+        }
+        return NULL;
+    }
+
+    return (oEntry->iLen != 0 ? oEntry : NULL);
+}
+
+/*
+ * Function:  local_charset_translit_ascii
+ * Info:      Transliterates the only printable 7-bit ASCII character, and the tab, which
+ *            are not in the GSM 03.38 alphabet, in place: '`' becomes '\'' and tab a space.
+ * Inputs:    chText - ASCII text, changed in place
+ *            iLen   - length of text
+ * Return:    number of characters replaced
+ */
+static long local_charset_translit_ascii(char *chText, long iLen)
+{
+    char *pChar = NULL;
+    long iReplaced = 0;
+
+    for (pChar = memchr(chText, '`', iLen); pChar != NULL; pChar = memchr(pChar, '`', chText + iLen - pChar), iReplaced++)
+        *pChar++ = '\'';
+    for (pChar = memchr(chText, '\t', iLen); pChar != NULL; pChar = memchr(pChar, '\t', chText + iLen - pChar), iReplaced++)
+        *pChar++ = ' ';
+
+    return iReplaced;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_charset_utf8_decode
+ * Info:      Decodes one UTF-8 character. Overlong forms, surrogates and code points
+ *            above U+10FFFF are rejected.
+ * Inputs:    pText - text, positioned at the start of a character
+ *            iLen  - bytes remaining in text (> 0)
+ * Outputs:   iCodePoint - decoded Unicode code point
+ * Return:    length of the character in bytes, or 0 if the text is not valid UTF-8
+ */
+int click_charset_utf8_decode(const unsigned char *pText, long iLen, long *iCodePoint)
+{
+    unsigned char c = pText[0];
+
+    if (c < 0x80) {
+        *iCodePoint = c;
+        return 1;
+    }
+    if (c < 0xc2)
+        return 0; // continuation byte, or overlong 2-byte form
+    if (c < 0xe0) {
+        if (iLen < 2 || (pText[1] & 0xc0) != 0x80)
+            return 0;
+        *iCodePoint = ((long)(c & 0x1f) << 6) | (pText[1] & 0x3f);
+        return 2;
+    }
+    if (c < 0xf0) {
+        if (iLen < 3 || (pText[1] & 0xc0) != 0x80 || (pText[2] & 0xc0) != 0x80)
+            return 0;
+        *iCodePoint = ((long)(c & 0x0f) << 12) | ((long)(pText[1] & 0x3f) << 6) | (pText[2] & 0x3f);
+        if (*iCodePoint < 0x800 || (*iCodePoint >= 0xd800 && *iCodePoint <= 0xdfff))
+            return 0;
+        return 3;
+    }
+    if (c < 0xf5) {
+        if (iLen < 4 || (pText[1] & 0xc0) != 0x80 || (pText[2] & 0xc0) != 0x80 || (pText[3] & 0xc0) != 0x80)
+            return 0;
+        *iCodePoint = ((long)(c & 0x07) << 18) | ((long)(pText[1] & 0x3f) << 12) |
+                      ((long)(pText[2] & 0x3f) << 6) | (pText[3] & 0x3f);
+        if (*iCodePoint < 0x10000 || *iCodePoint > 0x10ffff)
+            return 0;
+        return 4;
+    }
+
+    return 0;
+}
+
+/*
+ * Function:  click_charset_gsm7_lookup
+ * Info:      Looks up the GSM 03.38 code of a Unicode character.
+ * Inputs:    iCodePoint - Unicode code point
+ * Return:    GSM 03.38 code, OR'ed with CLICK_CHARSET_GSM7_EXT for extension table
+ *            characters (which are sent as CLICK_CHARSET_GSM7_ESCAPE followed by the code),
+ *            or -1 if the character is not in the GSM 03.38 alphabet
+ */
+int click_charset_gsm7_lookup(long iCodePoint)
+{
+    unsigned short iEntry = (iCodePoint >= 0 ? local_charset_gsm_entry(iCodePoint) : 0);
+
+    if (iEntry == 0)
+        return -1;
+
+    return LOCAL_GSM_CODE(iEntry) | (LOCAL_GSM_SEPTETS(iEntry) == 2 ? CLICK_CHARSET_GSM7_EXT : 0);
+}
+
+/*
+ * Function:  click_charset_ascii_span
+ * Info:      Counts the leading 7-bit ASCII bytes of a text, 16 at a time with SSE2
+ *            where available.
+ * Inputs:    chText - text
+ *            iLen   - length of text in bytes
+ * Return:    number of leading bytes below 0x80
+ */
+long click_charset_ascii_span(const char *chText, long iLen)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    long iPos = 0;
+
+#ifdef __SSE2__
+    for (; iPos + 16 <= iLen; iPos += 16) {
+        int iMask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(pText + iPos)));
+
+        if (iMask != 0)
+            return iPos + __builtin_ctz(iMask);
+    }
+#endif
+
+    while (iPos < iLen && pText[iPos] < 0x80)
+        iPos++;
+
+    return iPos;
+}
+
+/*
+ * Function:  click_charset_utf8_validate
+ * Info:      Validates UTF-8 text, rejecting overlong forms, surrogates and code points
+ *            above U+10FFFF. Blocks of 1 to 3 byte characters are validated 16 bytes at a
+ *            time with SSE2 where available; the rest is decoded one character at a time.
+ * Inputs:    chText - text (need not be NUL terminated)
+ *            iLen   - length of text in bytes
+ * Return:    length of the valid UTF-8 prefix of the text: 'iLen' if it is all valid
+ */
+long click_charset_utf8_validate(const char *chText, long iLen)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    long iPos = 0, iEnd = 0, iChars = 0, iCodePoint = 0;
+    int iCharLen = 0;
+
+    if ((chText == NULL && iLen > 0) || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return 0;
+    }
+
+    while (iPos < iLen) {
+        iPos += local_charset_utf8_run(pText + iPos, iLen - iPos, &iChars);
+
+        for (iEnd = (iLen - iPos > 16 ? iPos + 16 : iLen); iPos < iEnd; iPos += iCharLen) {
+            if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0)
+                return iPos;
+        }
+    }
+
+    return iPos;
+}
+
+/*
+ * Function:  click_charset_classify
+ * Info:      Classifies UTF-8 message text in a single pass: GSM 7-bit if every character
+ *            is in the GSM 03.38 default alphabet or extension table, else UCS-2. Runs of
+ *            ASCII text (and, once the text needs UCS-2, of other 1 to 3 byte characters)
+ *            take the SIMD fast path; the rest is decoded one character at a time. No
+ *            memory is allocated.
+ * Inputs:    chText - UTF-8 text (need not be NUL terminated)
+ *            iLen   - length of text in bytes
+ * Outputs:   oInfo  - character and septet/code unit counts. May be NULL.
+ * Return:    character set, or CLICK_CHARSET_INVALID if the text is not valid UTF-8
+ */
+eClickCharset click_charset_classify(const char *chText, long iLen, ClickCharsetInfo *oInfo)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    long iPos = 0, iSpan = 0, iEnd = 0, iCodePoint = 0;
+    long iChars = 0, iSeptets = 0, iUcs2Units = 0, iRunChars = 0;
+    int iCharLen = 0, bGsm7 = 1;
+    unsigned short iEntry = 0;
+    eClickCharset eCharset = CLICK_CHARSET_INVALID;
+
+    if (oInfo != NULL)
+        memset(oInfo, 0, sizeof(ClickCharsetInfo));
+
+    if ((chText == NULL && iLen > 0) || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        goto exit;
+    }
+
+    while (iPos < iLen) {
+        // a run of GSM 7-bit ASCII blocks while the text is still GSM 7-bit, or of valid
+        // UTF-8 blocks (without characters above U+FFFF) once it is known to need UCS-2
+        if (bGsm7)
+            iRunChars = iSpan = local_charset_gsm7_ascii_run(pText + iPos, iLen - iPos, &iSeptets);
+        else {
+            iRunChars = 0;
+            iSpan = local_charset_utf8_run(pText + iPos, iLen - iPos, &iRunChars);
+        }
+        iPos       += iSpan;
+        iChars     += iRunChars;
+        iUcs2Units += iRunChars;
+
+        // then the next 16 bytes one character at a time, before trying the fast path again
+        for (iEnd = (iLen - iPos > 16 ? iPos + 16 : iLen); iPos < iEnd; iPos += iCharLen) {
+            if (pText[iPos] < 0x80) {
+                iCodePoint = pText[iPos];
+                iCharLen   = 1;
+            }
+            else if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0)
+                goto exit;
+
+            if (bGsm7) {
+                if ((iEntry = local_charset_gsm_entry(iCodePoint)) == 0)
+                    bGsm7 = 0;
+                else
+                    iSeptets += LOCAL_GSM_SEPTETS(iEntry);
+            }
+
+            iChars     += 1;
+            iUcs2Units += (iCodePoint > 0xffff ? 2 : 1);
+        }
+    }
+
+    eCharset = (bGsm7 ? CLICK_CHARSET_GSM7 : CLICK_CHARSET_UCS2);
+
+exit:
+    if (oInfo != NULL) {
+        oInfo->eCharset   = eCharset;
+        oInfo->iChars     = iChars;
+        oInfo->iSeptets   = (eCharset == CLICK_CHARSET_GSM7 ? iSeptets : 0);
+        oInfo->iUcs2Units = iUcs2Units;
+    }
+
+    return eCharset;
+}
+
+/*
+ * Function:  click_charset_gsm7_packed_len
+ * Info:      Calculates the number of octets that packed GSM 7-bit text occupies.
+ * Inputs:    iSeptets  - number of septets
+ *            iFillBits - fill bits preceding the first septet (0-6), used to align the
+ *                        text to a septet boundary after a user data header
+ * Return:    number of octets
+ */
+long click_charset_gsm7_packed_len(long iSeptets, int iFillBits)
+{
+    return (iFillBits + iSeptets * 7 + 7) / 8;
+}
+
+/*
+ * Function:  click_charset_gsm7_pack
+ * Info:      Converts UTF-8 text to GSM 03.38 septets and packs them into octets, least
+ *            significant bit first, as sent in the user data of an SMS. Extension table
+ *            characters are packed as the escape septet followed by their code.
+ * Inputs:    chText    - UTF-8 text, which must classify as CLICK_CHARSET_GSM7
+ *            iLen      - length of text in bytes
+ *            iFillBits - zero bits preceding the first septet (0-6); see
+ *                        click_charset_gsm7_packed_len()
+ *            aOut      - output buffer
+ *            iOutSize  - size of output buffer in bytes
+ * Return:    number of octets written, or -1 if the text is not GSM 7-bit or the output
+ *            buffer is too small
+ */
+long click_charset_gsm7_pack(const char *chText, long iLen, int iFillBits, unsigned char *aOut, long iOutSize)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    unsigned long long iBlock = 0;
+    unsigned int iBits = 0, iNumBits = (unsigned int)iFillBits, iAnd = 0, iOr = 0, iHigh = 0;
+    unsigned short iEntry = 0;
+    long iPos = 0, iEnd = 0, iOut = 0, iCodePoint = 0;
+    int i = 0, iCharLen = 0;
+
+    if ((chText == NULL && iLen > 0) || iLen < 0 || iFillBits < 0 || iFillBits > 6 || aOut == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    while (iPos < iLen) {
+        // fast path: 8 single-septet ASCII characters pack into exactly 7 octets, which are
+        // written at once with the (fewer than 8) bits still pending from earlier septets
+        while (iPos + 8 <= iLen) {
+            iBlock = 0;
+            iAnd   = (1 << 8);
+            iOr    = iHigh = 0;
+            for (i = 0; i < 8; i++) {
+                iEntry  = aLocalAsciiGsm[pText[iPos + i] & 0x7f];
+                iHigh  |= pText[iPos + i];
+                iAnd   &= iEntry;
+                iOr    |= iEntry;
+                iBlock |= (unsigned long long)LOCAL_GSM_CODE(iEntry) << (7 * i);
+            }
+            if ((iHigh & 0x80) || iAnd == 0 || LOCAL_GSM_SEPTETS(iOr) != 1)
+                break;
+            if (iOut + 7 > iOutSize)
+                goto overflow;
+
+            iBlock = (iBlock << iNumBits) | iBits;
+            for (i = 0; i < 7; i++)
+                aOut[iOut++] = (unsigned char)(iBlock >> (8 * i));
+            iBits = (unsigned int)(iBlock >> 56);
+            iPos += 8;
+        }
+
+        // slow path: the next 8 bytes one character at a time, then try the fast path again
+        for (iEnd = (iLen - iPos > 8 ? iPos + 8 : iLen); iPos < iEnd; ) {
+            if (pText[iPos] < 0x80) {
+                iEntry   = aLocalAsciiGsm[pText[iPos]];
+                iCharLen = 1;
+            }
+            else if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) != 0)
+                iEntry = local_charset_gsm_entry(iCodePoint);
+
+            if (iCharLen == 0 || iEntry == 0) {
+                click_debug_print("%s ERROR: Text is not GSM 7-bit at byte %ld!\n", __func__, iPos);
+                return -1;
+            }
+            iPos += iCharLen;
+
+            if (LOCAL_GSM_SEPTETS(iEntry) == 2) {
+                iBits |= (unsigned int)CLICK_CHARSET_GSM7_ESCAPE << iNumBits;
+                iNumBits += 7;
+            }
+            iBits |= (unsigned int)LOCAL_GSM_CODE(iEntry) << iNumBits;
+            iNumBits += 7;
+
+            // at most 7 + 14 bits are pending, so whole octets are flushed after every character
+            while (iNumBits >= 8) {
+                if (iOut >= iOutSize)
+                    goto overflow;
+                aOut[iOut++] = (unsigned char)iBits;
+                iBits >>= 8;
+                iNumBits -= 8;
+            }
+        }
+    }
+
+    if (iNumBits > 0) {
+        if (iOut >= iOutSize)
+            goto overflow;
+        aOut[iOut++] = (unsigned char)iBits;
+    }
+
+    return iOut;
+
+overflow:
+    click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+    return -1;
+}
+
+/*
+ * Function:  click_charset_utf16be_encode
+ * Info:      Converts UTF-8 text to UTF-16 big-endian, as sent for UCS-2 messages.
+ *            Characters above U+FFFF are encoded as surrogate pairs.
+ * Inputs:    chText   - UTF-8 text
+ *            iLen     - length of text in bytes
+ *            aOut     - output buffer
+ *            iOutSize - size of output buffer in bytes
+ * Return:    number of bytes written, or -1 if the text is not valid UTF-8 or the output
+ *            buffer is too small
+ */
+long click_charset_utf16be_encode(const char *chText, long iLen, unsigned char *aOut, long iOutSize)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    long iPos = 0, iOut = 0, iCodePoint = 0;
+    int iCharLen = 0;
+
+    if ((chText == NULL && iLen > 0) || iLen < 0 || aOut == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (; iPos < iLen; iPos += iCharLen) {
+        if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0) {
+            click_debug_print("%s ERROR: Invalid UTF-8 at byte %ld!\n", __func__, iPos);
+            return -1;
+        }
+
+        if (iOut + (iCodePoint > 0xffff ? 4 : 2) > iOutSize) {
+            click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+            return -1;
+        }
+
+        if (iCodePoint > 0xffff) {
+            iCodePoint -= 0x10000;
+            aOut[iOut++] = (unsigned char)(0xd8 | (iCodePoint >> 18));
+            aOut[iOut++] = (unsigned char)(iCodePoint >> 10);
+            iCodePoint = 0xdc00 | (iCodePoint & 0x3ff);
+        }
+        aOut[iOut++] = (unsigned char)(iCodePoint >> 8);
+        aOut[iOut++] = (unsigned char)iCodePoint;
+    }
+
+    return iOut;
+}
+
+/*
+ * Function:  click_charset_ucs2_hex_encode
+ * Info:      Converts UTF-8 text to UTF-16 big-endian written as hex digits (4 uppercase
+ *            digits per code unit), as the HTTP API expects the text of Unicode messages.
+ *            Characters above U+FFFF are encoded as surrogate pairs. The text is validated
+ *            as it is converted. With SSE2, 16 byte blocks of ASCII and of 2 byte
+ *            characters (ie. Cyrillic, Greek, Arabic, Hebrew) are converted without
+ *            decoding each character, and hex digits are written 8 code units at a time.
+ *            No memory is allocated, so the digits may be written straight into a request.
+ * Inputs:    chText   - UTF-8 text (need not be NUL terminated)
+ *            iLen     - length of text in bytes
+ *            chOut    - output buffer, which is NUL terminated. 4 bytes per UTF-16 code
+ *                       unit (see ClickCharsetInfo.iUcs2Units) plus 1 are needed.
+ *            iOutSize - size of output buffer in bytes
+ * Return:    number of hex digits written (excluding the NUL), or -1 if the text is not
+ *            valid UTF-8 or the output buffer is too small
+ */
+long click_charset_ucs2_hex_encode(const char *chText, long iLen, char *chOut, long iOutSize)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    unsigned short aUnits[64];
+    long iPos = 0, iOut = 0, iCodePoint = 0;
+    int iUnits = 0, iCharLen = 0;
+
+    if ((chText == NULL && iLen > 0) || iLen < 0 || chOut == NULL || iOutSize < 1) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    while (iPos < iLen) {
+        // flush the hex digits of the units so far once a further 16 units might not fit
+        if (iUnits > 48) {
+            if (iOut + 4L * iUnits >= iOutSize)
+                goto overflow;
+            local_charset_hex_units(aUnits, iUnits, chOut + iOut);
+            iOut  += 4L * iUnits;
+            iUnits = 0;
+        }
+
+#ifdef __SSE2__
+        if (iPos + 16 <= iLen) {
+            __m128i vChunk = _mm_loadu_si128((const __m128i *)(pText + iPos));
+            __m128i vLanes;
+
+            // 16 ASCII characters: zero-extend them to 16 code units
+            if (_mm_movemask_epi8(vChunk) == 0) {
+                _mm_storeu_si128((__m128i *)(aUnits + iUnits), _mm_unpacklo_epi8(vChunk, _mm_setzero_si128()));
+                _mm_storeu_si128((__m128i *)(aUnits + iUnits + 8), _mm_unpackhi_epi8(vChunk, _mm_setzero_si128()));
+                iUnits += 16;
+                iPos   += 16;
+                continue;
+            }
+
+            // 8 whole 2 byte characters: each 16 bit lane holds a lead byte (110xxxxx, not
+            // the overlong C0 or C1) in its low byte and a continuation byte in its high byte
+            vLanes = _mm_and_si128(vChunk, _mm_set1_epi16((short)0xc0e0));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(vLanes, _mm_set1_epi16((short)0x80c0))) == 0xffff &&
+                _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(vChunk, _mm_set1_epi16(0x1e)), _mm_setzero_si128())) == 0) {
+                vLanes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(vChunk, _mm_set1_epi16(0x1f)), 6),
+                                      _mm_and_si128(_mm_srli_epi16(vChunk, 8), _mm_set1_epi16(0x3f)));
+                _mm_storeu_si128((__m128i *)(aUnits + iUnits), vLanes);
+                iUnits += 8;
+                iPos   += 16;
+                continue;
+            }
+        }
+#endif
+        if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0) {
+            click_debug_print("%s ERROR: Invalid UTF-8 at byte %ld!\n", __func__, iPos);
+            return -1;
+        }
+        iPos += iCharLen;
+
+        if (iCodePoint > 0xffff) {
+            iCodePoint -= 0x10000;
+            aUnits[iUnits++] = (unsigned short)(0xd800 | (iCodePoint >> 10));
+            iCodePoint = 0xdc00 | (iCodePoint & 0x3ff);
+        }
+        aUnits[iUnits++] = (unsigned short)iCodePoint;
+    }
+
+    if (iUnits > 0) {
+        if (iOut + 4L * iUnits >= iOutSize)
+            goto overflow;
+        local_charset_hex_units(aUnits, iUnits, chOut + iOut);
+        iOut += 4L * iUnits;
+    }
+    chOut[iOut] = '\0';
+
+    return iOut;
+
+overflow:
+    click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+    return -1;
+}
+
+/*
+ * Function:  click_charset_hex_encode
+ * Info:      Writes binary data as hex digits (2 uppercase digits per octet), as the APIs
+ *            expect the user data and UDH of binary messages. With SSE2, 16 octets are
+ *            converted at a time. No memory is allocated, so the digits may be written
+ *            straight into a request.
+ * Inputs:    aData    - binary data
+ *            iLen     - length of data in octets
+ *            chOut    - output buffer, which is NUL terminated. 2 * 'iLen' + 1 bytes are
+ *                       needed.
+ *            iOutSize - size of output buffer in bytes
+ * Return:    number of hex digits written (excluding the NUL), or -1 if invalid parameter
+ *            or the output buffer is too small
+ */
+long click_charset_hex_encode(const unsigned char *aData, long iLen, char *chOut, long iOutSize)
+{
+    static const char chHexDigits[] = "0123456789ABCDEF";
+    long i = 0;
+#ifdef __SSE2__
+    const __m128i vNibble = _mm_set1_epi8(0x0f), vNine = _mm_set1_epi8(9);
+    const __m128i vZero = _mm_set1_epi8('0'), vAlpha = _mm_set1_epi8('A' - '0' - 10);
+    __m128i vData, vHigh, vLow, vDigits;
+#endif
+
+    if ((aData == NULL && iLen > 0) || iLen < 0 || chOut == NULL || iOutSize < 1) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+    if (iLen > (iOutSize - 1) / 2) {
+        click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+        return -1;
+    }
+
+#ifdef __SSE2__
+    for (; i + 16 <= iLen; i += 16) {
+        // split every octet into its two nibbles, high nibble first
+        vData = _mm_loadu_si128((const __m128i *)(aData + i));
+        vHigh = _mm_and_si128(_mm_srli_epi16(vData, 4), vNibble);
+        vLow  = _mm_and_si128(vData, vNibble);
+
+        vDigits = _mm_unpacklo_epi8(vHigh, vLow);
+        vDigits = _mm_add_epi8(_mm_add_epi8(vDigits, vZero), _mm_and_si128(_mm_cmpgt_epi8(vDigits, vNine), vAlpha));
+        _mm_storeu_si128((__m128i *)(chOut + 2 * i), vDigits);
+
+        vDigits = _mm_unpackhi_epi8(vHigh, vLow);
+        vDigits = _mm_add_epi8(_mm_add_epi8(vDigits, vZero), _mm_and_si128(_mm_cmpgt_epi8(vDigits, vNine), vAlpha));
+        _mm_storeu_si128((__m128i *)(chOut + 2 * i + 16), vDigits);
+    }
+#endif
+
+    for (; i < iLen; i++) {
+        chOut[2 * i]     = chHexDigits[aData[i] >> 4];
+        chOut[2 * i + 1] = chHexDigits[aData[i] & 0xf];
+    }
+    chOut[2 * iLen] = '\0';
+
+    return 2 * iLen;
+}
+
+/*
+ * Function:  click_charset_ucs2_hex_decode
+ * Info:      Converts UTF-16 big-endian written as hex digits (4 digits per code unit, as
+ *            Clickatell delivers the text of Unicode inbound messages) to UTF-8: the
+ *            reverse of click_charset_ucs2_hex_encode(). Surrogate pairs are combined;
+ *            unpaired surrogates become U+FFFD.
+ * Inputs:    chHex    - hex digits, either case (need not be NUL terminated)
+ *            iLen     - number of hex digits, a multiple of 4
+ *            chOut    - output buffer, which is NUL terminated. 3 bytes per 4 digits plus
+ *                       1 are always enough.
+ *            iOutSize - size of output buffer in bytes
+ * Return:    length of the UTF-8 text (excluding the NUL), or -1 if invalid parameter,
+ *            the digits are not UTF-16 hex or the output buffer is too small
+ */
+long click_charset_ucs2_hex_decode(const char *chHex, long iLen, char *chOut, long iOutSize)
+{
+    long i = 0, iOut = 0, iCodePoint = 0;
+    int iLow = 0;
+
+    if ((chHex == NULL && iLen > 0) || iLen < 0 || iLen % 4 != 0 || chOut == NULL || iOutSize < 1) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < iLen; i += 4) {
+        if ((iCodePoint = local_charset_hex_unit(chHex + i)) < 0)
+            return -1;
+
+        if (iCodePoint >= 0xd800 && iCodePoint < 0xe000) {
+            // a high surrogate followed by a low surrogate makes one character
+            if (iCodePoint < 0xdc00 && i + 8 <= iLen && (iLow = local_charset_hex_unit(chHex + i + 4)) >= 0xdc00 &&
+                iLow < 0xe000) {
+                iCodePoint = 0x10000 + ((iCodePoint - 0xd800) << 10) + (iLow - 0xdc00);
+                i += 4;
+            }
+            else
+                iCodePoint = 0xfffd;
+        }
+
+        if (iOut + 4 >= iOutSize)
+            goto overflow;
+        iOut += local_charset_utf8_encode(iCodePoint, chOut + iOut);
+    }
+    chOut[iOut] = '\0';
+
+    return iOut;
+
+overflow:
+    click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+    return -1;
+}
+
+/*
+ * Function:  click_charset_latin1_decode
+ * Info:      Converts ISO-8859-1 text (as Clickatell delivers the text of some inbound
+ *            messages) to UTF-8. Runs of ASCII are copied as they are.
+ * Inputs:    chText   - ISO-8859-1 text (need not be NUL terminated)
+ *            iLen     - length of text in bytes
+ *            chOut    - output buffer, which is NUL terminated. 2 * 'iLen' + 1 bytes are
+ *                       always enough.
+ *            iOutSize - size of output buffer in bytes
+ * Return:    length of the UTF-8 text (excluding the NUL), or -1 if invalid parameter or
+ *            the output buffer is too small
+ */
+long click_charset_latin1_decode(const char *chText, long iLen, char *chOut, long iOutSize)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    long iPos = 0, iOut = 0, iRun = 0;
+
+    if ((chText == NULL && iLen > 0) || iLen < 0 || chOut == NULL || iOutSize < 1) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    while (iPos < iLen) {
+        iRun = click_charset_ascii_span(chText + iPos, iLen - iPos);
+        if (iOut + iRun >= iOutSize)
+            goto overflow;
+        memcpy(chOut + iOut, chText + iPos, iRun);
+        iOut += iRun;
+        iPos += iRun;
+
+        if (iPos < iLen) {
+            if (iOut + 2 >= iOutSize)
+                goto overflow;
+            chOut[iOut++] = (char)(0xc0 | pText[iPos] >> 6);
+            chOut[iOut++] = (char)(0x80 | (pText[iPos] & 0x3f));
+            iPos++;
+        }
+    }
+    chOut[iOut] = '\0';
+
+    return iOut;
+
+overflow:
+    click_debug_print("%s ERROR: Output buffer of %ld bytes is too small!\n", __func__, iOutSize);
+    return -1;
+}
+
+/*
+ * Function:  click_charset_transliterate
+ * Info:      Replaces characters which are not in the GSM 03.38 alphabet with close
+ *            equivalents which are (ie. curly quotes with straight quotes, dashes with '-',
+ *            '\xe2\x80\xa6' with "...", accented letters without GSM 03.38 forms with the
+ *            letter), so that text which needed UCS-2 for a few such characters can be sent
+ *            as GSM 7-bit. Characters without an equivalent (ie. Cyrillic) are kept as they
+ *            are. Runs of ASCII are copied as they are; other characters are looked up in
+ *            a table, and their replacements copied with fixed-size copies.
+ * Inputs:    chText    - UTF-8 text
+ *            iLen      - length of text in bytes
+ *            iOutSize  - size of chOut, at least CLICK_CHARSET_TRANSLIT_SIZE(iLen)
+ * Outputs:   chOut     - transliterated UTF-8 text, NUL terminated
+ *            iReplaced - number of characters replaced. May be NULL.
+ * Return:    length of the transliterated text in bytes, or -1 if invalid parameter, the
+ *            output buffer is too small or the text is not valid UTF-8
+ */
+long click_charset_transliterate(const char *chText, long iLen, char *chOut, long iOutSize, long *iReplaced)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    const LocalTranslitEntry *oEntry = NULL;
+    long iPos = 0, iOut = 0, iRun = 0, iCodePoint = 0, iCount = 0;
+    int iCharLen = 0;
+
+    if (chText == NULL || chOut == NULL || iLen < 0 || iOutSize < CLICK_CHARSET_TRANSLIT_SIZE(iLen)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    // the output can not overflow: each character's output fits in the worst case size
+    while (iPos < iLen) {
+        iRun = click_charset_ascii_span(chText + iPos, iLen - iPos);
+        memcpy(chOut + iOut, chText + iPos, iRun);
+        iCount += local_charset_translit_ascii(chOut + iOut, iRun);
+        iPos += iRun;
+        iOut += iRun;
+
+        if (iPos >= iLen)
+            break;
+
+        if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0) {
+            click_debug_print("%s ERROR: Text is not valid UTF-8 at byte %ld!\n", __func__, iPos);
+            return -1;
+        }
+
+        if ((oEntry = local_charset_translit_entry(iCodePoint)) != NULL) {
+            memcpy(chOut + iOut, oEntry->chText, sizeof(oEntry->chText));
+            iOut += oEntry->iLen - 1;
+            iCount++;
+        }
+        else {
+            memcpy(chOut + iOut, chText + iPos, iCharLen);
+            iOut += iCharLen;
+        }
+        iPos += iCharLen;
+    }
+
+    chOut[iOut] = '\0';
+    if (iReplaced != NULL)
+        *iReplaced = iCount;
+
+    return iOut;
+}
@@ -0,0 +1,60 @@
+#ifndef CLICKATELL_CHARSET_H
+#define CLICKATELL_CHARSET_H
+
+/*
+ * clickatell_charset.h
+ *
+ *  GSM 03.38 character set module used by the Clickatell SMS library.
+ *
+ *  Classifies UTF-8 message text as either GSM 7-bit (the GSM 03.38 default alphabet plus
+ *  its extension table) or Unicode (UCS-2), counts the septets or UCS-2 code units the text
+ *  occupies, packs GSM 7-bit text into octets for binary sending, and converts Unicode text
+ *  to UCS-2 (as octets, or as the hex digits the HTTP API expects); the data of binary
+ *  messages is written as hex digits too. Text can also be transliterated to GSM 03.38
+ *  (ie. curly quotes to straight quotes), so that a few stray characters do not force a
+ *  message into UCS-2. Runs of ASCII text, UTF-8 validation and hex encoding are handled
+ *  16 bytes at a time with SSE2 where available, falling back to a portable scalar loop
+ *  elsewhere.
+ */
+
+// Enumeration of message character sets
+typedef enum eClickCharset {
+    CLICK_CHARSET_GSM7,     // every character is in the GSM 03.38 default alphabet or extension table
+    CLICK_CHARSET_UCS2,     // valid UTF-8 which needs Unicode (UCS-2) encoding
+    CLICK_CHARSET_INVALID,  // not valid UTF-8
+    CLICK_CHARSET_COUNT     // count of character sets
+} eClickCharset;
+
+// GSM 03.38 escape septet which precedes characters from the extension table
+#define CLICK_CHARSET_GSM7_ESCAPE   0x1B
+
+// flag returned by click_charset_gsm7_lookup() for characters from the extension table
+#define CLICK_CHARSET_GSM7_EXT      0x100
+
+// size of the output buffer click_charset_transliterate() needs for iLen bytes of text
+#define CLICK_CHARSET_TRANSLIT_SIZE(iLen)   ((iLen) + (iLen) / 2 + 4)
+
+// Characters of a message, as counted by click_charset_classify()
+typedef struct ClickCharsetInfo {
+    eClickCharset eCharset; // character set the message needs
+    long iChars;            // number of Unicode characters (code points)
+    long iSeptets;          // GSM 7-bit septets, counting extension characters twice (GSM7 only)
+    long iUcs2Units;        // UTF-16 code units, counting characters above U+FFFF twice
+} ClickCharsetInfo;
+
+// function declarations
+int click_charset_utf8_decode(const unsigned char *pText, long iLen, long *iCodePoint);
+int click_charset_gsm7_lookup(long iCodePoint);
+eClickCharset click_charset_classify(const char *chText, long iLen, ClickCharsetInfo *oInfo);
+long click_charset_ascii_span(const char *chText, long iLen);
+long click_charset_utf8_validate(const char *chText, long iLen);
+long click_charset_gsm7_packed_len(long iSeptets, int iFillBits);
+long click_charset_gsm7_pack(const char *chText, long iLen, int iFillBits, unsigned char *aOut, long iOutSize);
+long click_charset_utf16be_encode(const char *chText, long iLen, unsigned char *aOut, long iOutSize);
+long click_charset_ucs2_hex_encode(const char *chText, long iLen, char *chOut, long iOutSize);
+long click_charset_hex_encode(const unsigned char *aData, long iLen, char *chOut, long iOutSize);
+long click_charset_ucs2_hex_decode(const char *chHex, long iLen, char *chOut, long iOutSize);
+long click_charset_latin1_decode(const char *chText, long iLen, char *chOut, long iOutSize);
+long click_charset_transliterate(const char *chText, long iLen, char *chOut, long iOutSize, long *iReplaced);
+
+#endif // CLICKATELL_CHARSET_H
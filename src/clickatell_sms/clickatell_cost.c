@@ -0,0 +1,538 @@
+/*
+ * clickatell_cost.c
+ *
+ *  Campaign cost estimation module: prices recipient lists from a local prefix price
+ *  table and counts the parts of each recipient's message, in parallel. See
+ *  clickatell_cost.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_segment.h"
+#include "clickatell_cost.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// longest prefix of a price table: a whole E.164 number
+#define LOCAL_PRICE_PREFIX_MAX      15
+
+// initial nodes of a price table
+#define LOCAL_PRICE_NODES_MIN       64
+
+// fewest recipients worth a thread of their own, and most threads of an estimate
+#define LOCAL_COST_THREAD_MIN       16384
+#define LOCAL_COST_THREADS_MAX      64
+
+// One digit of a price table prefix tree
+typedef struct LocalPriceNode {
+    int aChild[10];         // node of each next digit, or 0 if none (the root is never a child)
+    long long iPrice;       // price per part in CLICK_COST_UNITS of the prefix ending here, or -1 if none
+} LocalPriceNode;
+
+// internal structure (hidden from public access) of a price table
+struct ClickPriceTable {
+    int iNumNodes;          // nodes in use
+    int iNodesSize;         // allocated nodes
+    LocalPriceNode *aNodes; // prefix tree, aNodes[0] is the root (the empty prefix)
+};
+
+// A range of recipients estimated by one thread
+typedef struct LocalCostWork {
+    const ClickPriceTable *oPrices;     // price table
+    const ClickRecipients *oRecipients; // recipient list
+    const ClickTemplate *oTemplate;     // template rendered per recipient, or NULL for a single text
+    const char *const *aValues;         // template only: values of all recipients
+    const long *aValueLens;             // template only: lengths of the values, or NULL
+    int iNumValues;                     // template only: values per recipient
+    ClickSegmentInfo oText;             // single text only: part count of the text (iParts -1 if invalid)
+    long iFirst;                        // first recipient of the range
+    long iEnd;                          // recipient after the range
+    int *aParts;                        // parts of each recipient, or NULL
+    double *aCosts;                     // cost of each recipient, or NULL
+    long long iCost;                    // total cost of the range in CLICK_COST_UNITS
+    ClickCostEstimate oEstimate;        // totals of the range (fCost unused)
+    int iResult;                        // 0 if successful, else -1
+} LocalCostWork;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static long long local_price_find(const ClickPriceTable *oPrices, const char *chNumber, long iLen);
+static void local_cost_recipient_add(LocalCostWork *oWork, long iIndex, const ClickSegmentInfo *oInfo, int iParts);
+static void *local_cost_work_run(void *pWork);
+static int local_cost_run(LocalCostWork *oTemplateWork, int iThreads, ClickCostEstimate *oEstimate);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_price_find
+ * Info:      Finds the price of a number by its longest matching prefix.
+ * Inputs:    oPrices  - price table
+ *            chNumber - E.164 digits of the number
+ *            iLen     - count of digits
+ * Return:    price per part in CLICK_COST_UNITS, or -1 if no prefix matches
+ */
+static long long local_price_find(const ClickPriceTable *oPrices, const char *chNumber, long iLen)
+{
+    const LocalPriceNode *aNodes = oPrices->aNodes;
+    long long iPrice = aNodes[0].iPrice;
+    unsigned int iDigit = 0;
+    int iNode = 0;
+    long i = 0;
+
+    for (i = 0; i < iLen; i++) {
+        if ((iDigit = (unsigned char)chNumber[i] - '0') > 9 || (iNode = aNodes[iNode].aChild[iDigit]) == 0)
+            break;
+        if (aNodes[iNode].iPrice >= 0)
+            iPrice = aNodes[iNode].iPrice;
+    }
+
+    return iPrice;
+}
+
+/*
+ * Function:  local_cost_recipient_add
+ * Info:      Prices one recipient's message and adds it to the totals of a range.
+ * Inputs:    oWork  - range being estimated
+ *            iIndex - index of the recipient
+ *            oInfo  - part count of the recipient's message
+ *            iParts - parts of the message, or -1 if its text is not valid UTF-8
+ * Return:    void
+ */
+static void local_cost_recipient_add(LocalCostWork *oWork, long iIndex, const ClickSegmentInfo *oInfo, int iParts)
+{
+    const ClickRecipients *oRecipients = oWork->oRecipients;
+    ClickCostEstimate *oEstimate = &oWork->oEstimate;
+    long iOffset = oRecipients->aOffsets[iIndex];
+    long long iPrice = 0;
+
+    if (iParts < 0) {
+        oEstimate->iInvalid++;
+        iParts = 0;
+    }
+    else if (oInfo->eCharset == CLICK_CHARSET_GSM7)
+        oEstimate->iGsm7++;
+    else
+        oEstimate->iUcs2++;
+
+    if ((iPrice = local_price_find(oWork->oPrices, oRecipients->oDigits.data + iOffset,
+                                   oRecipients->aOffsets[iIndex + 1] - 1 - iOffset)) < 0)
+    {
+        oEstimate->iUnpriced++;
+        iPrice = 0;
+    }
+
+    oEstimate->iParts += iParts;
+    if (iParts < oEstimate->iMinParts)
+        oEstimate->iMinParts = iParts;
+    if (iParts > oEstimate->iMaxParts)
+        oEstimate->iMaxParts = iParts;
+    oWork->iCost += iPrice * iParts;
+
+    if (oWork->aParts != NULL)
+        oWork->aParts[iIndex] = iParts;
+    if (oWork->aCosts != NULL)
+        oWork->aCosts[iIndex] = (double)(iPrice * iParts) / CLICK_COST_UNITS;
+}
+
+/*
+ * Function:  local_cost_work_run
+ * Info:      Estimates a range of recipients (pthread start routine).
+ * Inputs:    pWork - LocalCostWork of the range
+ * Return:    pWork
+ */
+static void *local_cost_work_run(void *pWork)
+{
+    LocalCostWork *oWork = (LocalCostWork *)pWork;
+    ClickSmsBuffer oText;
+    ClickSegmentInfo oInfo;
+    const char *const *aValues = NULL;
+    const long *aValueLens = NULL;
+    long i = 0;
+
+    memset(&oText, 0, sizeof(oText));
+
+    for (i = oWork->iFirst; i < oWork->iEnd; i++) {
+        if (oWork->oTemplate == NULL) {
+            local_cost_recipient_add(oWork, i, &oWork->oText, oWork->oText.iParts);
+            continue;
+        }
+
+        if (oWork->iNumValues > 0) {
+            aValues    = oWork->aValues + i * oWork->iNumValues;
+            aValueLens = (oWork->aValueLens != NULL ? oWork->aValueLens + i * oWork->iNumValues : NULL);
+        }
+        click_buffer_reset(&oText);
+        if (click_template_render(oWork->oTemplate, aValues, aValueLens, CLICK_ENCODING_RAW, &oText) != 0) {
+            oWork->iResult = -1;
+            break;
+        }
+        local_cost_recipient_add(oWork, i, &oInfo, click_segment_count(oText.data, oText.iLen, &oInfo));
+    }
+
+    click_buffer_free(&oText);
+
+    return pWork;
+}
+
+/*
+ * Function:  local_cost_run
+ * Info:      Divides a list between threads, estimates each range and adds up the totals.
+ *            The calling thread estimates the first range itself.
+ * Inputs:    oTemplateWork - the estimate, with every field but the range and totals set
+ *            iThreads      - threads to use, or 0 for one per online core
+ * Outputs:   oEstimate     - totals of the list
+ * Return:    0 if successful, else -1 if failed to allocate memory
+ */
+static int local_cost_run(LocalCostWork *oTemplateWork, int iThreads, ClickCostEstimate *oEstimate)
+{
+    LocalCostWork aWork[LOCAL_COST_THREADS_MAX];
+    pthread_t aThreads[LOCAL_COST_THREADS_MAX];
+    int bStarted[LOCAL_COST_THREADS_MAX];
+    long iNum = oTemplateWork->oRecipients->iNum, iMaxThreads = 0;
+    long long iCost = 0;
+    int i = 0, iResult = 0;
+
+    if (iThreads <= 0)
+        iThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    iMaxThreads = iNum / LOCAL_COST_THREAD_MIN;
+    if (iThreads > iMaxThreads)
+        iThreads = (int)iMaxThreads;
+    if (iThreads > LOCAL_COST_THREADS_MAX)
+        iThreads = LOCAL_COST_THREADS_MAX;
+    if (iThreads < 1)
+        iThreads = 1;
+
+    for (i = 0; i < iThreads; i++) {
+        aWork[i] = *oTemplateWork;
+        aWork[i].iFirst = iNum * i / iThreads;
+        aWork[i].iEnd   = iNum * (i + 1) / iThreads;
+        aWork[i].oEstimate.iMinParts = INT_MAX;
+        bStarted[i] = 0;
+    }
+
+    // a range whose thread cannot be started is estimated by the calling thread
+    for (i = 1; i < iThreads; i++)
+        bStarted[i] = (pthread_create(&aThreads[i], NULL, local_cost_work_run, &aWork[i]) == 0);
+    local_cost_work_run(&aWork[0]);
+    for (i = 1; i < iThreads; i++) {
+        if (bStarted[i])
+            pthread_join(aThreads[i], NULL);
+        else
+            local_cost_work_run(&aWork[i]);
+    }
+
+    memset(oEstimate, 0, sizeof(ClickCostEstimate));
+    oEstimate->iRecipients = iNum;
+    oEstimate->iMinParts   = INT_MAX;
+    for (i = 0; i < iThreads; i++) {
+        iResult |= aWork[i].iResult;
+        iCost   += aWork[i].iCost;
+        oEstimate->iUnpriced += aWork[i].oEstimate.iUnpriced;
+        oEstimate->iInvalid  += aWork[i].oEstimate.iInvalid;
+        oEstimate->iGsm7     += aWork[i].oEstimate.iGsm7;
+        oEstimate->iUcs2     += aWork[i].oEstimate.iUcs2;
+        oEstimate->iParts    += aWork[i].oEstimate.iParts;
+        if (aWork[i].oEstimate.iMinParts < oEstimate->iMinParts)
+            oEstimate->iMinParts = aWork[i].oEstimate.iMinParts;
+        if (aWork[i].oEstimate.iMaxParts > oEstimate->iMaxParts)
+            oEstimate->iMaxParts = aWork[i].oEstimate.iMaxParts;
+    }
+    if (iNum == 0)
+        oEstimate->iMinParts = 0;
+    oEstimate->fCost = (double)iCost / CLICK_COST_UNITS;
+
+    if (iResult != 0) {
+        click_debug_print("%s ERROR: Failed to allocate memory for rendered text!\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_price_table_create
+ * Info:      Creates an empty price table.
+ *            Note that the calling function must destroy the returned table.
+ * Return:    price table, or NULL if failed to allocate memory
+ */
+ClickPriceTable *click_price_table_create(void)
+{
+    ClickPriceTable *oPrices = NULL;
+
+    if ((oPrices = (ClickPriceTable *)calloc(1, sizeof(ClickPriceTable))) == NULL ||
+        (oPrices->aNodes = (LocalPriceNode *)calloc(LOCAL_PRICE_NODES_MIN, sizeof(LocalPriceNode))) == NULL)
+    {
+        click_debug_print("%s ERROR: Failed to allocate memory for price table!\n", __func__);
+        free(oPrices);
+        return NULL;
+    }
+    oPrices->iNodesSize = LOCAL_PRICE_NODES_MIN;
+    oPrices->iNumNodes  = 1;
+    oPrices->aNodes[0].iPrice = -1;
+
+    return oPrices;
+}
+
+/*
+ * Function:  click_price_table_destroy
+ * Info:      Destroys a price table.
+ * Inputs:    oPrices - price table to destroy
+ * Return:    void
+ */
+void click_price_table_destroy(ClickPriceTable *oPrices)
+{
+    if (oPrices == NULL)
+        return;
+
+    free(oPrices->aNodes);
+    free(oPrices);
+}
+
+/*
+ * Function:  click_price_table_add
+ * Info:      Sets the price per part of numbers starting with a prefix, replacing any
+ *            price already set for the prefix. The empty prefix sets the price of numbers
+ *            matching no other prefix.
+ * Inputs:    oPrices  - price table
+ *            chPrefix - digits the numbers start with, optionally after a '+'
+ *            fPrice   - price per part (rounded to 1/CLICK_COST_UNITS)
+ * Return:    0 if successful, else -1 if invalid parameter or failed to allocate memory
+ */
+int click_price_table_add(ClickPriceTable *oPrices, const char *chPrefix, double fPrice)
+{
+    LocalPriceNode *aNodes = NULL;
+    unsigned int iDigit = 0;
+    int iNode = 0, iSize = 0;
+    const char *pDigit = NULL;
+
+    if (oPrices == NULL || chPrefix == NULL || !(fPrice >= 0.0) || fPrice * CLICK_COST_UNITS > (double)LLONG_MAX / 256) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+    if (*chPrefix == '+')
+        chPrefix++;
+    for (pDigit = chPrefix; *pDigit != '\0'; pDigit++) {
+        if (*pDigit < '0' || *pDigit > '9' || pDigit - chPrefix >= LOCAL_PRICE_PREFIX_MAX) {
+            click_debug_print("%s ERROR: Invalid prefix '%s'!\n", __func__, chPrefix);
+            return -1;
+        }
+    }
+
+    for (pDigit = chPrefix; *pDigit != '\0'; pDigit++) {
+        iDigit = *pDigit - '0';
+        if (oPrices->aNodes[iNode].aChild[iDigit] == 0) {
+            if (oPrices->iNumNodes == oPrices->iNodesSize) {
+                iSize = oPrices->iNodesSize * 2;
+                if ((aNodes = (LocalPriceNode *)realloc(oPrices->aNodes, iSize * sizeof(LocalPriceNode))) == NULL) {
+                    click_debug_print("%s ERROR: Failed to allocate memory for price table!\n", __func__);
+                    return -1;
+                }
+                oPrices->aNodes     = aNodes;
+                oPrices->iNodesSize = iSize;
+            }
+            memset(&oPrices->aNodes[oPrices->iNumNodes], 0, sizeof(LocalPriceNode));
+            oPrices->aNodes[oPrices->iNumNodes].iPrice = -1;
+            oPrices->aNodes[iNode].aChild[iDigit] = oPrices->iNumNodes++;
+        }
+        iNode = oPrices->aNodes[iNode].aChild[iDigit];
+    }
+    oPrices->aNodes[iNode].iPrice = (long long)(fPrice * CLICK_COST_UNITS + 0.5);
+
+    return 0;
+}
+
+/*
+ * Function:  click_price_table_parse
+ * Info:      Adds the prices of a text price table, one "prefix,price" line per prefix
+ *            (ie. "27,0.75" or "+2782;0.8"). The prefix and price may be separated by ',',
+ *            ';', tabs or spaces; a '*' prefix sets the price of numbers matching no other
+ *            prefix. Empty lines and lines starting with '#' are skipped.
+ * Inputs:    oPrices - price table
+ *            chTable - price table text (need not be NUL terminated)
+ *            iLen    - length of text
+ * Return:    number of prices added, or -1 if invalid parameter, a line is not a valid
+ *            price, or failed to allocate memory
+ */
+long click_price_table_parse(ClickPriceTable *oPrices, const char *chTable, long iLen)
+{
+    const char *pLine = chTable, *pEnd = chTable + iLen, *pEol = NULL, *pField = NULL;
+    char chPrefix[LOCAL_PRICE_PREFIX_MAX + 2], chPrice[32], *pParsed = NULL;
+    long iAdded = 0, iLine = 0, iFieldLen = 0;
+    double fPrice = 0.0;
+
+    if (oPrices == NULL || chTable == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for ( ; pLine < pEnd; pLine = pEol + 1) {
+        iLine++;
+        if ((pEol = memchr(pLine, '\n', pEnd - pLine)) == NULL)
+            pEol = pEnd;
+
+        while (pLine < pEol && (*pLine == ' ' || *pLine == '\t' || *pLine == '\r'))
+            pLine++;
+        if (pLine == pEol || *pLine == '#')
+            continue;
+
+        // prefix
+        for (pField = pLine; pLine < pEol && strchr(",; \t\r", *pLine) == NULL; pLine++)
+            ;
+        iFieldLen = pLine - pField;
+        if (iFieldLen >= (long)sizeof(chPrefix))
+            goto invalid;
+        memcpy(chPrefix, pField, iFieldLen);
+        chPrefix[iFieldLen] = '\0';
+        if (strcmp(chPrefix, "*") == 0)
+            chPrefix[0] = '\0';
+        else if (iFieldLen == 0)
+            goto invalid;
+
+        // price
+        while (pLine < pEol && strchr(",; \t\r", *pLine) != NULL)
+            pLine++;
+        for (pField = pLine; pLine < pEol && strchr(" \t\r", *pLine) == NULL; pLine++)
+            ;
+        iFieldLen = pLine - pField;
+        if (iFieldLen == 0 || iFieldLen >= (long)sizeof(chPrice))
+            goto invalid;
+        memcpy(chPrice, pField, iFieldLen);
+        chPrice[iFieldLen] = '\0';
+        fPrice = strtod(chPrice, &pParsed);
+        if (*pParsed != '\0')
+            goto invalid;
+
+        if (click_price_table_add(oPrices, chPrefix, fPrice) != 0)
+            return -1;
+        iAdded++;
+    }
+
+    return iAdded;
+
+invalid:
+    click_debug_print("%s ERROR: Invalid price on line %ld!\n", __func__, iLine);
+    return -1;
+}
+
+/*
+ * Function:  click_price_table_lookup
+ * Info:      Returns the price per part of a number, by its longest matching prefix.
+ * Inputs:    oPrices  - price table
+ *            chNumber - E.164 digits of the number (need not be NUL terminated)
+ *            iLen     - count of digits
+ * Return:    price per part, or -1.0 if invalid parameter or no prefix matches
+ */
+double click_price_table_lookup(const ClickPriceTable *oPrices, const char *chNumber, long iLen)
+{
+    long long iPrice = 0;
+
+    if (oPrices == NULL || chNumber == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1.0;
+    }
+
+    if ((iPrice = local_price_find(oPrices, chNumber, iLen)) < 0)
+        return -1.0;
+
+    return (double)iPrice / CLICK_COST_UNITS;
+}
+
+/*
+ * Function:  click_cost_estimate
+ * Info:      Estimates the parts and cost of sending one text to every recipient of a
+ *            list. The text's parts are counted once; each recipient is then priced by
+ *            its longest matching prefix, spread over 'iThreads' threads.
+ * Inputs:    oPrices     - price table
+ *            oRecipients - recipient list
+ *            chText      - UTF-8 message text (need not be NUL terminated)
+ *            iLen        - length of text in bytes, or -1 if it is NUL terminated
+ *            iThreads    - threads to use, or 0 for one per online core. Lists too short
+ *                          to benefit use fewer.
+ * Outputs:   oEstimate   - totals of the list
+ *            aParts      - parts of each recipient, in list order. May be NULL.
+ *            aCosts      - cost of each recipient, in list order. May be NULL.
+ * Return:    0 if successful, else -1 if invalid parameter
+ */
+int click_cost_estimate(const ClickPriceTable *oPrices, const ClickRecipients *oRecipients, const char *chText,
+                        long iLen, int iThreads, ClickCostEstimate *oEstimate, int *aParts, double *aCosts)
+{
+    LocalCostWork oWork;
+
+    if (oPrices == NULL || oRecipients == NULL || chText == NULL || oEstimate == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    memset(&oWork, 0, sizeof(oWork));
+    oWork.oPrices     = oPrices;
+    oWork.oRecipients = oRecipients;
+    oWork.aParts      = aParts;
+    oWork.aCosts      = aCosts;
+    oWork.oText.iParts = click_segment_count(chText, (iLen < 0 ? (long)strlen(chText) : iLen), &oWork.oText);
+
+    return local_cost_run(&oWork, iThreads, oEstimate);
+}
+
+/*
+ * Function:  click_cost_estimate_template
+ * Info:      Estimates the parts and cost of sending a personalised message to every
+ *            recipient of a list. Each recipient's message is rendered from the template
+ *            into a buffer of its thread and its parts counted, so each recipient's
+ *            values decide whether it is sent in GSM 7-bit or UCS-2 and how many parts
+ *            it needs.
+ * Inputs:    oPrices     - price table
+ *            oRecipients - recipient list
+ *            oTemplate   - compiled template
+ *            aValues     - values of every recipient, in list order: the values of
+ *                          recipient i start at aValues[i * n], where n is the count of
+ *                          the template's names. A NULL value renders as empty text.
+ *            aValueLens  - lengths of the values in the same order, or NULL if they are
+ *                          NUL terminated
+ *            iThreads    - threads to use, or 0 for one per online core. Lists too short
+ *                          to benefit use fewer.
+ * Outputs:   oEstimate   - totals of the list
+ *            aParts      - parts of each recipient, in list order. May be NULL.
+ *            aCosts      - cost of each recipient, in list order. May be NULL.
+ * Return:    0 if successful, else -1 if invalid parameter or failed to allocate memory
+ */
+int click_cost_estimate_template(const ClickPriceTable *oPrices, const ClickRecipients *oRecipients,
+                                 const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens,
+                                 int iThreads, ClickCostEstimate *oEstimate, int *aParts, double *aCosts)
+{
+    LocalCostWork oWork;
+
+    if (oPrices == NULL || oRecipients == NULL || oTemplate == NULL || oEstimate == NULL ||
+        (click_template_num_values(oTemplate) > 0 && aValues == NULL))
+    {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    memset(&oWork, 0, sizeof(oWork));
+    oWork.oPrices     = oPrices;
+    oWork.oRecipients = oRecipients;
+    oWork.oTemplate   = oTemplate;
+    oWork.aValues     = aValues;
+    oWork.aValueLens  = aValueLens;
+    oWork.iNumValues  = click_template_num_values(oTemplate);
+    oWork.aParts      = aParts;
+    oWork.aCosts      = aCosts;
+
+    return local_cost_run(&oWork, iThreads, oEstimate);
+}
@@ -0,0 +1,55 @@
+#ifndef CLICKATELL_COST_H
+#define CLICKATELL_COST_H
+
+/*
+ * clickatell_cost.h
+ *
+ *  Campaign cost estimation module used by the Clickatell SMS library.
+ *
+ *  Calculates, before anything is sent, how many parts (SMSes) a message costs each
+ *  recipient of a ClickRecipients list and what that comes to, from a local price table.
+ *  A price table maps number prefixes (ie. "27" for South Africa, "2782" for one of its
+ *  networks) to a price per part; each number is priced by its longest matching prefix.
+ *  Prices are kept in millionths, so totals are exact and do not depend on how the work
+ *  was divided between threads.
+ *
+ *  The message is either one text, which costs every recipient the same parts, or a
+ *  compiled template rendered with each recipient's values. Large lists are divided
+ *  between threads, one per core by default. Price tables, lists and templates are only
+ *  read, so several estimates may run at once.
+ */
+
+#include "clickatell_recipients.h"
+#include "clickatell_template.h"
+
+#define CLICK_COST_UNITS 1000000 // price table resolution: millionths of a price unit
+
+// price table (opaque)
+typedef struct ClickPriceTable ClickPriceTable;
+
+// totals of an estimate, as calculated by click_cost_estimate()
+typedef struct ClickCostEstimate {
+    long iRecipients;       // recipients estimated
+    long iUnpriced;         // recipients matching no prefix of the price table (costed at 0)
+    long iInvalid;          // recipients whose text is not valid UTF-8 (0 parts, costed at 0)
+    long iGsm7;             // recipients whose message is sent in GSM 7-bit
+    long iUcs2;             // recipients whose message is sent in UCS-2
+    long long iParts;       // total parts (SMSes) of all recipients
+    int  iMinParts;         // fewest parts of any recipient's message
+    int  iMaxParts;         // most parts of any recipient's message
+    double fCost;           // total estimated cost
+} ClickCostEstimate;
+
+// function declarations
+ClickPriceTable *click_price_table_create(void);
+void click_price_table_destroy(ClickPriceTable *oPrices);
+int click_price_table_add(ClickPriceTable *oPrices, const char *chPrefix, double fPrice);
+long click_price_table_parse(ClickPriceTable *oPrices, const char *chTable, long iLen);
+double click_price_table_lookup(const ClickPriceTable *oPrices, const char *chNumber, long iLen);
+int click_cost_estimate(const ClickPriceTable *oPrices, const ClickRecipients *oRecipients, const char *chText,
+                        long iLen, int iThreads, ClickCostEstimate *oEstimate, int *aParts, double *aCosts);
+int click_cost_estimate_template(const ClickPriceTable *oPrices, const ClickRecipients *oRecipients,
+                                 const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens,
+                                 int iThreads, ClickCostEstimate *oEstimate, int *aParts, double *aCosts);
+
+#endif // CLICKATELL_COST_H
@@ -16,6 +16,7 @@
  * Local variables                                                               *
  * ----------------------------------------------------------------------------- */
 
+// accessed atomically, since the library may be initialized and used from several threads at once
 static eClickDebugOption eLocalDebugOpt = CLICK_DEBUG_OFF;
 static int iDebugInitialized = 0;
 
@@ -33,8 +34,8 @@ static int iDebugInitialized = 0;
 void click_debug_init(eClickDebugOption eDebugOption)
 {
     if (eDebugOption >= 0 && eDebugOption < CLICK_DEBUG_COUNT) {
-        eLocalDebugOpt = eDebugOption;
-        iDebugInitialized = 1;
+        __atomic_store_n(&eLocalDebugOpt, eDebugOption, __ATOMIC_RELAXED);
+        __atomic_store_n(&iDebugInitialized, 1, __ATOMIC_RELEASE);
     }
 }
 
@@ -50,7 +51,8 @@ void click_debug_init(eClickDebugOption eDebugOption)
  */
 void click_debug_print(const char *chFormat, ...)
 {
-    if (iDebugInitialized == 0 || chFormat == NULL || eLocalDebugOpt != CLICK_DEBUG_ON)
+    if (__atomic_load_n(&iDebugInitialized, __ATOMIC_ACQUIRE) == 0 || chFormat == NULL ||
+        __atomic_load_n(&eLocalDebugOpt, __ATOMIC_RELAXED) != CLICK_DEBUG_ON)
         return;
 
     va_list argList;
@@ -0,0 +1,238 @@
+/*
+ * clickatell_mo.c
+ *
+ *  Inbound (MO) message module: a bounded lock-free queue of fixed-size inbound messages.
+ *  See clickatell_mo.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_mo.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// padding which keeps the producers' and consumers' positions on separate cache lines
+#define LOCAL_MO_CACHE_LINE 64
+
+// One slot of the queue. Its sequence number says whose turn it is: it equals the
+// position a producer may fill it at, and that position plus 1 once it may be popped.
+typedef struct LocalMoSlot {
+    unsigned long iSeq;
+    ClickMoMessage oMessage;
+} LocalMoSlot;
+
+// internal structure (hidden from public access) of an inbound message queue
+struct ClickMoQueue {
+    unsigned long iMask;        // number of slots - 1 (a power of 2 - 1)
+    LocalMoSlot *aSlots;        // slots, allocated when the queue is created
+    char aPad0[LOCAL_MO_CACHE_LINE];
+    unsigned long iEnqueue;     // next position to push at
+    char aPad1[LOCAL_MO_CACHE_LINE];
+    unsigned long iDequeue;     // next position to pop from
+    char aPad2[LOCAL_MO_CACHE_LINE];
+};
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_mo_queue_create
+ * Info:      Creates an inbound message queue, allocating all of its slots.
+ *            Note that the calling function must destroy the returned queue.
+ * Inputs:    iCapacity - number of messages the queue holds, rounded up to a power of 2
+ * Return:    new queue, or NULL if invalid parameter or failed to allocate memory
+ */
+ClickMoQueue *click_mo_queue_create(long iCapacity)
+{
+    ClickMoQueue *oQueue = NULL;
+    unsigned long iSlots = 2, i = 0;
+
+    if (iCapacity < 1 || iCapacity > (1L << 24)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+    while (iSlots < (unsigned long)iCapacity)
+        iSlots <<= 1;
+
+    if ((oQueue = (ClickMoQueue *)calloc(1, sizeof(ClickMoQueue))) == NULL ||
+        (oQueue->aSlots = (LocalMoSlot *)malloc(iSlots * sizeof(LocalMoSlot))) == NULL)
+    {
+        click_debug_print("%s ERROR: Failed to allocate memory for %lu messages!\n", __func__, iSlots);
+        free(oQueue);
+        return NULL;
+    }
+
+    oQueue->iMask = iSlots - 1;
+    for (i = 0; i < iSlots; i++)
+        oQueue->aSlots[i].iSeq = i;
+
+    return oQueue;
+}
+
+/*
+ * Function:  click_mo_queue_destroy
+ * Info:      Frees an inbound message queue and any messages left in it.
+ * Inputs:    oQueue - queue to destroy
+ * Return:    void
+ */
+void click_mo_queue_destroy(ClickMoQueue *oQueue)
+{
+    if (oQueue == NULL)
+        return;
+
+    free(oQueue->aSlots);
+    free(oQueue);
+}
+
+/*
+ * Function:  click_mo_queue_reserve
+ * Info:      Reserves the next slot of the queue, so that a message can be written
+ *            straight into it. The message is not popped until it is committed (see
+ *            click_mo_queue_commit()), which must follow promptly: later messages cannot
+ *            be popped before it.
+ * Inputs:    oQueue - queue
+ * Return:    slot's message to fill in, or NULL if invalid parameter or the queue is full
+ */
+ClickMoMessage *click_mo_queue_reserve(ClickMoQueue *oQueue)
+{
+    LocalMoSlot *oSlot = NULL;
+    unsigned long iPos = 0, iSeq = 0;
+    long iDiff = 0;
+
+    if (oQueue == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    iPos = __atomic_load_n(&oQueue->iEnqueue, __ATOMIC_RELAXED);
+    for (;;) {
+        oSlot = &oQueue->aSlots[iPos & oQueue->iMask];
+        iSeq  = __atomic_load_n(&oSlot->iSeq, __ATOMIC_ACQUIRE);
+        iDiff = (long)(iSeq - iPos);
+
+        if (iDiff == 0) {
+            if (__atomic_compare_exchange_n(&oQueue->iEnqueue, &iPos, iPos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                return &oSlot->oMessage;
+        }
+        else if (iDiff < 0)
+            return NULL; // the slot still holds a message from a lap ago
+        else
+            iPos = __atomic_load_n(&oQueue->iEnqueue, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Function:  click_mo_queue_commit
+ * Info:      Makes a message written into a reserved slot available to be popped.
+ * Inputs:    oQueue   - queue
+ *            oMessage - message returned by click_mo_queue_reserve()
+ * Return:    void
+ */
+void click_mo_queue_commit(ClickMoQueue *oQueue, ClickMoMessage *oMessage)
+{
+    LocalMoSlot *oSlot = NULL;
+
+    if (oQueue == NULL || oMessage == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    oSlot = (LocalMoSlot *)((char *)oMessage - offsetof(LocalMoSlot, oMessage));
+    __atomic_store_n(&oSlot->iSeq, oSlot->iSeq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function:  click_mo_queue_push
+ * Info:      Copies a message into the queue.
+ * Inputs:    oQueue   - queue
+ *            oMessage - message
+ * Return:    0 if successful, else -1 if invalid parameter or the queue is full
+ */
+int click_mo_queue_push(ClickMoQueue *oQueue, const ClickMoMessage *oMessage)
+{
+    ClickMoMessage *oSlotMessage = NULL;
+
+    if (oQueue == NULL || oMessage == NULL || oMessage->iTextLen < 0 || oMessage->iTextLen >= CLICK_MO_TEXT_MAX) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if ((oSlotMessage = click_mo_queue_reserve(oQueue)) == NULL)
+        return -1;
+    memcpy(oSlotMessage, oMessage, offsetof(ClickMoMessage, chText) + oMessage->iTextLen);
+    oSlotMessage->chText[oMessage->iTextLen] = '\0';
+    click_mo_queue_commit(oQueue, oSlotMessage);
+
+    return 0;
+}
+
+/*
+ * Function:  click_mo_queue_pop
+ * Info:      Takes the oldest message off the queue, without waiting. Only the used part
+ *            of the message's text is copied.
+ * Inputs:    oQueue   - queue
+ * Outputs:   oMessage - message
+ * Return:    1 if a message was popped, 0 if the queue is empty, or -1 if invalid parameter
+ */
+int click_mo_queue_pop(ClickMoQueue *oQueue, ClickMoMessage *oMessage)
+{
+    LocalMoSlot *oSlot = NULL;
+    unsigned long iPos = 0, iSeq = 0;
+    long iDiff = 0;
+
+    if (oQueue == NULL || oMessage == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    iPos = __atomic_load_n(&oQueue->iDequeue, __ATOMIC_RELAXED);
+    for (;;) {
+        oSlot = &oQueue->aSlots[iPos & oQueue->iMask];
+        iSeq  = __atomic_load_n(&oSlot->iSeq, __ATOMIC_ACQUIRE);
+        iDiff = (long)(iSeq - (iPos + 1));
+
+        if (iDiff == 0) {
+            if (__atomic_compare_exchange_n(&oQueue->iDequeue, &iPos, iPos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (iDiff < 0)
+            return 0; // not pushed (or not committed) yet
+        else
+            iPos = __atomic_load_n(&oQueue->iDequeue, __ATOMIC_RELAXED);
+    }
+
+    memcpy(oMessage, &oSlot->oMessage, offsetof(ClickMoMessage, chText) + oSlot->oMessage.iTextLen + 1);
+
+    // hand the slot back to producers for the next lap
+    __atomic_store_n(&oSlot->iSeq, iPos + oQueue->iMask + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/*
+ * Function:  click_mo_queue_size
+ * Info:      Returns the number of messages in the queue (only a snapshot while other
+ *            threads push and pop).
+ * Inputs:    oQueue - queue
+ * Return:    number of messages, or -1 if invalid parameter
+ */
+long click_mo_queue_size(const ClickMoQueue *oQueue)
+{
+    unsigned long iDequeue = 0, iEnqueue = 0;
+
+    if (oQueue == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    iDequeue = __atomic_load_n(&oQueue->iDequeue, __ATOMIC_ACQUIRE);
+    iEnqueue = __atomic_load_n(&oQueue->iEnqueue, __ATOMIC_ACQUIRE);
+
+    return (iEnqueue > iDequeue ? (long)(iEnqueue - iDequeue) : 0);
+}
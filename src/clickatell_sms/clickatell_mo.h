@@ -0,0 +1,59 @@
+#ifndef CLICKATELL_MO_H
+#define CLICKATELL_MO_H
+
+/*
+ * clickatell_mo.h
+ *
+ *  Inbound (MO) message module used by the Clickatell SMS library.
+ *
+ *  Replies and other messages sent to the account's numbers are posted by Clickatell to
+ *  a callback URL, and received by a ClickCallbackServer (see clickatell_callback.h).
+ *  Each one is parsed into a ClickMoMessage: a fixed-size struct holding the addresses
+ *  and the text decoded to UTF-8, whatever character set it was delivered in.
+ *
+ *  Messages are passed to the application through a ClickMoQueue: a bounded lock-free
+ *  queue whose slots are allocated when it is created. The server parses each message
+ *  straight into a reserved slot and application threads pop them, so bursts of
+ *  messages allocate no memory. Any number of threads may push and pop at once.
+ */
+
+#include "clickatell_string.h"
+#include "clickatell_sms.h"
+
+#define CLICK_MO_ID_MAX         48   // size of a ClickMoMessage's message ID, including the NUL
+#define CLICK_MO_ADDRESS_MAX    24   // size of a ClickMoMessage's addresses, including the NUL
+#define CLICK_MO_TEXT_MAX       1024 // size of a ClickMoMessage's text, including the NUL
+
+// Enumeration of the character sets inbound message text is delivered in
+typedef enum eClickMoCharset {
+    CLICK_MO_CHARSET_UTF8,      // UTF-8 (or not stated)
+    CLICK_MO_CHARSET_LATIN1,    // ISO-8859-1
+    CLICK_MO_CHARSET_UCS2       // UTF-16 big-endian, written as hex digits
+} eClickMoCharset;
+
+// Inbound message: fields are NUL terminated and cut to fit, and empty if not delivered
+typedef struct ClickMoMessage {
+    eClickApi eFormat;              // callback format: CLICK_API_HTTP (query/form) or CLICK_API_REST (JSON)
+    eClickMoCharset eCharset;       // character set the text was delivered in
+    long long iTimestamp;           // UNIX time the message was received by Clickatell, or 0 if missing
+    int  iTextLen;                  // length of chText in bytes
+    int  bTruncated;                // 1 if the text was cut to fit chText (at a character boundary)
+    char chMoMsgId[CLICK_MO_ID_MAX];    // Clickatell's ID of the message
+    char chFrom[CLICK_MO_ADDRESS_MAX];  // sender's number
+    char chTo[CLICK_MO_ADDRESS_MAX];    // number the message was sent to
+    char chText[CLICK_MO_TEXT_MAX];     // text, decoded to UTF-8
+} ClickMoMessage;
+
+// inbound message queue (opaque)
+typedef struct ClickMoQueue ClickMoQueue;
+
+// function declarations
+ClickMoQueue *click_mo_queue_create(long iCapacity);
+void click_mo_queue_destroy(ClickMoQueue *oQueue);
+ClickMoMessage *click_mo_queue_reserve(ClickMoQueue *oQueue);
+void click_mo_queue_commit(ClickMoQueue *oQueue, ClickMoMessage *oMessage);
+int click_mo_queue_push(ClickMoQueue *oQueue, const ClickMoMessage *oMessage);
+int click_mo_queue_pop(ClickMoQueue *oQueue, ClickMoMessage *oMessage);
+long click_mo_queue_size(const ClickMoQueue *oQueue);
+
+#endif // CLICKATELL_MO_H
@@ -0,0 +1,651 @@
+/*
+ * clickatell_msisdn.c
+ *
+ *  MSISDN normalization module: strips formatting from mobile numbers, applies country
+ *  code and national prefix rules, and validates them as E.164. See clickatell_msisdn.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_sms.h"
+#include "clickatell_msisdn.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// most digits accepted before prefixes are removed: an E.164 number plus international and national prefixes
+#define LOCAL_MSISDN_RAW_MAX        24
+
+// national significant number lengths used for country codes missing from aLocalCountries
+#define LOCAL_MSISDN_DEFAULT_MIN    4
+
+// smallest hash table of a ClickMsisdnSet, and the multiplier which spreads its keys
+#define LOCAL_MSISDN_SET_MIN_BITS   4
+#define LOCAL_MSISDN_SET_HASH       0x9E3779B97F4A7C15ULL
+
+// National significant number (digits after the country code) lengths of a country code
+typedef struct LocalMsisdnCountry {
+    unsigned short iCode;   // country code
+    unsigned char  iMinLen; // fewest digits after the country code
+    unsigned char  iMaxLen; // most digits after the country code
+} LocalMsisdnCountry;
+
+// Length of the country code which starts with each pair of digits: country codes are
+// prefix-free, so the first two digits tell whether a code has 1, 2 or 3 digits
+static const unsigned char aLocalCountryCodeLen[100] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x: not a country code
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 1:  North American Numbering Plan
+    2, 3, 3, 3, 3, 3, 3, 2, 3, 3, // 20, 27
+    2, 2, 2, 2, 2, 3, 2, 3, 3, 2, // 30-34, 36, 39
+    2, 2, 3, 2, 2, 2, 2, 2, 2, 2, // 40, 41, 43-49
+    3, 2, 2, 2, 2, 2, 2, 2, 2, 3, // 51-58
+    2, 2, 2, 2, 2, 2, 2, 3, 3, 3, // 60-66
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7:  Russia, Kazakhstan
+    3, 2, 2, 3, 2, 3, 2, 3, 3, 3, // 81, 82, 84, 86
+    2, 2, 2, 2, 2, 2, 3, 3, 2, 3, // 90-95, 98
+};
+
+// National significant number lengths, sorted by country code
+static const LocalMsisdnCountry aLocalCountries[] = {
+    {   1, 10, 10 }, {   7, 10, 10 }, {  20,  9, 10 }, {  27,  9,  9 }, {  30, 10, 10 }, {  31,  9,  9 },
+    {  32,  8,  9 }, {  33,  9,  9 }, {  34,  9,  9 }, {  36,  8,  9 }, {  39,  6, 11 }, {  40,  9,  9 },
+    {  41,  9,  9 }, {  43,  4, 13 }, {  44,  7, 10 }, {  45,  8,  8 }, {  46,  7, 10 }, {  47,  8,  8 },
+    {  48,  9,  9 }, {  49,  6, 13 }, {  51,  8,  9 }, {  52, 10, 10 }, {  53,  8,  8 }, {  54, 10, 11 },
+    {  55, 10, 11 }, {  56,  9,  9 }, {  57, 10, 10 }, {  58, 10, 10 }, {  60,  8, 10 }, {  61,  9,  9 },
+    {  62,  8, 12 }, {  63, 10, 10 }, {  64,  8, 10 }, {  65,  8,  8 }, {  66,  8,  9 }, {  81,  9, 10 },
+    {  82,  8, 10 }, {  84,  9, 10 }, {  86, 10, 11 }, {  90, 10, 10 }, {  91, 10, 10 }, {  92,  9, 10 },
+    {  93,  9,  9 }, {  94,  9,  9 }, {  95,  8, 10 }, {  98, 10, 10 }, { 212,  9,  9 }, { 233,  9,  9 },
+    { 234,  8, 10 }, { 244,  9,  9 }, { 251,  9,  9 }, { 254,  9,  9 }, { 255,  9,  9 }, { 256,  9,  9 },
+    { 258,  8,  9 }, { 260,  9,  9 }, { 263,  9,  9 }, { 264,  8,  9 }, { 265,  7,  9 }, { 266,  8,  8 },
+    { 267,  7,  8 }, { 268,  8,  8 }, { 351,  9,  9 }, { 353,  7,  9 }, { 358,  5, 12 }, { 380,  9,  9 },
+    { 852,  8,  8 }, { 880, 10, 10 }, { 886,  9,  9 }, { 966,  9,  9 }, { 971,  8,  9 }, { 972,  8,  9 },
+    { 974,  8,  8 },
+};
+
+#define LOCAL_MSISDN_COUNTRY_COUNT  ((int)(sizeof(aLocalCountries) / sizeof(aLocalCountries[0])))
+
+static const char *aLocalStatusStr[CLICK_MSISDN_STATUS_COUNT] = {
+    "ok", "empty", "invalid character", "no country code", "invalid country code", "invalid length"
+};
+
+// One slot of a ClickMsisdnSet's hash table
+typedef struct LocalMsisdnSlot {
+    unsigned long long iKey;    // key of the number (see click_msisdn_key()), or 0 if the slot is free
+    long iIndex;                // index stored with the key when it was first inserted
+} LocalMsisdnSlot;
+
+// internal structure (hidden from public access) of a number set: header and table in one allocation
+struct ClickMsisdnSet {
+    int iBits;                  // log2 of the count of slots
+    long iMask;                 // count of slots - 1
+    LocalMsisdnSlot aSlots[];   // hash table, linearly probed
+};
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static void local_msisdn_block_classify(const unsigned char *pBlock, int iBlockLen,
+                                        unsigned int *iDigits, unsigned int *iFormat, unsigned int *iPlus);
+static int local_msisdn_digits_extract(const unsigned char *pNumber, long iLen, char *chRaw, int *bPlus);
+static eClickMsisdnStatus local_msisdn_e164_check(const char *chDigits, int iLen);
+static int local_msisdn_prefix_match(const char *chDigits, int iLen, const char *chPrefix);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_msisdn_block_classify
+ * Info:      Classifies up to 16 bytes of a number as digits, formatting characters
+ *            (space - . ( ) /) and '+', as one bit per byte. With SSE2 all 16 bytes are
+ *            classified at once.
+ * Inputs:    pBlock    - bytes to classify
+ *            iBlockLen - number of bytes (1-16)
+ * Outputs:   iDigits   - bit i set if byte i is a digit
+ *            iFormat   - bit i set if byte i is a formatting character
+ *            iPlus     - bit i set if byte i is '+'
+ * Return:    void
+ */
+static void local_msisdn_block_classify(const unsigned char *pBlock, int iBlockLen,
+                                        unsigned int *iDigits, unsigned int *iFormat, unsigned int *iPlus)
+{
+    unsigned int iValid = (iBlockLen >= 16 ? 0xffff : (1u << iBlockLen) - 1);
+
+#ifdef __SSE2__
+    unsigned char aTail[16];
+    __m128i vBlock, vFormat;
+
+    // a short block is copied, so that no byte beyond the number is read
+    if (iBlockLen >= 16)
+        vBlock = _mm_loadu_si128((const __m128i *)pBlock);
+    else {
+        memset(aTail, 0, sizeof(aTail));
+        memcpy(aTail, pBlock, iBlockLen);
+        vBlock = _mm_loadu_si128((const __m128i *)aTail);
+    }
+
+    // signed compares: bytes with the top bit set are negative, so never digits
+    vFormat = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vBlock, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(vBlock, _mm_set1_epi8('-'))),
+                           _mm_or_si128(_mm_cmpeq_epi8(vBlock, _mm_set1_epi8('.')), _mm_cmpeq_epi8(vBlock, _mm_set1_epi8('/'))));
+    vFormat = _mm_or_si128(vFormat, _mm_or_si128(_mm_cmpeq_epi8(vBlock, _mm_set1_epi8('(')), _mm_cmpeq_epi8(vBlock, _mm_set1_epi8(')'))));
+
+    *iDigits = iValid & (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(vBlock, _mm_set1_epi8('0' - 1)),
+                                                                     _mm_cmplt_epi8(vBlock, _mm_set1_epi8('9' + 1))));
+    *iFormat = iValid & (unsigned int)_mm_movemask_epi8(vFormat);
+    *iPlus   = iValid & (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(vBlock, _mm_set1_epi8('+')));
+#else
+    int i = 0;
+
+    *iDigits = *iFormat = *iPlus = 0;
+    for (i = 0; i < iBlockLen; i++) {
+        if (pBlock[i] >= '0' && pBlock[i] <= '9')
+            *iDigits |= 1u << i;
+        else if (pBlock[i] == ' ' || pBlock[i] == '-' || pBlock[i] == '.' || pBlock[i] == '/' || pBlock[i] == '(' || pBlock[i] == ')')
+            *iFormat |= 1u << i;
+        else if (pBlock[i] == '+')
+            *iPlus |= 1u << i;
+    }
+    (void)iValid;
+#endif
+}
+
+/*
+ * Function:  local_msisdn_digits_extract
+ * Info:      Strips formatting from a number, 16 bytes at a time: blocks which are all
+ *            digits are copied whole, others digit by digit from the block's digit mask.
+ *            A '+' is only accepted before the first digit.
+ * Inputs:    pNumber - number as entered
+ *            iLen    - length of number in bytes
+ * Outputs:   chRaw   - the number's digits (LOCAL_MSISDN_RAW_MAX bytes, not NUL terminated)
+ *            bPlus   - set if the number starts with '+'
+ * Return:    number of digits, -CLICK_MSISDN_BAD_CHAR or -CLICK_MSISDN_BAD_LENGTH
+ */
+static int local_msisdn_digits_extract(const unsigned char *pNumber, long iLen, char *chRaw, int *bPlus)
+{
+    unsigned int iDigits = 0, iFormat = 0, iPlus = 0, iValid = 0;
+    long iPos = 0;
+    int iBlockLen = 0, iCount = 0;
+
+    *bPlus = 0;
+
+    for (iPos = 0; iPos < iLen; iPos += iBlockLen) {
+        iBlockLen = (iLen - iPos >= 16 ? 16 : (int)(iLen - iPos));
+        iValid    = (iBlockLen >= 16 ? 0xffff : (1u << iBlockLen) - 1);
+        local_msisdn_block_classify(pNumber + iPos, iBlockLen, &iDigits, &iFormat, &iPlus);
+
+        if ((iDigits | iFormat | iPlus) != iValid)
+            return -CLICK_MSISDN_BAD_CHAR;
+
+        // a single '+', before any digit
+        if (iPlus != 0) {
+            if (*bPlus || iCount > 0 || (iPlus & (iPlus - 1)) != 0 || (iDigits & (iPlus - 1)) != 0)
+                return -CLICK_MSISDN_BAD_CHAR;
+            *bPlus = 1;
+        }
+
+        if (iCount + __builtin_popcount(iDigits) > LOCAL_MSISDN_RAW_MAX)
+            return -CLICK_MSISDN_BAD_LENGTH;
+
+        if (iDigits == 0xffff) {
+            memcpy(chRaw + iCount, pNumber + iPos, 16);
+            iCount += 16;
+        }
+        else {
+            for (; iDigits != 0; iDigits &= iDigits - 1)
+                chRaw[iCount++] = (char)pNumber[iPos + __builtin_ctz(iDigits)];
+        }
+    }
+
+    return iCount;
+}
+
+/*
+ * Function:  local_msisdn_e164_check
+ * Info:      Validates the country code and length of an E.164 number.
+ * Inputs:    chDigits - E.164 number as digits, without '+'
+ *            iLen     - number of digits
+ * Return:    CLICK_MSISDN_OK, CLICK_MSISDN_BAD_COUNTRY or CLICK_MSISDN_BAD_LENGTH
+ */
+static eClickMsisdnStatus local_msisdn_e164_check(const char *chDigits, int iLen)
+{
+    int iCodeLen = 0, iCode = 0, iLow = 0, iHigh = LOCAL_MSISDN_COUNTRY_COUNT - 1, iMid = 0, i = 0;
+    int iMinLen = LOCAL_MSISDN_DEFAULT_MIN, iMaxLen = 0;
+
+    if (iLen < 2 || iLen > CLICK_MSISDN_MAX_DIGITS)
+        return (iLen >= 1 && chDigits[0] == '0' ? CLICK_MSISDN_BAD_COUNTRY : CLICK_MSISDN_BAD_LENGTH);
+
+    if ((iCodeLen = aLocalCountryCodeLen[(chDigits[0] - '0') * 10 + (chDigits[1] - '0')]) == 0)
+        return CLICK_MSISDN_BAD_COUNTRY;
+    if (iCodeLen >= iLen)
+        return CLICK_MSISDN_BAD_LENGTH;
+
+    for (i = 0; i < iCodeLen; i++)
+        iCode = iCode * 10 + (chDigits[i] - '0');
+    iMaxLen = CLICK_MSISDN_MAX_DIGITS - iCodeLen;
+
+    // binary search of the length table
+    while (iLow <= iHigh) {
+        iMid = (iLow + iHigh) / 2;
+        if (aLocalCountries[iMid].iCode == iCode) {
+            iMinLen = aLocalCountries[iMid].iMinLen;
+            iMaxLen = aLocalCountries[iMid].iMaxLen;
+            break;
+        }
+        if (aLocalCountries[iMid].iCode < iCode)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid - 1;
+    }
+
+    if (iLen - iCodeLen < iMinLen || iLen - iCodeLen > iMaxLen)
+        return CLICK_MSISDN_BAD_LENGTH;
+
+    return CLICK_MSISDN_OK;
+}
+
+/*
+ * Function:  local_msisdn_prefix_match
+ * Info:      Checks whether a number's digits start with a dialling prefix.
+ * Inputs:    chDigits - digits of number
+ *            iLen     - number of digits
+ *            chPrefix - prefix (digits, NUL terminated), or NULL
+ * Return:    length of the prefix if the number starts with it, else 0
+ */
+static int local_msisdn_prefix_match(const char *chDigits, int iLen, const char *chPrefix)
+{
+    int iPrefixLen = (chPrefix != NULL ? (int)strlen(chPrefix) : 0);
+
+    if (iPrefixLen == 0 || iPrefixLen > iLen || memcmp(chDigits, chPrefix, iPrefixLen) != 0)
+        return 0;
+
+    return iPrefixLen;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_msisdn_normalize
+ * Info:      Normalizes a number to E.164. Formatting characters are removed, then:
+ *              - a number starting with '+' or the international prefix is taken to
+ *                start with its country code
+ *              - a number starting with the national prefix has it replaced with the
+ *                default country code
+ *              - any other number is taken to start with its country code (as the
+ *                Clickatell APIs expect) if it is valid as such, else the default
+ *                country code is prepended
+ *            The result is checked against the length table of its country. No memory
+ *            is allocated.
+ * Inputs:    chNumber - number as entered (need not be NUL terminated)
+ *            iLen     - length of number in bytes
+ *            oRules   - rules for national numbers. May be NULL, in which case only
+ *                       international numbers are accepted.
+ * Outputs:   chDigits - E.164 number as digits without '+', NUL terminated
+ *                       (CLICK_MSISDN_MAX_DIGITS + 1 bytes). May be NULL.
+ *            iValue   - E.164 number as an integer, 0 if invalid. May be NULL.
+ * Return:    CLICK_MSISDN_OK, or the reason the number is invalid
+ */
+eClickMsisdnStatus click_msisdn_normalize(const char *chNumber, long iLen, const ClickMsisdnRules *oRules,
+                                          char *chDigits, unsigned long long *iValue)
+{
+    char chRaw[LOCAL_MSISDN_RAW_MAX], chNational[LOCAL_MSISDN_RAW_MAX + 8];
+    const char *pE164 = chRaw;
+    int iRawLen = 0, iE164Len = 0, iPrefixLen = 0, bPlus = 0, bNational = 0, i = 0;
+    eClickMsisdnStatus eStatus = CLICK_MSISDN_EMPTY;
+    unsigned long long iNumber = 0;
+
+    if (chDigits != NULL)
+        chDigits[0] = '\0';
+    if (iValue != NULL)
+        *iValue = 0;
+
+    if (chNumber == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return CLICK_MSISDN_EMPTY;
+    }
+
+    if ((iRawLen = local_msisdn_digits_extract((const unsigned char *)chNumber, iLen, chRaw, &bPlus)) <= 0)
+        return (iRawLen < 0 ? (eClickMsisdnStatus)-iRawLen : CLICK_MSISDN_EMPTY);
+
+    iE164Len = iRawLen;
+    if (!bPlus && oRules != NULL) {
+        if ((iPrefixLen = local_msisdn_prefix_match(chRaw, iRawLen, oRules->chIntlPrefix)) > 0) {
+            pE164     = chRaw + iPrefixLen;
+            iE164Len -= iPrefixLen;
+        }
+        else if ((iPrefixLen = local_msisdn_prefix_match(chRaw, iRawLen, oRules->chNationalPrefix)) > 0)
+            bNational = 1;
+    }
+
+    if (!bNational)
+        eStatus = local_msisdn_e164_check(pE164, iE164Len);
+
+    // a national number, or one which is not valid with a country code: try the default one
+    if (bNational || (eStatus != CLICK_MSISDN_OK && !bPlus && iPrefixLen == 0 && oRules != NULL && oRules->iCountryCode > 0)) {
+        if (oRules == NULL || oRules->iCountryCode <= 0 || oRules->iCountryCode > 999)
+            return CLICK_MSISDN_NO_COUNTRY;
+
+        iE164Len = 0;
+        for (i = (oRules->iCountryCode >= 100 ? 100 : (oRules->iCountryCode >= 10 ? 10 : 1)); i > 0; i /= 10)
+            chNational[iE164Len++] = (char)('0' + (oRules->iCountryCode / i) % 10);
+        memcpy(chNational + iE164Len, chRaw + iPrefixLen, iRawLen - iPrefixLen);
+        iE164Len += iRawLen - iPrefixLen;
+        pE164     = chNational;
+
+        eStatus = local_msisdn_e164_check(pE164, iE164Len);
+    }
+
+    if (eStatus != CLICK_MSISDN_OK)
+        return eStatus;
+
+    for (i = 0; i < iE164Len; i++)
+        iNumber = iNumber * 10 + (unsigned long long)(pE164[i] - '0');
+
+    if (chDigits != NULL) {
+        memcpy(chDigits, pE164, iE164Len);
+        chDigits[iE164Len] = '\0';
+    }
+    if (iValue != NULL)
+        *iValue = iNumber;
+
+    return CLICK_MSISDN_OK;
+}
+
+/*
+ * Function:  click_msisdn_normalize_batch
+ * Info:      Normalizes an array of numbers to E.164 integers (see click_msisdn_normalize()).
+ *            No memory is allocated.
+ * Inputs:    aNumbers - NUL terminated numbers as entered
+ *            iNum     - number of numbers
+ *            oRules   - rules for national numbers. May be NULL.
+ * Outputs:   aValues  - E.164 numbers as integers, 0 for invalid numbers. May be NULL.
+ *            aStatus  - result of each number. May be NULL.
+ * Return:    count of valid numbers, or -1 if invalid parameter
+ */
+long click_msisdn_normalize_batch(const char *const *aNumbers, long iNum, const ClickMsisdnRules *oRules,
+                                  unsigned long long *aValues, eClickMsisdnStatus *aStatus)
+{
+    eClickMsisdnStatus eStatus = CLICK_MSISDN_EMPTY;
+    unsigned long long iValue = 0;
+    long i = 0, iValid = 0;
+
+    if (aNumbers == NULL || iNum < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < iNum; i++) {
+        eStatus = (aNumbers[i] != NULL ? click_msisdn_normalize(aNumbers[i], (long)strlen(aNumbers[i]), oRules, NULL, &iValue) :
+                                         CLICK_MSISDN_EMPTY);
+        if (eStatus == CLICK_MSISDN_OK)
+            iValid++;
+        else
+            iValue = 0;
+
+        if (aValues != NULL)
+            aValues[i] = iValue;
+        if (aStatus != NULL)
+            aStatus[i] = eStatus;
+    }
+
+    return iValid;
+}
+
+/*
+ * Function:  click_msisdn_list_normalize
+ * Info:      Normalizes the destination addresses of a send message call in place, so
+ *            that invalid numbers can be found (and removed) before sending. Invalid
+ *            numbers are left unchanged.
+ * Inputs:    aMsisdns - destination addresses
+ *            oRules   - rules for national numbers. May be NULL.
+ * Outputs:   aStatus  - result of each number (aMsisdns->iNum entries). May be NULL.
+ * Return:    count of invalid numbers, or -1 if invalid parameter or out of memory
+ */
+int click_msisdn_list_normalize(ClickMsisdn *aMsisdns, const ClickMsisdnRules *oRules, eClickMsisdnStatus *aStatus)
+{
+    char chDigits[CLICK_MSISDN_MAX_DIGITS + 1];
+    char *chReallocatedStr = NULL;
+    eClickMsisdnStatus eStatus = CLICK_MSISDN_EMPTY;
+    int i = 0, iInvalid = 0, iLen = 0;
+
+    if (aMsisdns == NULL || aMsisdns->iNum < 0 || (aMsisdns->iNum > 0 && aMsisdns->aDests == NULL)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < aMsisdns->iNum; i++) {
+        if (CLICK_STR_INVALID(aMsisdns->aDests[i]))
+            eStatus = CLICK_MSISDN_EMPTY;
+        else
+            eStatus = click_msisdn_normalize(aMsisdns->aDests[i]->data, (long)strlen(aMsisdns->aDests[i]->data), oRules, chDigits, NULL);
+
+        if (eStatus == CLICK_MSISDN_OK) {
+            // the normalized number is longer than the original if a country code was added
+            if ((iLen = (int)strlen(chDigits)) > (int)strlen(aMsisdns->aDests[i]->data)) {
+                if ((chReallocatedStr = realloc(aMsisdns->aDests[i]->data, iLen + 1)) == NULL) {
+                    click_debug_print("%s ERROR: Failed to allocate memory for number!\n", __func__);
+                    return -1;
+                }
+                aMsisdns->aDests[i]->data = chReallocatedStr;
+            }
+            memcpy(aMsisdns->aDests[i]->data, chDigits, iLen + 1);
+        }
+        else
+            iInvalid++;
+
+        if (aStatus != NULL)
+            aStatus[i] = eStatus;
+    }
+
+    return iInvalid;
+}
+
+/*
+ * Function:  click_msisdn_format
+ * Info:      Converts an E.164 number held as an integer back to digits.
+ * Inputs:    iValue   - E.164 number as an integer
+ * Outputs:   chDigits - number as digits, NUL terminated (CLICK_MSISDN_MAX_DIGITS + 1 bytes)
+ * Return:    number of digits, or -1 if the value is not an E.164 number
+ */
+int click_msisdn_format(unsigned long long iValue, char *chDigits)
+{
+    char chReversed[CLICK_MSISDN_MAX_DIGITS];
+    int iLen = 0, i = 0;
+
+    if (chDigits == NULL || iValue == 0 || iValue >= 1000000000000000ULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (; iValue > 0; iValue /= 10)
+        chReversed[iLen++] = (char)('0' + iValue % 10);
+    for (i = 0; i < iLen; i++)
+        chDigits[i] = chReversed[iLen - 1 - i];
+    chDigits[iLen] = '\0';
+
+    return iLen;
+}
+
+/*
+ * Function:  click_msisdn_status_str
+ * Info:      Describes a normalization result, ie. for error reports.
+ * Inputs:    eStatus - normalization result
+ * Return:    static description string
+ */
+const char *click_msisdn_status_str(eClickMsisdnStatus eStatus)
+{
+    if (eStatus < CLICK_MSISDN_OK || eStatus >= CLICK_MSISDN_STATUS_COUNT)
+        return "unknown";
+
+    return aLocalStatusStr[eStatus];
+}
+
+/*
+ * Function:  click_msisdn_key
+ * Info:      Packs a number of up to CLICK_MSISDN_MAX_DIGITS digits into a 64-bit key
+ *            (its value and its digit count, so that "0821" and "821" differ), for use
+ *            with a ClickMsisdnSet. Numbers are not normalized: normalize them first so
+ *            that different ways of writing the same number have the same key.
+ * Inputs:    chDigits - number as digits (need not be NUL terminated)
+ *            iLen     - count of digits
+ * Return:    key (never 0), or 0 if the number is empty, too long or not digits only
+ */
+unsigned long long click_msisdn_key(const char *chDigits, long iLen)
+{
+    unsigned long long iValue = 0;
+    long i = 0;
+
+    if (chDigits == NULL || iLen < 1 || iLen > CLICK_MSISDN_MAX_DIGITS)
+        return 0;
+
+    for (i = 0; i < iLen; i++) {
+        if ((unsigned)(chDigits[i] - '0') > 9)
+            return 0;
+        iValue = iValue * 10 + (unsigned)(chDigits[i] - '0');
+    }
+
+    return (iValue << 4) | (unsigned long long)iLen;
+}
+
+/*
+ * Function:  click_msisdn_set_create
+ * Info:      Creates an empty open-addressing hash set of number keys, sized for a given
+ *            count of numbers (at most half of its slots are used). The set is a single
+ *            allocation.
+ *            Note that the calling function must destroy the returned set.
+ * Inputs:    iNum - most numbers which will be inserted
+ * Return:    new set, or NULL if invalid parameter or failed to allocate memory
+ */
+ClickMsisdnSet *click_msisdn_set_create(long iNum)
+{
+    ClickMsisdnSet *oSet = NULL;
+    int iBits = LOCAL_MSISDN_SET_MIN_BITS;
+
+    if (iNum < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    while ((1L << iBits) < 2 * iNum)
+        iBits++;
+
+    if ((oSet = calloc(1, sizeof(ClickMsisdnSet) + (sizeof(LocalMsisdnSlot) << iBits))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for number set!\n", __func__);
+        return NULL;
+    }
+    oSet->iBits = iBits;
+    oSet->iMask = (1L << iBits) - 1;
+
+    return oSet;
+}
+
+/*
+ * Function:  click_msisdn_set_destroy
+ * Info:      Destroys a number set.
+ * Inputs:    oSet - set to destroy
+ * Return:    void
+ */
+void click_msisdn_set_destroy(ClickMsisdnSet *oSet)
+{
+    free(oSet);
+}
+
+/*
+ * Function:  click_msisdn_set_insert
+ * Info:      Inserts a key into a set with an index (ie. the position of its number), if
+ *            it is not in the set already. No more keys may be inserted than the set was
+ *            created for.
+ * Inputs:    oSet   - number set
+ *            iKey   - key of the number (see click_msisdn_key()), not 0
+ *            iIndex - index to store with the key
+ * Return:    iIndex if the key was inserted, else the index stored when it was first
+ *            inserted; -1 if invalid parameter
+ */
+long click_msisdn_set_insert(ClickMsisdnSet *oSet, unsigned long long iKey, long iIndex)
+{
+    LocalMsisdnSlot *oSlot = NULL;
+    long iSlot = 0;
+
+    if (oSet == NULL || iKey == 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    // the high bits of the product depend on all bits of the key
+    for (iSlot = (long)((iKey * LOCAL_MSISDN_SET_HASH) >> (64 - oSet->iBits)); ; iSlot = (iSlot + 1) & oSet->iMask) {
+        oSlot = &oSet->aSlots[iSlot];
+        if (oSlot->iKey == iKey)
+            return oSlot->iIndex;
+        if (oSlot->iKey == 0)
+            break;
+    }
+
+    oSlot->iKey   = iKey;
+    oSlot->iIndex = iIndex;
+
+    return iIndex;
+}
+
+/*
+ * Function:  click_msisdn_list_dedup
+ * Info:      Removes repeated numbers from the destination addresses of a send message
+ *            call in place, so that each number is sent (and charged for) once. The first
+ *            occurrence of each number is kept, in order. Numbers are compared as digits:
+ *            normalize them first (see click_msisdn_list_normalize()); numbers which are
+ *            not digits only are always kept. Runs in linear time, using a single scratch
+ *            allocation.
+ * Inputs:    aMsisdns - destination addresses
+ * Outputs:   aMap     - for each original position (aMsisdns->iNum entries before the
+ *                       call), the position of its number in the deduplicated list. A
+ *                       position was collapsed if an earlier position maps to the same
+ *                       number. May be NULL.
+ * Return:    count of numbers removed, or -1 if invalid parameter or failed to allocate memory
+ */
+long click_msisdn_list_dedup(ClickMsisdn *aMsisdns, long *aMap)
+{
+    ClickMsisdnSet *oSet = NULL;
+    unsigned long long iKey = 0;
+    long i = 0, iNum = 0, iFirst = 0;
+
+    if (aMsisdns == NULL || aMsisdns->iNum < 0 || (aMsisdns->iNum > 0 && aMsisdns->aDests == NULL)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if ((oSet = click_msisdn_set_create(aMsisdns->iNum)) == NULL)
+        return -1;
+
+    for (i = 0; i < aMsisdns->iNum; i++) {
+        ClickSmsString *sDest = aMsisdns->aDests[i];
+
+        iKey   = (CLICK_STR_INVALID(sDest) ? 0 : click_msisdn_key(sDest->data, (long)strlen(sDest->data)));
+        iFirst = (iKey == 0 ? iNum : click_msisdn_set_insert(oSet, iKey, iNum));
+
+        if (iFirst == iNum)
+            aMsisdns->aDests[iNum++] = sDest;
+        else
+            click_string_destroy(sDest);
+
+        if (aMap != NULL)
+            aMap[i] = iFirst;
+    }
+
+    for (i = iNum; i < aMsisdns->iNum; i++)
+        aMsisdns->aDests[i] = NULL;
+
+    i = aMsisdns->iNum - iNum;
+    aMsisdns->iNum = (int)iNum;
+    click_msisdn_set_destroy(oSet);
+
+    return i;
+}
@@ -0,0 +1,55 @@
+#ifndef CLICKATELL_MSISDN_H
+#define CLICKATELL_MSISDN_H
+
+/*
+ * clickatell_msisdn.h
+ *
+ *  MSISDN normalization module used by the Clickatell SMS library.
+ *
+ *  Converts mobile numbers as users enter them ("+27 82-123 4567", "082 123 4567",
+ *  "0027821234567") to canonical E.164 form: the country code and national number as
+ *  digits only, without '+' or international prefix, as the Clickatell APIs expect
+ *  ("27821234567"). Numbers are validated against a per-country length table, so that
+ *  bad numbers are rejected before a request is made rather than by the API.
+ */
+
+struct ClickMsisdn; // destination address container (see clickatell_sms.h)
+
+#define CLICK_MSISDN_MAX_DIGITS     15  // most digits of an E.164 number, including its country code
+
+// Enumeration of normalization results
+typedef enum eClickMsisdnStatus {
+    CLICK_MSISDN_OK,            // valid, normalized to E.164
+    CLICK_MSISDN_EMPTY,         // no digits
+    CLICK_MSISDN_BAD_CHAR,      // characters other than digits, formatting (space - . ( ) /) and a leading '+'
+    CLICK_MSISDN_NO_COUNTRY,    // national number, but no default country code is configured
+    CLICK_MSISDN_BAD_COUNTRY,   // country code starts with 0
+    CLICK_MSISDN_BAD_LENGTH,    // too few or too many digits for its country
+    CLICK_MSISDN_STATUS_COUNT   // count of results
+} eClickMsisdnStatus;
+
+// Rules for numbers entered without a country code
+typedef struct ClickMsisdnRules {
+    int iCountryCode;               // default country code of national numbers (ie. 27), or 0 for none
+    const char *chNationalPrefix;   // trunk prefix of national numbers (ie. "0"), or NULL for none
+    const char *chIntlPrefix;       // international call prefix (ie. "00"), or NULL; '+' is always accepted
+} ClickMsisdnRules;
+
+// open-addressing hash set of normalized numbers (see click_msisdn_set_create())
+typedef struct ClickMsisdnSet ClickMsisdnSet;
+
+// function declarations
+eClickMsisdnStatus click_msisdn_normalize(const char *chNumber, long iLen, const ClickMsisdnRules *oRules,
+                                          char *chDigits, unsigned long long *iValue);
+long click_msisdn_normalize_batch(const char *const *aNumbers, long iNum, const ClickMsisdnRules *oRules,
+                                  unsigned long long *aValues, eClickMsisdnStatus *aStatus);
+int click_msisdn_list_normalize(struct ClickMsisdn *aMsisdns, const ClickMsisdnRules *oRules, eClickMsisdnStatus *aStatus);
+int click_msisdn_format(unsigned long long iValue, char *chDigits);
+const char *click_msisdn_status_str(eClickMsisdnStatus eStatus);
+unsigned long long click_msisdn_key(const char *chDigits, long iLen);
+ClickMsisdnSet *click_msisdn_set_create(long iNum);
+void click_msisdn_set_destroy(ClickMsisdnSet *oSet);
+long click_msisdn_set_insert(ClickMsisdnSet *oSet, unsigned long long iKey, long iIndex);
+long click_msisdn_list_dedup(struct ClickMsisdn *aMsisdns, long *aMap);
+
+#endif // CLICKATELL_MSISDN_H
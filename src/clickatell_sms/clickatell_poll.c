@@ -0,0 +1,703 @@
+/*
+ * clickatell_poll.c
+ *
+ *  Status poll scheduler module: polls the status of sent messages on adaptive
+ *  per-message schedules kept in a timing wheel, in concurrent waves within a rate
+ *  budget. See clickatell_poll.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_poll.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// timing wheel slots (a power of 2): with the default tick, one turn is over 17 minutes
+#define LOCAL_POLL_WHEEL_SLOTS      4096
+
+// polls per handle in one wave
+#define LOCAL_POLL_WAVE_PER_HANDLE  32
+
+// defaults of ClickPollConfig
+#define LOCAL_POLL_TICK_MS          250
+#define LOCAL_POLL_FIRST_MS         5000
+#define LOCAL_POLL_MAX_INTERVAL_MS  300000
+#define LOCAL_POLL_MAX_AGE_MS       (48L * 3600 * 1000)
+
+// a message's interval is at least this fraction of its age
+#define LOCAL_POLL_AGE_DIVISOR      10
+
+// One tracked message: linked into a timing wheel slot while waiting, or into the ready
+// list while due
+typedef struct LocalPollEntry {
+    char chMsgId[CLICK_POLL_ID_MAX];
+    long long iAddedMs;     // time the message was added
+    long long iDueTick;     // tick the next poll is due at
+    int iNext;              // next entry of the slot, ready list or free list, or -1
+    int iPrev;              // previous entry of the slot, or -1 (slot lists only)
+    int iStatus;            // last status seen, or 0 if none yet
+    int iRepeats;           // polls in a row which returned iStatus (or failed)
+} LocalPollEntry;
+
+// internal structure (hidden from public access) of a status poll scheduler
+struct ClickPollScheduler {
+    ClickPollConfig oConfig;    // settings, with defaults filled in
+    ClickPollHandler fnHandler; // status handler, or NULL
+    void *pContext;             // opaque argument passed to 'fnHandler'
+
+    LocalPollEntry *aEntries;   // tracked messages
+    long iCapacity;             // number of entries
+    int iFree;                  // first free entry, or -1
+    int aSlots[LOCAL_POLL_WHEEL_SLOTS]; // first entry of each wheel slot, or -1
+    long long iCursor;          // last tick collected, or -1 before the first message is added
+    int iReadyHead;             // first due entry, or -1
+    int iReadyTail;             // last due entry, or -1
+
+    double fTokens;             // polls the rate budget allows now
+    long long iBudgetMs;        // time the budget was last topped up, or -1
+
+    // the current wave, shared with the worker threads
+    ClickSmsHandle *aHandles[CLICK_POLL_HANDLES_MAX];
+    int iHandles;
+    int *aWave;                 // entries being polled
+    int *aWaveStatus;           // status each poll returned, or -1 if it failed
+    int iWaveLen;               // entries in the wave
+    int iWaveNext;              // next wave entry to poll, claimed atomically
+    pthread_t aThreads[CLICK_POLL_HANDLES_MAX];
+    pthread_mutex_t oLock;
+    pthread_cond_t oWake;       // signalled when a wave starts or the scheduler stops
+    pthread_cond_t oDone;       // signalled when the last worker finishes its part of a wave
+    long iGeneration;           // waves started
+    int iBusy;                  // workers still polling the current wave
+    int bStop;                  // set when the scheduler is destroyed
+
+    ClickPollStats oStats;
+};
+
+// Argument of a worker thread
+typedef struct LocalPollWorker {
+    ClickPollScheduler *oScheduler;
+    int iHandle;
+} LocalPollWorker;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static void local_poll_slot_insert(ClickPollScheduler *oScheduler, int iEntry);
+static void local_poll_slot_collect(ClickPollScheduler *oScheduler, int iSlot, long long iTick);
+static void local_poll_advance(ClickPollScheduler *oScheduler, long long iNowMs);
+static long local_poll_interval(const ClickPollScheduler *oScheduler, const LocalPollEntry *oEntry, long long iAgeMs);
+static void local_poll_wave_work(ClickPollScheduler *oScheduler, int iHandle);
+static void *local_poll_worker(void *pArg);
+static void local_poll_wave_run(ClickPollScheduler *oScheduler);
+static void local_poll_wave_apply(ClickPollScheduler *oScheduler, long long iNowMs);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_poll_slot_insert
+ * Info:      Links an entry into the timing wheel slot of its due tick.
+ * Inputs:    oScheduler - scheduler
+ *            iEntry     - entry, with its due tick set
+ * Return:    void
+ */
+static void local_poll_slot_insert(ClickPollScheduler *oScheduler, int iEntry)
+{
+    LocalPollEntry *oEntry = &oScheduler->aEntries[iEntry];
+    int iSlot = (int)(oEntry->iDueTick & (LOCAL_POLL_WHEEL_SLOTS - 1));
+
+    oEntry->iPrev = -1;
+    oEntry->iNext = oScheduler->aSlots[iSlot];
+    if (oEntry->iNext >= 0)
+        oScheduler->aEntries[oEntry->iNext].iPrev = iEntry;
+    oScheduler->aSlots[iSlot] = iEntry;
+}
+
+/*
+ * Function:  local_poll_slot_collect
+ * Info:      Moves the entries of a timing wheel slot which are due by a tick to the end
+ *            of the ready list. Entries due on a later turn of the wheel stay.
+ * Inputs:    oScheduler - scheduler
+ *            iSlot      - wheel slot
+ *            iTick      - tick
+ * Return:    void
+ */
+static void local_poll_slot_collect(ClickPollScheduler *oScheduler, int iSlot, long long iTick)
+{
+    LocalPollEntry *oEntry = NULL;
+    int iEntry = oScheduler->aSlots[iSlot], iNext = -1;
+
+    for ( ; iEntry >= 0; iEntry = iNext) {
+        oEntry = &oScheduler->aEntries[iEntry];
+        iNext  = oEntry->iNext;
+        if (oEntry->iDueTick > iTick)
+            continue;
+
+        // unlink from the slot
+        if (oEntry->iPrev >= 0)
+            oScheduler->aEntries[oEntry->iPrev].iNext = iNext;
+        else
+            oScheduler->aSlots[iSlot] = iNext;
+        if (iNext >= 0)
+            oScheduler->aEntries[iNext].iPrev = oEntry->iPrev;
+
+        // append to the ready list
+        oEntry->iNext = -1;
+        if (oScheduler->iReadyTail >= 0)
+            oScheduler->aEntries[oScheduler->iReadyTail].iNext = iEntry;
+        else
+            oScheduler->iReadyHead = iEntry;
+        oScheduler->iReadyTail = iEntry;
+    }
+}
+
+/*
+ * Function:  local_poll_advance
+ * Info:      Turns the timing wheel up to the current time, moving the entries which
+ *            have fallen due to the ready list.
+ * Inputs:    oScheduler - scheduler
+ *            iNowMs     - current time in milliseconds
+ * Return:    void
+ */
+static void local_poll_advance(ClickPollScheduler *oScheduler, long long iNowMs)
+{
+    long long iNowTick = iNowMs / oScheduler->oConfig.iTickMs, iTick = 0;
+    int iSlot = 0;
+
+    if (oScheduler->iCursor < 0 || iNowTick <= oScheduler->iCursor)
+        return;
+
+    // a whole turn or more has passed: every slot may hold due entries
+    if (iNowTick - oScheduler->iCursor >= LOCAL_POLL_WHEEL_SLOTS) {
+        for (iSlot = 0; iSlot < LOCAL_POLL_WHEEL_SLOTS; iSlot++)
+            local_poll_slot_collect(oScheduler, iSlot, iNowTick);
+    }
+    else {
+        for (iTick = oScheduler->iCursor + 1; iTick <= iNowTick; iTick++)
+            local_poll_slot_collect(oScheduler, (int)(iTick & (LOCAL_POLL_WHEEL_SLOTS - 1)), iNowTick);
+    }
+    oScheduler->iCursor = iNowTick;
+}
+
+/*
+ * Function:  local_poll_interval
+ * Info:      Calculates the interval until a message's next poll, from its last status,
+ *            how many polls in a row returned it and its age.
+ * Inputs:    oScheduler - scheduler
+ *            oEntry     - message
+ *            iAgeMs     - age of the message in milliseconds
+ * Return:    interval in milliseconds
+ */
+static long local_poll_interval(const ClickPollScheduler *oScheduler, const LocalPollEntry *oEntry, long long iAgeMs)
+{
+    long iInterval = 0;
+    int i = 0;
+
+    switch (oEntry->iStatus) {
+        case 3:  // delivered to gateway
+        case 8:  // OK (received by the network)
+            iInterval = 5000;
+            break;
+        case 2:  // queued
+            iInterval = 10000;
+            break;
+        case 11: // queued for later delivery
+            iInterval = 60000;
+            break;
+        default: // unknown, or no status yet
+            iInterval = 15000;
+            break;
+    }
+
+    // back off by half as much again for each poll in a row which saw nothing new
+    for (i = 1; i < oEntry->iRepeats && iInterval < oScheduler->oConfig.iMaxIntervalMs; i++)
+        iInterval += iInterval / 2;
+
+    if (iInterval < iAgeMs / LOCAL_POLL_AGE_DIVISOR)
+        iInterval = (long)(iAgeMs / LOCAL_POLL_AGE_DIVISOR);
+    if (iInterval > oScheduler->oConfig.iMaxIntervalMs)
+        iInterval = oScheduler->oConfig.iMaxIntervalMs;
+
+    return iInterval;
+}
+
+/*
+ * Function:  local_poll_wave_work
+ * Info:      Polls entries of the current wave with one handle, until none are left to
+ *            claim.
+ * Inputs:    oScheduler - scheduler
+ *            iHandle    - index of the handle to poll with
+ * Return:    void
+ */
+static void local_poll_wave_work(ClickPollScheduler *oScheduler, int iHandle)
+{
+    ClickSmsString sMsgId, *sResponse = NULL;
+    int i = 0;
+
+    while ((i = __atomic_fetch_add(&oScheduler->iWaveNext, 1, __ATOMIC_RELAXED)) < oScheduler->iWaveLen) {
+        sMsgId.data = oScheduler->aEntries[oScheduler->aWave[i]].chMsgId;
+        sResponse   = clickatell_sms_status_get(oScheduler->aHandles[iHandle], &sMsgId);
+
+        oScheduler->aWaveStatus[i] = (sResponse != NULL ? click_poll_status_parse(sResponse->data) : -1);
+        click_string_destroy(sResponse);
+    }
+}
+
+/*
+ * Function:  local_poll_worker
+ * Info:      Worker thread: takes part in each wave with its own handle.
+ * Inputs:    pArg - LocalPollWorker, freed by the thread
+ * Return:    NULL
+ */
+static void *local_poll_worker(void *pArg)
+{
+    LocalPollWorker *oWorker = (LocalPollWorker *)pArg;
+    ClickPollScheduler *oScheduler = oWorker->oScheduler;
+    int iHandle = oWorker->iHandle;
+    long iSeen = 0;
+
+    free(oWorker);
+
+    for (;;) {
+        pthread_mutex_lock(&oScheduler->oLock);
+        while (!oScheduler->bStop && oScheduler->iGeneration == iSeen)
+            pthread_cond_wait(&oScheduler->oWake, &oScheduler->oLock);
+        if (oScheduler->bStop) {
+            pthread_mutex_unlock(&oScheduler->oLock);
+            break;
+        }
+        iSeen = oScheduler->iGeneration;
+        pthread_mutex_unlock(&oScheduler->oLock);
+
+        local_poll_wave_work(oScheduler, iHandle);
+
+        pthread_mutex_lock(&oScheduler->oLock);
+        if (--oScheduler->iBusy == 0)
+            pthread_cond_signal(&oScheduler->oDone);
+        pthread_mutex_unlock(&oScheduler->oLock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Function:  local_poll_wave_run
+ * Info:      Polls the current wave: the calling thread polls with the first handle and
+ *            each worker thread with its own, and returns once all polls are done.
+ * Inputs:    oScheduler - scheduler, with aWave and iWaveLen set
+ * Return:    void
+ */
+static void local_poll_wave_run(ClickPollScheduler *oScheduler)
+{
+    oScheduler->iWaveNext = 0;
+
+    if (oScheduler->iHandles > 1) {
+        pthread_mutex_lock(&oScheduler->oLock);
+        oScheduler->iBusy = oScheduler->iHandles - 1;
+        oScheduler->iGeneration++;
+        pthread_cond_broadcast(&oScheduler->oWake);
+        pthread_mutex_unlock(&oScheduler->oLock);
+    }
+
+    local_poll_wave_work(oScheduler, 0);
+
+    if (oScheduler->iHandles > 1) {
+        pthread_mutex_lock(&oScheduler->oLock);
+        while (oScheduler->iBusy > 0)
+            pthread_cond_wait(&oScheduler->oDone, &oScheduler->oLock);
+        pthread_mutex_unlock(&oScheduler->oLock);
+    }
+}
+
+/*
+ * Function:  local_poll_wave_apply
+ * Info:      Acts on the statuses the current wave returned: reports changes, stops
+ *            polling messages with a final status or which have expired, and schedules
+ *            the next poll of the others.
+ * Inputs:    oScheduler - scheduler
+ *            iNowMs     - current time in milliseconds
+ * Return:    void
+ */
+static void local_poll_wave_apply(ClickPollScheduler *oScheduler, long long iNowMs)
+{
+    LocalPollEntry *oEntry = NULL;
+    long long iAgeMs = 0, iDueTick = 0;
+    int i = 0, iEntry = 0, iStatus = 0;
+
+    for (i = 0; i < oScheduler->iWaveLen; i++) {
+        iEntry = oScheduler->aWave[i];
+        oEntry = &oScheduler->aEntries[iEntry];
+        iStatus = oScheduler->aWaveStatus[i];
+        iAgeMs = iNowMs - oEntry->iAddedMs;
+
+        if (iStatus < 0) {
+            oScheduler->oStats.iFailed++;
+            oEntry->iRepeats++;
+        }
+        else if (iStatus != oEntry->iStatus) {
+            oEntry->iStatus  = iStatus;
+            oEntry->iRepeats = 1;
+            if (click_poll_status_final(iStatus)) {
+                oScheduler->oStats.iFinal++;
+                if (oScheduler->fnHandler != NULL)
+                    oScheduler->fnHandler(oScheduler->pContext, oEntry->chMsgId, iStatus, CLICK_POLL_FINAL);
+                goto release;
+            }
+            oScheduler->oStats.iChanged++;
+            if (oScheduler->fnHandler != NULL)
+                oScheduler->fnHandler(oScheduler->pContext, oEntry->chMsgId, iStatus, CLICK_POLL_CHANGED);
+        }
+        else
+            oEntry->iRepeats++;
+
+        if (iAgeMs >= oScheduler->oConfig.iMaxAgeMs) {
+            oScheduler->oStats.iExpired++;
+            if (oScheduler->fnHandler != NULL)
+                oScheduler->fnHandler(oScheduler->pContext, oEntry->chMsgId, oEntry->iStatus, CLICK_POLL_EXPIRED);
+            goto release;
+        }
+
+        iDueTick = (iNowMs + local_poll_interval(oScheduler, oEntry, iAgeMs) + oScheduler->oConfig.iTickMs - 1) /
+                   oScheduler->oConfig.iTickMs;
+        oEntry->iDueTick = (iDueTick > oScheduler->iCursor ? iDueTick : oScheduler->iCursor + 1);
+        local_poll_slot_insert(oScheduler, iEntry);
+        continue;
+
+release:
+        oEntry->iNext = oScheduler->iFree;
+        oScheduler->iFree = iEntry;
+        oScheduler->oStats.iPending--;
+    }
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_poll_status_parse
+ * Info:      Reads the message status from a clickatell_sms_status_get() response, in
+ *            either API's format (ie. "ID: 205e... Status: 004" or
+ *            {"data":{"messageStatus":"004",...}}).
+ * Inputs:    chResponse - response, NUL terminated
+ * Return:    status code (ie. 4), or -1 if the response holds no status (ie. an error)
+ */
+int click_poll_status_parse(const char *chResponse)
+{
+    const char *pStatus = NULL;
+    int iStatus = 0, iDigits = 0;
+
+    if (chResponse == NULL)
+        return -1;
+
+    if ((pStatus = strstr(chResponse, "Status: ")) != NULL)
+        pStatus += 8;
+    else if ((pStatus = strstr(chResponse, "\"messageStatus\":")) != NULL) {
+        pStatus += 16;
+        if (*pStatus == '"')
+            pStatus++;
+    }
+    else
+        return -1;
+
+    for ( ; *pStatus >= '0' && *pStatus <= '9' && iDigits < 4; pStatus++, iDigits++)
+        iStatus = iStatus * 10 + (*pStatus - '0');
+
+    return (iDigits > 0 ? iStatus : -1);
+}
+
+/*
+ * Function:  click_poll_status_final
+ * Info:      Tells whether a message status is final: the message's status will not
+ *            change again, so there is no point polling it.
+ * Inputs:    iStatus - status code (ie. 4 for 004, received by recipient)
+ * Return:    1 if final, else 0
+ */
+int click_poll_status_final(int iStatus)
+{
+    switch (iStatus) {
+        case 4:  // received by recipient
+        case 5:  // error with message
+        case 6:  // user cancelled message delivery
+        case 7:  // error delivering message
+        case 9:  // routing error
+        case 10: // message expired
+        case 12: // out of credit
+        case 14: // maximum MT limit exceeded
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Function:  click_poll_scheduler_create
+ * Info:      Creates a status poll scheduler. A worker thread is started for each handle
+ *            after the first; the thread which runs the scheduler polls with the first.
+ *            The handles must outlive the scheduler, and should not be used for other
+ *            calls meanwhile (they would hold up the waves).
+ *            Note that the calling function must destroy the returned scheduler.
+ * Inputs:    aHandles  - handles to poll with
+ *            iHandles  - number of handles, 1 to CLICK_POLL_HANDLES_MAX
+ *            iCapacity - most messages tracked at once
+ *            oConfig   - settings, or NULL for the defaults
+ *            fnHandler - status handler, or NULL
+ *            pContext  - opaque argument passed to the handler
+ * Return:    new scheduler, or NULL if invalid parameter or failed to allocate memory
+ */
+ClickPollScheduler *click_poll_scheduler_create(ClickSmsHandle *const *aHandles, int iHandles, long iCapacity,
+                                                const ClickPollConfig *oConfig, ClickPollHandler fnHandler, void *pContext)
+{
+    ClickPollScheduler *oScheduler = NULL;
+    LocalPollWorker *oWorker = NULL;
+    long i = 0;
+
+    if (aHandles == NULL || iHandles < 1 || iHandles > CLICK_POLL_HANDLES_MAX || iCapacity < 1 || iCapacity > 0x7fffffffL ||
+        (oConfig != NULL && (oConfig->fRate < 0 || oConfig->iTickMs < 0 || oConfig->iFirstPollMs < 0 ||
+                             oConfig->iMaxIntervalMs < 0 || oConfig->iMaxAgeMs < 0)))
+    {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+    for (i = 0; i < iHandles; i++) {
+        if (aHandles[i] == NULL) {
+            click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+            return NULL;
+        }
+    }
+
+    if ((oScheduler = (ClickPollScheduler *)calloc(1, sizeof(ClickPollScheduler))) == NULL ||
+        (oScheduler->aEntries = (LocalPollEntry *)malloc(iCapacity * sizeof(LocalPollEntry))) == NULL ||
+        (oScheduler->aWave = (int *)malloc(iHandles * LOCAL_POLL_WAVE_PER_HANDLE * sizeof(int))) == NULL ||
+        (oScheduler->aWaveStatus = (int *)malloc(iHandles * LOCAL_POLL_WAVE_PER_HANDLE * sizeof(int))) == NULL)
+    {
+        click_debug_print("%s ERROR: Failed to allocate memory for poll scheduler!\n", __func__);
+        if (oScheduler != NULL) {
+            free(oScheduler->aWave);
+            free(oScheduler->aEntries);
+        }
+        free(oScheduler);
+        return NULL;
+    }
+
+    if (oConfig != NULL)
+        oScheduler->oConfig = *oConfig;
+    if (oScheduler->oConfig.iTickMs == 0)
+        oScheduler->oConfig.iTickMs = LOCAL_POLL_TICK_MS;
+    if (oScheduler->oConfig.iFirstPollMs == 0)
+        oScheduler->oConfig.iFirstPollMs = LOCAL_POLL_FIRST_MS;
+    if (oScheduler->oConfig.iMaxIntervalMs == 0)
+        oScheduler->oConfig.iMaxIntervalMs = LOCAL_POLL_MAX_INTERVAL_MS;
+    if (oScheduler->oConfig.iMaxAgeMs == 0)
+        oScheduler->oConfig.iMaxAgeMs = LOCAL_POLL_MAX_AGE_MS;
+    oScheduler->fnHandler = fnHandler;
+    oScheduler->pContext  = pContext;
+
+    // all entries start on the free list, and all slots empty
+    oScheduler->iCapacity = iCapacity;
+    for (i = 0; i < iCapacity; i++)
+        oScheduler->aEntries[i].iNext = (i + 1 < iCapacity ? (int)i + 1 : -1);
+    oScheduler->iFree = 0;
+    for (i = 0; i < LOCAL_POLL_WHEEL_SLOTS; i++)
+        oScheduler->aSlots[i] = -1;
+    oScheduler->iCursor    = -1;
+    oScheduler->iReadyHead = oScheduler->iReadyTail = -1;
+    oScheduler->iBudgetMs  = -1;
+
+    memcpy(oScheduler->aHandles, aHandles, iHandles * sizeof(ClickSmsHandle *));
+    pthread_mutex_init(&oScheduler->oLock, NULL);
+    pthread_cond_init(&oScheduler->oWake, NULL);
+    pthread_cond_init(&oScheduler->oDone, NULL);
+    for (oScheduler->iHandles = 1; oScheduler->iHandles < iHandles; oScheduler->iHandles++) {
+        if ((oWorker = (LocalPollWorker *)malloc(sizeof(LocalPollWorker))) == NULL)
+            break;
+        oWorker->oScheduler = oScheduler;
+        oWorker->iHandle    = oScheduler->iHandles;
+        if (pthread_create(&oScheduler->aThreads[oScheduler->iHandles], NULL, local_poll_worker, oWorker) != 0) {
+            free(oWorker);
+            break;
+        }
+    }
+    if (oScheduler->iHandles < iHandles)
+        click_debug_print("%s ERROR: Started %d of %d poll threads!\n", __func__, oScheduler->iHandles - 1, iHandles - 1);
+
+    return oScheduler;
+}
+
+/*
+ * Function:  click_poll_scheduler_destroy
+ * Info:      Stops a scheduler's worker threads and frees it. Messages still pending are
+ *            dropped without being reported.
+ * Inputs:    oScheduler - scheduler to destroy
+ * Return:    void
+ */
+void click_poll_scheduler_destroy(ClickPollScheduler *oScheduler)
+{
+    int i = 0;
+
+    if (oScheduler == NULL)
+        return;
+
+    pthread_mutex_lock(&oScheduler->oLock);
+    oScheduler->bStop = 1;
+    pthread_cond_broadcast(&oScheduler->oWake);
+    pthread_mutex_unlock(&oScheduler->oLock);
+    for (i = 1; i < oScheduler->iHandles; i++)
+        pthread_join(oScheduler->aThreads[i], NULL);
+
+    pthread_cond_destroy(&oScheduler->oDone);
+    pthread_cond_destroy(&oScheduler->oWake);
+    pthread_mutex_destroy(&oScheduler->oLock);
+    free(oScheduler->aWaveStatus);
+    free(oScheduler->aWave);
+    free(oScheduler->aEntries);
+    free(oScheduler);
+}
+
+/*
+ * Function:  click_poll_scheduler_add
+ * Info:      Starts tracking a sent message: its first poll is due iFirstPollMs later.
+ * Inputs:    oScheduler - scheduler
+ *            chMsgId    - API Message ID returned when the message was sent
+ *            iNowMs     - current time in milliseconds (the clock passed to
+ *                         click_poll_scheduler_run())
+ * Return:    0 if successful, else -1 if invalid parameter or the scheduler is full
+ */
+int click_poll_scheduler_add(ClickPollScheduler *oScheduler, const char *chMsgId, long long iNowMs)
+{
+    LocalPollEntry *oEntry = NULL;
+    long long iDueTick = 0;
+    int iEntry = 0;
+
+    if (oScheduler == NULL || chMsgId == NULL || chMsgId[0] == '\0' || strlen(chMsgId) >= CLICK_POLL_ID_MAX || iNowMs < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+    if ((iEntry = oScheduler->iFree) < 0) {
+        click_debug_print("%s ERROR: Poll scheduler is tracking %ld messages already!\n", __func__, oScheduler->iCapacity);
+        return -1;
+    }
+
+    if (oScheduler->iCursor < 0)
+        oScheduler->iCursor = iNowMs / oScheduler->oConfig.iTickMs;
+
+    oEntry = &oScheduler->aEntries[iEntry];
+    oScheduler->iFree = oEntry->iNext;
+    strcpy(oEntry->chMsgId, chMsgId);
+    oEntry->iAddedMs = iNowMs;
+    oEntry->iStatus  = 0;
+    oEntry->iRepeats = 0;
+    iDueTick = (iNowMs + oScheduler->oConfig.iFirstPollMs + oScheduler->oConfig.iTickMs - 1) / oScheduler->oConfig.iTickMs;
+    oEntry->iDueTick = (iDueTick > oScheduler->iCursor ? iDueTick : oScheduler->iCursor + 1);
+    local_poll_slot_insert(oScheduler, iEntry);
+    oScheduler->oStats.iPending++;
+
+    return 0;
+}
+
+/*
+ * Function:  click_poll_scheduler_run
+ * Info:      Makes the polls which are due: the timing wheel is turned up to the current
+ *            time, then due polls are made in waves while the rate budget allows, and
+ *            their statuses acted on (see ClickPollHandler). Due polls over budget are
+ *            made first on a later run. Call this regularly (ie. every iTickMs) from one
+ *            thread.
+ * Inputs:    oScheduler - scheduler
+ *            iNowMs     - current time in milliseconds, from a clock which never goes back
+ * Return:    number of polls made, or -1 if invalid parameter
+ */
+long click_poll_scheduler_run(ClickPollScheduler *oScheduler, long long iNowMs)
+{
+    long iPolls = 0, iBurst = 0;
+    int iWaveMax = 0;
+
+    if (oScheduler == NULL || iNowMs < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    local_poll_advance(oScheduler, iNowMs);
+
+    // top up the rate budget, which holds at most a second's polls
+    if (oScheduler->oConfig.fRate > 0) {
+        iBurst = (oScheduler->oConfig.fRate > 1 ? (long)oScheduler->oConfig.fRate : 1);
+        if (oScheduler->iBudgetMs < 0)
+            oScheduler->fTokens = iBurst;
+        else if (iNowMs > oScheduler->iBudgetMs)
+            oScheduler->fTokens += (iNowMs - oScheduler->iBudgetMs) * oScheduler->oConfig.fRate / 1000.0;
+        if (oScheduler->fTokens > iBurst)
+            oScheduler->fTokens = iBurst;
+        oScheduler->iBudgetMs = iNowMs;
+    }
+
+    while (oScheduler->iReadyHead >= 0) {
+        iWaveMax = oScheduler->iHandles * LOCAL_POLL_WAVE_PER_HANDLE;
+        if (oScheduler->oConfig.fRate > 0 && oScheduler->fTokens < iWaveMax)
+            iWaveMax = (int)oScheduler->fTokens;
+        if (iWaveMax < 1)
+            break;
+
+        for (oScheduler->iWaveLen = 0; oScheduler->iWaveLen < iWaveMax && oScheduler->iReadyHead >= 0; oScheduler->iWaveLen++) {
+            oScheduler->aWave[oScheduler->iWaveLen] = oScheduler->iReadyHead;
+            oScheduler->iReadyHead = oScheduler->aEntries[oScheduler->iReadyHead].iNext;
+        }
+        if (oScheduler->iReadyHead < 0)
+            oScheduler->iReadyTail = -1;
+
+        local_poll_wave_run(oScheduler);
+        local_poll_wave_apply(oScheduler, iNowMs);
+
+        if (oScheduler->oConfig.fRate > 0)
+            oScheduler->fTokens -= oScheduler->iWaveLen;
+        iPolls += oScheduler->iWaveLen;
+        oScheduler->oStats.iPolls += oScheduler->iWaveLen;
+        oScheduler->oStats.iWaves++;
+    }
+
+    // count the polls held over by the budget
+    for (iWaveMax = oScheduler->iReadyHead; iWaveMax >= 0; iWaveMax = oScheduler->aEntries[iWaveMax].iNext)
+        oScheduler->oStats.iDeferred++;
+
+    return iPolls;
+}
+
+/*
+ * Function:  click_poll_scheduler_pending
+ * Info:      Returns the number of messages being polled.
+ * Inputs:    oScheduler - scheduler
+ * Return:    number of messages, or -1 if invalid parameter
+ */
+long click_poll_scheduler_pending(const ClickPollScheduler *oScheduler)
+{
+    if (oScheduler == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    return oScheduler->oStats.iPending;
+}
+
+/*
+ * Function:  click_poll_scheduler_stats_get
+ * Info:      Reads a scheduler's counters.
+ * Inputs:    oScheduler - scheduler
+ * Outputs:   oStats     - counters
+ * Return:    void
+ */
+void click_poll_scheduler_stats_get(const ClickPollScheduler *oScheduler, ClickPollStats *oStats)
+{
+    if (oScheduler == NULL || oStats == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    *oStats = oScheduler->oStats;
+}
@@ -0,0 +1,78 @@
+#ifndef CLICKATELL_POLL_H
+#define CLICKATELL_POLL_H
+
+/*
+ * clickatell_poll.h
+ *
+ *  Status poll scheduler module used by the Clickatell SMS library.
+ *
+ *  Where delivery receipt callbacks are not available (see clickatell_callback.h), the
+ *  status of sent messages has to be polled with clickatell_sms_status_get(). Polling
+ *  every message on a fixed interval mostly returns "still pending"; a
+ *  ClickPollScheduler instead polls each message on its own adaptive schedule:
+ *    - the interval depends on the last status seen: short once the message has reached
+ *      the gateway (delivery is close), long while it is queued for later delivery,
+ *    - the interval grows each time a poll returns the same status, and with the
+ *      message's age (never more than a tenth of its age, so that a status is never
+ *      much staler than the message is old), up to a maximum,
+ *    - a message stops being polled once a final status is seen, or once it is too old.
+ *
+ *  Pending messages are kept in a hashed timing wheel. When the scheduler is run, the
+ *  polls which are due are made in waves spread over one or more handles (one thread
+ *  per handle, since a handle serializes its API calls), within a polling rate budget;
+ *  polls over budget wait for the next run. The clock is passed in by the caller, so the
+ *  scheduler can be driven from any loop.
+ */
+
+#include "clickatell_string.h"
+#include "clickatell_sms.h"
+
+#define CLICK_POLL_ID_MAX       48  // size of a tracked message ID, including the NUL
+#define CLICK_POLL_HANDLES_MAX  64  // most handles a scheduler polls with
+
+// Enumeration of the events reported to a ClickPollHandler
+typedef enum eClickPollEvent {
+    CLICK_POLL_CHANGED, // a poll returned a new status which is not final; the message is still polled
+    CLICK_POLL_FINAL,   // a poll returned a final status (ie. 004 received by recipient); polling stopped
+    CLICK_POLL_EXPIRED  // the message reached its maximum age without a final status; polling stopped
+} eClickPollEvent;
+
+// Status handler, called on the thread which runs the scheduler
+typedef void (*ClickPollHandler)(void *pContext, const char *chMsgId, int iStatus, eClickPollEvent eEvent);
+
+// Scheduler settings: fields left 0 take the default
+typedef struct ClickPollConfig {
+    double fRate;           // most polls per second over all handles (0: no limit)
+    long   iTickMs;         // timing wheel resolution in milliseconds (250)
+    long   iFirstPollMs;    // delay between adding a message and its first poll (5000)
+    long   iMaxIntervalMs;  // longest interval between polls of a message (300000)
+    long   iMaxAgeMs;       // age at which a message without a final status expires (172800000, 48 hours)
+} ClickPollConfig;
+
+// Counters of a ClickPollScheduler (see click_poll_scheduler_stats_get())
+typedef struct ClickPollStats {
+    long iPending;          // messages being polled
+    long iPolls;            // polls made
+    long iWaves;            // waves of concurrent polls made
+    long iFailed;           // polls which failed or returned no status
+    long iChanged;          // status changes reported
+    long iFinal;            // final statuses reported
+    long iExpired;          // messages expired
+    long iDeferred;         // due polls left waiting by the rate budget, summed over runs
+} ClickPollStats;
+
+// status poll scheduler (opaque)
+typedef struct ClickPollScheduler ClickPollScheduler;
+
+// function declarations
+ClickPollScheduler *click_poll_scheduler_create(ClickSmsHandle *const *aHandles, int iHandles, long iCapacity,
+                                                const ClickPollConfig *oConfig, ClickPollHandler fnHandler, void *pContext);
+void click_poll_scheduler_destroy(ClickPollScheduler *oScheduler);
+int click_poll_scheduler_add(ClickPollScheduler *oScheduler, const char *chMsgId, long long iNowMs);
+long click_poll_scheduler_run(ClickPollScheduler *oScheduler, long long iNowMs);
+long click_poll_scheduler_pending(const ClickPollScheduler *oScheduler);
+void click_poll_scheduler_stats_get(const ClickPollScheduler *oScheduler, ClickPollStats *oStats);
+int click_poll_status_parse(const char *chResponse);
+int click_poll_status_final(int iStatus);
+
+#endif // CLICKATELL_POLL_H
@@ -0,0 +1,367 @@
+/*
+ * clickatell_recipients.c
+ *
+ *  Compact recipient list: E.164 numbers in one ','-separated buffer plus offsets.
+ *  See clickatell_recipients.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_msisdn.h"
+#include "clickatell_recipients.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+#define LOCAL_RECIPIENTS_MIN_OFFSETS    16  // offsets allocated for a list's first number
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static int local_recipients_reserve(ClickRecipients *oRecipients, long iNum, long iDigits);
+static char *local_recipients_slot(ClickRecipients *oRecipients);
+static void local_recipients_commit(ClickRecipients *oRecipients, long iDigits);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_recipients_reserve
+ * Info:      Makes room for more numbers, so that adding them does not reallocate.
+ * Inputs:    oRecipients - recipient list
+ *            iNum        - count of numbers to make room for
+ *            iDigits     - bytes of digits and separators to make room for
+ * Return:    0 if successful, else -1 if failed to allocate memory
+ */
+static int local_recipients_reserve(ClickRecipients *oRecipients, long iNum, long iDigits)
+{
+    long *aReallocatedOffsets = NULL;
+    long iNewSize = (oRecipients->iOffsetsSize > 0 ? oRecipients->iOffsetsSize : LOCAL_RECIPIENTS_MIN_OFFSETS);
+
+    // one extra offset marks the end of the last number
+    if (oRecipients->iNum + iNum + 1 > oRecipients->iOffsetsSize) {
+        while (iNewSize < oRecipients->iNum + iNum + 1)
+            iNewSize *= 2;
+
+        if ((aReallocatedOffsets = realloc(oRecipients->aOffsets, iNewSize * sizeof(long))) == NULL) {
+            click_debug_print("%s ERROR: Failed to allocate memory for recipient offsets!\n", __func__);
+            return -1;
+        }
+        oRecipients->aOffsets     = aReallocatedOffsets;
+        oRecipients->iOffsetsSize = iNewSize;
+    }
+
+    return click_buffer_reserve(&oRecipients->oDigits, iDigits);
+}
+
+/*
+ * Function:  local_recipients_slot
+ * Info:      Returns where the next number's digits are written: after the end of the
+ *            list and the ',' which separates it from the previous number. Room for the
+ *            number must have been reserved.
+ * Inputs:    oRecipients - recipient list
+ * Return:    start of the next number
+ */
+static char *local_recipients_slot(ClickRecipients *oRecipients)
+{
+    return oRecipients->oDigits.data + oRecipients->oDigits.iLen + (oRecipients->iNum > 0);
+}
+
+/*
+ * Function:  local_recipients_commit
+ * Info:      Adds the number written at local_recipients_slot() to the list.
+ * Inputs:    oRecipients - recipient list
+ *            iDigits     - count of digits written
+ * Return:    void
+ */
+static void local_recipients_commit(ClickRecipients *oRecipients, long iDigits)
+{
+    ClickSmsBuffer *oDigits = &oRecipients->oDigits;
+
+    if (oRecipients->iNum > 0)
+        oDigits->data[oDigits->iLen++] = ',';
+
+    oRecipients->aOffsets[oRecipients->iNum++] = oDigits->iLen;
+    oDigits->iLen += iDigits;
+    oDigits->data[oDigits->iLen] = '\0';
+    oRecipients->aOffsets[oRecipients->iNum] = oDigits->iLen + 1;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_recipients_create
+ * Info:      Creates an empty recipient list.
+ *            Note that the calling function must destroy the returned list.
+ * Inputs:    iCapacity - count of numbers to allocate room for up front, or 0
+ * Return:    new recipient list, or NULL if failed to allocate memory
+ */
+ClickRecipients *click_recipients_create(long iCapacity)
+{
+    ClickRecipients *oRecipients = NULL;
+
+    if (iCapacity < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if ((oRecipients = (ClickRecipients *)calloc(1, sizeof(ClickRecipients))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for recipient list!\n", __func__);
+        return NULL;
+    }
+
+    if (iCapacity > 0 && local_recipients_reserve(oRecipients, iCapacity, iCapacity * (CLICK_MSISDN_MAX_DIGITS + 1)) != 0) {
+        click_recipients_destroy(oRecipients);
+        return NULL;
+    }
+
+    return oRecipients;
+}
+
+/*
+ * Function:  click_recipients_destroy
+ * Info:      Destroys a recipient list.
+ * Inputs:    oRecipients - recipient list to destroy
+ * Return:    void
+ */
+void click_recipients_destroy(ClickRecipients *oRecipients)
+{
+    if (oRecipients == NULL)
+        return;
+
+    click_buffer_free(&oRecipients->oDigits);
+    free(oRecipients->aOffsets);
+    free(oRecipients);
+}
+
+/*
+ * Function:  click_recipients_reset
+ * Info:      Empties a recipient list, keeping its memory for reuse.
+ * Inputs:    oRecipients - recipient list
+ * Return:    void
+ */
+void click_recipients_reset(ClickRecipients *oRecipients)
+{
+    if (oRecipients == NULL)
+        return;
+
+    oRecipients->iNum = 0;
+    click_buffer_reset(&oRecipients->oDigits);
+}
+
+/*
+ * Function:  click_recipients_add
+ * Info:      Normalizes a number to E.164 (see click_msisdn_normalize()) and adds it to
+ *            a list. The number is normalized straight into the list's buffer.
+ * Inputs:    oRecipients - recipient list
+ *            chNumber    - number as entered (need not be NUL terminated)
+ *            iLen        - length of number in bytes
+ *            oRules      - rules for national numbers, or NULL for international numbers only
+ * Return:    CLICK_MSISDN_OK (0) if added, the reason the number is invalid (not added), or
+ *            -1 if invalid parameter or failed to allocate memory
+ */
+int click_recipients_add(ClickRecipients *oRecipients, const char *chNumber, long iLen, const ClickMsisdnRules *oRules)
+{
+    eClickMsisdnStatus eStatus = CLICK_MSISDN_OK;
+    char *chSlot = NULL;
+
+    if (oRecipients == NULL || chNumber == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if (local_recipients_reserve(oRecipients, 1, CLICK_MSISDN_MAX_DIGITS + 1) != 0)
+        return -1;
+
+    chSlot = local_recipients_slot(oRecipients);
+    if ((eStatus = click_msisdn_normalize(chNumber, iLen, oRules, chSlot, NULL)) == CLICK_MSISDN_OK)
+        local_recipients_commit(oRecipients, strlen(chSlot));
+    else
+        oRecipients->oDigits.data[oRecipients->oDigits.iLen] = '\0'; // the slot may have been the list's end
+
+    return eStatus;
+}
+
+/*
+ * Function:  click_recipients_add_value
+ * Info:      Adds an E.164 number held as an integer (see click_msisdn_normalize_batch())
+ *            to a list.
+ * Inputs:    oRecipients - recipient list
+ *            iValue      - E.164 number as an integer
+ * Return:    0 if successful, else -1 if invalid parameter (ie. not an E.164 number) or
+ *            failed to allocate memory
+ */
+int click_recipients_add_value(ClickRecipients *oRecipients, unsigned long long iValue)
+{
+    int iDigits = 0;
+
+    if (oRecipients == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if (local_recipients_reserve(oRecipients, 1, CLICK_MSISDN_MAX_DIGITS + 1) != 0)
+        return -1;
+
+    if ((iDigits = click_msisdn_format(iValue, local_recipients_slot(oRecipients))) < 0)
+        return -1;
+
+    local_recipients_commit(oRecipients, iDigits);
+
+    return 0;
+}
+
+/*
+ * Function:  click_recipients_parse
+ * Info:      Adds the numbers of a delimited buffer (ie. "0821234567, +27 83 765 4321\n...")
+ *            to a list in a single pass. Numbers are separated by any of
+ *            CLICK_RECIPIENTS_DELIMITERS and each is normalized straight into the list's
+ *            buffer. Empty entries are ignored; invalid numbers are counted and skipped.
+ * Inputs:    oRecipients - recipient list
+ *            chList      - delimited numbers (need not be NUL terminated)
+ *            iLen        - length of chList in bytes
+ *            oRules      - rules for national numbers, or NULL for international numbers only
+ * Outputs:   iInvalid    - count of invalid numbers skipped. May be NULL.
+ * Return:    count of numbers added, or -1 if invalid parameter or failed to allocate memory
+ */
+long click_recipients_parse(ClickRecipients *oRecipients, const char *chList, long iLen,
+                            const ClickMsisdnRules *oRules, long *iInvalid)
+{
+    unsigned char aDelimiters[256] = { 0 };
+    const char *pDelimiter = CLICK_RECIPIENTS_DELIMITERS;
+    const char *pEntry = chList, *pEnd = chList + iLen, *pText = NULL;
+    long iAdded = 0, iBad = 0;
+    eClickMsisdnStatus eStatus = CLICK_MSISDN_OK;
+    char *chSlot = NULL;
+
+    if (iInvalid != NULL)
+        *iInvalid = 0;
+
+    if (oRecipients == NULL || chList == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (; *pDelimiter != '\0'; pDelimiter++)
+        aDelimiters[(unsigned char)*pDelimiter] = 1;
+
+    // most lists are 8 to 16 byte numbers with their delimiters: reserve for that up front
+    if (local_recipients_reserve(oRecipients, iLen / 8 + 1, iLen + iLen / 4 + CLICK_MSISDN_MAX_DIGITS + 1) != 0)
+        return -1;
+
+    for (pText = chList; pText <= pEnd; pText++) {
+        if (pText < pEnd && !aDelimiters[(unsigned char)*pText])
+            continue;
+
+        if (pText > pEntry) {
+            if (local_recipients_reserve(oRecipients, 1, CLICK_MSISDN_MAX_DIGITS + 1) != 0)
+                return -1;
+
+            chSlot = local_recipients_slot(oRecipients);
+            if ((eStatus = click_msisdn_normalize(pEntry, pText - pEntry, oRules, chSlot, NULL)) == CLICK_MSISDN_OK) {
+                local_recipients_commit(oRecipients, strlen(chSlot));
+                iAdded++;
+            }
+            else {
+                oRecipients->oDigits.data[oRecipients->oDigits.iLen] = '\0'; // the slot may have been the list's end
+                iBad += (eStatus != CLICK_MSISDN_EMPTY); // empty entries (ie. only spaces) are not counted
+            }
+        }
+        pEntry = pText + 1;
+    }
+
+    if (iInvalid != NULL)
+        *iInvalid = iBad;
+
+    return iAdded;
+}
+
+/*
+ * Function:  click_recipients_get
+ * Info:      Returns a number of a list, in place in the list's buffer. The number is
+ *            followed by the ',' before the next number, so is NUL terminated only if it
+ *            is the last.
+ * Inputs:    oRecipients - recipient list
+ *            iIndex      - index of the number
+ * Outputs:   iLen        - count of digits of the number
+ * Return:    start of the number, or NULL if invalid parameter
+ */
+const char *click_recipients_get(const ClickRecipients *oRecipients, long iIndex, long *iLen)
+{
+    if (oRecipients == NULL || iLen == NULL || iIndex < 0 || iIndex >= oRecipients->iNum) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    *iLen = oRecipients->aOffsets[iIndex + 1] - 1 - oRecipients->aOffsets[iIndex];
+
+    return oRecipients->oDigits.data + oRecipients->aOffsets[iIndex];
+}
+
+/*
+ * Function:  click_recipients_dedup
+ * Info:      Removes repeated numbers from a list in place, so that each number is sent
+ *            (and charged for) once. The first occurrence of each number is kept, in
+ *            order, and the list's buffer is compacted. Runs in linear time, using a
+ *            single scratch allocation (see click_msisdn_set_create()).
+ * Inputs:    oRecipients - recipient list
+ * Outputs:   aMap        - for each original position (oRecipients->iNum entries before
+ *                          the call), the position of its number in the deduplicated list.
+ *                          A position was collapsed if an earlier position maps to the same
+ *                          number. May be NULL.
+ * Return:    count of numbers removed, or -1 if invalid parameter or failed to allocate memory
+ */
+long click_recipients_dedup(ClickRecipients *oRecipients, long *aMap)
+{
+    ClickMsisdnSet *oSet = NULL;
+    ClickSmsBuffer *oDigits = NULL;
+    long i = 0, iNum = 0, iFirst = 0, iStart = 0, iLen = 0, iOut = 0;
+
+    if (oRecipients == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if (oRecipients->iNum == 0)
+        return 0;
+
+    if ((oSet = click_msisdn_set_create(oRecipients->iNum)) == NULL)
+        return -1;
+
+    // numbers are only ever moved towards the start of the buffer, so are compacted in place
+    oDigits = &oRecipients->oDigits;
+    for (i = 0; i < oRecipients->iNum; i++) {
+        iStart = oRecipients->aOffsets[i];
+        iLen   = oRecipients->aOffsets[i + 1] - 1 - iStart;
+        iFirst = click_msisdn_set_insert(oSet, click_msisdn_key(oDigits->data + iStart, iLen), iNum);
+
+        if (iFirst == iNum) {
+            if (iNum > 0)
+                oDigits->data[iOut++] = ',';
+            memmove(oDigits->data + iOut, oDigits->data + iStart, iLen);
+            oRecipients->aOffsets[iNum++] = iOut;
+            iOut += iLen;
+        }
+
+        if (aMap != NULL)
+            aMap[i] = iFirst;
+    }
+
+    oDigits->iLen = iOut;
+    oDigits->data[iOut] = '\0';
+    oRecipients->aOffsets[iNum] = iOut + 1;
+
+    i = oRecipients->iNum - iNum;
+    oRecipients->iNum = iNum;
+    click_msisdn_set_destroy(oSet);
+
+    return i;
+}
@@ -0,0 +1,45 @@
+#ifndef CLICKATELL_RECIPIENTS_H
+#define CLICKATELL_RECIPIENTS_H
+
+/*
+ * clickatell_recipients.h
+ *
+ *  Compact recipient list used by the Clickatell SMS library.
+ *
+ *  Unlike ClickMsisdn (an array of individually allocated strings), a ClickRecipients
+ *  list keeps all of its numbers in one buffer, normalized to E.164 digits and separated
+ *  by ',', plus an array of offsets: a list of any size takes two allocations. The
+ *  buffer is laid out exactly as the HTTP API's "to" parameter, so it is written into a
+ *  request with a single copy, and each number is found in place for the REST API.
+ *
+ *  Lists are built number by number, from 64-bit values (see
+ *  click_msisdn_normalize_batch()) or by parsing a delimited buffer in a single pass. A
+ *  list which is not being changed may be sent from several threads at once.
+ */
+
+#include "clickatell_string.h"
+#include "clickatell_msisdn.h"
+
+// delimiters between numbers parsed by click_recipients_parse()
+#define CLICK_RECIPIENTS_DELIMITERS ",;\t\r\n"
+
+// compact recipient list (see clickatell_sms_message_send_recipients()); a zeroed list is empty
+typedef struct ClickRecipients {
+    long iNum;              // number of recipients
+    long iOffsetsSize;      // allocated entries of aOffsets
+    long *aOffsets;         // start of each number in oDigits, plus one entry past the last separator
+    ClickSmsBuffer oDigits; // E.164 numbers, separated by ','
+} ClickRecipients;
+
+// function declarations
+ClickRecipients *click_recipients_create(long iCapacity);
+void click_recipients_destroy(ClickRecipients *oRecipients);
+void click_recipients_reset(ClickRecipients *oRecipients);
+int click_recipients_add(ClickRecipients *oRecipients, const char *chNumber, long iLen, const ClickMsisdnRules *oRules);
+int click_recipients_add_value(ClickRecipients *oRecipients, unsigned long long iValue);
+long click_recipients_parse(ClickRecipients *oRecipients, const char *chList, long iLen,
+                            const ClickMsisdnRules *oRules, long *iInvalid);
+const char *click_recipients_get(const ClickRecipients *oRecipients, long iIndex, long *iLen);
+long click_recipients_dedup(ClickRecipients *oRecipients, long *aMap);
+
+#endif // CLICKATELL_RECIPIENTS_H
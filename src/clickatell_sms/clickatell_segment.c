@@ -0,0 +1,242 @@
+/*
+ * clickatell_segment.c
+ *
+ *  Long message segmentation module: calculates how many parts (SMSes) a message is sent
+ *  as, and splits messages into parts with concatenation UDH. See clickatell_segment.h.
+ */
+
+#include <string.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_charset.h"
+#include "clickatell_segment.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// fill bits after the concatenation UDH (48 bits), so that GSM 7-bit text starts on a septet boundary
+#define CLICK_SEGMENT_UDH_FILL_BITS 1
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static long local_segment_part_end(const unsigned char *pText, long iLen, long iPos, eClickCharset eCharset,
+                                   long iCapacity, long *iUnits);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_segment_part_end
+ * Info:      Finds where a part which starts at 'iPos' ends: after as many whole
+ *            characters as fit in its capacity.
+ * Inputs:    pText     - valid UTF-8 text
+ *            iLen      - length of text in bytes
+ *            iPos      - byte offset at which the part starts
+ *            eCharset  - CLICK_CHARSET_GSM7 or CLICK_CHARSET_UCS2
+ *            iCapacity - septets or code units which fit in the part
+ * Outputs:   iUnits    - septets or code units of the part's text
+ * Return:    byte offset at which the part ends
+ */
+static long local_segment_part_end(const unsigned char *pText, long iLen, long iPos, eClickCharset eCharset,
+                                   long iCapacity, long *iUnits)
+{
+    long iCodePoint = 0, iCharUnits = 0;
+    int iCharLen = 0;
+
+    *iUnits = 0;
+
+    while (iPos < iLen) {
+        if ((iCharLen = click_charset_utf8_decode(pText + iPos, iLen - iPos, &iCodePoint)) == 0)
+            break;
+
+        if (eCharset == CLICK_CHARSET_GSM7)
+            iCharUnits = (click_charset_gsm7_lookup(iCodePoint) & CLICK_CHARSET_GSM7_EXT ? 2 : 1);
+        else
+            iCharUnits = (iCodePoint > 0xffff ? 2 : 1);
+
+        if (*iUnits + iCharUnits > iCapacity)
+            break;
+
+        *iUnits += iCharUnits;
+        iPos    += iCharLen;
+    }
+
+    return iPos;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_segment_count
+ * Info:      Calculates how many parts a message is sent as. No memory is allocated, so
+ *            this may be called for every message for cost and rate accounting. Unless the
+ *            message is concatenated and contains GSM extension characters or characters
+ *            above U+FFFF (which must not be split between parts), this costs no more than
+ *            click_charset_classify().
+ * Inputs:    chText - UTF-8 message text (need not be NUL terminated)
+ *            iLen   - length of text in bytes
+ * Outputs:   oInfo  - part count details. May be NULL.
+ * Return:    number of parts (1 for an empty message), or -1 if the text is not valid
+ *            UTF-8. Messages of more than CLICK_SEGMENT_MAX_PARTS parts cannot be sent.
+ */
+int click_segment_count(const char *chText, long iLen, ClickSegmentInfo *oInfo)
+{
+    ClickCharsetInfo oCharset;
+    long iUnits = 0, iSingle = 0, iMulti = 0, iPos = 0, iPartUnits = 0, iParts = 0;
+
+    if (oInfo != NULL)
+        memset(oInfo, 0, sizeof(ClickSegmentInfo));
+
+    if (click_charset_classify(chText, iLen, &oCharset) == CLICK_CHARSET_INVALID)
+        return -1;
+
+    if (oCharset.eCharset == CLICK_CHARSET_GSM7) {
+        iUnits  = oCharset.iSeptets;
+        iSingle = CLICK_SEGMENT_GSM7_SINGLE;
+        iMulti  = CLICK_SEGMENT_GSM7_MULTI;
+    }
+    else {
+        iUnits  = oCharset.iUcs2Units;
+        iSingle = CLICK_SEGMENT_UCS2_SINGLE;
+        iMulti  = CLICK_SEGMENT_UCS2_MULTI;
+    }
+
+    if (iUnits <= iSingle) {
+        iParts     = 1;
+        iPartUnits = iUnits;
+        iMulti     = iSingle;
+    }
+    else if (iUnits == oCharset.iChars) {
+        // every character is a single unit, so parts are filled completely
+        iParts     = (iUnits + iMulti - 1) / iMulti;
+        iPartUnits = iUnits - (iParts - 1) * iMulti;
+    }
+    else {
+        for (iPos = 0; iPos < iLen; iParts++)
+            iPos = local_segment_part_end((const unsigned char *)chText, iLen, iPos, oCharset.eCharset, iMulti, &iPartUnits);
+    }
+
+    if (oInfo != NULL) {
+        oInfo->eCharset      = oCharset.eCharset;
+        oInfo->iParts        = (int)iParts;
+        oInfo->iUnits        = iUnits;
+        oInfo->iUnitsPerPart = iMulti;
+        oInfo->iUnitsFree    = iMulti - iPartUnits;
+    }
+
+    return (int)iParts;
+}
+
+/*
+ * Function:  click_segment_split
+ * Info:      Splits a message into parts ready for binary sending: each part of a
+ *            concatenated message starts with a concatenation UDH, followed by its text
+ *            as packed GSM 7-bit (aligned to a septet boundary after the UDH) or UCS-2
+ *            big-endian. A single part message has no UDH. No memory is allocated.
+ * Inputs:    chText     - UTF-8 message text (need not be NUL terminated)
+ *            iLen       - length of text in bytes
+ *            iReference - concatenation reference number (0-255), which should differ
+ *                         between concatenated messages sent to the same recipient
+ *            aParts     - output parts
+ *            iMaxParts  - size of the aParts array
+ * Return:    number of parts written, or -1 if the text is not valid UTF-8 or needs more
+ *            than 'iMaxParts' (or CLICK_SEGMENT_MAX_PARTS) parts
+ */
+int click_segment_split(const char *chText, long iLen, int iReference, ClickSegmentPart *aParts, int iMaxParts)
+{
+    const unsigned char *pText = (const unsigned char *)chText;
+    ClickSegmentInfo oInfo;
+    ClickSegmentPart *oPart = NULL;
+    long iPos = 0, iEnd = 0, iUnits = 0, iTextLen = 0;
+    int i = 0;
+
+    if (aParts == NULL || iMaxParts < 1) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if (click_segment_count(chText, iLen, &oInfo) < 0) {
+        click_debug_print("%s ERROR: Message text is not valid UTF-8!\n", __func__);
+        return -1;
+    }
+
+    if (oInfo.iParts > iMaxParts || oInfo.iParts > CLICK_SEGMENT_MAX_PARTS) {
+        click_debug_print("%s ERROR: Message needs %d parts, at most %d allowed!\n", __func__, oInfo.iParts,
+                          (iMaxParts < CLICK_SEGMENT_MAX_PARTS ? iMaxParts : CLICK_SEGMENT_MAX_PARTS));
+        return -1;
+    }
+
+    for (i = 0; i < oInfo.iParts; i++, iPos = iEnd) {
+        oPart = &aParts[i];
+        memset(oPart, 0, sizeof(ClickSegmentPart));
+
+        iEnd = local_segment_part_end(pText, iLen, iPos, oInfo.eCharset, oInfo.iUnitsPerPart, &iUnits);
+        oPart->iTextOffset = iPos;
+        oPart->iTextLen    = iEnd - iPos;
+        oPart->iUnits      = (int)iUnits;
+
+        if (oInfo.iParts > 1) {
+            oPart->aData[0] = 0x05;                       // UDH length
+            oPart->aData[1] = 0x00;                       // IEI: concatenated message, 8-bit reference
+            oPart->aData[2] = 0x03;                       // IE length
+            oPart->aData[3] = (unsigned char)iReference;  // reference number
+            oPart->aData[4] = (unsigned char)oInfo.iParts;// total parts
+            oPart->aData[5] = (unsigned char)(i + 1);     // this part's sequence number
+            oPart->iUdhLen  = CLICK_SEGMENT_UDH_LEN;
+        }
+
+        if (oInfo.eCharset == CLICK_CHARSET_GSM7)
+            iTextLen = click_charset_gsm7_pack(chText + iPos, iEnd - iPos, (oPart->iUdhLen > 0 ? CLICK_SEGMENT_UDH_FILL_BITS : 0),
+                                               oPart->aData + oPart->iUdhLen, CLICK_SEGMENT_DATA_MAX - oPart->iUdhLen);
+        else
+            iTextLen = click_charset_utf16be_encode(chText + iPos, iEnd - iPos,
+                                                    oPart->aData + oPart->iUdhLen, CLICK_SEGMENT_DATA_MAX - oPart->iUdhLen);
+
+        if (iTextLen < 0)
+            return -1;
+
+        oPart->iDataLen = oPart->iUdhLen + (int)iTextLen;
+    }
+
+    return oInfo.iParts;
+}
+
+/*
+ * Function:  click_segment_transliterate
+ * Info:      Transliterates a message to GSM 03.38 where it can (see
+ *            click_charset_transliterate()) and calculates how many parts the message is
+ *            sent as before and after, so that callers can tell whether the transliterated
+ *            text saves parts. The text is only GSM 7-bit after transliteration if every
+ *            character which needed UCS-2 had an equivalent.
+ * Inputs:    chText   - UTF-8 message text (need not be NUL terminated)
+ *            iLen     - length of text in bytes
+ *            iOutSize - size of chOut, at least CLICK_CHARSET_TRANSLIT_SIZE(iLen)
+ * Outputs:   chOut    - transliterated text, NUL terminated
+ *            iOutLen  - length of the transliterated text in bytes
+ *            oBefore  - part count details of the text. May be NULL.
+ *            oAfter   - part count details of the transliterated text. May be NULL.
+ * Return:    number of parts of the transliterated text, or -1 if invalid parameter, the
+ *            output buffer is too small or the text is not valid UTF-8
+ */
+int click_segment_transliterate(const char *chText, long iLen, char *chOut, long iOutSize, long *iOutLen,
+                                ClickSegmentInfo *oBefore, ClickSegmentInfo *oAfter)
+{
+    if (iOutLen == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    if ((*iOutLen = click_charset_transliterate(chText, iLen, chOut, iOutSize, NULL)) < 0)
+        return -1;
+
+    if (oBefore != NULL)
+        click_segment_count(chText, iLen, oBefore);
+
+    return click_segment_count(chOut, *iOutLen, oAfter);
+}
@@ -0,0 +1,51 @@
+#ifndef CLICKATELL_SEGMENT_H
+#define CLICKATELL_SEGMENT_H
+
+/*
+ * clickatell_segment.h
+ *
+ *  Long message segmentation module used by the Clickatell SMS library.
+ *
+ *  A single SMS carries 140 octets of user data: 160 GSM 7-bit septets or 70 UCS-2 code
+ *  units. Longer messages are sent as several parts, each starting with a concatenation
+ *  user data header (UDH) which leaves 153 septets or 67 code units for text. Characters
+ *  are never split between parts, so GSM extension characters (escape + code) and UTF-16
+ *  surrogate pairs which do not fit in a part move to the next part.
+ */
+
+#include "clickatell_charset.h"
+
+#define CLICK_SEGMENT_DATA_MAX      140 // user data octets per SMS
+#define CLICK_SEGMENT_UDH_LEN       6   // concatenation UDH with 8-bit reference: 05 00 03 ref total seq
+#define CLICK_SEGMENT_GSM7_SINGLE   160 // septets in a single part message
+#define CLICK_SEGMENT_GSM7_MULTI    153 // septets per part of a concatenated message
+#define CLICK_SEGMENT_UCS2_SINGLE   70  // UCS-2 code units in a single part message
+#define CLICK_SEGMENT_UCS2_MULTI    67  // UCS-2 code units per part of a concatenated message
+#define CLICK_SEGMENT_MAX_PARTS     255 // most parts a concatenation UDH can number
+
+// Part count of a message, as calculated by click_segment_count()
+typedef struct ClickSegmentInfo {
+    eClickCharset eCharset; // character set the message is sent in
+    int  iParts;            // number of parts (SMSes) the message is sent as
+    long iUnits;            // septets (GSM7) or UTF-16 code units (UCS2) of text
+    long iUnitsPerPart;     // septets or code units which fit in each part
+    long iUnitsFree;        // septets or code units still free in the last part
+} ClickSegmentInfo;
+
+// One part of a message, as produced by click_segment_split()
+typedef struct ClickSegmentPart {
+    long iTextOffset;       // byte offset of the part's text within the UTF-8 message
+    long iTextLen;          // length of the part's text in bytes
+    int  iUnits;            // septets or code units of the part's text
+    int  iUdhLen;           // length of the UDH at the start of aData, 0 for a single part message
+    int  iDataLen;          // length of aData in octets
+    unsigned char aData[CLICK_SEGMENT_DATA_MAX]; // UDH, then packed GSM 7-bit or UCS-2 big-endian text
+} ClickSegmentPart;
+
+// function declarations
+int click_segment_count(const char *chText, long iLen, ClickSegmentInfo *oInfo);
+int click_segment_split(const char *chText, long iLen, int iReference, ClickSegmentPart *aParts, int iMaxParts);
+int click_segment_transliterate(const char *chText, long iLen, char *chOut, long iOutSize, long *iOutLen,
+                                ClickSegmentInfo *oBefore, ClickSegmentInfo *oAfter);
+
+#endif // CLICKATELL_SEGMENT_H
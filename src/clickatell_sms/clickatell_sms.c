@@ -24,20 +24,29 @@
  *   Martin Beyers <martin.beyers@clickatell.com>
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <ctype.h>
+#include <time.h>
+#include <pthread.h>
 #include "curl/curl.h"
 
 #include "clickatell_debug.h"
 #include "clickatell_string.h"
+#include "clickatell_trace.h"
+#include "clickatell_segment.h"
+#include "clickatell_recipients.h"
 #include "clickatell_sms.h"
+#include "clickatell_audience.h"
 
 /* ----------------------------------------------------------------------------- *
  * Types/Macros                                                                  *
  * ----------------------------------------------------------------------------- */
 
+#define CLICK_SMS_RESPONSE_HEAD_SIZE  64 // bytes of a submitted message's response scanned
+
 // HTTP API Username+Password container
 typedef struct ClickLoginUserPass {
     ClickSmsString *sUsername;
@@ -53,6 +62,12 @@ typedef struct ClickLoginApiKey {
 typedef struct ClickKeyVal {
     ClickSmsString *sKey; // sKey string
     ClickSmsString *sVal; // value string
+    int bNumber;          // REST only: value is a JSON number rather than a JSON string
+    const char *chRawVal; // value borrowed from the caller instead of 'sVal' (ie. message text), which is
+                          // URL-encoded (HTTP) or JSON-escaped (REST) straight into the request, or NULL
+    long iRawValLen;      // length of 'chRawVal'
+    int bUcs2Hex;         // HTTP only: 'chRawVal' is written as hex-encoded UCS-2 rather than URL-encoded
+    int bHex;             // 'chRawVal' is binary data, written as hex digits (ie. UDH and binary user data)
 } ClickKeyVal;
 
 // container to hold all Key/Value pairs for an API call
@@ -77,24 +92,120 @@ struct ClickSmsHandle {
 
     // output data
     ClickSmsString *sResponse;
+    ClickSmsBuffer oResponseData;   // response received so far, in as many chunks as it arrives; moved to
+                                    // 'sResponse' once the request is done
+
+    // response of a submitted message (see clickatell_sms_message_submit()): only its first bytes are
+    // kept, in place of 'sResponse', and the rest is counted and discarded; accessed with oLock held
+    int  bDiscardResponse;
+    char chResponseHead[CLICK_SMS_RESPONSE_HEAD_SIZE];
+    long iResponseLen;
 
     // cURL-request related fields
     struct curl_slist *curlHeaders; // cURL header data
+    struct curl_slist *curlFormHeaders; // HTTP API only: cURL header data of form POST requests
     long     curlHttpStatus;        // HTTP status code
     CURL    *curlHandle;            // libcurl handle
     CURLcode curlCode;              // return code from recent curlHandle request
+
+    // optional user-supplied transport which replaces libcurl (ie. loopback testing)
+    ClickSmsTransport fnTransport;
+    void *pTransportContext;
+
+    // optional traffic capture of all API calls made on this handle
+    ClickTrace *oTrace;
+
+    // handle options (see clickatell_sms_handle_option_set()), read and written atomically
+    long aOptions[CLICK_SMS_OPTION_COUNT];
+
+    // serializes API calls made on this handle, so that a handle may be shared between threads
+    pthread_mutex_t oLock;
+
+    // HTTP API authentication parameters, formatted once: the credentials
+    // (user=...&password=...&api_id=...), and the session (session_id=...) while one is open
+    // (see CLICK_SMS_OPTION_HTTP_SESSION), accessed with oLock held
+    ClickSmsString *sHttpAuth;
+    ClickSmsString *sSessionAuth;
+    long long iLastCallUs;          // click_trace_clock_us() when the last request was made, with oLock held
+
+    // HTTP API session keepalive thread, started when the first session is opened
+    pthread_t oPingThread;
+    pthread_mutex_t oPingLock;
+    pthread_cond_t oPingWake;       // signalled when the handle is shut down
+    int bPingThread;                // set once the thread is started
+    int bPingStop;                  // set when the handle is shut down, with oPingLock held
 };
 
+// destination addresses of a send message call, held in one of the containers
+typedef struct LocalSmsDests {
+    const ClickMsisdn *aMsisdns;        // array of strings, or NULL
+    const ClickRecipients *oRecipients; // compact list, or NULL
+    const ClickAudienceChunk *oChunk;   // chunk of a prepared audience, already in both wire forms, or NULL
+} LocalSmsDests;
+
+// body of a send message call generated while it is sent (see CLICK_SMS_OPTION_STREAM_BODY):
+// the formatted parameters, then the "to" parameter piece by piece straight from the recipients
+typedef struct LocalSmsBodyStream {
+    eClickApi eApiType;
+    const LocalSmsDests *oDests;
+    const char *chHead;   // formatted parameters which precede the recipients
+    long iHeadLen;
+    long iLen;            // length of the whole body
+    int  iStep;           // 0 head, 1 "to" prefix, 2 recipients, 3 closing brackets (REST), 4 done
+    long iDest;           // next recipient
+    int  iDestPart;       // next part of the recipient: separator and quote, number, closing quote
+    const char *pPiece;   // rest of the piece being copied
+    long iPieceLen;
+} LocalSmsBodyStream;
+
 typedef enum eClickCurlRequestType{
     CLICK_CURL_GET,   // REST or HTTP
     CLICK_CURL_POST,  // REST or HTTP
     CLICK_CURL_DELETE // REST API only
 } eClickCurlRequestType;
 
+// request formatted by local_api_command_execute() (or prepared, see ClickSmsRequest), sent by
+// local_sms_request_send()
+typedef struct LocalSmsRequest {
+    const char *chPath;                 // API call script (HTTP) or resource path (REST)
+    eClickCurlRequestType eRequestType;
+    const ClickSmsBuffer *oQuery;       // parameters which follow the path in the URL, or NULL
+    ClickSmsString *sBody;              // request body, or NULL
+    const char *chStreamHead;           // body generated while it is sent (see LocalSmsBodyStream): formatted
+    long iStreamHeadLen;                // parameters which precede the recipients, or NULL if not streamed
+    const ClickSmsString *sUrl;         // full URL already formatted with 'sUrlAuth', or NULL
+    const ClickSmsString *sUrlAuth;     // HTTP authentication parameters in 'sUrl'
+    const LocalSmsDests *oDests;        // destination addresses of a streamed body, or NULL
+    long iNumDests;                     // number of destination addresses, for the trace
+    eClickTraceCall eCall;              // API call made, for the trace
+    const ClickSmsString *sParam;       // main parameter of the API call, or NULL, for the trace
+} LocalSmsRequest;
+
+// prepared request (see clickatell_sms_request_prepare()): read only once prepared, except its reference count
+struct ClickSmsRequest {
+    int iRefs;                          // references, changed atomically
+    eClickApi eApiType;                 // API of the handles the request may be executed on
+    eClickCurlRequestType eRequestType;
+    ClickSmsString *sPath;
+    ClickSmsBuffer oQuery;              // HTTP GET: parameters which follow the authentication parameters
+    ClickSmsString *sBody;              // JSON (REST) or form-urlencoded (HTTP) body, or NULL
+    ClickSmsString *sUrl;               // full URL, formatted with the preparing handle's credentials
+    ClickSmsString *sUrlAuth;           // HTTP: the credentials in 'sUrl'
+    long iNumDests;
+    eClickTraceCall eCall;
+    ClickSmsString *sParam;             // message text, kept for the trace
+};
+
 // default cURL request timeout values
 #define CLICK_SMS_DEFAULT_APICALL_TIMEOUT          5  // max time allowed for API call to Clickatell
 #define CLICK_SMS_DEFAULT_APICALL_CONNECT_TIMEOUT  5  // max connection time allowed for API call to Clickatell
 
+// transliterated message text is built on the stack up to this size, else allocated
+#define CLICK_SMS_TRANSLIT_STACK_SIZE              1024
+
+// HTTP API session keepalive thread: wait between checks while sessions are disabled
+#define CLICK_SMS_SESSION_IDLE_WAIT                60 // seconds
+
 // macro to validate API type
 #define VALIDATE_API_TYPE(api)           ((api) >= CLICK_API_HTTP &&  (api) < CLICK_API_COUNT)
 // macro to validate user-provided input parameters
@@ -102,29 +213,81 @@ typedef enum eClickCurlRequestType{
                                                        ((api) == CLICK_API_REST && !CLICK_STR_INVALID((apikey))))
 // macro to validate a ClickMsisdn container
 #define CLICK_MSISDN_INVALID(cm)         ((cm) == NULL || ((cm)->iNum) < 1 || (cm)->aDests == NULL)
+// macro to validate a ClickRecipients list
+#define CLICK_RECIPIENTS_INVALID(cr)     ((cr) == NULL || ((cr)->iNum) < 1 || (cr)->oDigits.data == NULL)
 // macro to validate a ClickArrayKeyVal container
 #define CLICK_KEYVAL_ARRAY_INVALID(ckva) ((ckva) != NULL && (((ckva)->iNum) < 1 || (ckva)->aKeyValues == NULL))
 
 // Clickatell Messaging base URL
 static char chLocalBaseUrl[] = "https://api.clickatell.com/";
 
+// count of clickatell_sms_init() calls not yet matched by clickatell_sms_shutdown()
+static pthread_mutex_t oLocalInitLock = PTHREAD_MUTEX_INITIALIZER;
+static int iLocalInitCount = 0;
+
 /* ----------------------------------------------------------------------------- *
  * Forward declarations                                                          *
  * ----------------------------------------------------------------------------- */
 
 static ClickArrayKeyVal *local_click_keyval_array_create(int iNumKeyPairs);
+static void local_click_keyval_array_destroy(ClickArrayKeyVal *oKeyVals);
 static void local_sms_reset(ClickSmsHandle *oClickSms);
 static size_t local_sms_curl_response_cb(void *buffer, size_t iSize, size_t iMemLen, void *sResponse);
 static void local_sms_curl_config(ClickSmsHandle *oClickSms, long iTimeout, long iConnectTimeout);
 static void local_sms_curl_execute(ClickSmsHandle *oClickSms,
                                    ClickSmsString *sFullUrl,
                                    eClickCurlRequestType eReqType,
-                                   ClickSmsString *sPostData);
+                                   ClickSmsString *sPostData,
+                                   LocalSmsBodyStream *oStream);
+static struct curl_slist *local_sms_headers_get(const ClickSmsHandle *oClickSms, eClickCurlRequestType eReqType);
+static void local_sms_transport_execute(ClickSmsHandle *oClickSms,
+                                        ClickSmsString *sFullUrl,
+                                        eClickCurlRequestType eReqType,
+                                        ClickSmsString *sPostData,
+                                        LocalSmsBodyStream *oStream);
+static void local_sms_trace_record(ClickSmsHandle *oClickSms, eClickTraceCall eCall, const ClickSmsString *sParam,
+                                   long iNumDests, long long iStartUs,
+                                   const ClickSmsString *sUrl, long iBodyLen);
+static long local_sms_option_get(ClickSmsHandle *oClickSms, eClickSmsOption eOption);
+static int local_sms_message_parts_get(const char *chText, long iLen, ClickSegmentInfo *oInfo);
+static int local_sms_hex_serialize(ClickSmsBuffer *oParams, const ClickKeyVal *oKeyVal);
+static int local_sms_keyval_serialize(ClickSmsBuffer *oParams, eClickApi eApiType, const ClickKeyVal *oKeyVal, int bFirst);
+static long local_sms_dests_count(const LocalSmsDests *oDests);
+static int local_sms_dests_serialize(ClickSmsBuffer *oParams, eClickApi eApiType, const LocalSmsDests *oDests);
+static int local_sms_stream_next(LocalSmsBodyStream *oStream);
+static void local_sms_stream_init(LocalSmsBodyStream *oStream, eClickApi eApiType, const char *chHead, long iHeadLen,
+                                  const LocalSmsDests *oDests);
+static size_t local_sms_stream_dests_fill(LocalSmsBodyStream *oStream, char *pBuffer, size_t iRoom);
+static size_t local_sms_stream_read_cb(char *pBuffer, size_t iSize, size_t iNum, void *pStream);
+static int local_sms_stream_seek_cb(void *pStream, curl_off_t iOffset, int iOrigin);
+static ClickSmsString *local_sms_message_send(ClickSmsHandle *oClickSms, const char *chText, long iTextLen, const LocalSmsDests *oDests,
+                                              eClickSmsSubmit *peAccepted, ClickSmsRequest *oPrepared);
+static const ClickAudienceChunk *local_sms_audience_chunk_get(ClickSmsHandle *oClickSms, const ClickAudience *oAudience, long iChunk);
+static ClickSmsRequest *local_sms_request_prepare(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                  const LocalSmsDests *oDests);
+static ClickSmsString *local_sms_prepared_send(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest, eClickSmsSubmit *peAccepted);
+static int local_sms_binary_valid(const ClickSmsBinary *oBinary);
+static ClickSmsString *local_sms_binary_send(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary, const LocalSmsDests *oDests);
+static ClickSmsString *local_sms_batch_execute(ClickSmsHandle *oClickSms, const char *chScript, const ClickSmsString *sBatchId,
+                                               const LocalSmsDests *oDests, const char *const *aFields, int iFields,
+                                               eClickTraceCall eCall);
+static ClickSmsString *local_sms_url_format(ClickSmsHandle *oClickSms, const char *chPath, const ClickSmsBuffer *oQuery,
+                                            const ClickSmsString *sAuth);
+static int local_sms_session_open(ClickSmsHandle *oClickSms);
+static int local_sms_session_rejected(const ClickSmsHandle *oClickSms);
+static const char *local_sms_json_value(const char *chJson, const char *chKey);
+static eClickSmsSubmit local_sms_response_accepted(const ClickSmsHandle *oClickSms);
+static void *local_sms_session_keepalive(void *pArg);
 static ClickSmsString *local_api_command_execute(ClickSmsHandle *oClickSms,
                                                  const ClickSmsString *sPath,
                                                  eClickCurlRequestType eRequestType,
                                                  const ClickArrayKeyVal *oKeyVals,
-                                                 const ClickMsisdn *aMsisdns);
+                                                 const LocalSmsDests *oDests,
+                                                 eClickTraceCall eCall,
+                                                 const ClickSmsString *sParam,
+                                                 eClickSmsSubmit *peAccepted,
+                                                 ClickSmsRequest *oPrepared);
+static ClickSmsString *local_sms_request_send(ClickSmsHandle *oClickSms, const LocalSmsRequest *oRequest, eClickSmsSubmit *peAccepted);
 
 /* ----------------------------------------------------------------------------- *
  * Local function definitions                                                    *
@@ -171,7 +334,8 @@ static ClickArrayKeyVal *local_click_keyval_array_create(int iNumKeyPairs)
     int i = 0;
     for (i = 0; i < iNumKeyPairs; i++) {
         if ((oKeyVals->aKeyValues[i] = (ClickKeyVal *)calloc(1, sizeof(ClickKeyVal))) == NULL) {
-            free(oKeyVals);
+            oKeyVals->iNum = i; // only destroy the Key/Value structures allocated so far
+            local_click_keyval_array_destroy(oKeyVals);
             return NULL;
         }
     }
@@ -217,37 +381,40 @@ static void local_click_keyval_array_destroy(ClickArrayKeyVal *oKeyVals)
  *            the cURL CURLOPT_WRITEFUNCTION option.
  *            The 'sResponse' parameter passed back here was set in function
  *            local_sms_curl_execute() when configuring the cURL CURLOPT_WRITEDATA option.
- *            This callback function reads a curlHandle request's response data.
- *            In here we allocate the response data to the corresponding
- *            ClickSmsHandle's response field.
- * Return:    Size of response data buffer
+ *            This callback function reads a curlHandle request's response data, one chunk
+ *            per call (at most CURL_MAX_WRITE_SIZE bytes from libcurl). In here we append the
+ *            chunk to the corresponding ClickSmsHandle's response data, unless the response is
+ *            being discarded: then only its first bytes are copied into the handle, without
+ *            allocating memory.
+ * Return:    Size of response data buffer, or 0 (which fails the request) if failed to allocate
+ *            memory
  */
 static size_t local_sms_curl_response_cb(void *buffer, size_t iSize, size_t iMemLen, void *sResponse)
 {
     int iTotalSize = iMemLen * iSize;
+    ClickSmsHandle *oHandle = (ClickSmsHandle *)sResponse;
 
-    if (iTotalSize > 0) {
-        ClickSmsHandle *oClickSms = (ClickSmsHandle *)sResponse;
-        char *chTempData = NULL;
+    if (oHandle != NULL && oHandle->bDiscardResponse) {
+        long iRoom = CLICK_SMS_RESPONSE_HEAD_SIZE - 1 - oHandle->iResponseLen;
 
-        if (oClickSms->sResponse != NULL) { // should not reach this logic since local_sms_reset() called before each eRequestType
-            click_string_destroy(oClickSms->sResponse);
-            oClickSms->sResponse = NULL;
-            click_debug_print("%s WARNING: Had to clear response data which should be NULL\n", __func__);
+        if (iRoom > 0 && iTotalSize > 0) {
+            if (iRoom > iTotalSize)
+                iRoom = iTotalSize;
+            memcpy(oHandle->chResponseHead + oHandle->iResponseLen, buffer, iRoom);
+            oHandle->chResponseHead[oHandle->iResponseLen + iRoom] = '\0';
         }
+        oHandle->iResponseLen += iTotalSize;
+        return iTotalSize;
+    }
 
-        if (oClickSms == NULL) // this handle should never be NULL, but cater for the scenario in any case
-            click_debug_print("%s ERROR: cURL reponse data invalid!\n", __func__);
-        else if ((chTempData = calloc(iTotalSize + 1, sizeof(char))) != NULL) {
-            memcpy(chTempData, buffer, iTotalSize);
-            chTempData[iTotalSize] = '\0';
-
-            oClickSms->sResponse = click_string_create(chTempData);
+    if (oHandle == NULL) { // this handle should never be NULL, but cater for the scenario in any case
+        click_debug_print("%s ERROR: cURL reponse data invalid!\n", __func__);
+        return 0;
+    }
 
-            free(chTempData);
-        }
-        else
-            click_debug_print("%s ERROR: Failed to allocate memory for response!\n", __func__);
+    if (iTotalSize > 0 && click_buffer_append(&oHandle->oResponseData, buffer, iTotalSize) != 0) {
+        click_debug_print("%s ERROR: Failed to allocate memory for response!\n", __func__);
+        return 0;
     }
 
     return (iTotalSize);
@@ -286,6 +453,65 @@ static void local_sms_curl_config(ClickSmsHandle *oClickSms, long iTimeout, long
     curl_easy_setopt(oClickSms->curlHandle, CURLOPT_WRITEFUNCTION, local_sms_curl_response_cb);
 }
 
+/*
+ * Function:  local_sms_headers_get
+ * Info:      Selects the request headers: an HTTP API POST carries a form-urlencoded body,
+ *            so it is sent with the handle's form headers.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            eReqType  - Type of request
+ * Return:    header list, or NULL if none
+ */
+static struct curl_slist *local_sms_headers_get(const ClickSmsHandle *oClickSms, eClickCurlRequestType eReqType)
+{
+    if (oClickSms->eApiType == CLICK_API_HTTP && eReqType == CLICK_CURL_POST)
+        return oClickSms->curlFormHeaders;
+
+    return oClickSms->curlHeaders;
+}
+
+/*
+ * Function:  local_sms_transport_execute
+ * Info:      Executes a request using the user-supplied transport set with
+ *            clickatell_sms_handle_transport_set(), instead of libcurl.
+ *            The transport's response data is passed through local_sms_curl_response_cb(),
+ *            so the ClickSmsHandle output fields are set exactly as for a cURL request.
+ * Input:     oClickSms - Handle required when calling clickatell_sms_### functions
+ *            sFullUrl  - Full URL for API call (including any parameters)
+ *            eReqType  - Type of request
+ *            sPostData - 'POST request' data
+ *            oStream   - 'POST request' data generated while it is sent, or NULL
+ * Return:    void
+ */
+static void local_sms_transport_execute(ClickSmsHandle *oClickSms, ClickSmsString *sFullUrl,
+                                        eClickCurlRequestType eReqType, ClickSmsString *sPostData,
+                                        LocalSmsBodyStream *oStream)
+{
+    ClickSmsTransportRequest oRequest;
+
+    oRequest.chMethod   = (eReqType == CLICK_CURL_POST ? "POST" : (eReqType == CLICK_CURL_GET ? "GET" : "DELETE"));
+    oRequest.chUrl      = sFullUrl->data;
+    oRequest.chBody     = NULL;
+    oRequest.iBodyLen   = 0;
+    oRequest.oHeaders   = local_sms_headers_get(oClickSms, eReqType);
+    oRequest.fnWrite    = local_sms_curl_response_cb;
+    oRequest.pWriteData = oClickSms;
+    oRequest.fnRead     = NULL;
+    oRequest.pReadData  = NULL;
+
+    if (eReqType == CLICK_CURL_POST && oStream != NULL) {
+        oRequest.iBodyLen  = oStream->iLen;
+        oRequest.fnRead    = local_sms_stream_read_cb;
+        oRequest.pReadData = oStream;
+    }
+    else if (eReqType == CLICK_CURL_POST && !CLICK_STR_INVALID(sPostData)) {
+        oRequest.chBody   = sPostData->data;
+        oRequest.iBodyLen = strlen(sPostData->data);
+    }
+
+    oClickSms->curlHttpStatus = oClickSms->fnTransport(oClickSms->pTransportContext, &oRequest);
+    oClickSms->curlCode       = (oClickSms->curlHttpStatus < 0 ? CURLE_COULDNT_CONNECT : CURLE_OK);
+}
+
 /*
  * Function:  local_sms_curl_execute
  * Info:      Executes a cURL request using libcurl.
@@ -297,6 +523,8 @@ static void local_sms_curl_config(ClickSmsHandle *oClickSms, long iTimeout, long
  *            eReqType  - Type of curl handle request
  *            sFullUrl  - Full URL for API call (excluding parameters)
  *            sPostData - cURL 'POST request' data
+ *            oStream   - cURL 'POST request' data generated while it is sent (read by
+ *                        local_sms_stream_read_cb()) instead of sPostData, or NULL
  * Output:    oClickSms - ClickSmsHandle 'sResponse' field will contain the API call's
  *                        response received from Clickatell.
  *            oClickSms - ClickSmsHandle 'curlCode' field will contain the cURL
@@ -307,16 +535,25 @@ static void local_sms_curl_config(ClickSmsHandle *oClickSms, long iTimeout, long
  * Return:    void
  */
 static void local_sms_curl_execute(ClickSmsHandle *oClickSms, ClickSmsString *sFullUrl,
-                                   eClickCurlRequestType eReqType, ClickSmsString *sPostData)
+                                   eClickCurlRequestType eReqType, ClickSmsString *sPostData,
+                                   LocalSmsBodyStream *oStream)
 {
     if (oClickSms == NULL || CLICK_STR_INVALID(sFullUrl)) {
         click_debug_print("%s ERROR: invalid parameter!\n", __func__);
         return;
     }
 
+    click_buffer_reset(&oClickSms->oResponseData);
+
+    // hand the request to the user-supplied transport instead of libcurl
+    if (oClickSms->fnTransport != NULL) {
+        local_sms_transport_execute(oClickSms, sFullUrl, eReqType, sPostData, oStream);
+        goto exit;
+    }
+
     // add curlHeaders if applicable
-    if (oClickSms->curlHeaders != NULL)
-        curl_easy_setopt(oClickSms->curlHandle, CURLOPT_HTTPHEADER, oClickSms->curlHeaders);
+    if (local_sms_headers_get(oClickSms, eReqType) != NULL)
+        curl_easy_setopt(oClickSms->curlHandle, CURLOPT_HTTPHEADER, local_sms_headers_get(oClickSms, eReqType));
     else // remove curlHeaders
         curl_easy_setopt(oClickSms->curlHandle, CURLOPT_HTTPHEADER, NULL);
 
@@ -326,8 +563,20 @@ static void local_sms_curl_execute(ClickSmsHandle *oClickSms, ClickSmsString *sF
 
     switch (eReqType) {
         case CLICK_CURL_POST:
+            // generate cURL 'POST request' data while it is sent, of a length known up front
+            if (oStream != NULL) {
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POST, 1);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POSTFIELDS, NULL);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_READFUNCTION, local_sms_stream_read_cb);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_READDATA, oStream);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_SEEKFUNCTION, local_sms_stream_seek_cb);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_SEEKDATA, oStream);
+                curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)oStream->iLen);
+
+                click_debug_print("Curl post data:\n(streamed, %ld bytes)\n", oStream->iLen);
+            }
             // set cURL 'POST request' data if requested and if the post data exists
-            if (!CLICK_STR_INVALID(sPostData) && strlen(sPostData->data) > 0) {
+            else if (!CLICK_STR_INVALID(sPostData) && strlen(sPostData->data) > 0) {
                 curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POST, 1);
                 curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POSTFIELDS, sPostData->data);
                 curl_easy_setopt(oClickSms->curlHandle, CURLOPT_POSTFIELDSIZE, strlen(sPostData->data));
@@ -353,6 +602,12 @@ static void local_sms_curl_execute(ClickSmsHandle *oClickSms, ClickSmsString *sF
     if (oClickSms->curlCode == CURLE_OK)
         oClickSms->curlCode = curl_easy_getinfo(oClickSms->curlHandle, CURLINFO_RESPONSE_CODE, &(oClickSms->curlHttpStatus));
 
+exit:
+    // the response as a whole, however many chunks it arrived in
+    local_sms_reset(oClickSms);
+    if (oClickSms->oResponseData.iLen > 0)
+        oClickSms->sResponse = click_buffer_detach(&oClickSms->oResponseData);
+
     // output debug information
     click_debug_print("Curl %s-Request URL:\n%s\n", (eReqType == CLICK_CURL_POST ? "POST" : (eReqType == CLICK_CURL_GET ? "GET" : "DELETE")),
                                                     (sFullUrl == NULL ? "" : sFullUrl->data));
@@ -368,36 +623,51 @@ static void local_sms_curl_execute(ClickSmsHandle *oClickSms, ClickSmsString *sF
  * Function:  clickatell_sms_init
  * Info:      Initializes Clickatell SMS library.
  *            This function MUST be called before calling any other functions in
- *            this library.
+ *            this library. It may be called several times and from several threads;
+ *            only the first call initializes the library, and each call must be
+ *            matched by a call to clickatell_sms_shutdown().
  * Inputs:    none
  * Return:    none
  */
 void clickatell_sms_init(void)
 {
-    // initialize debug module
-    click_debug_init(CLICK_DEBUG_ON);
+    pthread_mutex_lock(&oLocalInitLock);
+
+    if (iLocalInitCount++ == 0) {
+        // initialize debug module
+        click_debug_init(CLICK_DEBUG_ON);
 
-    // initialize cURL
-    curl_global_init(CURL_GLOBAL_ALL);
+        // initialize cURL
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    pthread_mutex_unlock(&oLocalInitLock);
 }
 
 /*
  * Function:  clickatell_sms_shutdown
  * Info:      Shutdown the Clickatell SMS library.
  *            This function must be called when the Clickatell SMS library
- *            must be shutdown.
+ *            must be shutdown. The library is only shut down once every
+ *            clickatell_sms_init() call has been matched by this function.
  * Inputs:    none
  * Return:    none
  */
 void clickatell_sms_shutdown(void)
 {
-    // shutdown cURL
-    curl_global_cleanup();
+    pthread_mutex_lock(&oLocalInitLock);
+
+    if (iLocalInitCount > 0 && --iLocalInitCount == 0)
+        curl_global_cleanup(); // shutdown cURL
+
+    pthread_mutex_unlock(&oLocalInitLock);
 }
 
 /*
  * Function:  clickatell_sms_handle_init
  * Info:      Initializes Clickatell SMS API handle.
+ *            A handle may be shared between threads, in which case the API calls made
+ *            on it are serialized. Use one handle per thread for concurrent API calls.
  * Inputs:    sUsername       - HTTP API Username from Clickatell account
  *            sPassword       - HTTP API Password from Clickatell account
  *            sApiKey         - REST API Key from Clickatell account
@@ -419,8 +689,22 @@ ClickSmsHandle *clickatell_sms_handle_init(eClickApi eApiType,
         return NULL;
     }
 
+    pthread_condattr_t oCondAttr;
+    ClickSmsBuffer oAuth = { NULL, 0, 0 };
+    int iErr = 0;
     ClickSmsHandle *oClickSms = (ClickSmsHandle *)calloc(1, sizeof(ClickSmsHandle));
+    if (oClickSms == NULL) {
+        click_debug_print("%s ERROR: failed to allocate memory for handle!\n", __func__);
+        return NULL;
+    }
+
     oClickSms->eApiType = eApiType;
+    pthread_mutex_init(&oClickSms->oLock, NULL);
+    pthread_mutex_init(&oClickSms->oPingLock, NULL);
+    pthread_condattr_init(&oCondAttr);
+    pthread_condattr_setclock(&oCondAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&oClickSms->oPingWake, &oCondAttr);
+    pthread_condattr_destroy(&oCondAttr);
 
     if ((oClickSms->curlHandle = curl_easy_init()) == NULL) {
         clickatell_sms_handle_shutdown(oClickSms);
@@ -437,6 +721,7 @@ ClickSmsHandle *clickatell_sms_handle_init(eClickApi eApiType,
             oClickSms->curlHeaders = curl_slist_append(NULL, "X-Version: 1");
             oClickSms->curlHeaders = curl_slist_append(oClickSms->curlHeaders, "Content-Type: application/json");
             oClickSms->curlHeaders = curl_slist_append(oClickSms->curlHeaders, "Accept: application/json");
+            oClickSms->curlHeaders = curl_slist_append(oClickSms->curlHeaders, "Expect:"); // no "100 Continue" wait
 
             // the REST API Key will be used as the authorization token
             ClickSmsString *sBuf = click_string_create("Authorization: Bearer ");
@@ -451,318 +736,2079 @@ ClickSmsHandle *clickatell_sms_handle_init(eClickApi eApiType,
             oClickSms->uLoginDetails.userpass.sUsername = click_string_duplicate(sUsername);
             oClickSms->uLoginDetails.userpass.sPassword = click_string_duplicate(sPassword);
 
+            // format the credentials as URL parameters once, ie. user=name&password=secret&api_id=3518209
+            iErr |= click_buffer_append(&oAuth, "user=", 5);
+            iErr |= click_buffer_append_encoded(&oAuth, sUsername->data, strlen(sUsername->data), CLICK_ENCODING_URL);
+            iErr |= click_buffer_append(&oAuth, "&password=", 10);
+            iErr |= click_buffer_append_encoded(&oAuth, sPassword->data, strlen(sPassword->data), CLICK_ENCODING_URL);
+            iErr |= click_buffer_append(&oAuth, "&api_id=", 8);
+            iErr |= click_buffer_append_encoded(&oAuth, sApiId->data, strlen(sApiId->data), CLICK_ENCODING_URL);
+            oClickSms->sHttpAuth = (iErr == 0 ? click_buffer_detach(&oAuth) : NULL);
+            click_buffer_free(&oAuth);
+
             // configure default curlHeaders - always ensure first slist append call has NULL curl headers argument
             oClickSms->curlHeaders = curl_slist_append(NULL, "Connection:keep-alive");
             oClickSms->curlHeaders = curl_slist_append(oClickSms->curlHeaders, "Cache-Control:max-age=0");
             oClickSms->curlHeaders = curl_slist_append(oClickSms->curlHeaders, "Origin:null");
 
+            // form POST requests (see CLICK_SMS_OPTION_HTTP_POST) send the same headers, plus the body's
+            // content type; an empty "Expect:" stops libcurl waiting for "100 Continue" before larger bodies
+            oClickSms->curlFormHeaders = curl_slist_append(NULL, "Connection:keep-alive");
+            oClickSms->curlFormHeaders = curl_slist_append(oClickSms->curlFormHeaders, "Cache-Control:max-age=0");
+            oClickSms->curlFormHeaders = curl_slist_append(oClickSms->curlFormHeaders, "Origin:null");
+            oClickSms->curlFormHeaders = curl_slist_append(oClickSms->curlFormHeaders,
+                                                           "Content-Type: application/x-www-form-urlencoded");
+            oClickSms->curlFormHeaders = curl_slist_append(oClickSms->curlFormHeaders, "Expect:");
+
             // set default curlHeaders - can replace them if necessary
             curl_easy_setopt(oClickSms->curlHandle, CURLOPT_HTTPHEADER, oClickSms->curlHeaders);
         }
 
         oClickSms->sApiId = click_string_duplicate(sApiId);
+
+        if (eApiType == CLICK_API_HTTP && oClickSms->sHttpAuth == NULL) {
+            click_debug_print("%s ERROR: failed to allocate memory for handle!\n", __func__);
+            clickatell_sms_handle_shutdown(oClickSms);
+            oClickSms = NULL;
+        }
     }
 
     return oClickSms;
 }
 
 /*
- * Function:  local_api_command_execute
- * Info:      Common function to execute a Clickatell API call.
- *            This function assumes ALL input parameters are valid.
- *            If providing HTTP Key/Values, then the sizes of both the
- *            'param_keys' and the 'param_vals' should match.
- * Inputs:    oClickSms        - ClickSmsHandle API handle
- *            sPath            - local path to resource which will be appended to base URL
- *            eRequestType     - Type of cURL request type (ie POST, GET, DELETE)
- *            oKeyVals         - array of Key/Value pairs. Set this to NULL if no Key/Value pairs
- *                               will be used.
- *            aMsisdns         - Array of destination addresses (for send message call only)
- *                               This function expects this parameter to be validated by the calling
- *                               function.
- *                               If not performing a send message call, then this parameter
- *                               should be set to NULL.
- * Return:    ClickSmsString containing the curlHandle request's response from Clickatell.
- *            The calling function must destroy said ClickSmsString.
+ * Function:  local_sms_trace_record
+ * Info:      Records an API call to the trace attached to the handle.
+ *            Must be called with the handle's lock held, after the request was executed.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            eCall     - API call made
+ *            sParam    - main parameter of the API call, or NULL
+ *            iNumDests - number of destination addresses (send message call only), or 0
+ *            iStartUs  - click_trace_clock_us() when the request was started
+ *            sUrl      - request URL
+ *            iBodyLen  - length of request body, 0 if none
+ * Return:    void
  */
-static ClickSmsString *local_api_command_execute(ClickSmsHandle *oClickSms,
-                                                 const ClickSmsString *sPath,
-                                                 eClickCurlRequestType eRequestType,
-                                                 const ClickArrayKeyVal *oKeyVals,
-                                                 const ClickMsisdn *aMsisdns)
+static void local_sms_trace_record(ClickSmsHandle *oClickSms, eClickTraceCall eCall, const ClickSmsString *sParam,
+                                   long iNumDests, long long iStartUs,
+                                   const ClickSmsString *sUrl, long iBodyLen)
 {
-    if (oClickSms == NULL || CLICK_STR_INVALID(sPath) || CLICK_KEYVAL_ARRAY_INVALID(oKeyVals)) {
-        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
-        return NULL;
-    }
+    ClickTraceRecord oRecord;
+
+    oRecord.iStartUs       = iStartUs;
+    oRecord.iDurationUs    = (long)(click_trace_clock_us() - iStartUs);
+    oRecord.eCall          = eCall;
+    oRecord.eApiType       = oClickSms->eApiType;
+    oRecord.iHttpStatus    = (oClickSms->curlCode == CURLE_OK ? oClickSms->curlHttpStatus : -1);
+    oRecord.eParamShape    = click_trace_shape_get((CLICK_STR_INVALID(sParam) ? NULL : sParam->data), &oRecord.iParamLen);
+    oRecord.iNumDests      = iNumDests;
+    oRecord.iRequestBytes  = strlen(sUrl->data) + iBodyLen;
+    oRecord.iResponseBytes = (oClickSms->bDiscardResponse ? oClickSms->iResponseLen :
+                              (CLICK_STR_INVALID(oClickSms->sResponse) ? 0 : (long)strlen(oClickSms->sResponse->data)));
+
+    click_trace_record(oClickSms->oTrace, &oRecord);
+}
 
-    int i = 0;
-    ClickSmsString *sResponse = NULL, *sPostData = NULL, *sUrl = NULL, *sApiParams = NULL;
-
-    // format URL Key/Value parameters
-    if (oKeyVals != NULL) {
-       if (oClickSms->eApiType == CLICK_API_HTTP) {
-            sApiParams = click_string_create("?");
-
-            // append all non-"to" parameters first
-            for (i = 0; i < oKeyVals->iNum; i++) {
-                click_string_append_formatted_cstr(sApiParams, "%s%s=%s", (i == 0 ? "" : "&"),
-                                                (char *)(oKeyVals->aKeyValues[i]->sKey->data),
-                                                (char *)(oKeyVals->aKeyValues[i]->sVal->data));
-            }
+/*
+ * Function:  local_sms_option_get
+ * Info:      Reads a handle option. Options may be changed while other threads are using
+ *            the handle, so they are read atomically rather than under the handle's lock.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            eOption   - option to read
+ * Return:    option value
+ */
+static long local_sms_option_get(ClickSmsHandle *oClickSms, eClickSmsOption eOption)
+{
+    return __atomic_load_n(&oClickSms->aOptions[eOption], __ATOMIC_RELAXED);
+}
 
-            // For send message API calls only: append "to" parameter, example:  &to=2799900001,2799900002
-            if (aMsisdns != NULL) {
-                click_string_append_formatted_cstr(sApiParams, "&to=");
+/*
+ * Function:  local_sms_message_parts_get
+ * Info:      Calculates how many parts (SMSes) a message is sent as. Text which is not
+ *            valid UTF-8 (ie. Latin1) is counted as one GSM 7-bit septet per byte.
+ * Inputs:    chText - message text
+ *            iLen   - length of text in bytes
+ * Outputs:   oInfo  - part count details; its character set is CLICK_CHARSET_INVALID for
+ *                     text which is not valid UTF-8
+ * Return:    number of parts
+ */
+static int local_sms_message_parts_get(const char *chText, long iLen, ClickSegmentInfo *oInfo)
+{
+    int iParts = click_segment_count(chText, iLen, oInfo);
 
-                for (i = 0; i < aMsisdns->iNum; i++) {
-                    click_string_append_formatted_cstr(sApiParams, "%s%s", (i == 0 ? "" : ","), aMsisdns->aDests[i]->data);
-                }
-            }
-        }
-        else { // REST
-            sApiParams = click_string_create("{"); // the JSON data is enclosed in opening/closing braces
+    if (iParts < 0) {
+        iParts = (iLen <= CLICK_SEGMENT_GSM7_SINGLE ? 1 : (int)((iLen + CLICK_SEGMENT_GSM7_MULTI - 1) / CLICK_SEGMENT_GSM7_MULTI));
+        oInfo->eCharset = CLICK_CHARSET_INVALID;
+        oInfo->iParts   = iParts;
+        oInfo->iUnits   = iLen;
+    }
+
+    return iParts;
+}
+
+/*
+ * Function:  local_sms_hex_serialize
+ * Info:      Appends a Key/Value pair's binary value to a request as hex digits, written
+ *            straight into the request's parameters.
+ * Inputs:    oParams  - request parameters
+ *            oKeyVal  - Key/Value pair whose 'chRawVal' is binary data
+ * Return:    0 if successful, else -1 if failed to allocate memory
+ */
+static int local_sms_hex_serialize(ClickSmsBuffer *oParams, const ClickKeyVal *oKeyVal)
+{
+    long iHexLen = 0;
 
-            // append all non-"to" parameters first, example:  {"sText":"Test Message","callback":"7"}
-            for (i = 0; i < oKeyVals->iNum; i++)
-                click_string_append_formatted_cstr(sApiParams, "%s\"%s\":\"%s\"", (i == 0 ? "" : ","),
-                        (char *)(oKeyVals->aKeyValues[i]->sKey->data),
-                        (char *)(oKeyVals->aKeyValues[i]->sVal->data));
+    if (click_buffer_reserve(oParams, 2 * oKeyVal->iRawValLen) != 0)
+        return -1;
 
-            // For send message API calls only: append "to" parameter, example:  "to":["2799900001","2799900002"]}'
-            if (aMsisdns != NULL) {
-                click_string_append_formatted_cstr(sApiParams, ",\"to\":[");
+    iHexLen = click_charset_hex_encode((const unsigned char *)oKeyVal->chRawVal, oKeyVal->iRawValLen,
+                                       oParams->data + oParams->iLen, oParams->iSize - oParams->iLen);
+    if (iHexLen < 0)
+        return -1;
+    oParams->iLen += iHexLen;
 
-                for (i = 0; i < aMsisdns->iNum; i++)
-                    click_string_append_formatted_cstr(sApiParams, "%s\"%s\"", (i == 0 ? "" : ","), aMsisdns->aDests[i]->data);
+    return 0;
+}
 
-                click_string_append_formatted_cstr(sApiParams, "]");
+/*
+ * Function:  local_sms_keyval_serialize
+ * Info:      Appends a Key/Value pair to a request's parameters: key=value for HTTP
+ *            (preceded by '&' unless first), or "key":"value" for REST (preceded by ','
+ *            unless first). Values borrowed from the caller are encoded straight into
+ *            the parameters (binary values as hex digits); 'sVal' values are appended as
+ *            they are.
+ * Inputs:    oParams  - request parameters
+ *            eApiType - API type
+ *            oKeyVal  - Key/Value pair
+ *            bFirst   - set for the first Key/Value pair
+ * Return:    0 if successful, else -1 if failed to allocate memory or to encode the value
+ */
+static int local_sms_keyval_serialize(ClickSmsBuffer *oParams, eClickApi eApiType, const ClickKeyVal *oKeyVal, int bFirst)
+{
+    const char *chVal = (CLICK_STR_INVALID(oKeyVal->sVal) ? "" : oKeyVal->sVal->data);
+    long iHexLen = 0;
+    int iErr = 0;
+
+    if (eApiType == CLICK_API_HTTP) {
+        iErr |= click_buffer_append(oParams, "&", (bFirst ? 0 : 1));
+        iErr |= click_buffer_append(oParams, oKeyVal->sKey->data, strlen(oKeyVal->sKey->data));
+        iErr |= click_buffer_append(oParams, "=", 1);
+
+        if (oKeyVal->chRawVal != NULL && oKeyVal->bHex)
+            iErr |= local_sms_hex_serialize(oParams, oKeyVal);
+        else if (oKeyVal->chRawVal != NULL && oKeyVal->bUcs2Hex) {
+            // every UTF-8 byte makes at most one UTF-16 code unit, of 4 hex digits
+            if ((iErr |= click_buffer_reserve(oParams, 4 * oKeyVal->iRawValLen)) == 0) {
+                iHexLen = click_charset_ucs2_hex_encode(oKeyVal->chRawVal, oKeyVal->iRawValLen, oParams->data + oParams->iLen,
+                                                        oParams->iSize - oParams->iLen);
+                if (iHexLen < 0)
+                    return -1;
+                oParams->iLen += iHexLen;
             }
-            click_string_append_formatted_cstr(sApiParams, "}"); // the JSON data is enclosed in opening/closing braces
         }
+        else if (oKeyVal->chRawVal != NULL)
+            iErr |= click_buffer_append_encoded(oParams, oKeyVal->chRawVal, oKeyVal->iRawValLen, CLICK_ENCODING_URL);
+        else
+            iErr |= click_buffer_append(oParams, chVal, strlen(chVal));
     }
+    else { // REST
+        iErr |= click_buffer_append(oParams, (bFirst ? "\"" : ",\""), (bFirst ? 1 : 2));
+        iErr |= click_buffer_append(oParams, oKeyVal->sKey->data, strlen(oKeyVal->sKey->data));
+        iErr |= click_buffer_append(oParams, (oKeyVal->bNumber ? "\":" : "\":\""), (oKeyVal->bNumber ? 2 : 3));
+
+        if (oKeyVal->chRawVal != NULL && oKeyVal->bHex)
+            iErr |= local_sms_hex_serialize(oParams, oKeyVal);
+        else if (oKeyVal->chRawVal != NULL)
+            iErr |= click_buffer_append_encoded(oParams, oKeyVal->chRawVal, oKeyVal->iRawValLen, CLICK_ENCODING_JSON);
+        else
+            iErr |= click_buffer_append(oParams, chVal, strlen(chVal));
 
-    // format full URL by combining 1. Clickatell base URL 2. API call script or resource path and 3. Key/Value parameters
-    sUrl = click_string_create(chLocalBaseUrl);
-    if (sUrl == NULL) {
-        click_debug_print("%s ERROR: failed to allocate memory for URL!\n", __func__);
-        goto exit;
+        iErr |= click_buffer_append(oParams, "\"", (oKeyVal->bNumber ? 0 : 1));
     }
 
-    click_string_append(sUrl, sPath, NULL); // append API call script (HTTP) / resource path (REST)
+    return (iErr != 0 ? -1 : 0);
+}
 
-    // cURL eRequestType-type specific logic
-    if (oKeyVals != NULL) {
-        switch (eRequestType) {
-            case CLICK_CURL_POST:
-                sPostData = click_string_duplicate(sApiParams);
-                break;
+/*
+ * Function:  local_sms_dests_count
+ * Info:      Counts the destination addresses of a send message call.
+ * Inputs:    oDests - destination addresses
+ * Return:    number of destination addresses
+ */
+static long local_sms_dests_count(const LocalSmsDests *oDests)
+{
+    if (oDests->oChunk != NULL)
+        return oDests->oChunk->iNum;
 
-            case CLICK_CURL_DELETE:
-                click_string_append(sUrl, sApiParams, NULL);
-                break;
+    return (oDests->oRecipients != NULL ? oDests->oRecipients->iNum : oDests->aMsisdns->iNum);
+}
 
-            case CLICK_CURL_GET:
-            default:
-                click_string_append(sUrl, sApiParams, NULL);
-                break;
-        }
+/*
+ * Function:  local_sms_dests_serialize
+ * Info:      Appends the "to" parameter of a send message call to a request: a ','
+ *            separated list for HTTP (ie. &to=2799900001,2799900002), or a JSON array of
+ *            strings for REST (ie. ,"to":["2799900001","2799900002"]). The digits of a
+ *            ClickRecipients list are already laid out as the HTTP list, so are appended
+ *            with a single copy; for REST, room for the whole array is reserved up front.
+ *            A prepared audience chunk is appended as it is, in the request's form.
+ * Inputs:    oParams   - request parameters being serialized
+ *            eApiType  - API type of the request
+ *            oDests    - destination addresses
+ * Return:    0 if successful, else -1 if failed to allocate memory
+ */
+static int local_sms_dests_serialize(ClickSmsBuffer *oParams, eClickApi eApiType, const LocalSmsDests *oDests)
+{
+    const ClickRecipients *oRecipients = oDests->oRecipients;
+    const ClickMsisdn *aMsisdns = oDests->aMsisdns;
+    const char *chDest = NULL;
+    char *pOut = NULL;
+    long iDestLen = 0;
+    long i = 0, iNum = local_sms_dests_count(oDests);
+    int iErr = 0;
+
+    if (oDests->oChunk != NULL && eApiType == CLICK_API_HTTP)
+        return click_buffer_append(oParams, "&to=", 4) | click_buffer_append(oParams, oDests->oChunk->chHttp, oDests->oChunk->iHttpLen);
+    if (oDests->oChunk != NULL) {
+        iErr |= click_buffer_append(oParams, ",\"to\":[", 7);
+        iErr |= click_buffer_append(oParams, oDests->oChunk->chRest, oDests->oChunk->iRestLen);
+        return iErr | click_buffer_append(oParams, "]", 1);
     }
 
-    // execute curl handle request
-    local_sms_curl_execute(oClickSms, sUrl, eRequestType, sPostData);
+    if (eApiType == CLICK_API_HTTP) {
+        iErr |= click_buffer_append(oParams, "&to=", 4);
 
-    // set response string (memory must be deallocated by calling function)
-    sResponse = click_string_duplicate(oClickSms->sResponse);
+        if (oRecipients != NULL)
+            return iErr | click_buffer_append(oParams, oRecipients->oDigits.data, oRecipients->oDigits.iLen);
 
-exit:
-    click_string_destroy(sUrl);
-    click_string_destroy(sPostData);
-    click_string_destroy(sApiParams);
+        for (i = 0; i < iNum; i++) {
+            iErr |= click_buffer_append(oParams, ",", (i == 0 ? 0 : 1));
+            iErr |= click_buffer_append(oParams, aMsisdns->aDests[i]->data, strlen(aMsisdns->aDests[i]->data));
+        }
+        return iErr;
+    }
 
-    return sResponse;
+    iErr |= click_buffer_append(oParams, ",\"to\":[", 7);
+
+    if (oRecipients != NULL) {
+        // each number is quoted, adding 2 bytes per number to the HTTP list: written in place
+        if (click_buffer_reserve(oParams, oRecipients->oDigits.iLen + 2 * iNum + 1) != 0)
+            return -1;
+
+        pOut = oParams->data + oParams->iLen;
+        for (i = 0; i < iNum; i++) {
+            chDest   = oRecipients->oDigits.data + oRecipients->aOffsets[i];
+            iDestLen = oRecipients->aOffsets[i + 1] - 1 - oRecipients->aOffsets[i];
+            *pOut++  = '"';
+            memcpy(pOut, chDest, iDestLen);
+            pOut    += iDestLen;
+            *pOut++  = '"';
+            *pOut++  = ','; // the last one is replaced by ']'
+        }
+        oParams->iLen = pOut - 1 - oParams->data;
+    }
+    else {
+        for (i = 0; i < iNum; i++) {
+            chDest   = aMsisdns->aDests[i]->data;
+            iDestLen = strlen(chDest);
+            iErr |= click_buffer_append(oParams, (i == 0 ? "\"" : ",\""), (i == 0 ? 1 : 2));
+            iErr |= click_buffer_append(oParams, chDest, iDestLen);
+            iErr |= click_buffer_append(oParams, "\"", 1);
+        }
+    }
+
+    return iErr | click_buffer_append(oParams, "]", 1);
 }
 
 /*
- * Function:  clickatell_sms_message_send
- * Info:      Sends SMSes.
- *            This function will set the URL / post data params as follows:
- *               For REST, we need at least 2 Key/Value pairs -> "text" "to"
- *               For HTTP, we need at least 5 Key/Value pairs -> "user" "password" "api_id" "text" "to"
- *            The calling function must free memory allocated to the returned string.
- * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
- *            sText      - Message Text (Latin1 format supported in this library)
- *            aMsisdns   - Array of destination mobile numbers
- * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ * Function:  local_sms_stream_next
+ * Info:      Moves a body stream on to its next piece: the formatted parameters, the
+ *            "to" prefix, then each recipient's separator, number and (REST) quotes, exactly
+ *            as local_sms_dests_serialize() would format them (or a prepared audience chunk
+ *            as a single piece), and the closing brackets.
+ *            Pieces point into the parameters, the recipients or constant strings; nothing
+ *            is copied.
+ * Inputs:    oStream - body stream
+ * Return:    1 if the stream has a next piece (possibly empty), else 0 at the end of the body
  */
-ClickSmsString *clickatell_sms_message_send(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns)
+static int local_sms_stream_next(LocalSmsBodyStream *oStream)
 {
-    if (oClickSms == NULL || CLICK_STR_INVALID(sText) || CLICK_MSISDN_INVALID(aMsisdns)) {
-        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
-        return NULL;
+    const ClickRecipients *oRecipients = oStream->oDests->oRecipients;
+    const ClickMsisdn *aMsisdns = oStream->oDests->aMsisdns;
+    const ClickAudienceChunk *oChunk = oStream->oDests->oChunk;
+    long iNum = local_sms_dests_count(oStream->oDests);
+    int bRest = (oStream->eApiType == CLICK_API_REST);
+
+    switch (oStream->iStep) {
+        case 0:
+            oStream->pPiece    = oStream->chHead;
+            oStream->iPieceLen = oStream->iHeadLen;
+            break;
+        case 1:
+            oStream->pPiece    = (bRest ? ",\"to\":[" : (oStream->iHeadLen > 0 ? "&to=" : "to="));
+            oStream->iPieceLen = strlen(oStream->pPiece);
+            break;
+        case 2:
+            if (oStream->iDest >= iNum) {
+                oStream->iStep = 3;
+                return local_sms_stream_next(oStream);
+            }
+            if (oChunk != NULL) { // already in the request's form
+                oStream->pPiece    = (bRest ? oChunk->chRest : oChunk->chHttp);
+                oStream->iPieceLen = (bRest ? oChunk->iRestLen : oChunk->iHttpLen);
+                oStream->iDest     = iNum;
+                return 1;
+            }
+            if (!bRest && oRecipients != NULL) { // already laid out as the HTTP list
+                oStream->pPiece    = oRecipients->oDigits.data;
+                oStream->iPieceLen = oRecipients->oDigits.iLen;
+                oStream->iDest     = iNum;
+                return 1;
+            }
+            if (oStream->iDestPart == 0) {
+                oStream->pPiece    = (bRest ? (oStream->iDest == 0 ? "\"" : ",\"") : (oStream->iDest == 0 ? "" : ","));
+                oStream->iPieceLen = strlen(oStream->pPiece);
+            }
+            else if (oStream->iDestPart == 1 && oRecipients != NULL) {
+                oStream->pPiece    = oRecipients->oDigits.data + oRecipients->aOffsets[oStream->iDest];
+                oStream->iPieceLen = oRecipients->aOffsets[oStream->iDest + 1] - 1 - oRecipients->aOffsets[oStream->iDest];
+            }
+            else if (oStream->iDestPart == 1) {
+                oStream->pPiece    = aMsisdns->aDests[oStream->iDest]->data;
+                oStream->iPieceLen = strlen(oStream->pPiece);
+            }
+            else {
+                oStream->pPiece    = "\"";
+                oStream->iPieceLen = 1;
+            }
+            if (++oStream->iDestPart == (bRest ? 3 : 2)) {
+                oStream->iDestPart = 0;
+                oStream->iDest++;
+            }
+            return 1;
+        case 3:
+            oStream->pPiece    = (bRest ? "]}" : "");
+            oStream->iPieceLen = strlen(oStream->pPiece);
+            break;
+        default:
+            return 0;
     }
+    oStream->iStep++;
 
-    int i = 0;
-    ClickSmsString *sResponse  = NULL;
-    ClickSmsString *sPath      = NULL; // API call script file / resource path designator
-    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures, excluding "to" field
-    eClickCurlRequestType eReqType = (oClickSms->eApiType == CLICK_API_HTTP ? CLICK_CURL_GET : CLICK_CURL_POST);
-
-    local_sms_reset(oClickSms); // clear any old memory allocations
+    return 1;
+}
 
-    if (oClickSms->eApiType == CLICK_API_HTTP) {
-        sPath = click_string_create("http/sendmsg.php");
+/*
+ * Function:  local_sms_stream_init
+ * Info:      Starts (or restarts) a body stream, and measures the body (as pieced together
+ *            by local_sms_stream_next()), so that the request can still declare its
+ *            Content-Length.
+ * Inputs:    oStream  - body stream
+ *            eApiType - API type of the request
+ *            chHead   - formatted parameters which precede the recipients (HTTP: without
+ *                       a leading '&'; REST: from the opening brace)
+ *            iHeadLen - length of formatted parameters
+ *            oDests   - destination addresses
+ * Return:    void
+ */
+static void local_sms_stream_init(LocalSmsBodyStream *oStream, eClickApi eApiType, const char *chHead, long iHeadLen,
+                                  const LocalSmsDests *oDests)
+{
+    long i = 0, iNum = local_sms_dests_count(oDests);
+    long iLen = iHeadLen + (iNum - 1); // the parameters, and a ',' between recipients
 
-        // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(4)) == NULL)
-            return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
-        oKeyVals->aKeyValues[3]->sKey = click_string_create("text");
-        oKeyVals->aKeyValues[3]->sVal = click_string_duplicate(sText);
-
-        // URL-encode the URL values
-        for (i = 0; i < oKeyVals->iNum; i++)
-            click_string_url_encode(oKeyVals->aKeyValues[i]->sVal);
+    if (oDests->oChunk != NULL) // already separated by ',', and quoted for REST
+        iLen += (eApiType == CLICK_API_REST ? oDests->oChunk->iRestLen - 2 * iNum : oDests->oChunk->iHttpLen) - (iNum - 1);
+    else if (oDests->oRecipients != NULL)
+        iLen += oDests->oRecipients->oDigits.iLen - (iNum - 1); // already separated by ','
+    else {
+        for (i = 0; i < iNum; i++)
+            iLen += strlen(oDests->aMsisdns->aDests[i]->data);
     }
-    else { // REST
-        sPath = click_string_create("rest/message");
+    if (eApiType == CLICK_API_REST)
+        iLen += 7 + 2 * iNum + 2; // ,"to":[ then quoted recipients then ]}
+    else
+        iLen += (iHeadLen > 0 ? 4 : 3); // &to=
+
+    memset(oStream, 0, sizeof(LocalSmsBodyStream));
+    oStream->eApiType = eApiType;
+    oStream->oDests   = oDests;
+    oStream->chHead   = chHead;
+    oStream->iHeadLen = iHeadLen;
+    oStream->iLen     = iLen;
+}
 
-        // set post data Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(1)) == NULL)
-            return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("text");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(sText);
+/*
+ * Function:  local_sms_stream_dests_fill
+ * Info:      Writes as many whole recipients of a body stream as fit straight into a
+ *            buffer, each with its separator and (REST) quotes, rather than piece by piece.
+ *            Must only be called between recipients.
+ * Inputs:    oStream - body stream, at the start of a recipient
+ *            pBuffer - buffer to fill
+ *            iRoom   - room left in buffer
+ * Return:    bytes written, 0 if the next recipient does not fit (or there is none)
+ */
+static size_t local_sms_stream_dests_fill(LocalSmsBodyStream *oStream, char *pBuffer, size_t iRoom)
+{
+    const ClickRecipients *oRecipients = oStream->oDests->oRecipients;
+    const ClickMsisdn *aMsisdns = oStream->oDests->aMsisdns;
+    long iNum = local_sms_dests_count(oStream->oDests);
+    long iDest = oStream->iDest; // kept in a register: the buffer may alias the stream as far as the compiler knows
+    const char *chDigits = (oRecipients != NULL ? oRecipients->oDigits.data : NULL);
+    const long *aOffsets = (oRecipients != NULL ? oRecipients->aOffsets : NULL);
+    int bRest = (oStream->eApiType == CLICK_API_REST);
+    const char *chDest = NULL;
+    char *pOut = pBuffer, *pEnd = pBuffer + iRoom;
+    size_t iDestLen = 0;
+
+    for (; iDest < iNum; iDest++) {
+        if (chDigits != NULL) {
+            chDest   = chDigits + aOffsets[iDest];
+            iDestLen = aOffsets[iDest + 1] - 1 - aOffsets[iDest];
+        }
+        else {
+            chDest   = aMsisdns->aDests[iDest]->data;
+            iDestLen = strlen(chDest);
+        }
+        if (iDestLen + 3 > (size_t)(pEnd - pOut)) // separator and quotes
+            break;
+
+        if (iDest > 0)
+            *pOut++ = ',';
+        if (bRest)
+            *pOut++ = '"';
+        memcpy(pOut, chDest, iDestLen);
+        pOut += iDestLen;
+        if (bRest)
+            *pOut++ = '"';
     }
+    oStream->iDest = iDest;
 
-    // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, eReqType, oKeyVals, aMsisdns);
+    return pOut - pBuffer;
+}
 
-    // free allocated memory
-    local_click_keyval_array_destroy(oKeyVals);
-    click_string_destroy(sPath);
+/*
+ * Function:  local_sms_stream_read_cb
+ * Info:      Fills the buffer of libcurl (CURLOPT_READFUNCTION), or of a user-supplied
+ *            transport, with the next bytes of a body stream.
+ * Inputs:    pBuffer - buffer to fill
+ *            iSize   - size of each element
+ *            iNum    - number of elements the buffer holds
+ *            pStream - LocalSmsBodyStream
+ * Return:    bytes written to the buffer, 0 at the end of the body
+ */
+static size_t local_sms_stream_read_cb(char *pBuffer, size_t iSize, size_t iNum, void *pStream)
+{
+    LocalSmsBodyStream *oStream = (LocalSmsBodyStream *)pStream;
+    size_t iRoom = iSize * iNum, iCopied = 0, iCopy = 0;
+
+    while (iCopied < iRoom) {
+        // whole recipients are written straight into the buffer while they fit
+        if (oStream->iPieceLen == 0 && oStream->iStep == 2 && oStream->iDestPart == 0 &&
+            oStream->oDests->oChunk == NULL && (oStream->eApiType == CLICK_API_REST || oStream->oDests->oRecipients == NULL) &&
+            (iCopy = local_sms_stream_dests_fill(oStream, pBuffer + iCopied, iRoom - iCopied)) > 0)
+        {
+            iCopied += iCopy;
+            continue;
+        }
+        if (oStream->iPieceLen == 0 && !local_sms_stream_next(oStream))
+            break;
+        iCopy = ((size_t)oStream->iPieceLen < iRoom - iCopied ? (size_t)oStream->iPieceLen : iRoom - iCopied);
+        memcpy(pBuffer + iCopied, oStream->pPiece, iCopy);
+        oStream->pPiece    += iCopy;
+        oStream->iPieceLen -= iCopy;
+        iCopied            += iCopy;
+    }
 
-    return sResponse;
+    return iCopied;
 }
 
 /*
- * Function:  clickatell_sms_status_get
- * Info:      Obtain current status of an SMS message.
- *            Authentication: This function uses Username+Password to authenticate for the
- *                            HTTP API, however it is also possible in a session to use a session ID to
- *                            authenticate with the HTTP API. See the Clickatell API docs at
- *                            www.clickatell.com for more details.
- *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
- *                          this function.
- *            The calling function must free memory allocated to the returned string.
- * Inputs:    oClickSms      - Handle returned from clickatell_sms_init() function call
- *            API Message ID - SMS ID assigned by Clickatell
- * Return:    Status of API message
+ * Function:  local_sms_stream_seek_cb
+ * Info:      Rewinds a body stream when libcurl has to send the body again
+ *            (CURLOPT_SEEKFUNCTION), ie. over a new connection.
+ * Inputs:    pStream - LocalSmsBodyStream
+ *            iOffset - offset to seek to
+ *            iOrigin - SEEK_SET, SEEK_CUR or SEEK_END
+ * Return:    CURL_SEEKFUNC_OK, or CURL_SEEKFUNC_CANTSEEK unless rewinding to the start
  */
-ClickSmsString *clickatell_sms_status_get(ClickSmsHandle *oClickSms, const ClickSmsString *sMsgId)
+static int local_sms_stream_seek_cb(void *pStream, curl_off_t iOffset, int iOrigin)
 {
-    if (oClickSms == NULL || CLICK_STR_INVALID(sMsgId)) {
-        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
-        return NULL;
-    }
+    LocalSmsBodyStream *oStream = (LocalSmsBodyStream *)pStream;
 
-    int i = 0;
-    ClickSmsString *sResponse  = NULL;
-    ClickSmsString *sPath      = NULL; // api call path designator
-    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
+    if (iOffset != 0 || iOrigin != SEEK_SET)
+        return CURL_SEEKFUNC_CANTSEEK;
 
-    local_sms_reset(oClickSms); // clear any old memory allocations
+    local_sms_stream_init(oStream, oStream->eApiType, oStream->chHead, oStream->iHeadLen, oStream->oDests);
 
-    if (oClickSms->eApiType == CLICK_API_HTTP) {
-        sPath = click_string_create("http/querymsg.php");
+    return CURL_SEEKFUNC_OK;
+}
 
-        // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(4)) == NULL)
-            return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
-        oKeyVals->aKeyValues[3]->sKey = click_string_create("apimsgid");
-        oKeyVals->aKeyValues[3]->sVal = click_string_duplicate(sMsgId);
+/*
+ * Function:  local_sms_url_format
+ * Info:      Formats the full URL of a request: the Clickatell base URL, the API call
+ *            script or resource path and, for HTTP, the authentication parameters (the
+ *            session ID while a session is open, else the credentials), then the query.
+ *            Must be called with the handle's lock held.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            chPath    - API call script (HTTP) or resource path (REST)
+ *            oQuery    - parameters which follow the path (HTTP: each preceded by '&'), or NULL
+ *            sAuth     - HTTP authentication parameters, or NULL for the handle's current ones
+ * Return:    new URL, or NULL if failed to allocate memory
+ */
+static ClickSmsString *local_sms_url_format(ClickSmsHandle *oClickSms, const char *chPath, const ClickSmsBuffer *oQuery,
+                                            const ClickSmsString *sAuth)
+{
+    ClickSmsBuffer oUrl = { NULL, 0, 0 };
+    ClickSmsString *sUrl = NULL;
 
-        // URL-encode URL values
-        for (i = 0; i < oKeyVals->iNum; i++)
-            click_string_url_encode(oKeyVals->aKeyValues[i]->sVal);
-    }
-    else { // REST
-        // example URL:  http://api.clickatell.com/rest/message/47584bae0165fbec57b18bf47895fece
-        sPath = click_string_create("rest/message/");
-        click_string_append(sPath, sMsgId, NULL);
-    }
+    if (sAuth == NULL)
+        sAuth = (oClickSms->sSessionAuth != NULL ? oClickSms->sSessionAuth : oClickSms->sHttpAuth);
+    int iErr = 0;
 
-    // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL);
+    iErr |= click_buffer_append(&oUrl, chLocalBaseUrl, sizeof(chLocalBaseUrl) - 1);
+    iErr |= click_buffer_append(&oUrl, chPath, strlen(chPath));
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        iErr |= click_buffer_append(&oUrl, "?", 1);
+        iErr |= click_buffer_append(&oUrl, sAuth->data, strlen(sAuth->data));
+    }
+    if (oQuery != NULL && oQuery->iLen > 0)
+        iErr |= click_buffer_append(&oUrl, oQuery->data, oQuery->iLen);
 
-    // free allocated memory
-    local_click_keyval_array_destroy(oKeyVals);
-    click_string_destroy(sPath);
+    if (iErr == 0)
+        sUrl = click_buffer_detach(&oUrl);
+    click_buffer_free(&oUrl);
 
-    return sResponse;
+    return sUrl;
 }
 
 /*
- * Function:  clickatell_sms_balance_get
- * Info:      Obtain user's credit balance.
- *            Authentication: This function uses Username+Password to authenticate for the
- *                            HTTP API, however it is also possible in a session to use a session ID to
- *                            authenticate with the HTTP API. See the Clickatell API docs at
- *                            www.clickatell.com for more details.
- *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
- *                          this function.
- *            The calling function must free memory allocated to the returned string.
- * Inputs:    oClickSms      - Handle returned from clickatell_sms_init() function call
- * Return:    User's current balance.
+ * Function:  local_sms_session_open
+ * Info:      Opens an HTTP API session: authenticates with auth.php (ie. response
+ *            "OK: 2eda2fe1f07f6e4e96e3e2d39bd1b1b7"), so that subsequent requests send the
+ *            session ID instead of the credentials. Starts the handle's keepalive thread
+ *            the first time. Must be called with the handle's lock held.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ * Outputs:   oClickSms - the auth.php response is left in the handle's 'sResponse' field
+ * Return:    0 if successful, else -1 if authentication failed
  */
-ClickSmsString *clickatell_sms_balance_get(ClickSmsHandle *oClickSms)
+static int local_sms_session_open(ClickSmsHandle *oClickSms)
 {
-    if (oClickSms == NULL) {
-        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
-        return NULL;
-    }
+    ClickSmsString *sUrl = NULL;
+    const char *chId = NULL;
+    long iIdLen = 0;
 
-    int i = 0;
+    click_string_destroy(oClickSms->sSessionAuth);
+    oClickSms->sSessionAuth = NULL;
+
+    if ((sUrl = local_sms_url_format(oClickSms, "http/auth.php", NULL, NULL)) == NULL)
+        return -1;
+    local_sms_reset(oClickSms);
+    local_sms_curl_execute(oClickSms, sUrl, CLICK_CURL_GET, NULL, NULL);
+    click_string_destroy(sUrl);
+
+    if (oClickSms->curlCode != CURLE_OK || CLICK_STR_INVALID(oClickSms->sResponse) ||
+        strncmp(oClickSms->sResponse->data, "OK: ", 4) != 0)
+    {
+        click_debug_print("%s ERROR: HTTP API authentication failed!\n", __func__);
+        return -1;
+    }
+
+    chId = oClickSms->sResponse->data + 4;
+    while (isalnum((unsigned char)chId[iIdLen]))
+        iIdLen++;
+    if (iIdLen == 0 || (oClickSms->sSessionAuth = click_string_create_empty((int)iIdLen + 12)) == NULL)
+        return -1;
+    memcpy(oClickSms->sSessionAuth->data, "session_id=", 11);
+    memcpy(oClickSms->sSessionAuth->data + 11, chId, iIdLen);
+    oClickSms->sSessionAuth->data[11 + iIdLen] = '\0';
+
+    if (!oClickSms->bPingThread)
+        oClickSms->bPingThread = (pthread_create(&oClickSms->oPingThread, NULL, local_sms_session_keepalive, oClickSms) == 0);
+
+    return 0;
+}
+
+/*
+ * Function:  local_sms_session_rejected
+ * Info:      Tells whether the response to a request sent with a session ID rejected the
+ *            session (ie. "ERR: 003, Session ID expired"), so that a new session must be
+ *            opened. Must be called with the handle's lock held.
+ * Inputs:    oClickSms - ClickSmsHandle API handle, holding the response
+ * Return:    1 if rejected, else 0
+ */
+static int local_sms_session_rejected(const ClickSmsHandle *oClickSms)
+{
+    const char *chResponse = (oClickSms->bDiscardResponse ? oClickSms->chResponseHead :
+                              (CLICK_STR_INVALID(oClickSms->sResponse) ? "" : oClickSms->sResponse->data));
+
+    // 001: authentication failed (ie. unknown session ID), 003: session ID expired
+    return (strncmp(chResponse, "ERR: 001", 8) == 0 || strncmp(chResponse, "ERR: 003", 8) == 0);
+}
+
+/*
+ * Function:  local_sms_json_value
+ * Info:      Finds the value of a key in (the start of) a JSON response, allowing for
+ *            whitespace around the colon. The first occurrence of the key followed by a colon
+ *            is used.
+ * Inputs:    chJson - NUL-terminated JSON text
+ *            chKey  - key, including its quotes (ie. "\"accepted\"")
+ * Return:    pointer to the first character of the value, or NULL if the key is not found
+ */
+static const char *local_sms_json_value(const char *chJson, const char *chKey)
+{
+    const char *chValue = chJson;
+
+    while ((chValue = strstr(chValue, chKey)) != NULL) {
+        chValue += strlen(chKey);
+        while (isspace((unsigned char)*chValue))
+            chValue++;
+        if (*chValue != ':')
+            continue; // the key's text used as a value, look further
+        chValue++;
+        while (isspace((unsigned char)*chValue))
+            chValue++;
+        return chValue;
+    }
+
+    return NULL;
+}
+
+/*
+ * Function:  local_sms_response_accepted
+ * Info:      Tells from the status code and the first bytes of a discarded send response
+ *            whether the API accepted the message: for HTTP, a response starting "ID:"
+ *            (rather than "ERR:"); for REST, a 2xx status code without a non-null "error"
+ *            or an "accepted" of false. Only the first recipient's result is within the bytes kept.
+ *            Must be called with the handle's lock held.
+ * Inputs:    oClickSms - ClickSmsHandle API handle, holding the response head
+ * Return:    CLICK_SMS_SUBMIT_ACCEPTED, CLICK_SMS_SUBMIT_REJECTED, or CLICK_SMS_SUBMIT_FAILED if
+ *            there was no response
+ */
+static eClickSmsSubmit local_sms_response_accepted(const ClickSmsHandle *oClickSms)
+{
+    const char *chHead = oClickSms->chResponseHead, *chError = NULL, *chAccepted = NULL;
+
+    if (oClickSms->curlCode != CURLE_OK || oClickSms->iResponseLen == 0)
+        return CLICK_SMS_SUBMIT_FAILED;
+
+    if (oClickSms->eApiType == CLICK_API_HTTP)
+        return (oClickSms->curlHttpStatus == 200 && strncmp(chHead, "ID:", 3) == 0 ? CLICK_SMS_SUBMIT_ACCEPTED : CLICK_SMS_SUBMIT_REJECTED);
+
+    chError    = local_sms_json_value(chHead, "\"error\"");
+    chAccepted = local_sms_json_value(chHead, "\"accepted\"");
+    if (oClickSms->curlHttpStatus < 200 || oClickSms->curlHttpStatus > 299 ||
+        (chError != NULL && strncmp(chError, "null", 4) != 0) || (chAccepted != NULL && strncmp(chAccepted, "false", 5) == 0))
+        return CLICK_SMS_SUBMIT_REJECTED;
+
+    return CLICK_SMS_SUBMIT_ACCEPTED;
+}
+
+/*
+ * Function:  local_sms_session_keepalive
+ * Info:      HTTP API session keepalive thread: while a session is open, pings it with
+ *            ping.php whenever the handle has made no request for the interval set with
+ *            CLICK_SMS_OPTION_HTTP_SESSION, so that it does not expire. A handle which is
+ *            busy is never waited for: its requests keep the session alive. A session whose
+ *            ping fails is closed, so that the next request opens a new one.
+ * Inputs:    pArg - ClickSmsHandle API handle
+ * Return:    NULL
+ */
+static void *local_sms_session_keepalive(void *pArg)
+{
+    ClickSmsHandle *oClickSms = (ClickSmsHandle *)pArg;
+    ClickSmsString *sUrl = NULL;
+    struct timespec oWait;
+    long iInterval = 0;
+    int bStop = 0;
+
+    while (!bStop) {
+        // check twice per interval, so that an idle session is pinged within 1.5 intervals
+        iInterval = local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_SESSION);
+        clock_gettime(CLOCK_MONOTONIC, &oWait);
+        oWait.tv_sec += (iInterval > 0 ? (iInterval + 1) / 2 : CLICK_SMS_SESSION_IDLE_WAIT);
+
+        pthread_mutex_lock(&oClickSms->oPingLock);
+        while (!oClickSms->bPingStop && pthread_cond_timedwait(&oClickSms->oPingWake, &oClickSms->oPingLock, &oWait) == 0)
+            ;
+        bStop = oClickSms->bPingStop;
+        pthread_mutex_unlock(&oClickSms->oPingLock);
+
+        if (bStop || pthread_mutex_trylock(&oClickSms->oLock) != 0)
+            continue;
+
+        iInterval = local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_SESSION);
+        if (oClickSms->sSessionAuth != NULL &&
+            (iInterval == 0 || click_trace_clock_us() - oClickSms->iLastCallUs >= iInterval * 1000000LL))
+        {
+            if (iInterval == 0) { // sessions disabled: let the session expire
+                click_string_destroy(oClickSms->sSessionAuth);
+                oClickSms->sSessionAuth = NULL;
+            }
+            else if ((sUrl = local_sms_url_format(oClickSms, "http/ping.php", NULL, NULL)) != NULL) {
+                local_sms_reset(oClickSms);
+                local_sms_curl_execute(oClickSms, sUrl, CLICK_CURL_GET, NULL, NULL);
+                if (oClickSms->curlCode != CURLE_OK || CLICK_STR_INVALID(oClickSms->sResponse) ||
+                    strncmp(oClickSms->sResponse->data, "OK", 2) != 0)
+                {
+                    click_debug_print("%s: HTTP API session ping failed, session closed\n", __func__);
+                    click_string_destroy(oClickSms->sSessionAuth);
+                    oClickSms->sSessionAuth = NULL;
+                }
+                local_sms_reset(oClickSms);
+                click_string_destroy(sUrl);
+                oClickSms->iLastCallUs = click_trace_clock_us();
+            }
+        }
+
+        pthread_mutex_unlock(&oClickSms->oLock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Function:  local_api_command_execute
+ * Info:      Common function to execute a Clickatell API call.
+ *            This function assumes ALL input parameters are valid.
+ *            If providing HTTP Key/Values, then the sizes of both the
+ *            'param_keys' and the 'param_vals' should match.
+ * Inputs:    oClickSms        - ClickSmsHandle API handle
+ *            sPath            - local path to resource which will be appended to base URL
+ *            eRequestType     - Type of cURL request type (ie POST, GET, DELETE). HTTP API GET
+ *                               requests are sent as form POST requests instead if the handle's
+ *                               CLICK_SMS_OPTION_HTTP_POST option is set.
+ *            oKeyVals         - array of Key/Value pairs. Set this to NULL if no Key/Value pairs
+ *                               will be used.
+ *            oDests           - Destination addresses (for send message call only)
+ *                               This function expects this parameter to be validated by the calling
+ *                               function.
+ *                               If not performing a send message call, then this parameter
+ *                               should be set to NULL.
+ *            eCall            - API call being made, recorded if the handle has a trace attached
+ *            sParam           - main parameter of the API call (message text, message ID or
+ *                               MSISDN), or NULL. Only its length and shape are recorded.
+ *            peAccepted       - NULL to return the response, else the response is discarded
+ *                               as it is received (see local_sms_curl_response_cb()) and only
+ *                               whether the API accepted the message is set here
+ *            oPrepared        - NULL to execute the request, else the request is formatted (never
+ *                               streamed) into this zeroed prepared request instead of being
+ *                               executed
+ * Return:    ClickSmsString containing the curlHandle request's response from Clickatell, or
+ *            NULL if the response was discarded or the request was prepared.
+ *            The calling function must destroy said ClickSmsString.
+ */
+static ClickSmsString *local_api_command_execute(ClickSmsHandle *oClickSms,
+                                                 const ClickSmsString *sPath,
+                                                 eClickCurlRequestType eRequestType,
+                                                 const ClickArrayKeyVal *oKeyVals,
+                                                 const LocalSmsDests *oDests,
+                                                 eClickTraceCall eCall,
+                                                 const ClickSmsString *sParam,
+                                                 eClickSmsSubmit *peAccepted,
+                                                 ClickSmsRequest *oPrepared)
+{
+    if (oClickSms == NULL || CLICK_STR_INVALID(sPath) || CLICK_KEYVAL_ARRAY_INVALID(oKeyVals)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    int i = 0, iErr = 0, bStream = 0;
+    long iStreamMin = local_sms_option_get(oClickSms, CLICK_SMS_OPTION_STREAM_BODY);
+    long iHeadSkip = 0;
+    ClickSmsString *sResponse = NULL, *sPostData = NULL, *sBody = NULL;
+    ClickSmsString oForm = { NULL }; // HTTP API form body, borrowed from oParams
+    ClickSmsBuffer oParams = { NULL, 0, 0 };
+    LocalSmsRequest oRequest;
+
+    // a send to enough recipients has its body generated while it is sent: only the parameters which
+    // precede the recipients are formatted (see local_sms_stream_next())
+    if (oDests != NULL && oPrepared == NULL && iStreamMin > 0 && local_sms_dests_count(oDests) >= iStreamMin) {
+        bStream = (oClickSms->eApiType == CLICK_API_REST ? (eRequestType == CLICK_CURL_POST && oKeyVals != NULL) :
+                   (eRequestType == CLICK_CURL_GET && local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_POST) > 0));
+    }
+
+    // format URL Key/Value parameters (or post data) in a single growing buffer
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        // the parameters follow the authentication parameters, added when the URL is formatted
+        for (i = 0; oKeyVals != NULL && i < oKeyVals->iNum; i++)
+            iErr |= local_sms_keyval_serialize(&oParams, CLICK_API_HTTP, oKeyVals->aKeyValues[i], 0);
+
+        // For send message API calls only: append "to" parameter, example:  &to=2799900001,2799900002
+        if (oDests != NULL && !bStream)
+            iErr |= local_sms_dests_serialize(&oParams, CLICK_API_HTTP, oDests);
+    }
+    else if (oKeyVals != NULL) { // REST
+        iErr |= click_buffer_append(&oParams, "{", 1); // the JSON data is enclosed in opening/closing braces
+
+        // append all non-"to" parameters first, example:  {"sText":"Test Message","callback":"7"}
+        for (i = 0; i < oKeyVals->iNum; i++)
+            iErr |= local_sms_keyval_serialize(&oParams, CLICK_API_REST, oKeyVals->aKeyValues[i], (i == 0));
+
+        // For send message API calls only: append "to" parameter, example:  "to":["2799900001","2799900002"]}'
+        if (oDests != NULL && !bStream)
+            iErr |= local_sms_dests_serialize(&oParams, CLICK_API_REST, oDests);
+        iErr |= click_buffer_append(&oParams, "}", (bStream ? 0 : 1)); // the JSON data is enclosed in opening/closing braces
+    }
+
+    // the parameters become the post data as they are, else they follow the path in the URL
+    if (eRequestType == CLICK_CURL_POST && oKeyVals != NULL && !bStream)
+        sBody = sPostData = click_buffer_detach(&oParams);
+
+    if (iErr != 0 || (eRequestType == CLICK_CURL_POST && oKeyVals != NULL && !bStream && sPostData == NULL)) {
+        click_debug_print("%s ERROR: failed to format request!\n", __func__);
+        goto exit;
+    }
+
+    // HTTP API form POST: the parameters are sent from the buffer they were formatted in, without
+    // their leading '&', so that the URL only holds the authentication parameters
+    if (oClickSms->eApiType == CLICK_API_HTTP && eRequestType == CLICK_CURL_GET && (oParams.iLen > 1 || bStream) &&
+        local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_POST) > 0)
+    {
+        eRequestType = CLICK_CURL_POST;
+        iHeadSkip    = (oParams.iLen > 0 ? 1 : 0);
+        oForm.data   = oParams.data + iHeadSkip;
+        sBody        = (bStream ? NULL : &oForm);
+    }
+
+    memset(&oRequest, 0, sizeof(LocalSmsRequest));
+    oRequest.chPath         = sPath->data;
+    oRequest.eRequestType   = eRequestType;
+    oRequest.oQuery         = (sBody == NULL && !bStream ? &oParams : NULL);
+    oRequest.sBody          = sBody;
+    oRequest.chStreamHead   = (bStream ? oParams.data + iHeadSkip : NULL);
+    oRequest.iStreamHeadLen = (bStream ? oParams.iLen - iHeadSkip : 0);
+    oRequest.oDests         = (bStream ? oDests : NULL);
+    oRequest.iNumDests      = (oDests != NULL ? local_sms_dests_count(oDests) : 0);
+    oRequest.eCall          = eCall;
+    oRequest.sParam         = sParam;
+
+    if (oPrepared == NULL) {
+        sResponse = local_sms_request_send(oClickSms, &oRequest, peAccepted);
+        goto exit;
+    }
+
+    // prepared request: keeps the parameters or body, and the URL formatted with the handle's credentials
+    // (the session ID changes, so is never prepared)
+    oPrepared->eApiType     = oClickSms->eApiType;
+    oPrepared->eRequestType = eRequestType;
+    oPrepared->iNumDests    = oRequest.iNumDests;
+    oPrepared->eCall        = eCall;
+    oPrepared->sPath        = click_string_duplicate(sPath);
+    oPrepared->sParam       = (CLICK_STR_INVALID(sParam) ? NULL : click_string_duplicate(sParam));
+    oPrepared->sUrlAuth     = (oClickSms->eApiType == CLICK_API_HTTP ? click_string_duplicate(oClickSms->sHttpAuth) : NULL);
+    oPrepared->sUrl         = local_sms_url_format(oClickSms, sPath->data, oRequest.oQuery, oClickSms->sHttpAuth);
+    if (sBody != NULL && sBody == sPostData) { // the body was detached from the parameters
+        oPrepared->sBody = sPostData;
+        sPostData        = NULL;
+    }
+    else if (sBody != NULL)
+        oPrepared->sBody = click_string_create(sBody->data);
+    else {
+        oPrepared->oQuery = oParams; // the buffer moves to the prepared request
+        memset(&oParams, 0, sizeof(ClickSmsBuffer));
+    }
+
+    // a copy which failed to allocate leaves the request without its URL, which fails the prepare
+    // (see local_sms_request_prepare())
+    if (oPrepared->sPath == NULL || (!CLICK_STR_INVALID(sParam) && oPrepared->sParam == NULL) ||
+        (oClickSms->eApiType == CLICK_API_HTTP && oPrepared->sUrlAuth == NULL) ||
+        (sBody != NULL && oPrepared->sBody == NULL)) {
+        click_debug_print("%s ERROR: Failed to allocate memory for prepared request!\n", __func__);
+        click_string_destroy(oPrepared->sUrl);
+        oPrepared->sUrl = NULL;
+    }
+
+exit:
+    click_string_destroy(sPostData);
+    click_buffer_free(&oParams);
+
+    return sResponse;
+}
+
+/*
+ * Function:  local_sms_request_send
+ * Info:      Sends a formatted request on a handle: opens the handle's HTTP API session if
+ *            needed (then retries once if the session is rejected), formats the request's
+ *            URL with the handle's authentication parameters unless it was already formatted
+ *            with them, and executes the request. Records the call if a trace is attached.
+ * Inputs:    oClickSms  - ClickSmsHandle API handle
+ *            oRequest   - formatted request
+ *            peAccepted - NULL to return the response, else the response is discarded as it
+ *                         is received (see local_sms_curl_response_cb()) and only whether the
+ *                         API accepted the message is set here
+ * Return:    ClickSmsString containing the curlHandle request's response from Clickatell, or
+ *            NULL if the response was discarded.
+ *            The calling function must destroy said ClickSmsString.
+ */
+static ClickSmsString *local_sms_request_send(ClickSmsHandle *oClickSms, const LocalSmsRequest *oRequest, eClickSmsSubmit *peAccepted)
+{
+    int iAttempt = 0, bSession = 0, bStream = (oRequest->chStreamHead != NULL);
+    long long iStartUs = 0;
+    ClickSmsString *sResponse = NULL, *sUrl = NULL;
+    const ClickSmsString *sSendUrl = NULL;
+    LocalSmsBodyStream oStream;
+
+    // the handle's cURL, session and response fields are only accessed by one thread at a time
+    pthread_mutex_lock(&oClickSms->oLock);
+
+    iStartUs = (oClickSms->oTrace != NULL ? click_trace_clock_us() : 0);
+
+    // HTTP API session: authenticate once, and again (then retry once) if the session is rejected.
+    // Other threads calling on this handle wait for the lock as they would for any request.
+    bSession = (oClickSms->eApiType == CLICK_API_HTTP && local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_SESSION) > 0);
+    for (iAttempt = 0; iAttempt < 2; iAttempt++) {
+        oClickSms->bDiscardResponse = 0; // a session is opened with its response kept
+        if (bSession && oClickSms->sSessionAuth == NULL && local_sms_session_open(oClickSms) != 0)
+            break; // the auth.php response is returned
+        if (!bSession && oClickSms->sSessionAuth != NULL) { // sessions were disabled
+            click_string_destroy(oClickSms->sSessionAuth);
+            oClickSms->sSessionAuth = NULL;
+        }
+
+        // format full URL by combining 1. Clickatell base URL 2. API call script or resource path 3. HTTP
+        // authentication parameters and 4. Key/Value parameters, unless already formatted with this
+        // handle's authentication parameters
+        click_string_destroy(sUrl);
+        sUrl = NULL;
+        if (oRequest->sUrl != NULL && (oClickSms->eApiType == CLICK_API_REST ||
+            (oClickSms->sSessionAuth == NULL && strcmp(oClickSms->sHttpAuth->data, oRequest->sUrlAuth->data) == 0)))
+            sSendUrl = oRequest->sUrl;
+        else if ((sSendUrl = sUrl = local_sms_url_format(oClickSms, oRequest->chPath, oRequest->oQuery, NULL)) == NULL) {
+            click_debug_print("%s ERROR: failed to format request!\n", __func__);
+            break;
+        }
+
+        local_sms_reset(oClickSms); // clear any old memory allocations
+
+        // execute curl handle request, (re)starting any body stream
+        if (bStream)
+            local_sms_stream_init(&oStream, oClickSms->eApiType, oRequest->chStreamHead, oRequest->iStreamHeadLen, oRequest->oDests);
+        oClickSms->bDiscardResponse  = (peAccepted != NULL);
+        oClickSms->chResponseHead[0] = '\0';
+        oClickSms->iResponseLen      = 0;
+        local_sms_curl_execute(oClickSms, (ClickSmsString *)sSendUrl, oRequest->eRequestType, oRequest->sBody, (bStream ? &oStream : NULL));
+
+        if (!bSession || !local_sms_session_rejected(oClickSms))
+            break;
+        click_string_destroy(oClickSms->sSessionAuth);
+        oClickSms->sSessionAuth = NULL;
+    }
+    oClickSms->iLastCallUs = click_trace_clock_us();
+
+    // set response string (memory must be deallocated by calling function), or only whether it accepted the message
+    if (peAccepted != NULL)
+        *peAccepted = (oClickSms->bDiscardResponse ? local_sms_response_accepted(oClickSms) : CLICK_SMS_SUBMIT_FAILED);
+    else
+        sResponse = click_string_duplicate(oClickSms->sResponse);
+
+    if (oClickSms->oTrace != NULL && sSendUrl != NULL)
+        local_sms_trace_record(oClickSms, oRequest->eCall, oRequest->sParam, oRequest->iNumDests, iStartUs, sSendUrl,
+                               (bStream ? oStream.iLen : (CLICK_STR_INVALID(oRequest->sBody) ? 0 : (long)strlen(oRequest->sBody->data))));
+    oClickSms->bDiscardResponse = 0;
+
+    pthread_mutex_unlock(&oClickSms->oLock);
+
+    click_string_destroy(sUrl);
+
+    return sResponse;
+}
+
+/*
+ * Function:  local_sms_message_send
+ * Info:      Sends SMSes: common to clickatell_sms_message_send() and
+ *            clickatell_sms_message_send_buffer() and clickatell_sms_message_send_recipients().
+ *            The text is not copied: it is encoded
+ *            straight into the request (URL-encoded or as hex UCS-2 for HTTP, JSON-escaped
+ *            for REST).
+ *            This function assumes ALL input parameters are valid.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            chText    - message text, NUL terminated
+ *            iTextLen  - length of text in bytes
+ *            oDests    - destination addresses
+ *            peAccepted - NULL to return the response, else only whether the message was
+ *                         accepted is set here (see clickatell_sms_message_submit())
+ *            oPrepared  - NULL to send the message, else the request is prepared into it
+ *                         instead (see clickatell_sms_request_prepare())
+ * Return:    API Message ID or error code, or NULL if the request could not be made, the
+ *            response was discarded or the request was prepared
+ */
+static ClickSmsString *local_sms_message_send(ClickSmsHandle *oClickSms, const char *chText, long iTextLen, const LocalSmsDests *oDests,
+                                              eClickSmsSubmit *peAccepted, ClickSmsRequest *oPrepared)
+{
+    int iKey = 0, bUnicode = 0;
+    ClickSegmentInfo oSegment, oTranslit;
+    int iParts = local_sms_message_parts_get(chText, iTextLen, &oSegment);
+    long iMaxParts = local_sms_option_get(oClickSms, CLICK_SMS_OPTION_MAX_PARTS);
+    long iTranslitLen = 0, iTranslitSize = 0;
+    char chParts[16];
+    char chTranslit[CLICK_SMS_TRANSLIT_STACK_SIZE]; // transliterated text, if it fits
+    char *chTranslitAlloc      = NULL; // transliterated text, if it does not fit in chTranslit
+    char *chTranslitOut        = NULL;
+    ClickSmsString oTraceText  = { NULL }; // only read, by the trace
+    ClickSmsString *sResponse  = NULL;
+    ClickSmsString *sPath      = NULL; // API call script file / resource path designator
+    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures, excluding "to" field
+    ClickKeyVal *oText         = NULL; // the "text" Key/Value pair
+    eClickCurlRequestType eReqType = (oClickSms->eApiType == CLICK_API_HTTP ? CLICK_CURL_GET : CLICK_CURL_POST);
+
+    // opt-in: send text which needs UCS-2 for a few characters (ie. curly quotes) as GSM 7-bit
+    if (oSegment.eCharset == CLICK_CHARSET_UCS2 && local_sms_option_get(oClickSms, CLICK_SMS_OPTION_TRANSLITERATE) != 0) {
+        iTranslitSize = CLICK_CHARSET_TRANSLIT_SIZE(iTextLen);
+        chTranslitOut = (iTranslitSize <= (long)sizeof(chTranslit) ? chTranslit : (chTranslitAlloc = malloc(iTranslitSize)));
+
+        if (chTranslitOut != NULL &&
+            click_segment_transliterate(chText, iTextLen, chTranslitOut, iTranslitSize, &iTranslitLen, NULL, &oTranslit) > 0 &&
+            oTranslit.eCharset == CLICK_CHARSET_GSM7 && oTranslit.iParts <= iParts)
+        {
+            click_debug_print("%s: text transliterated to GSM 7-bit, %d parts before, %d after\n", __func__, iParts, oTranslit.iParts);
+            chText   = chTranslitOut;
+            iTextLen = iTranslitLen;
+            oSegment = oTranslit;
+            iParts   = oTranslit.iParts;
+        }
+    }
+    bUnicode = (oClickSms->eApiType == CLICK_API_HTTP && oSegment.eCharset == CLICK_CHARSET_UCS2);
+    oTraceText.data = (char *)chText;
+
+    if ((iMaxParts > 0 && iParts > iMaxParts) || iParts > CLICK_SEGMENT_MAX_PARTS) {
+        click_debug_print("%s ERROR: message needs %d parts, at most %ld allowed!\n", __func__, iParts,
+                          (iMaxParts > 0 && iMaxParts < CLICK_SEGMENT_MAX_PARTS ? iMaxParts : (long)CLICK_SEGMENT_MAX_PARTS));
+        goto exit;
+    }
+    snprintf(chParts, sizeof(chParts), "%d", iParts);
+
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        sPath = click_string_create("http/sendmsg.php");
+
+        // set URL Key/Value pairs
+        if ((oKeyVals = local_click_keyval_array_create(1 + (iParts > 1) + bUnicode)) == NULL)
+            goto exit;
+        oText = oKeyVals->aKeyValues[0];
+        iKey  = 1;
+        if (iParts > 1) {
+            oKeyVals->aKeyValues[iKey]->sKey = click_string_create("concat");
+            oKeyVals->aKeyValues[iKey]->sVal = click_string_create(chParts);
+            iKey++;
+        }
+        if (bUnicode) {
+            oKeyVals->aKeyValues[iKey]->sKey = click_string_create("unicode");
+            oKeyVals->aKeyValues[iKey]->sVal = click_string_create("1");
+        }
+
+        // URL-encode the URL values (the text is encoded as it is serialized)
+        for (iKey = 0; iKey < oKeyVals->iNum; iKey++) {
+            if (oKeyVals->aKeyValues[iKey] != oText)
+                click_string_url_encode(oKeyVals->aKeyValues[iKey]->sVal);
+        }
+    }
+    else { // REST
+        sPath = click_string_create("rest/message");
+
+        // set post data Key/Value pairs
+        if ((oKeyVals = local_click_keyval_array_create(iParts > 1 ? 2 : 1)) == NULL)
+            goto exit;
+        oText = oKeyVals->aKeyValues[0];
+        if (iParts > 1) {
+            oKeyVals->aKeyValues[1]->sKey    = click_string_create("maxMessageParts");
+            oKeyVals->aKeyValues[1]->sVal    = click_string_create(chParts);
+            oKeyVals->aKeyValues[1]->bNumber = 1;
+        }
+    }
+
+    oText->sKey       = click_string_create("text");
+    oText->chRawVal   = chText;
+    oText->iRawValLen = iTextLen;
+    oText->bUcs2Hex   = bUnicode;
+
+    // performs formatting of API call and then executes the request
+    sResponse = local_api_command_execute(oClickSms, sPath, eReqType, oKeyVals, oDests,
+                                          CLICK_TRACE_MESSAGE_SEND, &oTraceText, peAccepted, oPrepared);
+
+exit:
+    // free allocated memory
+    local_click_keyval_array_destroy(oKeyVals);
+    click_string_destroy(sPath);
+    free(chTranslitAlloc);
+
+    return sResponse;
+}
+
+/*
+ * Function:  local_sms_request_prepare
+ * Info:      Prepares a send message request: common to clickatell_sms_request_prepare() and
+ *            clickatell_sms_request_prepare_recipients().
+ *            This function assumes ALL input parameters are valid.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            chText    - message text, NUL terminated
+ *            iTextLen  - length of text in bytes
+ *            oDests    - destination addresses
+ * Return:    new prepared request with one reference, or NULL if the request could not be
+ *            formatted or failed to allocate memory
+ */
+static ClickSmsRequest *local_sms_request_prepare(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                  const LocalSmsDests *oDests)
+{
+    ClickSmsRequest *oRequest = NULL;
+
+    if ((oRequest = (ClickSmsRequest *)calloc(1, sizeof(ClickSmsRequest))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for request!\n", __func__);
+        return NULL;
+    }
+    oRequest->iRefs = 1;
+
+    local_sms_message_send(oClickSms, chText, iTextLen, oDests, NULL, oRequest);
+    if (oRequest->sPath == NULL || oRequest->sUrl == NULL) {
+        click_debug_print("%s ERROR: failed to prepare request!\n", __func__);
+        clickatell_sms_request_release(oRequest);
+        return NULL;
+    }
+
+    return oRequest;
+}
+
+/*
+ * Function:  local_sms_prepared_send
+ * Info:      Sends a prepared request on a handle: common to clickatell_sms_request_execute()
+ *            and clickatell_sms_request_submit(). Nothing is formatted unless the handle has to
+ *            format its own URL.
+ *            This function assumes ALL input parameters are valid.
+ * Inputs:    oClickSms  - ClickSmsHandle API handle, of the request's API
+ *            oRequest   - prepared request
+ *            peAccepted - NULL to return the response, else only whether the message was
+ *                         accepted is set here
+ * Return:    API Message ID or error code, or NULL if the request could not be made or the
+ *            response was discarded
+ */
+static ClickSmsString *local_sms_prepared_send(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest, eClickSmsSubmit *peAccepted)
+{
+    LocalSmsRequest oSend;
+
+    memset(&oSend, 0, sizeof(LocalSmsRequest));
+    oSend.chPath       = oRequest->sPath->data;
+    oSend.eRequestType = oRequest->eRequestType;
+    oSend.oQuery       = (oRequest->sBody == NULL ? &oRequest->oQuery : NULL);
+    oSend.sBody        = oRequest->sBody;
+    oSend.sUrl         = oRequest->sUrl;
+    oSend.sUrlAuth     = oRequest->sUrlAuth;
+    oSend.iNumDests    = oRequest->iNumDests;
+    oSend.eCall        = oRequest->eCall;
+    oSend.sParam       = oRequest->sParam;
+
+    return local_sms_request_send(oClickSms, &oSend, peAccepted);
+}
+
+/*
+ * Function:  local_sms_audience_chunk_get
+ * Info:      Returns a chunk of a prepared audience to be sent on a handle: for the HTTP
+ *            API, the chunk must not have more recipients than a request may take
+ *            (CLICK_SMS_HTTP_GET_TO_MAX, or CLICK_SMS_HTTP_POST_TO_MAX with
+ *            CLICK_SMS_OPTION_HTTP_POST set).
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            oAudience - prepared audience
+ *            iChunk    - index of the chunk
+ * Return:    chunk, or NULL if invalid parameter or the chunk is too large for the handle
+ */
+static const ClickAudienceChunk *local_sms_audience_chunk_get(ClickSmsHandle *oClickSms, const ClickAudience *oAudience, long iChunk)
+{
+    long iToMax = (local_sms_option_get(oClickSms, CLICK_SMS_OPTION_HTTP_POST) > 0 ? CLICK_SMS_HTTP_POST_TO_MAX : CLICK_SMS_HTTP_GET_TO_MAX);
+
+    if (oAudience == NULL || oAudience->aChunks == NULL || iChunk < 0 || iChunk >= oAudience->iChunks) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if (oClickSms->eApiType == CLICK_API_HTTP && oAudience->aChunks[iChunk].iNum > iToMax) {
+        click_debug_print("%s ERROR: audience chunk of %ld recipients exceeds the maximum of %ld!\n", __func__,
+                          oAudience->aChunks[iChunk].iNum, iToMax);
+        return NULL;
+    }
+
+    return &oAudience->aChunks[iChunk];
+}
+
+/*
+ * Function:  local_sms_binary_valid
+ * Info:      Validates a binary message: its UDH and user data must fit in a single SMS,
+ *            and the UDH must start with its own length.
+ * Inputs:    oBinary - binary message
+ * Return:    1 if valid, else 0
+ */
+static int local_sms_binary_valid(const ClickSmsBinary *oBinary)
+{
+    if (oBinary == NULL || oBinary->iUdhLen < 0 || oBinary->iDataLen < 0 || oBinary->iUdhLen + oBinary->iDataLen < 1 ||
+        (oBinary->iUdhLen > 0 && oBinary->aUdh == NULL) || (oBinary->iDataLen > 0 && oBinary->aData == NULL) ||
+        oBinary->iDataCoding < -1 || oBinary->iDataCoding > 0xff)
+        return 0;
+
+    if (oBinary->iUdhLen + oBinary->iDataLen > CLICK_SEGMENT_DATA_MAX) {
+        click_debug_print("%s ERROR: UDH and data of %ld octets do not fit in an SMS of %d octets!\n", __func__,
+                          oBinary->iUdhLen + oBinary->iDataLen, CLICK_SEGMENT_DATA_MAX);
+        return 0;
+    }
+
+    if (oBinary->iUdhLen > 0 && oBinary->aUdh[0] != oBinary->iUdhLen - 1) {
+        click_debug_print("%s ERROR: UDH length octet %d does not match UDH of %ld octets!\n", __func__,
+                          oBinary->aUdh[0], oBinary->iUdhLen);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Function:  local_sms_binary_send
+ * Info:      Sends binary SMSes: common to clickatell_sms_message_send_binary() and
+ *            clickatell_sms_message_send_binary_recipients(). The UDH and user data are not
+ *            copied: they are written straight into the request as hex digits ("udh" and
+ *            "data" for HTTP; "udh" and "text", with "binary" set, for REST). A data coding
+ *            scheme is passed as "dcs".
+ *            This function assumes ALL input parameters are valid.
+ * Inputs:    oClickSms - ClickSmsHandle API handle
+ *            oBinary   - binary message
+ *            oDests    - destination addresses
+ * Return:    API Message ID or error code, or NULL if the request could not be made
+ */
+static ClickSmsString *local_sms_binary_send(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary, const LocalSmsDests *oDests)
+{
+    int iKey = 0, bUdh = (oBinary->iUdhLen > 0), bDataCoding = (oBinary->iDataCoding >= 0);
+    char chDataCoding[16];
+    ClickSmsString *sResponse  = NULL;
+    ClickSmsString *sPath      = NULL; // API call script file / resource path designator
+    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures, excluding "to" field
+    ClickKeyVal *oUdh          = NULL; // the "udh" Key/Value pair
+    ClickKeyVal *oData         = NULL; // the "data" (HTTP) or "text" (REST) Key/Value pair
+    ClickKeyVal *oDataCoding   = NULL; // the "dcs" Key/Value pair
+    eClickCurlRequestType eReqType = (oClickSms->eApiType == CLICK_API_HTTP ? CLICK_CURL_GET : CLICK_CURL_POST);
+
+    snprintf(chDataCoding, sizeof(chDataCoding), "%d", oBinary->iDataCoding);
+
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        sPath = click_string_create("http/sendmsg.php");
+
+        // set URL Key/Value pairs
+        if ((oKeyVals = local_click_keyval_array_create(1 + bUdh + bDataCoding)) == NULL)
+            goto exit;
+        iKey = 0;
+        oUdh = (bUdh ? oKeyVals->aKeyValues[iKey++] : NULL);
+        oData = oKeyVals->aKeyValues[iKey++];
+        oData->sKey = click_string_create("data");
+        oDataCoding = (bDataCoding ? oKeyVals->aKeyValues[iKey] : NULL);
+    }
+    else { // REST
+        sPath = click_string_create("rest/message");
+
+        // set post data Key/Value pairs
+        if ((oKeyVals = local_click_keyval_array_create(2 + bUdh + bDataCoding)) == NULL)
+            goto exit;
+        oKeyVals->aKeyValues[0]->sKey    = click_string_create("binary");
+        oKeyVals->aKeyValues[0]->sVal    = click_string_create("true");
+        oKeyVals->aKeyValues[0]->bNumber = 1;
+        iKey = 1;
+        oUdh = (bUdh ? oKeyVals->aKeyValues[iKey++] : NULL);
+        oData = oKeyVals->aKeyValues[iKey++];
+        oData->sKey = click_string_create("text");
+        oDataCoding = (bDataCoding ? oKeyVals->aKeyValues[iKey] : NULL);
+    }
+
+    if (oUdh != NULL) {
+        oUdh->sKey       = click_string_create("udh");
+        oUdh->chRawVal   = (const char *)oBinary->aUdh;
+        oUdh->iRawValLen = oBinary->iUdhLen;
+        oUdh->bHex       = 1;
+    }
+    oData->chRawVal   = (oBinary->iDataLen > 0 ? (const char *)oBinary->aData : NULL);
+    oData->iRawValLen = oBinary->iDataLen;
+    oData->bHex       = 1;
+    if (oDataCoding != NULL) {
+        oDataCoding->sKey    = click_string_create("dcs");
+        oDataCoding->sVal    = click_string_create(chDataCoding);
+        oDataCoding->bNumber = 1;
+    }
+
+    // URL-encode the URL values (the UDH and data are hex digits, which need no encoding)
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        for (iKey = 0; iKey < oKeyVals->iNum; iKey++) {
+            if (oKeyVals->aKeyValues[iKey]->chRawVal == NULL)
+                click_string_url_encode(oKeyVals->aKeyValues[iKey]->sVal);
+        }
+    }
+
+    // performs formatting of API call and then executes the request
+    sResponse = local_api_command_execute(oClickSms, sPath, eReqType, oKeyVals, oDests,
+                                          CLICK_TRACE_MESSAGE_SEND_BINARY, NULL, NULL, NULL);
+
+exit:
+    // free allocated memory
+    local_click_keyval_array_destroy(oKeyVals);
+    click_string_destroy(sPath);
+
+    return sResponse;
+}
+
+/*
+ * Function:  clickatell_sms_message_send
+ * Info:      Sends SMSes.
+ *            This function will set the URL / post data params as follows:
+ *               For REST, we need at least 2 Key/Value pairs -> "text" "to"
+ *               For HTTP, we need at least 2 Key/Value pairs -> "text" "to", after the authentication
+ *               parameters (see local_api_command_execute())
+ *            Messages longer than a single SMS are sent as several concatenated parts: the
+ *            part count is calculated (see click_segment_count()) and passed as "concat" for
+ *            HTTP or "maxMessageParts" for REST. Text which is not UTF-8 (ie. Latin1) is
+ *            counted as one septet per byte. If the handle's CLICK_SMS_OPTION_MAX_PARTS
+ *            option is set, messages needing more parts are rejected without being sent.
+ *            If the handle's CLICK_SMS_OPTION_TRANSLITERATE option is set, text which needs
+ *            UCS-2 is transliterated (see click_segment_transliterate()) and sent as GSM
+ *            7-bit instead if every such character has an equivalent and no more parts are
+ *            needed.
+ *            Unicode: for HTTP, UTF-8 text which is not in the GSM 03.38 alphabet is sent
+ *            as hex-encoded UCS-2 with "unicode" set to 1.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            sText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text)
+ *            aMsisdns   - Array of destination mobile numbers
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ *            or the message needs more than the maximum allowed parts
+ */
+ClickSmsString *clickatell_sms_message_send(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns)
+{
+    if (oClickSms == NULL || CLICK_STR_INVALID(sText) || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    LocalSmsDests oDests = { aMsisdns, NULL };
+
+    return local_sms_message_send(oClickSms, sText->data, (long)strlen(sText->data), &oDests, NULL, NULL);
+}
+
+/*
+ * Function:  clickatell_sms_message_send_buffer
+ * Info:      Sends SMSes, exactly as clickatell_sms_message_send(), with the text taken
+ *            from a ClickSmsBuffer (ie. a reusable buffer a template was rendered into, see
+ *            click_template_render()). The text is serialized straight from the buffer,
+ *            without being copied into a ClickSmsString first.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            oText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text)
+ *            aMsisdns   - Array of destination mobile numbers
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ *            or the message needs more than the maximum allowed parts
+ */
+ClickSmsString *clickatell_sms_message_send_buffer(ClickSmsHandle *oClickSms, const ClickSmsBuffer *oText, ClickMsisdn *aMsisdns)
+{
+    if (oClickSms == NULL || oText == NULL || oText->data == NULL || oText->iLen < 1 || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    LocalSmsDests oDests = { aMsisdns, NULL };
+
+    return local_sms_message_send(oClickSms, oText->data, oText->iLen, &oDests, NULL, NULL);
+}
+
+/*
+ * Function:  clickatell_sms_message_send_recipients
+ * Info:      Sends SMSes, exactly as clickatell_sms_message_send(), to a compact recipient
+ *            list (see clickatell_recipients.h). The list's numbers are written into the
+ *            request's "to" parameter straight from the list's buffer.
+ *            The text may be taken from a ClickSmsString (sText->data, -1) or a
+ *            ClickSmsBuffer (oText->data, oText->iLen).
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_init() function call
+ *            chText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text), NUL terminated
+ *            iTextLen    - length of text in bytes, or -1 to use strlen(chText)
+ *            oRecipients - destination mobile numbers
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ *            or the message needs more than the maximum allowed parts
+ */
+ClickSmsString *clickatell_sms_message_send_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                       const ClickRecipients *oRecipients)
+{
+    LocalSmsDests oDests = { NULL, oRecipients };
+
+    if (oClickSms == NULL || chText == NULL || CLICK_RECIPIENTS_INVALID(oRecipients)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if (iTextLen < 0)
+        iTextLen = (long)strlen(chText);
+
+    if (iTextLen < 1) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_message_send(oClickSms, chText, iTextLen, &oDests, NULL, NULL);
+}
+
+/*
+ * Function:  clickatell_sms_message_submit
+ * Info:      Sends SMSes exactly as clickatell_sms_message_send(), fire-and-forget: the
+ *            response is not kept. Only its status code and first bytes are scanned as they
+ *            arrive, to tell whether the message was accepted ("ID:" rather than "ERR:" for
+ *            HTTP; a 2xx status code without an error for REST); the rest is discarded without
+ *            being buffered, and no response string is allocated. With several recipients,
+ *            only the first recipient's result is judged.
+ *            The message IDs are not returned, so delivery can only be followed through
+ *            delivery receipt callbacks (see clickatell_callback.h).
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            sText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text)
+ *            aMsisdns   - Array of destination mobile numbers
+ * Return:    CLICK_SMS_SUBMIT_ACCEPTED or CLICK_SMS_SUBMIT_REJECTED, or CLICK_SMS_SUBMIT_FAILED if
+ *            invalid parameter, the message needs more than the maximum allowed parts, or the
+ *            request failed
+ */
+eClickSmsSubmit clickatell_sms_message_submit(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns)
+{
+    eClickSmsSubmit eAccepted = CLICK_SMS_SUBMIT_FAILED;
+
+    if (oClickSms == NULL || CLICK_STR_INVALID(sText) || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    LocalSmsDests oDests = { aMsisdns, NULL };
+
+    local_sms_message_send(oClickSms, sText->data, (long)strlen(sText->data), &oDests, &eAccepted, NULL);
+    return eAccepted;
+}
+
+/*
+ * Function:  clickatell_sms_message_submit_recipients
+ * Info:      Submits SMSes, exactly as clickatell_sms_message_submit(), to a compact
+ *            recipient list (see clickatell_recipients.h).
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_init() function call
+ *            chText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text), NUL terminated
+ *            iTextLen    - length of text in bytes, or -1 to use strlen(chText)
+ *            oRecipients - destination mobile numbers
+ * Return:    CLICK_SMS_SUBMIT_ACCEPTED or CLICK_SMS_SUBMIT_REJECTED, or CLICK_SMS_SUBMIT_FAILED if
+ *            invalid parameter, the message needs more than the maximum allowed parts, or the
+ *            request failed
+ */
+eClickSmsSubmit clickatell_sms_message_submit_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                         const ClickRecipients *oRecipients)
+{
+    eClickSmsSubmit eAccepted = CLICK_SMS_SUBMIT_FAILED;
+    LocalSmsDests oDests = { NULL, oRecipients };
+
+    if (oClickSms == NULL || chText == NULL || CLICK_RECIPIENTS_INVALID(oRecipients)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    if (iTextLen < 0)
+        iTextLen = (long)strlen(chText);
+
+    if (iTextLen < 1) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    local_sms_message_send(oClickSms, chText, iTextLen, &oDests, &eAccepted, NULL);
+    return eAccepted;
+}
+
+/*
+ * Function:  clickatell_sms_message_send_audience
+ * Info:      Sends SMSes, exactly as clickatell_sms_message_send(), to one chunk of a
+ *            prepared audience (see clickatell_audience.h). The chunk is already in the
+ *            request's wire form, so it is spliced into the request as it is. The audience
+ *            is only read, so may be sent from several handles at once; a send to the whole
+ *            audience is a send per chunk.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            chText     - Message Text (UTF-8, or Latin1 for GSM 03.38 text), NUL terminated
+ *            iTextLen   - length of text in bytes, or -1 to use strlen(chText)
+ *            oAudience  - prepared audience
+ *            iChunk     - index of the chunk to send to, from 0 to oAudience->iChunks - 1
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter,
+ *            the chunk has too many recipients for the handle, or the message needs more than the
+ *            maximum allowed parts
+ */
+ClickSmsString *clickatell_sms_message_send_audience(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                     const ClickAudience *oAudience, long iChunk)
+{
+    LocalSmsDests oDests = { NULL, NULL, NULL };
+
+    if (oClickSms == NULL || chText == NULL || (oDests.oChunk = local_sms_audience_chunk_get(oClickSms, oAudience, iChunk)) == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if (iTextLen < 0)
+        iTextLen = (long)strlen(chText);
+
+    if (iTextLen < 1) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_message_send(oClickSms, chText, iTextLen, &oDests, NULL, NULL);
+}
+
+/*
+ * Function:  clickatell_sms_message_submit_audience
+ * Info:      Submits SMSes, exactly as clickatell_sms_message_submit(), to one chunk of a
+ *            prepared audience (see clickatell_sms_message_send_audience()).
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            chText     - Message Text (UTF-8, or Latin1 for GSM 03.38 text), NUL terminated
+ *            iTextLen   - length of text in bytes, or -1 to use strlen(chText)
+ *            oAudience  - prepared audience
+ *            iChunk     - index of the chunk to send to, from 0 to oAudience->iChunks - 1
+ * Return:    CLICK_SMS_SUBMIT_ACCEPTED or CLICK_SMS_SUBMIT_REJECTED, or CLICK_SMS_SUBMIT_FAILED if
+ *            invalid parameter, the chunk has too many recipients for the handle, the message needs
+ *            more than the maximum allowed parts, or the request failed
+ */
+eClickSmsSubmit clickatell_sms_message_submit_audience(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                       const ClickAudience *oAudience, long iChunk)
+{
+    eClickSmsSubmit eAccepted = CLICK_SMS_SUBMIT_FAILED;
+    LocalSmsDests oDests = { NULL, NULL, NULL };
+
+    if (oClickSms == NULL || chText == NULL || (oDests.oChunk = local_sms_audience_chunk_get(oClickSms, oAudience, iChunk)) == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    if (iTextLen < 0)
+        iTextLen = (long)strlen(chText);
+
+    if (iTextLen < 1) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    local_sms_message_send(oClickSms, chText, iTextLen, &oDests, &eAccepted, NULL);
+    return eAccepted;
+}
+
+/*
+ * Function:  clickatell_sms_request_prepare
+ * Info:      Prepares a send, exactly as clickatell_sms_message_send() would format it,
+ *            without sending it: the path, parameters (URL-encoded or JSON), body and URL are
+ *            formatted once into a request which can then be executed any number of times
+ *            (ie. retried, hedged on another handle, or sent later) with
+ *            clickatell_sms_request_execute(), at the cost of the network I/O only.
+ *            The request is read only once prepared, and reference counted, so it may be
+ *            executed from several threads and handles at once. For HTTP, the URL holds the
+ *            preparing handle's credentials: a handle with other credentials, or with an open
+ *            session, formats its own URL from the prepared parameters. The handle's options
+ *            (ie. CLICK_SMS_OPTION_HTTP_POST) are applied when the request is prepared; the
+ *            body is never streamed.
+ *            The calling function must release the returned request.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            sText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text)
+ *            aMsisdns   - Array of destination mobile numbers
+ * Return:    new prepared request with one reference, or NULL if invalid parameter, the message
+ *            needs more than the maximum allowed parts or failed to allocate memory
+ */
+ClickSmsRequest *clickatell_sms_request_prepare(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns)
+{
+    if (oClickSms == NULL || CLICK_STR_INVALID(sText) || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    LocalSmsDests oDests = { aMsisdns, NULL, NULL };
+
+    return local_sms_request_prepare(oClickSms, sText->data, (long)strlen(sText->data), &oDests);
+}
+
+/*
+ * Function:  clickatell_sms_request_prepare_recipients
+ * Info:      Prepares a send, exactly as clickatell_sms_request_prepare(), to a compact
+ *            recipient list (see clickatell_recipients.h). The list may be changed or
+ *            destroyed once the request is prepared.
+ *            The calling function must release the returned request.
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_init() function call
+ *            chText      - Message Text (UTF-8, or Latin1 for GSM 03.38 text), NUL terminated
+ *            iTextLen    - length of text in bytes, or -1 to use strlen(chText)
+ *            oRecipients - destination mobile numbers
+ * Return:    new prepared request with one reference, or NULL if invalid parameter, the message
+ *            needs more than the maximum allowed parts or failed to allocate memory
+ */
+ClickSmsRequest *clickatell_sms_request_prepare_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                           const ClickRecipients *oRecipients)
+{
+    LocalSmsDests oDests = { NULL, oRecipients, NULL };
+
+    if (oClickSms == NULL || chText == NULL || CLICK_RECIPIENTS_INVALID(oRecipients)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if (iTextLen < 0)
+        iTextLen = (long)strlen(chText);
+
+    if (iTextLen < 1) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_request_prepare(oClickSms, chText, iTextLen, &oDests);
+}
+
+/*
+ * Function:  clickatell_sms_request_ref
+ * Info:      Adds a reference to a prepared request, ie. for another thread which executes
+ *            it. Each reference must be released with clickatell_sms_request_release().
+ * Inputs:    oRequest - prepared request
+ * Return:    the request, or NULL if invalid parameter
+ */
+ClickSmsRequest *clickatell_sms_request_ref(ClickSmsRequest *oRequest)
+{
+    if (oRequest == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    __atomic_add_fetch(&oRequest->iRefs, 1, __ATOMIC_RELAXED);
+
+    return oRequest;
+}
+
+/*
+ * Function:  clickatell_sms_request_release
+ * Info:      Releases a reference to a prepared request, destroying the request when its
+ *            last reference is released.
+ * Inputs:    oRequest - prepared request
+ * Return:    void
+ */
+void clickatell_sms_request_release(ClickSmsRequest *oRequest)
+{
+    if (oRequest == NULL || __atomic_sub_fetch(&oRequest->iRefs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    click_string_destroy(oRequest->sPath);
+    click_buffer_free(&oRequest->oQuery);
+    click_string_destroy(oRequest->sBody);
+    click_string_destroy(oRequest->sUrl);
+    click_string_destroy(oRequest->sUrlAuth);
+    click_string_destroy(oRequest->sParam);
+    free(oRequest);
+}
+
+/*
+ * Function:  clickatell_sms_request_execute
+ * Info:      Executes a prepared request on a handle of the API it was prepared for: the
+ *            request is sent as it was formatted, so only the network I/O is done (unless the
+ *            handle has to format its own URL, see clickatell_sms_request_prepare()). HTTP API
+ *            sessions are opened and renewed as for any request.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            oRequest   - prepared request
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ */
+ClickSmsString *clickatell_sms_request_execute(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest)
+{
+    if (oClickSms == NULL || oRequest == NULL || oRequest->eApiType != oClickSms->eApiType) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_prepared_send(oClickSms, oRequest, NULL);
+}
+
+/*
+ * Function:  clickatell_sms_request_submit
+ * Info:      Executes a prepared request, exactly as clickatell_sms_request_execute(),
+ *            fire-and-forget (see clickatell_sms_message_submit()).
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            oRequest   - prepared request
+ * Return:    CLICK_SMS_SUBMIT_ACCEPTED or CLICK_SMS_SUBMIT_REJECTED, or CLICK_SMS_SUBMIT_FAILED if
+ *            invalid parameter or the request failed
+ */
+eClickSmsSubmit clickatell_sms_request_submit(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest)
+{
+    eClickSmsSubmit eAccepted = CLICK_SMS_SUBMIT_FAILED;
+
+    if (oClickSms == NULL || oRequest == NULL || oRequest->eApiType != oClickSms->eApiType) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return CLICK_SMS_SUBMIT_FAILED;
+    }
+
+    local_sms_prepared_send(oClickSms, oRequest, &eAccepted);
+    return eAccepted;
+}
+
+/*
+ * Function:  clickatell_sms_message_send_binary
+ * Info:      Sends binary SMSes (ie. WAP push or SIM OTA data): a user data header and
+ *            user data, which together must fit in a single SMS (CLICK_SEGMENT_DATA_MAX
+ *            octets). Both are written into the request as hex digits, without being
+ *            copied first: "udh" and "data" for HTTP, or "udh" and "text" with "binary"
+ *            set to true for REST. A data coding scheme other than -1 is passed as "dcs".
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms  - Handle returned from clickatell_sms_init() function call
+ *            oBinary    - binary message
+ *            aMsisdns   - Array of destination mobile numbers
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ *            or the message does not fit in an SMS
+ */
+ClickSmsString *clickatell_sms_message_send_binary(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary, ClickMsisdn *aMsisdns)
+{
+    LocalSmsDests oDests = { aMsisdns, NULL };
+
+    if (oClickSms == NULL || !local_sms_binary_valid(oBinary) || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_binary_send(oClickSms, oBinary, &oDests);
+}
+
+/*
+ * Function:  clickatell_sms_message_send_binary_recipients
+ * Info:      Sends binary SMSes, exactly as clickatell_sms_message_send_binary(), to a
+ *            compact recipient list (see clickatell_recipients.h).
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_init() function call
+ *            oBinary     - binary message
+ *            oRecipients - destination mobile numbers
+ * Return:    API Message ID or error code if eRequestType unsuccessful or NULL if invalid parameter
+ *            or the message does not fit in an SMS
+ */
+ClickSmsString *clickatell_sms_message_send_binary_recipients(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary,
+                                                              const ClickRecipients *oRecipients)
+{
+    LocalSmsDests oDests = { NULL, oRecipients };
+
+    if (oClickSms == NULL || !local_sms_binary_valid(oBinary) || CLICK_RECIPIENTS_INVALID(oRecipients)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_binary_send(oClickSms, oBinary, &oDests);
+}
+
+/*
+ * Function:  local_sms_batch_execute
+ * Info:      Makes a batch item call: common to clickatell_sms_batch_item_send(),
+ *            clickatell_sms_batch_quicksend() and clickatell_sms_batch_end(). The batch ID
+ *            is URL-encoded; field values are borrowed and URL-encoded straight into the
+ *            request as field1, field2, ...
+ *            This function assumes ALL input parameters are valid.
+ * Inputs:    oClickSms - ClickSmsHandle API handle (HTTP)
+ *            chScript  - API call script
+ *            sBatchId  - batch ID returned by startbatch.php
+ *            oDests    - destination addresses, or NULL
+ *            aFields   - template field values, or NULL
+ *            iFields   - number of field values
+ *            eCall     - API call being made, recorded if the handle has a trace attached
+ * Return:    response from Clickatell, or NULL if the request could not be made
+ */
+static ClickSmsString *local_sms_batch_execute(ClickSmsHandle *oClickSms, const char *chScript, const ClickSmsString *sBatchId,
+                                               const LocalSmsDests *oDests, const char *const *aFields, int iFields,
+                                               eClickTraceCall eCall)
+{
+    int i = 0;
+    char chKey[16];
     ClickSmsString *sResponse  = NULL;
-    ClickSmsString *sPath      = NULL; // api call path designator
+    ClickSmsString *sPath      = click_string_create(chScript);
+    ClickArrayKeyVal *oKeyVals = local_click_keyval_array_create(1 + iFields); // excluding "to" field
+
+    if (sPath == NULL || oKeyVals == NULL)
+        goto exit;
+
+    oKeyVals->aKeyValues[0]->sKey = click_string_create("batch_id");
+    oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(sBatchId);
+    click_string_url_encode(oKeyVals->aKeyValues[0]->sVal);
+    for (i = 0; i < iFields; i++) {
+        snprintf(chKey, sizeof(chKey), "field%d", i + 1);
+        oKeyVals->aKeyValues[1 + i]->sKey       = click_string_create(chKey);
+        oKeyVals->aKeyValues[1 + i]->chRawVal   = aFields[i];
+        oKeyVals->aKeyValues[1 + i]->iRawValLen = strlen(aFields[i]);
+    }
+
+    // performs formatting of API call and then executes the request
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, oDests, eCall, NULL, NULL, NULL);
+
+exit:
+    // free allocated memory
+    local_click_keyval_array_destroy(oKeyVals);
+    click_string_destroy(sPath);
+
+    return sResponse;
+}
+
+/*
+ * Function:  clickatell_sms_batch_start
+ * Info:      Starts an HTTP API batch (startbatch.php): the message template is sent once,
+ *            then each recipient is sent a much smaller request, either with its own
+ *            template field values (clickatell_sms_batch_item_send()) or with the template
+ *            as it is (clickatell_sms_batch_quicksend()). Template fields are written as
+ *            #field1# to #field10#.
+ *            The most parts an item may take once its fields are filled in is passed as
+ *            "concat": 'iMaxParts' if given, else the handle's CLICK_SMS_OPTION_MAX_PARTS
+ *            option if set, else CLICK_SEGMENT_MAX_PARTS. Only the caller knows how long the
+ *            field values may be; templates needing more parts than this are rejected.
+ *            A template which is not in the GSM 03.38
+ *            alphabet is sent as hex-encoded UCS-2 with "unicode" set to 1, in which case
+ *            field values must be hex-encoded UCS-2 too (see click_charset_ucs2_hex_encode()).
+ *            Batches are made on the HTTP API only, and are best combined with a session
+ *            (see CLICK_SMS_OPTION_HTTP_SESSION).
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms    - Handle returned from clickatell_sms_handle_init() function call
+ *            chTemplate   - message template (UTF-8, or Latin1 for GSM 03.38 text)
+ *            iTemplateLen - length of template in bytes
+ *            iMaxParts    - most parts (SMSes) an item may take with its field values, at most
+ *                           the handle's CLICK_SMS_OPTION_MAX_PARTS if set and at most
+ *                           CLICK_SEGMENT_MAX_PARTS, or 0 to use the handle's limit
+ * Return:    Batch ID (ie. "ID: 8c9d6e2a81b6b8f2c4ebd2c2f76d6b1b") or error code, or NULL if
+ *            invalid parameter or the template needs more than the maximum allowed parts
+ */
+ClickSmsString *clickatell_sms_batch_start(ClickSmsHandle *oClickSms, const char *chTemplate, long iTemplateLen, long iMaxParts)
+{
+    long iHandleMax = (oClickSms != NULL ? local_sms_option_get(oClickSms, CLICK_SMS_OPTION_MAX_PARTS) : 0);
+
+    if (iHandleMax <= 0 || iHandleMax > CLICK_SEGMENT_MAX_PARTS)
+        iHandleMax = CLICK_SEGMENT_MAX_PARTS;
+    if (oClickSms == NULL || chTemplate == NULL || iTemplateLen < 1 || oClickSms->eApiType != CLICK_API_HTTP ||
+        iMaxParts < 0 || iMaxParts > iHandleMax) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+    if (iMaxParts == 0)
+        iMaxParts = iHandleMax;
+
+    ClickSegmentInfo oSegment;
+    int iParts = local_sms_message_parts_get(chTemplate, iTemplateLen, &oSegment);
+    int bUnicode = (oSegment.eCharset == CLICK_CHARSET_UCS2);
+    char chParts[24];
+    ClickSmsString oTraceTemplate = { (char *)chTemplate }; // only read, by the trace
+    ClickSmsString *sResponse  = NULL;
+    ClickSmsString *sPath      = NULL; // API call script
     ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
 
-    local_sms_reset(oClickSms); // clear any old memory allocations
+    if (iParts > iMaxParts) {
+        click_debug_print("%s ERROR: template needs %d parts, at most %ld allowed!\n", __func__, iParts, iMaxParts);
+        return NULL;
+    }
+    snprintf(chParts, sizeof(chParts), "%ld", iMaxParts);
+
+    sPath = click_string_create("http/startbatch.php");
+
+    // set URL Key/Value pairs
+    if ((oKeyVals = local_click_keyval_array_create(2 + bUnicode)) == NULL)
+        goto exit;
+    oKeyVals->aKeyValues[0]->sKey       = click_string_create("template");
+    oKeyVals->aKeyValues[0]->chRawVal   = chTemplate;
+    oKeyVals->aKeyValues[0]->iRawValLen = iTemplateLen;
+    oKeyVals->aKeyValues[0]->bUcs2Hex   = bUnicode;
+    oKeyVals->aKeyValues[1]->sKey       = click_string_create("concat");
+    oKeyVals->aKeyValues[1]->sVal       = click_string_create(chParts);
+    if (bUnicode) {
+        oKeyVals->aKeyValues[2]->sKey = click_string_create("unicode");
+        oKeyVals->aKeyValues[2]->sVal = click_string_create("1");
+    }
+
+    // performs formatting of API call and then executes the request
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL,
+                                          CLICK_TRACE_BATCH_START, &oTraceTemplate, NULL, NULL);
+
+exit:
+    // free allocated memory
+    local_click_keyval_array_destroy(oKeyVals);
+    click_string_destroy(sPath);
+
+    return sResponse;
+}
+
+/*
+ * Function:  clickatell_sms_batch_item_send
+ * Info:      Sends a batch's template to one recipient (senditem.php), with the
+ *            recipient's template field values: aFields[0] replaces #field1#, and so on.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms - Handle returned from clickatell_sms_handle_init() function call
+ *            sBatchId  - batch ID returned by clickatell_sms_batch_start() (without "ID: ")
+ *            sTo       - destination mobile number
+ *            aFields   - template field values (UTF-8), or NULL if none
+ *            iFields   - number of field values, 0 to CLICK_SMS_BATCH_FIELDS_MAX
+ * Return:    API Message ID or error code, or NULL if invalid parameter
+ */
+ClickSmsString *clickatell_sms_batch_item_send(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId, const ClickSmsString *sTo,
+                                               const char *const *aFields, int iFields)
+{
+    ClickSmsString *aTo[1] = { (ClickSmsString *)sTo };
+    ClickMsisdn oMsisdns = { 1, aTo };
+    LocalSmsDests oDests = { &oMsisdns, NULL };
+    int i = 0;
+
+    if (oClickSms == NULL || oClickSms->eApiType != CLICK_API_HTTP || CLICK_STR_INVALID(sBatchId) || CLICK_STR_INVALID(sTo) ||
+        iFields < 0 || iFields > CLICK_SMS_BATCH_FIELDS_MAX || (iFields > 0 && aFields == NULL))
+    {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+    for (i = 0; i < iFields; i++) {
+        if (aFields[i] == NULL) {
+            click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+            return NULL;
+        }
+    }
+
+    return local_sms_batch_execute(oClickSms, "http/senditem.php", sBatchId, &oDests, aFields, iFields, CLICK_TRACE_BATCH_ITEM);
+}
+
+/*
+ * Function:  clickatell_sms_batch_quicksend
+ * Info:      Sends a batch's template as it is to many recipients in one request
+ *            (quicksend.php).
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms - Handle returned from clickatell_sms_handle_init() function call
+ *            sBatchId  - batch ID returned by clickatell_sms_batch_start() (without "ID: ")
+ *            aMsisdns  - Array of destination mobile numbers
+ * Return:    API Message IDs (one line per recipient) or error code, or NULL if invalid parameter
+ */
+ClickSmsString *clickatell_sms_batch_quicksend(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId, ClickMsisdn *aMsisdns)
+{
+    LocalSmsDests oDests = { aMsisdns, NULL };
+
+    if (oClickSms == NULL || oClickSms->eApiType != CLICK_API_HTTP || CLICK_STR_INVALID(sBatchId) || CLICK_MSISDN_INVALID(aMsisdns)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_batch_execute(oClickSms, "http/quicksend.php", sBatchId, &oDests, NULL, 0, CLICK_TRACE_BATCH_QUICKSEND);
+}
+
+/*
+ * Function:  clickatell_sms_batch_quicksend_recipients
+ * Info:      Same as clickatell_sms_batch_quicksend(), for a compact recipient list (see
+ *            clickatell_recipients.h), whose numbers are appended with a single copy.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_handle_init() function call
+ *            sBatchId    - batch ID returned by clickatell_sms_batch_start() (without "ID: ")
+ *            oRecipients - destination mobile numbers
+ * Return:    API Message IDs (one line per recipient) or error code, or NULL if invalid parameter
+ */
+ClickSmsString *clickatell_sms_batch_quicksend_recipients(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId,
+                                                          const ClickRecipients *oRecipients)
+{
+    LocalSmsDests oDests = { NULL, oRecipients };
+
+    if (oClickSms == NULL || oClickSms->eApiType != CLICK_API_HTTP || CLICK_STR_INVALID(sBatchId) ||
+        CLICK_RECIPIENTS_INVALID(oRecipients))
+    {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_batch_execute(oClickSms, "http/quicksend.php", sBatchId, &oDests, NULL, 0, CLICK_TRACE_BATCH_QUICKSEND);
+}
+
+/*
+ * Function:  clickatell_sms_batch_end
+ * Info:      Ends a batch (endbatch.php): no more items can be sent with it.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms - Handle returned from clickatell_sms_handle_init() function call
+ *            sBatchId  - batch ID returned by clickatell_sms_batch_start() (without "ID: ")
+ * Return:    "OK" or error code, or NULL if invalid parameter
+ */
+ClickSmsString *clickatell_sms_batch_end(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId)
+{
+    if (oClickSms == NULL || oClickSms->eApiType != CLICK_API_HTTP || CLICK_STR_INVALID(sBatchId)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    return local_sms_batch_execute(oClickSms, "http/endbatch.php", sBatchId, NULL, NULL, 0, CLICK_TRACE_BATCH_END);
+}
+
+/*
+ * Function:  clickatell_sms_status_get
+ * Info:      Obtain current status of an SMS message.
+ *            Authentication: This function uses Username+Password to authenticate for the
+ *                            HTTP API, or a session ID if the handle's CLICK_SMS_OPTION_HTTP_SESSION
+ *                            option is set (see local_api_command_execute()).
+ *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
+ *                          this function.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms      - Handle returned from clickatell_sms_init() function call
+ *            API Message ID - SMS ID assigned by Clickatell
+ * Return:    Status of API message
+ */
+ClickSmsString *clickatell_sms_status_get(ClickSmsHandle *oClickSms, const ClickSmsString *sMsgId)
+{
+    if (oClickSms == NULL || CLICK_STR_INVALID(sMsgId)) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    int i = 0;
+    ClickSmsString *sResponse  = NULL;
+    ClickSmsString *sPath      = NULL; // api call path designator
+    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
 
     if (oClickSms->eApiType == CLICK_API_HTTP) {
-        sPath = click_string_create("http/getbalance.php");
+        sPath = click_string_create("http/querymsg.php");
 
         // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(3)) == NULL)
+        if ((oKeyVals = local_click_keyval_array_create(1)) == NULL) {
+            click_string_destroy(sPath);
             return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
+        }
+        oKeyVals->aKeyValues[0]->sKey = click_string_create("apimsgid");
+        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(sMsgId);
 
         // URL-encode URL values
         for (i = 0; i < oKeyVals->iNum; i++)
             click_string_url_encode(oKeyVals->aKeyValues[i]->sVal);
     }
+    else { // REST
+        // example URL:  http://api.clickatell.com/rest/message/47584bae0165fbec57b18bf47895fece
+        sPath = click_string_create("rest/message/");
+        click_string_append(sPath, sMsgId, NULL);
+    }
+
+    // performs formatting of API call and then executes the request
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL,
+                                          CLICK_TRACE_STATUS_GET, sMsgId, NULL, NULL);
+
+    // free allocated memory
+    local_click_keyval_array_destroy(oKeyVals);
+    click_string_destroy(sPath);
+
+    return sResponse;
+}
+
+/*
+ * Function:  clickatell_sms_balance_get
+ * Info:      Obtain user's credit balance.
+ *            Authentication: This function uses Username+Password to authenticate for the
+ *                            HTTP API, or a session ID if the handle's CLICK_SMS_OPTION_HTTP_SESSION
+ *                            option is set (see local_api_command_execute()).
+ *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
+ *                          this function.
+ *            The calling function must free memory allocated to the returned string.
+ * Inputs:    oClickSms      - Handle returned from clickatell_sms_init() function call
+ * Return:    User's current balance.
+ */
+ClickSmsString *clickatell_sms_balance_get(ClickSmsHandle *oClickSms)
+{
+    if (oClickSms == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    ClickSmsString *sResponse  = NULL;
+    ClickSmsString *sPath      = NULL; // api call path designator
+    ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
+
+    if (oClickSms->eApiType == CLICK_API_HTTP) {
+        // no parameters besides authentication
+        sPath = click_string_create("http/getbalance.php");
+    }
     else { // REST
         // example URL:  https://api.clickatell.com/rest/account/balance
         sPath = click_string_create("rest/account/balance");
     }
 
     // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL);
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL,
+                                          CLICK_TRACE_BALANCE_GET, NULL, NULL, NULL);
 
     // free allocated memory
     local_click_keyval_array_destroy(oKeyVals);
@@ -775,9 +2821,8 @@ ClickSmsString *clickatell_sms_balance_get(ClickSmsHandle *oClickSms)
  * Function:  clickatell_sms_charge_get
  * Info:      Obtain charge of an SMS message.
  *            Authentication: This function uses Username+Password to authenticate for the
- *                            HTTP API, however it is also possible in a session to use a session ID to
- *                            authenticate with the HTTP API. See the Clickatell API docs at
- *                            www.clickatell.com for more details.
+ *                            HTTP API, or a session ID if the handle's CLICK_SMS_OPTION_HTTP_SESSION
+ *                            option is set (see local_api_command_execute()).
  *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
  *                          this function.
  *            The calling function must free memory allocated to the returned string.
@@ -797,22 +2842,16 @@ ClickSmsString *clickatell_sms_charge_get(ClickSmsHandle *oClickSms, const Click
     ClickSmsString *sPath      = NULL; // api call path designator
     ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
 
-    local_sms_reset(oClickSms); // clear any old memory allocations
-
     if (oClickSms->eApiType == CLICK_API_HTTP) {
         sPath = click_string_create("http/getmsgcharge.php");
 
         // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(4)) == NULL)
+        if ((oKeyVals = local_click_keyval_array_create(1)) == NULL) {
+            click_string_destroy(sPath);
             return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
-        oKeyVals->aKeyValues[3]->sKey = click_string_create("apimsgid");
-        oKeyVals->aKeyValues[3]->sVal = click_string_duplicate(sMsgId);
+        }
+        oKeyVals->aKeyValues[0]->sKey = click_string_create("apimsgid");
+        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(sMsgId);
 
         // URL-encode URL values
         for (i = 0; i < oKeyVals->iNum; i++)
@@ -825,7 +2864,8 @@ ClickSmsString *clickatell_sms_charge_get(ClickSmsHandle *oClickSms, const Click
     }
 
     // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL);
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL,
+                                          CLICK_TRACE_CHARGE_GET, sMsgId, NULL, NULL);
 
     // free allocated memory
     local_click_keyval_array_destroy(oKeyVals);
@@ -839,9 +2879,8 @@ ClickSmsString *clickatell_sms_charge_get(ClickSmsHandle *oClickSms, const Click
  * Info:      Enables users to check Clickatell coverage of a network/number, without sending
  *            a message to that number
  *            Authentication: This function uses Username+Password to authenticate for the
- *                            HTTP API, however it is also possible in a session to use a session ID to
- *                            authenticate with the HTTP API. See the Clickatell API docs at
- *                            www.clickatell.com for more details.
+ *                            HTTP API, or a session ID if the handle's CLICK_SMS_OPTION_HTTP_SESSION
+ *                            option is set (see local_api_command_execute()).
  *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
  *                          this function.
  *            The calling function must free memory allocated to the returned string.
@@ -861,22 +2900,16 @@ ClickSmsString *clickatell_sms_coverage_get(ClickSmsHandle *oClickSms, const Cli
     ClickSmsString *sPath      = NULL; // api call path designator
     ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
 
-    local_sms_reset(oClickSms); // clear any old memory allocations
-
     if (oClickSms->eApiType == CLICK_API_HTTP) {
         sPath = click_string_create("utils/routecoverage.php");
 
         // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(4)) == NULL)
+        if ((oKeyVals = local_click_keyval_array_create(1)) == NULL) {
+            click_string_destroy(sPath);
             return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
-        oKeyVals->aKeyValues[3]->sKey = click_string_create("msisdn");
-        oKeyVals->aKeyValues[3]->sVal = click_string_duplicate(msisdn);
+        }
+        oKeyVals->aKeyValues[0]->sKey = click_string_create("msisdn");
+        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(msisdn);
 
         // URL-encode URL values
         for (i = 0; i < oKeyVals->iNum; i++)
@@ -889,7 +2922,8 @@ ClickSmsString *clickatell_sms_coverage_get(ClickSmsHandle *oClickSms, const Cli
     }
 
     // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL);
+    sResponse = local_api_command_execute(oClickSms, sPath, CLICK_CURL_GET, oKeyVals, NULL,
+                                          CLICK_TRACE_COVERAGE_GET, msisdn, NULL, NULL);
 
     // free allocated memory
     local_click_keyval_array_destroy(oKeyVals);
@@ -904,9 +2938,8 @@ ClickSmsString *clickatell_sms_coverage_get(ClickSmsHandle *oClickSms, const Cli
  *            which may be queued within the Clickatell system and not messages which have already
  *            been delivered to an SMSC.
  *            Authentication: This function uses Username+Password to authenticate for the
- *                            HTTP API, however it is also possible in a session to use a session ID to
- *                            authenticate with the HTTP API. See the Clickatell API docs at
- *                            www.clickatell.com for more details.
+ *                            HTTP API, or a session ID if the handle's CLICK_SMS_OPTION_HTTP_SESSION
+ *                            option is set (see local_api_command_execute()).
  *            URL Encoding: For the HTTP API, The URL parameter values are URL-encoded in
  *                          this function.
  *            The calling function must free memory allocated to the returned string.
@@ -927,22 +2960,16 @@ ClickSmsString *clickatell_sms_message_stop(ClickSmsHandle *oClickSms, const Cli
     ClickArrayKeyVal *oKeyVals = NULL; // array of Key/Value structures
     eClickCurlRequestType eReqType  = (oClickSms->eApiType == CLICK_API_HTTP ? CLICK_CURL_GET : CLICK_CURL_DELETE);
 
-    local_sms_reset(oClickSms); // clear any old memory allocations
-
     if (oClickSms->eApiType == CLICK_API_HTTP) {
         sPath = click_string_create("http/delmsg.php");
 
         // set URL Key/Value pairs
-        if ((oKeyVals = local_click_keyval_array_create(4)) == NULL)
+        if ((oKeyVals = local_click_keyval_array_create(1)) == NULL) {
+            click_string_destroy(sPath);
             return NULL;
-        oKeyVals->aKeyValues[0]->sKey = click_string_create("user");
-        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sUsername);
-        oKeyVals->aKeyValues[1]->sKey = click_string_create("password");
-        oKeyVals->aKeyValues[1]->sVal = click_string_duplicate(oClickSms->uLoginDetails.userpass.sPassword);
-        oKeyVals->aKeyValues[2]->sKey = click_string_create("api_id");
-        oKeyVals->aKeyValues[2]->sVal = click_string_duplicate(oClickSms->sApiId);
-        oKeyVals->aKeyValues[3]->sKey = click_string_create("apimsgid");
-        oKeyVals->aKeyValues[3]->sVal = click_string_duplicate(sMsgId);
+        }
+        oKeyVals->aKeyValues[0]->sKey = click_string_create("apimsgid");
+        oKeyVals->aKeyValues[0]->sVal = click_string_duplicate(sMsgId);
 
         // URL-encode URL values
         for (i = 0; i < oKeyVals->iNum; i++)
@@ -955,7 +2982,8 @@ ClickSmsString *clickatell_sms_message_stop(ClickSmsHandle *oClickSms, const Cli
     }
 
     // performs formatting of API call and then executes the request
-    sResponse = local_api_command_execute(oClickSms, sPath, eReqType, oKeyVals, NULL);
+    sResponse = local_api_command_execute(oClickSms, sPath, eReqType, oKeyVals, NULL,
+                                          CLICK_TRACE_MESSAGE_STOP, sMsgId, NULL, NULL);
 
     // free allocated memory
     local_click_keyval_array_destroy(oKeyVals);
@@ -964,9 +2992,86 @@ ClickSmsString *clickatell_sms_message_stop(ClickSmsHandle *oClickSms, const Cli
     return sResponse;
 }
 
+/*
+ * Function:  clickatell_sms_handle_transport_set
+ * Info:      Replaces libcurl with a user-supplied transport for all subsequent API calls
+ *            made with this handle. Requests are still fully formatted by the library, but
+ *            are handed to 'fnTransport' instead of being sent to Clickatell. This allows
+ *            the library to be exercised against a loopback or local stand-in transport.
+ *            Set 'fnTransport' to NULL to revert to libcurl.
+ * Inputs:    oClickSms   - Handle returned from clickatell_sms_handle_init() function call
+ *            fnTransport - transport callback, or NULL to use libcurl
+ *            pContext    - opaque pointer passed back to 'fnTransport'
+ * Return:    0 if successful, else -1 if invalid parameter
+ */
+int clickatell_sms_handle_transport_set(ClickSmsHandle *oClickSms, ClickSmsTransport fnTransport, void *pContext)
+{
+    if (oClickSms == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&oClickSms->oLock);
+
+    oClickSms->fnTransport       = fnTransport;
+    oClickSms->pTransportContext = (fnTransport != NULL ? pContext : NULL);
+
+    pthread_mutex_unlock(&oClickSms->oLock);
+
+    return 0;
+}
+
+/*
+ * Function:  clickatell_sms_handle_option_set
+ * Info:      Sets a handle option (see eClickSmsOption). Options may be changed at any
+ *            time, including while other threads are making API calls on the handle; the
+ *            new value applies to API calls started after this function returns.
+ * Inputs:    oClickSms - Handle returned from clickatell_sms_handle_init() function call
+ *            eOption   - option to set
+ *            iValue    - option value
+ * Return:    0 if successful, else -1 if invalid parameter
+ */
+int clickatell_sms_handle_option_set(ClickSmsHandle *oClickSms, eClickSmsOption eOption, long iValue)
+{
+    if (oClickSms == NULL || eOption < 0 || eOption >= CLICK_SMS_OPTION_COUNT || iValue < 0) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    __atomic_store_n(&oClickSms->aOptions[eOption], iValue, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/*
+ * Function:  clickatell_sms_handle_trace_set
+ * Info:      Attaches a trace (see clickatell_trace.h) to the handle, so that the shape and
+ *            timing of every subsequent API call made on the handle is recorded. Message
+ *            text, numbers, message IDs and credentials are never recorded. The same trace
+ *            may be attached to several handles. Set 'oTrace' to NULL to stop recording;
+ *            the trace must be detached from all handles before it is closed.
+ * Inputs:    oClickSms - Handle returned from clickatell_sms_handle_init() function call
+ *            oTrace    - trace returned from click_trace_open(), or NULL
+ * Return:    0 if successful, else -1 if invalid parameter
+ */
+int clickatell_sms_handle_trace_set(ClickSmsHandle *oClickSms, struct ClickTrace *oTrace)
+{
+    if (oClickSms == NULL) {
+        click_debug_print("%s ERROR: invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&oClickSms->oLock);
+    oClickSms->oTrace = oTrace;
+    pthread_mutex_unlock(&oClickSms->oLock);
+
+    return 0;
+}
+
 /*
  * Function:  clickatell_sms_handle_shutdown
  * Info:      Shutdown library descriptor handle, freeing up any memory used by the descriptor.
+ *            No other thread may be using the handle when it is shut down.
  * Inputs:    oClickSms - Handle returned from clickatell_sms_init() function call
  * Return:    void
  */
@@ -977,9 +3082,19 @@ void clickatell_sms_handle_shutdown(ClickSmsHandle *oClickSms)
         return;
     }
 
+    // stop the session keepalive thread
+    pthread_mutex_lock(&oClickSms->oPingLock);
+    oClickSms->bPingStop = 1;
+    pthread_cond_signal(&oClickSms->oPingWake);
+    pthread_mutex_unlock(&oClickSms->oPingLock);
+    if (oClickSms->bPingThread)
+        pthread_join(oClickSms->oPingThread, NULL);
+
     local_sms_reset(oClickSms);
 
     click_string_destroy(oClickSms->sApiId);
+    click_string_destroy(oClickSms->sHttpAuth);
+    click_string_destroy(oClickSms->sSessionAuth);
 
     if (oClickSms->eApiType == CLICK_API_REST)
         click_string_destroy(oClickSms->uLoginDetails.apikey.sKey);
@@ -991,8 +3106,17 @@ void clickatell_sms_handle_shutdown(ClickSmsHandle *oClickSms)
     if (oClickSms->curlHeaders != NULL)
         curl_slist_free_all(oClickSms->curlHeaders);
 
+    if (oClickSms->curlFormHeaders != NULL)
+        curl_slist_free_all(oClickSms->curlFormHeaders);
+
+    click_buffer_free(&oClickSms->oResponseData);
+
     if (oClickSms->curlHandle != NULL)
         curl_easy_cleanup(oClickSms->curlHandle);
 
+    pthread_cond_destroy(&oClickSms->oPingWake);
+    pthread_mutex_destroy(&oClickSms->oPingLock);
+    pthread_mutex_destroy(&oClickSms->oLock);
+
     free(oClickSms);
 }
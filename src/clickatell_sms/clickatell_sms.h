@@ -19,6 +19,11 @@
  *  Martin Beyers <martin.beyers@clickatell.com>
  */
 
+#include <stddef.h>
+
+struct curl_slist; // libcurl header list (see curl/curl.h)
+struct ClickTrace; // traffic capture trace (see clickatell_trace.h)
+
 /*
  * Structure that acts as a handle when calling API functions.
  * It is returned during a successful initialization call.
@@ -32,23 +37,129 @@ typedef enum eClickApi {
     CLICK_API_COUNT // count of supported APIs
 } eClickApi;
 
+// Enumeration of handle options (see clickatell_sms_handle_option_set())
+typedef enum eClickSmsOption {
+    CLICK_SMS_OPTION_MAX_PARTS,     // most parts (SMSes) a sent message may take, 0 for no limit (default)
+    CLICK_SMS_OPTION_TRANSLITERATE, // 1 to send text which needs UCS-2 as GSM 7-bit if it can be transliterated
+                                    // and takes no more parts, 0 to send text as it is (default)
+    CLICK_SMS_OPTION_HTTP_SESSION,  // HTTP API only: seconds of idleness after which the handle's session is pinged,
+                                    // to authenticate once (auth.php) and send a session ID instead of the
+                                    // credentials; Clickatell expires sessions idle for 15 minutes, so use at
+                                    // most 300. 0 to send the credentials with every request (default)
+    CLICK_SMS_OPTION_HTTP_POST,     // HTTP API only: 1 to send the parameters of each request as a form-urlencoded
+                                    // POST body, so that a send may have up to CLICK_SMS_HTTP_POST_TO_MAX
+                                    // recipients; 0 to send them in the URL of a GET request (default)
+    CLICK_SMS_OPTION_STREAM_BODY,   // least recipients of a send whose request body (REST, or HTTP with
+                                    // CLICK_SMS_OPTION_HTTP_POST) is generated from the text and recipient list
+                                    // while it is sent, rather than formatted in memory first; 0 to never
+                                    // stream (default)
+    CLICK_SMS_OPTION_COUNT          // count of options
+} eClickSmsOption;
+
+// most recipients per HTTP API send request: in the URL of a GET request, or in a form POST body
+// (see CLICK_SMS_OPTION_HTTP_POST). Longer recipient lists must be split across requests.
+#define CLICK_SMS_HTTP_GET_TO_MAX   100
+#define CLICK_SMS_HTTP_POST_TO_MAX  300
+
+// Result of a submitted message (see clickatell_sms_message_submit())
+typedef enum eClickSmsSubmit {
+    CLICK_SMS_SUBMIT_FAILED = -1,   // invalid parameter, or the request failed or had no response
+    CLICK_SMS_SUBMIT_ACCEPTED,      // the API accepted the message (to the first recipient)
+    CLICK_SMS_SUBMIT_REJECTED       // the API returned an error
+} eClickSmsSubmit;
+
+// most template fields (#field1# to #field10#) a batch item may fill (see clickatell_sms_batch_item_send())
+#define CLICK_SMS_BATCH_FIELDS_MAX  10
+
 // destination address container (used for send message API call only)
 typedef struct ClickMsisdn {
     int iNum;                 // number of destination ("to") addresses
     ClickSmsString **aDests;   // array of pointers to destination addresses
 } ClickMsisdn;
 
+struct ClickRecipients; // compact destination address list (see clickatell_recipients.h)
+struct ClickAudience;   // prepared destination addresses (see clickatell_audience.h)
+
+// binary message (used for binary send message API calls only, see clickatell_sms_message_send_binary())
+typedef struct ClickSmsBinary {
+    const unsigned char *aUdh;  // user data header, starting with its length octet (ie. 06 05 04 0B 84 23 F0
+                                // for WAP push), or NULL
+    long iUdhLen;               // length of UDH in octets, 0 if none
+    const unsigned char *aData; // user data which follows the UDH
+    long iDataLen;              // length of user data in octets
+    int  iDataCoding;           // data coding scheme (DCS) octet, or -1 for the API default
+} ClickSmsBinary;
+
+/*
+ * Request handed to a user-supplied transport (see clickatell_sms_handle_transport_set()).
+ * The transport must pass any response data to 'fnWrite', exactly as libcurl would
+ * pass it to a CURLOPT_WRITEFUNCTION callback. A streamed body (see
+ * CLICK_SMS_OPTION_STREAM_BODY) has no 'chBody': its 'iBodyLen' bytes must be read from
+ * 'fnRead', exactly as libcurl would read them from a CURLOPT_READFUNCTION callback.
+ */
+typedef struct ClickSmsTransportRequest {
+    const char *chMethod;   // "GET", "POST" or "DELETE"
+    const char *chUrl;      // full request URL, including any query string
+    const char *chBody;     // request body (JSON for the REST API, form-urlencoded for the HTTP API), or NULL
+    size_t      iBodyLen;   // length of request body
+    const struct curl_slist *oHeaders; // request headers set by the library, or NULL
+    size_t    (*fnWrite)(void *pData, size_t iSize, size_t iMemLen, void *pWriteData); // response data sink
+    void       *pWriteData; // opaque argument which must be passed to 'fnWrite'
+    size_t    (*fnRead)(char *pBuffer, size_t iSize, size_t iNum, void *pReadData); // streamed body source, or NULL
+    void       *pReadData;  // opaque argument which must be passed to 'fnRead'
+} ClickSmsTransportRequest;
+
+/*
+ * Prepared send request (see clickatell_sms_request_prepare()): formatted once, then executed
+ * any number of times on any handle of the same API. Read only once prepared; reference counted.
+ */
+typedef struct ClickSmsRequest ClickSmsRequest;
+
+// Transport callback which replaces libcurl. Returns the HTTP status code, or -1 if the request failed.
+typedef long (*ClickSmsTransport)(void *pContext, const ClickSmsTransportRequest *oRequest);
+
 // Public function declarations
 void clickatell_sms_init(void);
 void clickatell_sms_shutdown(void);
 ClickSmsHandle *clickatell_sms_handle_init(eClickApi eApiType, const ClickSmsString *sUsername, const ClickSmsString *sPassword,
                                            const ClickSmsString *sApiKey, const ClickSmsString *sApiId, long iTimeout, long iConnectTimeout);
 void clickatell_sms_handle_shutdown(ClickSmsHandle *oClickSms);
+int clickatell_sms_handle_transport_set(ClickSmsHandle *oClickSms, ClickSmsTransport fnTransport, void *pContext);
+int clickatell_sms_handle_option_set(ClickSmsHandle *oClickSms, eClickSmsOption eOption, long iValue);
+int clickatell_sms_handle_trace_set(ClickSmsHandle *oClickSms, struct ClickTrace *oTrace);
 ClickSmsString *clickatell_sms_message_send(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns);
+ClickSmsString *clickatell_sms_message_send_buffer(ClickSmsHandle *oClickSms, const ClickSmsBuffer *oText, ClickMsisdn *aMsisdns);
+ClickSmsString *clickatell_sms_message_send_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                       const struct ClickRecipients *oRecipients);
+eClickSmsSubmit clickatell_sms_message_submit(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns);
+eClickSmsSubmit clickatell_sms_message_submit_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                         const struct ClickRecipients *oRecipients);
+ClickSmsString *clickatell_sms_message_send_audience(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                     const struct ClickAudience *oAudience, long iChunk);
+eClickSmsSubmit clickatell_sms_message_submit_audience(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                       const struct ClickAudience *oAudience, long iChunk);
+ClickSmsRequest *clickatell_sms_request_prepare(ClickSmsHandle *oClickSms, const ClickSmsString *sText, ClickMsisdn *aMsisdns);
+ClickSmsRequest *clickatell_sms_request_prepare_recipients(ClickSmsHandle *oClickSms, const char *chText, long iTextLen,
+                                                           const struct ClickRecipients *oRecipients);
+ClickSmsRequest *clickatell_sms_request_ref(ClickSmsRequest *oRequest);
+void clickatell_sms_request_release(ClickSmsRequest *oRequest);
+ClickSmsString *clickatell_sms_request_execute(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest);
+eClickSmsSubmit clickatell_sms_request_submit(ClickSmsHandle *oClickSms, const ClickSmsRequest *oRequest);
+ClickSmsString *clickatell_sms_message_send_binary(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary, ClickMsisdn *aMsisdns);
+ClickSmsString *clickatell_sms_message_send_binary_recipients(ClickSmsHandle *oClickSms, const ClickSmsBinary *oBinary,
+                                                              const struct ClickRecipients *oRecipients);
 ClickSmsString *clickatell_sms_status_get(ClickSmsHandle *oClickSms, const ClickSmsString *sMsgId);
 ClickSmsString *clickatell_sms_balance_get(ClickSmsHandle *oClickSms);
 ClickSmsString *clickatell_sms_charge_get(ClickSmsHandle *oClickSms, const ClickSmsString *sMsgId);
 ClickSmsString *clickatell_sms_coverage_get(ClickSmsHandle *oClickSms, const ClickSmsString *msisdn);
 ClickSmsString *clickatell_sms_message_stop(ClickSmsHandle *oClickSms, const ClickSmsString *sMsgId);
+ClickSmsString *clickatell_sms_batch_start(ClickSmsHandle *oClickSms, const char *chTemplate, long iTemplateLen,
+                                           long iMaxParts);
+ClickSmsString *clickatell_sms_batch_item_send(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId, const ClickSmsString *sTo,
+                                               const char *const *aFields, int iFields);
+ClickSmsString *clickatell_sms_batch_quicksend(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId, ClickMsisdn *aMsisdns);
+ClickSmsString *clickatell_sms_batch_quicksend_recipients(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId,
+                                                          const struct ClickRecipients *oRecipients);
+ClickSmsString *clickatell_sms_batch_end(ClickSmsHandle *oClickSms, const ClickSmsString *sBatchId);
 
 #endif // CLICKATELL_SMS_H
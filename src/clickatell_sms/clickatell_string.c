@@ -24,6 +24,9 @@
                                     ((c) >= 'a' && (c) <= 'z') || \
                                     (c) == '-' || (c) == '_' || (c) == '.' || (c) == '~')
 
+// smallest allocation made for a ClickSmsBuffer
+#define CLICK_BUFFER_MIN_SIZE   64
+
 /* ----------------------------------------------------------------------------- *
  * Forward declarations                                                          *
  * ----------------------------------------------------------------------------- */
@@ -48,12 +51,15 @@ static ClickSmsString *local_string_create(const char *chStr, int iLenBuffer)
     if (sOutput != NULL) {
         sOutput->data = malloc(iLenBuffer + 1);
 
-        if (sOutput != NULL) {
-            strncpy(sOutput->data, chStr, iLenBuffer); // copy sSource buffer (including '\0') to destination string
+        if (sOutput->data != NULL) {
+            memcpy(sOutput->data, chStr, iLenBuffer); // copy sSource buffer to destination string
             sOutput->data[iLenBuffer] = '\0';         // ensure string terminator exists if it did not in the 'chStr' parameter
         }
-        else
+        else {
             click_debug_print("%s ERROR: Failed to allocate memory for ClickSmsString data!\n", __func__);
+            free(sOutput);
+            sOutput = NULL;
+        }
     }
     else
         click_debug_print("%s ERROR: Failed to allocate memory for ClickSmsString!\n", __func__);
@@ -135,12 +141,19 @@ void click_string_append_formatted_cstr(ClickSmsString *sDest, const char *chFor
                         0,
                         chFormat,
                         argList);
+    va_end(argList);
+
     // now we know how large the appended string will be, allocate memory for it
-    tmp_cstr = malloc(iNewLen + 1);
+    if ((tmp_cstr = malloc(iNewLen + 1)) == NULL) {
+        va_end(arg_list_copy);
+        click_debug_print("%s ERROR: Failed to allocate memory for formatted string!\n", __func__);
+        return;
+    }
+
     // chFormat the string
     vsnprintf(tmp_cstr, iNewLen + 1, chFormat, arg_list_copy);
 
-    va_end(argList);
+    va_end(arg_list_copy);
 
     // reallocate destination data memory buffer and then concatenate strings
     chReallocatedStr = realloc((void *)(sDest->data), (size_t)(iOldLen + iNewLen + 1));
@@ -158,8 +171,9 @@ void click_string_append_formatted_cstr(ClickSmsString *sDest, const char *chFor
  * Function:  click_string_trim_prefix
  * Info:      Remove prefix string from a ClickSmsString.
  *            If prefix string length is the same or longer than the ClickSmsString
- *            length, then the ClickSmsString's data field will be freed and said
- *            ClickSmsString will be destroyed.
+ *            length, then the ClickSmsString's data field is truncated to an empty
+ *            string. The ClickSmsString itself is never destroyed here, it remains
+ *            owned by the calling function.
  * Inputs:    sBuf   - ClickSmsString containing prefix to remove
  *            iLen   - length of prefix data to remove
  * Return:    void
@@ -176,7 +190,7 @@ void click_string_trim_prefix(ClickSmsString *sBuf, unsigned int iLen)
     char *chCopiedStr      = NULL;
 
     if (iNewLen < 1)
-        click_string_destroy(sBuf);
+        sBuf->data[0] = '\0'; // everything trimmed - keep the (now empty) buffer for the caller to destroy
     else {
         if ((chReallocatedStr = malloc(iNewLen + 1)) != NULL) {
             if ((chCopiedStr = strncpy(chReallocatedStr, sBuf->data + iLen, iNewLen)) != NULL) {
@@ -206,10 +220,15 @@ void click_string_trim_prefix(ClickSmsString *sBuf, unsigned int iLen)
  */
 int click_string_find_cstr(const ClickSmsString *sHaystack, char *chNeedle, unsigned int iStartPos)
 {
+    if (CLICK_STR_INVALID(sHaystack) || chNeedle == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
     int iNeedleLen   = strlen(chNeedle);
     int iHaystackLen = strlen(sHaystack->data);
 
-    if (CLICK_STR_INVALID(sHaystack) || chNeedle == NULL || iHaystackLen < iNeedleLen || (int)iStartPos > iHaystackLen) {
+    if (iHaystackLen < iNeedleLen || (int)iStartPos > iHaystackLen) {
         click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
         return -1;
     }
@@ -247,6 +266,35 @@ ClickSmsString *click_string_create(const char *chStr)
     return local_string_create(chStr, iLenBuffer);
 }
 
+/*
+ * Function:  click_string_create_empty
+ * Info:      Creates a new empty ClickSmsString with room for a string of 'iLen'
+ *            characters, for callers which write the string data directly.
+ * Inputs:    iLen - length of the string which will be written (excluding the NUL)
+ * Return:    new ClickSmsString if successful, else NULL if failed to allocate memory for
+ *            new ClickSmsString or if 'iLen' parameter is invalid.
+ */
+ClickSmsString *click_string_create_empty(int iLen)
+{
+    if (iLen < 0)
+        return NULL;
+
+    ClickSmsString *sOutput = (ClickSmsString *)malloc(sizeof(ClickSmsString));
+    if (sOutput != NULL) {
+        if ((sOutput->data = malloc(iLen + 1)) != NULL)
+            sOutput->data[0] = '\0';
+        else {
+            click_debug_print("%s ERROR: Failed to allocate memory for ClickSmsString data!\n", __func__);
+            free(sOutput);
+            sOutput = NULL;
+        }
+    }
+    else
+        click_debug_print("%s ERROR: Failed to allocate memory for ClickSmsString!\n", __func__);
+
+    return sOutput;
+}
+
 /*
  * Function:  click_string_duplicate
  * Info:      Allocates memory for a new duplicated ClickSmsString.
@@ -383,3 +431,209 @@ void click_string_url_encode(ClickSmsString *sBuf)
         sBuf->data = sReturn;
     }
 }
+
+/*
+ * Function:  click_buffer_reserve
+ * Info:      Ensures a ClickSmsBuffer has room to append 'iLen' more characters (and the
+ *            NUL terminator) without reallocating. The buffer at least doubles in size
+ *            when it grows, so a sequence of appends costs amortized linear time.
+ * Inputs:    oBuf - buffer
+ *            iLen - number of characters which will be appended
+ * Return:    0 if successful, else -1 if invalid parameter or failed to allocate memory
+ */
+int click_buffer_reserve(ClickSmsBuffer *oBuf, long iLen)
+{
+    if (oBuf == NULL || iLen < 0) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    char *chReallocatedStr = NULL;
+    long iNewSize = (oBuf->iSize > 0 ? oBuf->iSize : CLICK_BUFFER_MIN_SIZE);
+
+    if (oBuf->iLen + iLen + 1 <= oBuf->iSize)
+        return 0;
+
+    while (iNewSize < oBuf->iLen + iLen + 1)
+        iNewSize *= 2;
+
+    if ((chReallocatedStr = realloc(oBuf->data, (size_t)iNewSize)) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for buffer!\n", __func__);
+        return -1;
+    }
+
+    if (oBuf->data == NULL)
+        chReallocatedStr[0] = '\0';
+    oBuf->data  = chReallocatedStr;
+    oBuf->iSize = iNewSize;
+
+    return 0;
+}
+
+/*
+ * Function:  click_buffer_append
+ * Info:      Appends data to a ClickSmsBuffer. If memory cannot be allocated the buffer
+ *            remains unchanged.
+ * Inputs:    oBuf   - buffer to append to
+ *            chData - data to append (need not be NUL terminated)
+ *            iLen   - length of data
+ * Return:    0 if successful, else -1
+ */
+int click_buffer_append(ClickSmsBuffer *oBuf, const char *chData, long iLen)
+{
+    if ((chData == NULL && iLen > 0) || click_buffer_reserve(oBuf, iLen) != 0)
+        return -1;
+
+    memcpy(oBuf->data + oBuf->iLen, chData, iLen);
+    oBuf->iLen += iLen;
+    oBuf->data[oBuf->iLen] = '\0';
+
+    return 0;
+}
+
+/*
+ * Function:  click_buffer_encoded_len_max
+ * Info:      Calculates the most characters data can take once encoded.
+ * Inputs:    iLen      - length of data
+ *            eEncoding - encoding
+ * Return:    most characters of encoded data
+ */
+long click_buffer_encoded_len_max(long iLen, eClickEncoding eEncoding)
+{
+    switch (eEncoding) {
+        case CLICK_ENCODING_URL:  return iLen * 3; // %XX
+        case CLICK_ENCODING_JSON: return iLen * 6; // \u00XX
+        case CLICK_ENCODING_RAW:
+        default:                  return iLen;
+    }
+}
+
+/*
+ * Function:  click_buffer_append_encoded
+ * Info:      Appends data to a ClickSmsBuffer, encoded directly into the buffer (so no
+ *            intermediate string is needed). URL encoding matches click_string_url_encode():
+ *            unsafe characters become %xx and spaces become '+'. JSON encoding escapes
+ *            quotes, backslashes and control characters; other bytes (ie. UTF-8 text) are
+ *            copied as is. If memory cannot be allocated the buffer remains unchanged.
+ * Inputs:    oBuf      - buffer to append to
+ *            chData    - data to append (need not be NUL terminated)
+ *            iLen      - length of data
+ *            eEncoding - encoding to apply
+ * Return:    0 if successful, else -1
+ */
+int click_buffer_append_encoded(ClickSmsBuffer *oBuf, const char *chData, long iLen, eClickEncoding eEncoding)
+{
+    static const char chHexDigits[] = "0123456789abcdef";
+    const unsigned char *pData = (const unsigned char *)chData;
+    char *pOut = NULL;
+    long i = 0;
+
+    if (eEncoding == CLICK_ENCODING_RAW)
+        return click_buffer_append(oBuf, chData, iLen);
+
+    if ((chData == NULL && iLen > 0) || click_buffer_reserve(oBuf, click_buffer_encoded_len_max(iLen, eEncoding)) != 0)
+        return -1;
+
+    pOut = oBuf->data + oBuf->iLen;
+
+    for (i = 0; i < iLen; i++) {
+        if (eEncoding == CLICK_ENCODING_URL) {
+            if (URL_ENCODE_SAFE_CHAR(pData[i]))
+                *pOut++ = (char)pData[i];
+            else if (pData[i] == ' ')
+                *pOut++ = '+';
+            else {
+                *pOut++ = '%';
+                *pOut++ = chHexDigits[pData[i] >> 4];
+                *pOut++ = chHexDigits[pData[i] & 0xf];
+            }
+        }
+        else { // JSON
+            if (pData[i] >= 0x20 && pData[i] != '"' && pData[i] != '\\')
+                *pOut++ = (char)pData[i];
+            else {
+                *pOut++ = '\\';
+                switch (pData[i]) {
+                    case '"':  *pOut++ = '"';  break;
+                    case '\\': *pOut++ = '\\'; break;
+                    case '\n': *pOut++ = 'n';  break;
+                    case '\r': *pOut++ = 'r';  break;
+                    case '\t': *pOut++ = 't';  break;
+                    default:
+                        memcpy(pOut, "u00", 3);
+                        pOut[3] = chHexDigits[pData[i] >> 4];
+                        pOut[4] = chHexDigits[pData[i] & 0xf];
+                        pOut += 5;
+                        break;
+                }
+            }
+        }
+    }
+
+    oBuf->iLen = pOut - oBuf->data;
+    oBuf->data[oBuf->iLen] = '\0';
+
+    return 0;
+}
+
+/*
+ * Function:  click_buffer_reset
+ * Info:      Empties a ClickSmsBuffer, keeping its memory for reuse.
+ * Inputs:    oBuf - buffer
+ * Return:    void
+ */
+void click_buffer_reset(ClickSmsBuffer *oBuf)
+{
+    if (oBuf == NULL)
+        return;
+
+    oBuf->iLen = 0;
+    if (oBuf->data != NULL)
+        oBuf->data[0] = '\0';
+}
+
+/*
+ * Function:  click_buffer_free
+ * Info:      Frees the memory of a ClickSmsBuffer, leaving it empty. The ClickSmsBuffer
+ *            structure itself is owned by the calling function.
+ * Inputs:    oBuf - buffer
+ * Return:    void
+ */
+void click_buffer_free(ClickSmsBuffer *oBuf)
+{
+    if (oBuf == NULL)
+        return;
+
+    free(oBuf->data);
+    oBuf->data  = NULL;
+    oBuf->iLen  = 0;
+    oBuf->iSize = 0;
+}
+
+/*
+ * Function:  click_buffer_detach
+ * Info:      Moves the data of a ClickSmsBuffer into a new ClickSmsString without copying
+ *            it, leaving the buffer empty.
+ *            Note that the calling function must destroy the returned ClickSmsString.
+ * Inputs:    oBuf - buffer
+ * Return:    new ClickSmsString, or NULL if the buffer is empty or failed to allocate memory
+ */
+ClickSmsString *click_buffer_detach(ClickSmsBuffer *oBuf)
+{
+    ClickSmsString *sOutput = NULL;
+
+    if (oBuf == NULL || oBuf->data == NULL)
+        return NULL;
+
+    if ((sOutput = (ClickSmsString *)malloc(sizeof(ClickSmsString))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for ClickSmsString!\n", __func__);
+        return NULL;
+    }
+
+    sOutput->data = oBuf->data;
+    oBuf->data  = NULL;
+    oBuf->iLen  = 0;
+    oBuf->iSize = 0;
+
+    return sOutput;
+}
@@ -22,8 +22,29 @@ typedef struct ClickSmsString{
 // macro to validate a ClickSmsString
 #define CLICK_STR_INVALID(sBuf)  ((sBuf) == NULL || (sBuf)->data == NULL)
 
+/*
+ * Length-tracked buffer which grows as it is appended to. Used to serialize requests
+ * without reallocating and rescanning a ClickSmsString for every append, and reusable
+ * across calls (see click_buffer_reset()). A zeroed ClickSmsBuffer is empty and ready for
+ * use. Its data is always NUL terminated once anything has been appended.
+ */
+typedef struct ClickSmsBuffer {
+    char *data;     // buffer data, or NULL if nothing has been appended yet
+    long  iLen;     // length of data, excluding the NUL terminator
+    long  iSize;    // allocated size of data
+} ClickSmsBuffer;
+
+// Enumeration of encodings applied to data appended with click_buffer_append_encoded()
+typedef enum eClickEncoding {
+    CLICK_ENCODING_RAW,     // copied as is
+    CLICK_ENCODING_URL,     // URL-encoded, as for HTTP API query parameters (see click_string_url_encode())
+    CLICK_ENCODING_JSON,    // escaped for use inside a JSON string, as for REST API post data
+    CLICK_ENCODING_COUNT    // count of encodings
+} eClickEncoding;
+
 // function declarations
 ClickSmsString *click_string_create(const char *chStr);
+ClickSmsString *click_string_create_empty(int iLen);
 void click_string_destroy(ClickSmsString *sBuf);
 void click_string_trim_prefix(ClickSmsString *sBuf, unsigned int iLen);
 int click_string_find_cstr(const ClickSmsString *sHaystack, char *chNeedle, unsigned int iStartPos);
@@ -32,5 +53,12 @@ char *click_string_retrieve_cstr(const ClickSmsString *sBuf);
 void click_string_append(ClickSmsString *sDest, const ClickSmsString *sSource, const char *chSource);
 void click_string_append_formatted_cstr(ClickSmsString *sDest, const char *chFormat, ...);
 void click_string_url_encode(ClickSmsString *sBuf);
+int click_buffer_reserve(ClickSmsBuffer *oBuf, long iLen);
+int click_buffer_append(ClickSmsBuffer *oBuf, const char *chData, long iLen);
+int click_buffer_append_encoded(ClickSmsBuffer *oBuf, const char *chData, long iLen, eClickEncoding eEncoding);
+long click_buffer_encoded_len_max(long iLen, eClickEncoding eEncoding);
+void click_buffer_reset(ClickSmsBuffer *oBuf);
+void click_buffer_free(ClickSmsBuffer *oBuf);
+ClickSmsString *click_buffer_detach(ClickSmsBuffer *oBuf);
 
 #endif // CLICKATELL_STRING_H
@@ -0,0 +1,311 @@
+/*
+ * clickatell_template.c
+ *
+ *  Message template module: compiles templates with {name} placeholders into segments
+ *  and renders them into ClickSmsBuffers. See clickatell_template.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_template.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// characters allowed in placeholder names
+#define LOCAL_TEMPLATE_NAME_CHAR(c) (((c) >= '0' && (c) <= '9') || ((c) >= 'A' && (c) <= 'Z') || \
+                                     ((c) >= 'a' && (c) <= 'z') || (c) == '_')
+
+// One literal or placeholder segment of a template
+typedef struct LocalTemplateSegment {
+    int  iValue;                            // index of the placeholder's value, or -1 for a literal
+    long aOffsets[CLICK_ENCODING_COUNT];    // literal only: offset of its text in each encoding
+    long aLens[CLICK_ENCODING_COUNT];       // literal only: length of its text in each encoding
+} LocalTemplateSegment;
+
+// internal structure (hidden from public access) of a compiled template
+struct ClickTemplate {
+    int iNumSegments;                       // count of segments
+    int iNumValues;                         // count of placeholder names (values passed when rendering)
+    LocalTemplateSegment *aSegments;        // segments in template order
+    ClickSmsBuffer aLiterals[CLICK_ENCODING_COUNT]; // all literal text, in each encoding
+};
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static int local_template_literal_add(ClickTemplate *oTemplate, const char *chText, long iLen);
+static void local_template_value_add(ClickTemplate *oTemplate, int iValue);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_template_literal_add
+ * Info:      Appends text to the template's literal segments, encoded in each encoding.
+ *            Consecutive literal text is merged into one segment.
+ * Inputs:    oTemplate - template being compiled
+ *            chText    - literal text
+ *            iLen      - length of text
+ * Return:    0 if successful, else -1 if failed to allocate memory
+ */
+static int local_template_literal_add(ClickTemplate *oTemplate, const char *chText, long iLen)
+{
+    LocalTemplateSegment *oSegment = NULL;
+    int i = 0;
+
+    if (iLen == 0)
+        return 0;
+
+    if (oTemplate->iNumSegments == 0 || oTemplate->aSegments[oTemplate->iNumSegments - 1].iValue >= 0) {
+        oSegment = &oTemplate->aSegments[oTemplate->iNumSegments++];
+        oSegment->iValue = -1;
+        for (i = 0; i < CLICK_ENCODING_COUNT; i++) {
+            oSegment->aOffsets[i] = oTemplate->aLiterals[i].iLen;
+            oSegment->aLens[i]    = 0;
+        }
+    }
+    else
+        oSegment = &oTemplate->aSegments[oTemplate->iNumSegments - 1];
+
+    for (i = 0; i < CLICK_ENCODING_COUNT; i++) {
+        if (click_buffer_append_encoded(&oTemplate->aLiterals[i], chText, iLen, (eClickEncoding)i) != 0)
+            return -1;
+        oSegment->aLens[i] = oTemplate->aLiterals[i].iLen - oSegment->aOffsets[i];
+    }
+
+    return 0;
+}
+
+/*
+ * Function:  local_template_value_add
+ * Info:      Appends a placeholder segment to a template.
+ * Inputs:    oTemplate - template being compiled
+ *            iValue    - index of the placeholder's value
+ * Return:    void
+ */
+static void local_template_value_add(ClickTemplate *oTemplate, int iValue)
+{
+    LocalTemplateSegment *oSegment = &oTemplate->aSegments[oTemplate->iNumSegments++];
+
+    memset(oSegment, 0, sizeof(LocalTemplateSegment));
+    oSegment->iValue = iValue;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_template_compile
+ * Info:      Compiles a message template. Placeholders are written as {name}, where name
+ *            is one of 'aNames' (letters, digits and '_'); the values of a render are
+ *            passed in the same order as 'aNames'.
+ *            Note that the calling function must destroy the returned template.
+ * Inputs:    chTemplate - template text
+ *            aNames     - placeholder names
+ *            iNumNames  - count of placeholder names
+ * Return:    compiled template, or NULL if invalid parameter, the template uses a name
+ *            not in 'aNames', or failed to allocate memory
+ */
+ClickTemplate *click_template_compile(const char *chTemplate, const char *const *aNames, int iNumNames)
+{
+    ClickTemplate *oTemplate = NULL;
+    const char *pText = chTemplate, *pLiteral = chTemplate, *pName = NULL;
+    long iNameLen = 0;
+    int i = 0, iValue = -1;
+
+    if (chTemplate == NULL || iNumNames < 0 || (iNumNames > 0 && aNames == NULL)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if ((oTemplate = (ClickTemplate *)calloc(1, sizeof(ClickTemplate))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for template!\n", __func__);
+        return NULL;
+    }
+    oTemplate->iNumValues = iNumNames;
+
+    // a template of n braces has at most n + 1 segments
+    for (pText = chTemplate; *pText != '\0'; pText++)
+        i += (*pText == '{' || *pText == '}');
+    if ((oTemplate->aSegments = calloc(i + 1, sizeof(LocalTemplateSegment))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for template segments!\n", __func__);
+        goto error;
+    }
+
+    for (pText = chTemplate; *pText != '\0'; ) {
+        // escaped braces: the first brace is kept as text, the second skipped
+        if ((pText[0] == '{' && pText[1] == '{') || (pText[0] == '}' && pText[1] == '}')) {
+            if (local_template_literal_add(oTemplate, pLiteral, pText + 1 - pLiteral) != 0)
+                goto error;
+            pText   += 2;
+            pLiteral = pText;
+            continue;
+        }
+
+        if (pText[0] != '{') {
+            pText++;
+            continue;
+        }
+
+        // a placeholder is '{', a name and '}'; anything else is text
+        for (pName = pText + 1; LOCAL_TEMPLATE_NAME_CHAR(*pName); pName++)
+            ;
+        iNameLen = pName - (pText + 1);
+        if (iNameLen == 0 || *pName != '}') {
+            pText++;
+            continue;
+        }
+
+        for (iValue = -1, i = 0; i < iNumNames && iValue < 0; i++) {
+            if (aNames[i] != NULL && (long)strlen(aNames[i]) == iNameLen && memcmp(aNames[i], pText + 1, iNameLen) == 0)
+                iValue = i;
+        }
+        if (iValue < 0) {
+            click_debug_print("%s ERROR: Unknown placeholder '%.*s'!\n", __func__, (int)iNameLen, pText + 1);
+            goto error;
+        }
+
+        if (local_template_literal_add(oTemplate, pLiteral, pText - pLiteral) != 0)
+            goto error;
+        local_template_value_add(oTemplate, iValue);
+
+        pText    = pName + 1;
+        pLiteral = pText;
+    }
+
+    if (local_template_literal_add(oTemplate, pLiteral, pText - pLiteral) != 0)
+        goto error;
+
+    return oTemplate;
+
+error:
+    click_template_destroy(oTemplate);
+    return NULL;
+}
+
+/*
+ * Function:  click_template_destroy
+ * Info:      Destroys a compiled template.
+ * Inputs:    oTemplate - template to destroy
+ * Return:    void
+ */
+void click_template_destroy(ClickTemplate *oTemplate)
+{
+    int i = 0;
+
+    if (oTemplate == NULL)
+        return;
+
+    for (i = 0; i < CLICK_ENCODING_COUNT; i++)
+        click_buffer_free(&oTemplate->aLiterals[i]);
+    free(oTemplate->aSegments);
+    free(oTemplate);
+}
+
+/*
+ * Function:  click_template_num_values
+ * Info:      Returns the count of a template's placeholder names, ie. the values passed
+ *            to each render.
+ * Inputs:    oTemplate - compiled template
+ * Return:    count of values, or -1 if invalid parameter
+ */
+int click_template_num_values(const ClickTemplate *oTemplate)
+{
+    if (oTemplate == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    return oTemplate->iNumValues;
+}
+
+/*
+ * Function:  click_template_render_len
+ * Info:      Calculates the length of a rendered template (without encoding).
+ * Inputs:    oTemplate  - compiled template
+ *            aValues    - placeholder values, in the order of the template's names
+ *            aValueLens - lengths of the values, or NULL if they are NUL terminated
+ * Return:    length of the rendered text, or -1 if invalid parameter
+ */
+long click_template_render_len(const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens)
+{
+    long iLen = 0;
+    int i = 0, iValue = 0;
+
+    if (oTemplate == NULL || (oTemplate->iNumValues > 0 && aValues == NULL)) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < oTemplate->iNumSegments; i++) {
+        if ((iValue = oTemplate->aSegments[i].iValue) < 0)
+            iLen += oTemplate->aSegments[i].aLens[CLICK_ENCODING_RAW];
+        else if (aValues[iValue] != NULL)
+            iLen += (aValueLens != NULL ? aValueLens[iValue] : (long)strlen(aValues[iValue]));
+    }
+
+    return iLen;
+}
+
+/*
+ * Function:  click_template_render
+ * Info:      Renders a template, appending the text to a buffer. The most space the text
+ *            can take is reserved up front, after which literals are copied from their
+ *            pre-encoded form and values are encoded straight into the buffer, so the
+ *            rendered text may be written directly into a URL (CLICK_ENCODING_URL) or
+ *            JSON post data (CLICK_ENCODING_JSON). To reuse a buffer for each render, call
+ *            click_buffer_reset() first. A NULL value renders as empty text.
+ * Inputs:    oTemplate  - compiled template
+ *            aValues    - placeholder values, in the order of the template's names
+ *            aValueLens - lengths of the values, or NULL if they are NUL terminated
+ *            eEncoding  - encoding of the rendered text
+ *            oBuf       - buffer to append to
+ * Return:    0 if successful, else -1 if invalid parameter or failed to allocate memory
+ */
+int click_template_render(const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens,
+                          eClickEncoding eEncoding, ClickSmsBuffer *oBuf)
+{
+    const LocalTemplateSegment *oSegment = NULL;
+    long iMaxLen = 0, iLen = 0;
+    int i = 0;
+
+    if (oTemplate == NULL || oBuf == NULL || (oTemplate->iNumValues > 0 && aValues == NULL) ||
+        eEncoding < CLICK_ENCODING_RAW || eEncoding >= CLICK_ENCODING_COUNT)
+    {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < oTemplate->iNumSegments; i++) {
+        oSegment = &oTemplate->aSegments[i];
+        if (oSegment->iValue < 0)
+            iMaxLen += oSegment->aLens[eEncoding];
+        else if (aValues[oSegment->iValue] != NULL)
+            iMaxLen += click_buffer_encoded_len_max((aValueLens != NULL ? aValueLens[oSegment->iValue] : (long)strlen(aValues[oSegment->iValue])),
+                                                    eEncoding);
+    }
+
+    if (click_buffer_reserve(oBuf, iMaxLen) != 0)
+        return -1;
+
+    // no appends below can reallocate the buffer
+    for (i = 0; i < oTemplate->iNumSegments; i++) {
+        oSegment = &oTemplate->aSegments[i];
+        if (oSegment->iValue < 0)
+            click_buffer_append(oBuf, oTemplate->aLiterals[eEncoding].data + oSegment->aOffsets[eEncoding], oSegment->aLens[eEncoding]);
+        else if (aValues[oSegment->iValue] != NULL) {
+            iLen = (aValueLens != NULL ? aValueLens[oSegment->iValue] : (long)strlen(aValues[oSegment->iValue]));
+            click_buffer_append_encoded(oBuf, aValues[oSegment->iValue], iLen, eEncoding);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CLICKATELL_TEMPLATE_H
+#define CLICKATELL_TEMPLATE_H
+
+/*
+ * clickatell_template.h
+ *
+ *  Message template module used by the Clickatell SMS library.
+ *
+ *  A template such as "Hi {name}, your code is {code}" is compiled once into a sequence of
+ *  literal and placeholder segments, with the literals pre-encoded for each encoding
+ *  (raw, URL and JSON). Rendering is then a sequence of copies into a reusable
+ *  ClickSmsBuffer, sized up front so that the buffer grows at most once per render.
+ *  "{{" and "}}" stand for literal braces; a '{' which does not start a placeholder (ie.
+ *  "{ref [A-7]}") is kept as text.
+ *
+ *  Compiled templates are never changed by rendering, so a template may be rendered by
+ *  several threads at once (each into its own buffer).
+ */
+
+#include "clickatell_string.h"
+
+// compiled message template (opaque)
+typedef struct ClickTemplate ClickTemplate;
+
+// function declarations
+ClickTemplate *click_template_compile(const char *chTemplate, const char *const *aNames, int iNumNames);
+void click_template_destroy(ClickTemplate *oTemplate);
+int click_template_num_values(const ClickTemplate *oTemplate);
+long click_template_render_len(const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens);
+int click_template_render(const ClickTemplate *oTemplate, const char *const *aValues, const long *aValueLens,
+                          eClickEncoding eEncoding, ClickSmsBuffer *oBuf);
+
+#endif // CLICKATELL_TEMPLATE_H
@@ -0,0 +1,329 @@
+/*
+ * clickatell_trace.c
+ *
+ *  Traffic capture module: records the shape and timing of API calls to a compact
+ *  binary trace file, and reads such trace files back for replay.
+ *  See clickatell_trace.h for the trace file format.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "clickatell_debug.h"
+#include "clickatell_string.h"
+#include "clickatell_sms.h"
+#include "clickatell_trace.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Macros/Types                                                                  *
+ * ----------------------------------------------------------------------------- */
+
+// trace file magic, followed by the version byte
+#define CLICK_TRACE_MAGIC       "CLKTRACE"
+#define CLICK_TRACE_MAGIC_LEN   8
+
+// maximum encoded record size: 10 varints of at most 10 bytes each
+#define CLICK_TRACE_RECORD_MAX  100
+
+// trace file opened for writing or reading
+struct ClickTrace {
+    FILE *fpFile;             // trace file
+    int bWriter;              // 1 if opened for writing, 0 if opened for reading
+    long long iOpenUs;        // click_trace_clock_us() when the trace was opened (writer only)
+    long long iLastStartUs;   // start time of the previous record, relative to iOpenUs
+    pthread_mutex_t oLock;    // serializes records written from several threads (writer only)
+};
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static int local_trace_varint_put(unsigned char *aBuf, unsigned long long iVal);
+static int local_trace_varint_get(FILE *fpFile, unsigned long long *iVal);
+static ClickTrace *local_trace_create(const char *chPath, int bWriter);
+
+/* ----------------------------------------------------------------------------- *
+ * Local functions                                                               *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  local_trace_varint_put
+ * Info:      Encodes an unsigned LEB128 varint.
+ * Inputs:    aBuf - output buffer, at least 10 bytes
+ *            iVal - value to encode
+ * Return:    number of bytes written
+ */
+static int local_trace_varint_put(unsigned char *aBuf, unsigned long long iVal)
+{
+    int iLen = 0;
+
+    while (iVal >= 0x80) {
+        aBuf[iLen++] = (unsigned char)(iVal | 0x80);
+        iVal >>= 7;
+    }
+    aBuf[iLen++] = (unsigned char)iVal;
+
+    return iLen;
+}
+
+/*
+ * Function:  local_trace_varint_get
+ * Info:      Decodes an unsigned LEB128 varint from a file.
+ * Inputs:    fpFile - file to read from
+ * Outputs:   iVal   - decoded value
+ * Return:    1 if decoded, 0 if at end of file before the first byte, else -1
+ */
+static int local_trace_varint_get(FILE *fpFile, unsigned long long *iVal)
+{
+    int iByte = 0, iShift = 0;
+
+    *iVal = 0;
+
+    while ((iByte = fgetc(fpFile)) != EOF) {
+        *iVal |= (unsigned long long)(iByte & 0x7f) << iShift;
+
+        if ((iByte & 0x80) == 0)
+            return 1;
+
+        if ((iShift += 7) > 63)
+            return -1;
+    }
+
+    return (iShift == 0 ? 0 : -1);
+}
+
+/*
+ * Function:  local_trace_create
+ * Info:      Opens a trace file, writing or validating its header.
+ * Inputs:    chPath  - trace file path
+ *            bWriter - 1 to create the file for writing, 0 to open it for reading
+ * Return:    new ClickTrace, or NULL if failed
+ */
+static ClickTrace *local_trace_create(const char *chPath, int bWriter)
+{
+    unsigned char aHeader[CLICK_TRACE_MAGIC_LEN + 1];
+    ClickTrace *oTrace = NULL;
+
+    if (chPath == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return NULL;
+    }
+
+    if ((oTrace = (ClickTrace *)calloc(1, sizeof(ClickTrace))) == NULL) {
+        click_debug_print("%s ERROR: Failed to allocate memory for trace!\n", __func__);
+        return NULL;
+    }
+
+    if ((oTrace->fpFile = fopen(chPath, (bWriter ? "wb" : "rb"))) == NULL) {
+        click_debug_print("%s ERROR: Failed to open trace file %s!\n", __func__, chPath);
+        free(oTrace);
+        return NULL;
+    }
+
+    if (bWriter) {
+        memcpy(aHeader, CLICK_TRACE_MAGIC, CLICK_TRACE_MAGIC_LEN);
+        aHeader[CLICK_TRACE_MAGIC_LEN] = CLICK_TRACE_VERSION;
+
+        if (fwrite(aHeader, sizeof(aHeader), 1, oTrace->fpFile) != 1) {
+            click_debug_print("%s ERROR: Failed to write trace header!\n", __func__);
+            fclose(oTrace->fpFile);
+            free(oTrace);
+            return NULL;
+        }
+
+        oTrace->iOpenUs = click_trace_clock_us();
+    }
+    else if (fread(aHeader, sizeof(aHeader), 1, oTrace->fpFile) != 1 ||
+             memcmp(aHeader, CLICK_TRACE_MAGIC, CLICK_TRACE_MAGIC_LEN) != 0 ||
+             aHeader[CLICK_TRACE_MAGIC_LEN] != CLICK_TRACE_VERSION) {
+        click_debug_print("%s ERROR: %s is not a version %d trace file!\n", __func__, chPath, CLICK_TRACE_VERSION);
+        fclose(oTrace->fpFile);
+        free(oTrace);
+        return NULL;
+    }
+
+    oTrace->bWriter = bWriter;
+    pthread_mutex_init(&oTrace->oLock, NULL);
+
+    return oTrace;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public functions                                                              *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  click_trace_clock_us
+ * Info:      Reads the monotonic clock used to time traced API calls.
+ * Return:    current time in microseconds
+ */
+long long click_trace_clock_us(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return (long long)tNow.tv_sec * 1000000LL + tNow.tv_nsec / 1000;
+}
+
+/*
+ * Function:  click_trace_shape_get
+ * Info:      Classifies a parameter without recording its content.
+ * Inputs:    chParam - parameter string, or NULL if the call has no parameter
+ * Outputs:   iLen    - length of parameter in bytes
+ * Return:    eClickTraceShape of parameter
+ */
+int click_trace_shape_get(const char *chParam, long *iLen)
+{
+    const unsigned char *pParam = (const unsigned char *)chParam;
+    int eShape = CLICK_TRACE_SHAPE_ASCII;
+
+    *iLen = 0;
+
+    if (pParam == NULL)
+        return CLICK_TRACE_SHAPE_NONE;
+
+    for (; *pParam != '\0'; pParam++) {
+        if (*pParam >= 0x80)
+            eShape = CLICK_TRACE_SHAPE_NON_ASCII;
+    }
+
+    *iLen = (long)(pParam - (const unsigned char *)chParam);
+
+    return eShape;
+}
+
+/*
+ * Function:  click_trace_open
+ * Info:      Creates a trace file for writing. Any existing file is replaced.
+ *            The trace may be attached to several handles, which may be used from
+ *            several threads.
+ * Inputs:    chPath - trace file path
+ * Return:    new ClickTrace, or NULL if failed. Close it with click_trace_close().
+ */
+ClickTrace *click_trace_open(const char *chPath)
+{
+    return local_trace_create(chPath, 1);
+}
+
+/*
+ * Function:  click_trace_reader_open
+ * Info:      Opens an existing trace file for reading with click_trace_read().
+ * Inputs:    chPath - trace file path
+ * Return:    new ClickTrace, or NULL if failed or if the file is not a trace file.
+ *            Close it with click_trace_close().
+ */
+ClickTrace *click_trace_reader_open(const char *chPath)
+{
+    return local_trace_create(chPath, 0);
+}
+
+/*
+ * Function:  click_trace_close
+ * Info:      Flushes and closes a trace file. No handle may still be using the trace.
+ * Inputs:    oTrace - trace to close
+ * Return:    void
+ */
+void click_trace_close(ClickTrace *oTrace)
+{
+    if (oTrace == NULL)
+        return;
+
+    fclose(oTrace->fpFile);
+    pthread_mutex_destroy(&oTrace->oLock);
+    free(oTrace);
+}
+
+/*
+ * Function:  click_trace_record
+ * Info:      Appends a record to a trace opened with click_trace_open().
+ * Inputs:    oTrace  - trace to write to
+ *            oRecord - record to write. Its 'iStartUs' field must be an absolute time
+ *                      read from click_trace_clock_us(); it is stored relative to the
+ *                      time the trace was opened.
+ * Return:    void
+ */
+void click_trace_record(ClickTrace *oTrace, const ClickTraceRecord *oRecord)
+{
+    if (oTrace == NULL || !oTrace->bWriter || oRecord == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return;
+    }
+
+    unsigned char aBuf[CLICK_TRACE_RECORD_MAX];
+    int iLen = 0;
+    long long iStartUs = oRecord->iStartUs - oTrace->iOpenUs;
+
+    pthread_mutex_lock(&oTrace->oLock);
+
+    long long iDelta = iStartUs - oTrace->iLastStartUs;
+    oTrace->iLastStartUs = iStartUs;
+
+    iLen += local_trace_varint_put(aBuf + iLen, ((unsigned long long)iDelta << 1) ^ (unsigned long long)(iDelta >> 63)); // zigzag
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)(oRecord->iDurationUs > 0 ? oRecord->iDurationUs : 0));
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->eCall);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->eApiType);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)(oRecord->iHttpStatus + 1)); // -1 (failed) is stored as 0
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->iParamLen);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->eParamShape);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->iNumDests);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->iRequestBytes);
+    iLen += local_trace_varint_put(aBuf + iLen, (unsigned long long)oRecord->iResponseBytes);
+
+    if (fwrite(aBuf, iLen, 1, oTrace->fpFile) != 1)
+        click_debug_print("%s ERROR: Failed to write trace record!\n", __func__);
+
+    pthread_mutex_unlock(&oTrace->oLock);
+}
+
+/*
+ * Function:  click_trace_read
+ * Info:      Reads the next record from a trace opened with click_trace_reader_open().
+ * Inputs:    oTrace  - trace to read from
+ * Outputs:   oRecord - record read. Its 'iStartUs' field is relative to the time the
+ *                      trace was opened for writing.
+ * Return:    1 if a record was read, 0 at end of trace, else -1 if the trace is corrupt (a
+ *            field is truncated or out of range)
+ */
+int click_trace_read(ClickTrace *oTrace, ClickTraceRecord *oRecord)
+{
+    if (oTrace == NULL || oTrace->bWriter || oRecord == NULL) {
+        click_debug_print("%s ERROR: Invalid parameter!\n", __func__);
+        return -1;
+    }
+
+    unsigned long long aFields[10];
+    int i = 0, iResult = 0;
+
+    for (i = 0; i < 10; i++) {
+        if ((iResult = local_trace_varint_get(oTrace->fpFile, &aFields[i])) != 1)
+            return (i == 0 && iResult == 0 ? 0 : -1); // end of trace only between records
+    }
+
+    // check the fields before narrowing them, so that large values cannot wrap into valid ones
+    if (aFields[2] >= CLICK_TRACE_CALL_COUNT || aFields[3] >= CLICK_API_COUNT || aFields[6] >= CLICK_TRACE_SHAPE_COUNT)
+        return -1;
+    for (i = 1; i < 10; i++) {
+        if (aFields[i] > LONG_MAX)
+            return -1;
+    }
+
+    long long iDelta = (long long)(aFields[0] >> 1) ^ -(long long)(aFields[0] & 1); // zigzag
+    oTrace->iLastStartUs += iDelta;
+
+    oRecord->iStartUs       = oTrace->iLastStartUs;
+    oRecord->iDurationUs    = (long)aFields[1];
+    oRecord->eCall          = (int)aFields[2];
+    oRecord->eApiType       = (int)aFields[3];
+    oRecord->iHttpStatus    = (long)aFields[4] - 1;
+    oRecord->iParamLen      = (long)aFields[5];
+    oRecord->eParamShape    = (int)aFields[6];
+    oRecord->iNumDests      = (long)aFields[7];
+    oRecord->iRequestBytes  = (long)aFields[8];
+    oRecord->iResponseBytes = (long)aFields[9];
+
+    return 1;
+}
@@ -0,0 +1,75 @@
+#ifndef CLICKATELL_TRACE_H
+#define CLICKATELL_TRACE_H
+
+/*
+ * clickatell_trace.h
+ *
+ * Traffic capture module used by the Clickatell SMS library.
+ *
+ * When a trace is attached to a handle (see clickatell_sms_handle_trace_set()), every API
+ * call made on the handle is recorded: which call was made, the size and shape of its
+ * parameters, the size of the request and response, and its timing. Payloads (message
+ * text, numbers, message IDs and credentials) are never recorded.
+ *
+ * Trace file format:
+ *   header: the 8 characters "CLKTRACE" followed by one version byte (CLICK_TRACE_VERSION)
+ *   record: a sequence of unsigned LEB128 varints, in ClickTraceRecord field order. The
+ *           start time is stored as a zigzag-encoded delta from the previous record's start
+ *           time, since calls made from several threads may complete out of order.
+ */
+
+#include <stdio.h>
+
+#define CLICK_TRACE_VERSION 1
+
+// Enumeration of traced API calls
+typedef enum eClickTraceCall {
+    CLICK_TRACE_MESSAGE_SEND,  // clickatell_sms_message_send()
+    CLICK_TRACE_STATUS_GET,    // clickatell_sms_status_get()
+    CLICK_TRACE_BALANCE_GET,   // clickatell_sms_balance_get()
+    CLICK_TRACE_CHARGE_GET,    // clickatell_sms_charge_get()
+    CLICK_TRACE_COVERAGE_GET,  // clickatell_sms_coverage_get()
+    CLICK_TRACE_MESSAGE_STOP,  // clickatell_sms_message_stop()
+    CLICK_TRACE_MESSAGE_SEND_BINARY, // clickatell_sms_message_send_binary()
+    CLICK_TRACE_BATCH_START,   // clickatell_sms_batch_start()
+    CLICK_TRACE_BATCH_ITEM,    // clickatell_sms_batch_item_send()
+    CLICK_TRACE_BATCH_QUICKSEND, // clickatell_sms_batch_quicksend()
+    CLICK_TRACE_BATCH_END,     // clickatell_sms_batch_end()
+    CLICK_TRACE_CALL_COUNT     // count of traced API calls
+} eClickTraceCall;
+
+// Enumeration of redacted parameter shapes
+typedef enum eClickTraceShape {
+    CLICK_TRACE_SHAPE_NONE,      // call has no parameter
+    CLICK_TRACE_SHAPE_ASCII,     // parameter contains 7-bit ASCII characters only
+    CLICK_TRACE_SHAPE_NON_ASCII, // parameter contains other (UTF-8 or Latin1) characters
+    CLICK_TRACE_SHAPE_COUNT      // count of shapes
+} eClickTraceShape;
+
+// one traced API call
+typedef struct ClickTraceRecord {
+    long long iStartUs;       // call start in microseconds since the trace was opened
+    long      iDurationUs;    // call duration in microseconds
+    int       eCall;          // eClickTraceCall
+    int       eApiType;       // eClickApi of the handle which made the call
+    long      iHttpStatus;    // HTTP status code, or -1 if the request failed
+    long      iParamLen;      // length of the main parameter: message text, message ID or MSISDN
+    int       eParamShape;    // eClickTraceShape of the main parameter
+    long      iNumDests;      // number of destination addresses (send message calls only)
+    long      iRequestBytes;  // request URL plus body length in bytes
+    long      iResponseBytes; // response length in bytes
+} ClickTraceRecord;
+
+// trace file, opened either for writing or for reading
+typedef struct ClickTrace ClickTrace;
+
+// function declarations
+ClickTrace *click_trace_open(const char *chPath);
+ClickTrace *click_trace_reader_open(const char *chPath);
+void click_trace_close(ClickTrace *oTrace);
+void click_trace_record(ClickTrace *oTrace, const ClickTraceRecord *oRecord);
+int click_trace_read(ClickTrace *oTrace, ClickTraceRecord *oRecord);
+long long click_trace_clock_us(void);
+int click_trace_shape_get(const char *chParam, long *iLen);
+
+#endif // CLICKATELL_TRACE_H
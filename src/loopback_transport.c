@@ -0,0 +1,108 @@
+/*
+ * loopback_transport.c
+ *
+ * Loopback transport shared by the soak, stress and benchmark applications.
+ * See clickatell_sms_handle_transport_set().
+ */
+
+#include <string.h>
+
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "loopback_transport.h"
+
+#define LOOPBACK_WRITE_CHUNK    8   // responses are written in pieces of at most this many bytes, as a
+                                    // server's response may arrive over several cURL write callbacks
+
+/* ----------------------------------------------------------------------------- *
+ * Public function definitions                                                   *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  loopback_transport
+ * Info:      Loopback transport which returns a canned Clickatell response for each
+ *            API call, based on the request URL and method. The response is written in
+ *            several pieces, the way a server's response may arrive.
+ * Inputs:    pContext - API type of the handle making the request
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+long loopback_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    eClickApi eApiType = *(eClickApi *)pContext;
+    const char *chResponse = NULL;
+    size_t iLen = 0, iChunk = 0;
+
+    if (eApiType == CLICK_API_HTTP) {
+        if (strstr(oRequest->chUrl, "sendmsg.php") != NULL)
+            chResponse = "ID: 205e85d0578314037a96175249fc6a2b";
+        else if (strstr(oRequest->chUrl, "querymsg.php") != NULL)
+            chResponse = "ID: 205e85d0578314037a96175249fc6a2b Status: 004";
+        else if (strstr(oRequest->chUrl, "getbalance.php") != NULL)
+            chResponse = "Credit: 1234.500";
+        else if (strstr(oRequest->chUrl, "getmsgcharge.php") != NULL)
+            chResponse = "apiMsgId: 205e85d0578314037a96175249fc6a2b charge: 1 status: 004";
+        else if (strstr(oRequest->chUrl, "auth.php") != NULL)
+            chResponse = "OK: 2eda2fe1f07f6e4e96e3e2d39bd1b1b7";
+        else if (strstr(oRequest->chUrl, "ping.php") != NULL || strstr(oRequest->chUrl, "endbatch.php") != NULL)
+            chResponse = "OK:";
+        else if (strstr(oRequest->chUrl, "startbatch.php") != NULL)
+            chResponse = "ID: 8c9d6e2a81b6b8f2c4ebd2c2f76d6b1b";
+        else if (strstr(oRequest->chUrl, "senditem.php") != NULL || strstr(oRequest->chUrl, "quicksend.php") != NULL)
+            chResponse = "ID: 205e85d0578314037a96175249fc6a2b To: 2991000000";
+        else if (strstr(oRequest->chUrl, "routecoverage.php") != NULL)
+            chResponse = "OK: This prefix is currently supported. Messages sent to this prefix will be routed. Charge: 1";
+        else
+            chResponse = "ID: 205e85d0578314037a96175249fc6a2b Status: 006";
+    }
+    else {
+        if (strcmp(oRequest->chMethod, "POST") == 0)
+            chResponse = "{\"data\":{\"message\":[{\"accepted\":true,\"to\":\"2991000000\","
+                         "\"apiMessageId\":\"77a4a70428f984d9741001e6f17d02b4\"}]}}";
+        else if (strcmp(oRequest->chMethod, "DELETE") == 0)
+            chResponse = "{\"data\":{\"apiMessageId\":\"77a4a70428f984d9741001e6f17d02b4\","
+                         "\"messageStatus\":\"006\",\"description\":\"User cancelled message delivery\"}}";
+        else if (strstr(oRequest->chUrl, "rest/account/balance") != NULL)
+            chResponse = "{\"data\":{\"balance\":\"1234.500\"}}";
+        else if (strstr(oRequest->chUrl, "rest/coverage/") != NULL)
+            chResponse = "{\"data\":{\"routable\":true,\"destination\":\"2991000000\",\"minimumCharge\":1}}";
+        else
+            chResponse = "{\"data\":{\"charge\":1,\"messageStatus\":\"004\",\"description\":\"Received by recipient\","
+                         "\"apiMessageId\":\"77a4a70428f984d9741001e6f17d02b4\"}}";
+    }
+
+    for (iLen = strlen(chResponse); iLen > 0; iLen -= iChunk, chResponse += iChunk) {
+        iChunk = (iLen < LOOPBACK_WRITE_CHUNK ? iLen : LOOPBACK_WRITE_CHUNK);
+        if (oRequest->fnWrite((void *)chResponse, 1, iChunk, oRequest->pWriteData) != iChunk)
+            break;
+    }
+
+    return (eApiType == CLICK_API_REST && strcmp(oRequest->chMethod, "POST") == 0 ? 202 : 200);
+}
+
+/*
+ * Function:  loopback_handle_create
+ * Info:      Creates a ClickSmsHandle which uses the loopback transport.
+ * Inputs:    eApiType - API type
+ * Return:    new handle, or NULL if failed
+ */
+ClickSmsHandle *loopback_handle_create(eClickApi eApiType)
+{
+    static eClickApi aApiTypes[CLICK_API_COUNT] = { CLICK_API_HTTP, CLICK_API_REST };
+    ClickSmsHandle *oClickSms = NULL;
+    ClickSmsString *sUser   = click_string_create("loopbackuser");
+    ClickSmsString *sPass   = click_string_create("loopback password&=");
+    ClickSmsString *sApiKey = click_string_create("uJqYpaWlUNPUhEDsuptRJCk5nGZD.Fwx8vHQOUjoTXTdFghXERUsZDvoK1SiF");
+    ClickSmsString *sApiId  = click_string_create("3518209");
+
+    oClickSms = clickatell_sms_handle_init(eApiType, sUser, sPass, sApiKey, sApiId, 5, 2);
+    if (oClickSms != NULL)
+        clickatell_sms_handle_transport_set(oClickSms, loopback_transport, &aApiTypes[eApiType]);
+
+    click_string_destroy(sUser);
+    click_string_destroy(sPass);
+    click_string_destroy(sApiKey);
+    click_string_destroy(sApiId);
+
+    return oClickSms;
+}
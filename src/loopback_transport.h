@@ -0,0 +1,16 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+/*
+ * loopback_transport.h
+ *
+ * Loopback transport shared by the soak, stress and benchmark applications.
+ * API calls made on a loopback handle are fully formatted by the Clickatell SMS
+ * library, but never leave the process: each request receives a canned Clickatell
+ * response instead.
+ */
+
+long loopback_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+ClickSmsHandle *loopback_handle_create(eClickApi eApiType);
+
+#endif // LOOPBACK_TRANSPORT_H
@@ -0,0 +1,244 @@
+/*
+ * perf_counters.c
+ *
+ * Hardware performance counters for the benchmark applications.
+ * See perf_counters.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf_counters.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static long long perf_local_now_ns(void);
+static int perf_local_event_open(ePerfCounter eCounter);
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  perf_local_now_ns
+ * Info:      Reads the monotonic clock.
+ * Return:    current time in nanoseconds
+ */
+static long long perf_local_now_ns(void)
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+    return (long long)tNow.tv_sec * 1000000000LL + tNow.tv_nsec;
+}
+
+/*
+ * Function:  perf_local_event_open
+ * Info:      Opens a disabled, user-space only perf event for the calling thread.
+ * Inputs:    eCounter - counter to open
+ * Return:    file descriptor, or -1 if the counter is unavailable
+ */
+static int perf_local_event_open(ePerfCounter eCounter)
+{
+#ifdef __linux__
+    struct perf_event_attr oAttr;
+
+    memset(&oAttr, 0, sizeof(oAttr));
+    oAttr.size           = sizeof(oAttr);
+    oAttr.disabled       = 1;
+    oAttr.exclude_kernel = 1; // user-space only, so that perf_event_paranoid=2 still allows it
+    oAttr.exclude_hv     = 1;
+    oAttr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (eCounter) {
+        case PERF_COUNTER_CYCLES:
+            oAttr.type   = PERF_TYPE_HARDWARE;
+            oAttr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_COUNTER_INSTRUCTIONS:
+            oAttr.type   = PERF_TYPE_HARDWARE;
+            oAttr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_COUNTER_BRANCH_MISSES:
+            oAttr.type   = PERF_TYPE_HARDWARE;
+            oAttr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_COUNTER_L1D_MISSES:
+            oAttr.type   = PERF_TYPE_HW_CACHE;
+            oAttr.config = PERF_COUNT_HW_CACHE_L1D |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_COUNTER_LLC_MISSES:
+            oAttr.type   = PERF_TYPE_HARDWARE;
+            oAttr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        default:
+            return -1;
+    }
+
+    return (int)syscall(SYS_perf_event_open, &oAttr, 0, -1, -1, 0);
+#else
+    (void)eCounter;
+    return -1;
+#endif
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Public function definitions                                                   *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  perf_counters_open
+ * Info:      Opens all counters. Each counter is opened independently, so that the
+ *            counters which are available are still measured if others are not.
+ * Inputs:    oCounters - counter set to open
+ * Return:    void
+ */
+void perf_counters_open(PerfCounters *oCounters)
+{
+    int i = 0;
+
+    memset(oCounters, 0, sizeof(PerfCounters));
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+        oCounters->aFds[i] = perf_local_event_open((ePerfCounter)i);
+}
+
+/*
+ * Function:  perf_counters_close
+ * Info:      Closes all counters.
+ * Inputs:    oCounters - counter set to close
+ * Return:    void
+ */
+void perf_counters_close(PerfCounters *oCounters)
+{
+    int i = 0;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+#ifdef __linux__
+        if (oCounters->aFds[i] >= 0)
+            close(oCounters->aFds[i]);
+#endif
+        oCounters->aFds[i] = -1;
+    }
+}
+
+/*
+ * Function:  perf_counters_start
+ * Info:      Resets and starts all available counters, and the wall clock.
+ * Inputs:    oCounters - counter set
+ * Return:    void
+ */
+void perf_counters_start(PerfCounters *oCounters)
+{
+    int i = 0;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+#ifdef __linux__
+        if (oCounters->aFds[i] >= 0) {
+            ioctl(oCounters->aFds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(oCounters->aFds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    oCounters->iStartNs = perf_local_now_ns();
+}
+
+/*
+ * Function:  perf_counters_stop
+ * Info:      Stops all counters and reads their values. If the kernel had to multiplex
+ *            counters, the values are scaled up to the full measured time.
+ * Inputs:    oCounters - counter set
+ * Return:    void
+ */
+void perf_counters_stop(PerfCounters *oCounters)
+{
+    int i = 0;
+
+    oCounters->fElapsedNs = (double)(perf_local_now_ns() - oCounters->iStartNs);
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        oCounters->aValues[i] = 0.0;
+#ifdef __linux__
+        unsigned long long aRead[3] = { 0, 0, 0 }; // value, time enabled, time running
+
+        if (oCounters->aFds[i] < 0)
+            continue;
+
+        ioctl(oCounters->aFds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        if (read(oCounters->aFds[i], aRead, sizeof(aRead)) == (ssize_t)sizeof(aRead) && aRead[2] > 0)
+            oCounters->aValues[i] = (double)aRead[0] * ((double)aRead[1] / (double)aRead[2]);
+#endif
+    }
+}
+
+/*
+ * Function:  perf_counters_available
+ * Info:      Checks whether a counter could be opened.
+ * Inputs:    oCounters - counter set
+ *            eCounter  - counter
+ * Return:    1 if available, else 0
+ */
+int perf_counters_available(const PerfCounters *oCounters, ePerfCounter eCounter)
+{
+    return (eCounter >= 0 && eCounter < PERF_COUNTER_COUNT && oCounters->aFds[eCounter] >= 0);
+}
+
+/*
+ * Function:  perf_counters_report_header
+ * Info:      Prints the column headings for perf_counters_report().
+ * Return:    void
+ */
+void perf_counters_report_header(void)
+{
+    printf("%-32s %10s %10s %10s %6s %10s %10s %10s\n",
+           "operation", "ns/op", "cycles/op", "instr/op", "IPC", "brmiss/op", "L1Dmiss/op", "LLCmiss/op");
+}
+
+/*
+ * Function:  perf_counters_report
+ * Info:      Prints the last measured region, divided by the number of operations it
+ *            contained. Unavailable counters are printed as "n/a".
+ * Inputs:    oCounters - counter set
+ *            chName    - operation name
+ *            iOps      - number of operations measured
+ * Return:    void
+ */
+void perf_counters_report(const PerfCounters *oCounters, const char *chName, long iOps)
+{
+    int i = 0;
+    char aColumns[PERF_COUNTER_COUNT][16];
+    char chIpc[16] = "n/a";
+
+    if (iOps < 1)
+        iOps = 1;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_counters_available(oCounters, (ePerfCounter)i))
+            snprintf(aColumns[i], sizeof(aColumns[i]), "%.2f", oCounters->aValues[i] / iOps);
+        else
+            snprintf(aColumns[i], sizeof(aColumns[i]), "n/a");
+    }
+
+    if (perf_counters_available(oCounters, PERF_COUNTER_CYCLES) && perf_counters_available(oCounters, PERF_COUNTER_INSTRUCTIONS) &&
+        oCounters->aValues[PERF_COUNTER_CYCLES] > 0.0)
+        snprintf(chIpc, sizeof(chIpc), "%.2f", oCounters->aValues[PERF_COUNTER_INSTRUCTIONS] / oCounters->aValues[PERF_COUNTER_CYCLES]);
+
+    printf("%-32s %10.1f %10s %10s %6s %10s %10s %10s\n", chName, oCounters->fElapsedNs / iOps,
+           aColumns[PERF_COUNTER_CYCLES], aColumns[PERF_COUNTER_INSTRUCTIONS], chIpc,
+           aColumns[PERF_COUNTER_BRANCH_MISSES], aColumns[PERF_COUNTER_L1D_MISSES], aColumns[PERF_COUNTER_LLC_MISSES]);
+}
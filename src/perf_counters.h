@@ -0,0 +1,39 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/*
+ * perf_counters.h
+ *
+ * Hardware performance counters for the benchmark applications, read with the Linux
+ * perf_event_open() system call. Counters which cannot be opened (non-Linux platform,
+ * virtual machine without a PMU, or perf_event_paranoid restrictions) are reported as
+ * unavailable, and only wall-clock time is measured for them.
+ */
+
+// Enumeration of counters measured around each benchmarked operation
+typedef enum ePerfCounter {
+    PERF_COUNTER_CYCLES,        // CPU cycles
+    PERF_COUNTER_INSTRUCTIONS,  // instructions retired
+    PERF_COUNTER_BRANCH_MISSES, // mispredicted branches
+    PERF_COUNTER_L1D_MISSES,    // L1 data cache read misses
+    PERF_COUNTER_LLC_MISSES,    // last level cache misses
+    PERF_COUNTER_COUNT          // count of counters
+} ePerfCounter;
+
+// counter set, opened once and then started/stopped around each measured region
+typedef struct PerfCounters {
+    int    aFds[PERF_COUNTER_COUNT];          // perf event file descriptors, -1 if unavailable
+    double aValues[PERF_COUNTER_COUNT];       // counts measured in the last region (scaled if multiplexed)
+    double fElapsedNs;                        // wall-clock time of the last region in nanoseconds
+    long long iStartNs;                       // wall-clock start of current region
+} PerfCounters;
+
+void perf_counters_open(PerfCounters *oCounters);
+void perf_counters_close(PerfCounters *oCounters);
+void perf_counters_start(PerfCounters *oCounters);
+void perf_counters_stop(PerfCounters *oCounters);
+int perf_counters_available(const PerfCounters *oCounters, ePerfCounter eCounter);
+void perf_counters_report_header(void);
+void perf_counters_report(const PerfCounters *oCounters, const char *chName, long iOps);
+
+#endif // PERF_COUNTERS_H
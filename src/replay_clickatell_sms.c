@@ -0,0 +1,301 @@
+/*
+ * replay_clickatell_sms.c
+ *
+ * Replays a traffic trace recorded with clickatell_sms_handle_trace_set() (see
+ * clickatell_sms/clickatell_trace.h) against the loopback transport. Each recorded API
+ * call is re-issued with synthesized parameters of the recorded length and shape, and the
+ * recorded number of destination addresses, so that library changes can be benchmarked
+ * against a production-shaped workload without network access. Binary sends, whose
+ * payload is not recorded, are replayed as full single SMS WAP push messages.
+ *
+ * Usage:  ./replay_clickatell_sms <trace file> [speed] [emulate latency]
+ *         speed           - 1 replays at the original speed (default), 2 at twice the
+ *                           original speed, and so on; 0 replays as fast as possible
+ *         emulate latency - 1 to make the loopback transport take as long as each
+ *                           recorded call took, 0 to respond immediately (default)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clickatell_sms/clickatell_debug.h"
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_trace.h"
+#include "clickatell_sms/clickatell_segment.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "loopback_transport.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Fixed Macros/Types                                                            *
+ * ----------------------------------------------------------------------------- */
+
+#define REPLAY_MAX_DESTS    100000 // maximum destination addresses per replayed call
+#define REPLAY_MAX_PARAM    65536  // maximum length of a replayed parameter in bytes
+
+// replay state shared with the replay transport
+typedef struct ReplayState {
+    const ClickTraceRecord *oRecord;  // record currently being replayed
+    int bEmulateLatency;              // 1 to sleep for the recorded call duration
+    eClickApi aApiTypes[CLICK_API_COUNT]; // loopback transport contexts
+} ReplayState;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static void replay_sleep_us(long long iUs);
+static long replay_transport(void *pContext, const ClickSmsTransportRequest *oRequest);
+static ClickSmsString *replay_param_create(long iLen, int eShape);
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  replay_sleep_us
+ * Info:      Sleeps for a number of microseconds.
+ * Inputs:    iUs - microseconds to sleep
+ * Return:    void
+ */
+static void replay_sleep_us(long long iUs)
+{
+    struct timespec tSleep;
+
+    if (iUs <= 0)
+        return;
+
+    tSleep.tv_sec  = iUs / 1000000;
+    tSleep.tv_nsec = (iUs % 1000000) * 1000;
+    nanosleep(&tSleep, NULL);
+}
+
+/*
+ * Function:  replay_transport
+ * Info:      Loopback transport which optionally takes as long to respond as the
+ *            recorded call did.
+ * Inputs:    pContext - ReplayState
+ *            oRequest - formatted request
+ * Return:    HTTP status code
+ */
+static long replay_transport(void *pContext, const ClickSmsTransportRequest *oRequest)
+{
+    ReplayState *oState = (ReplayState *)pContext;
+
+    if (oState->bEmulateLatency)
+        replay_sleep_us(oState->oRecord->iDurationUs);
+
+    return loopback_transport(&oState->aApiTypes[oState->oRecord->eApiType], oRequest);
+}
+
+/*
+ * Function:  replay_param_create
+ * Info:      Synthesizes a parameter of the recorded length (at most REPLAY_MAX_PARAM)
+ *            and shape.
+ * Inputs:    iLen   - length in bytes
+ *            eShape - eClickTraceShape
+ * Return:    new ClickSmsString, or NULL if the call had no parameter or failed to
+ *            allocate memory
+ */
+static ClickSmsString *replay_param_create(long iLen, int eShape)
+{
+    long i = 0;
+    char *chParam = NULL;
+    ClickSmsString *sParam = NULL;
+
+    if (eShape == CLICK_TRACE_SHAPE_NONE || iLen < 1)
+        return NULL;
+
+    if (iLen > REPLAY_MAX_PARAM)
+        iLen = REPLAY_MAX_PARAM;
+    if ((chParam = malloc(iLen + 1)) == NULL)
+        return NULL;
+    for (i = 0; i < iLen; i++) {
+        // non-ASCII parameters use 2-byte UTF-8 characters (U+00E9), padded with ASCII
+        if (eShape == CLICK_TRACE_SHAPE_NON_ASCII && i + 1 < iLen && i % 4 == 0) {
+            chParam[i++] = (char)0xc3;
+            chParam[i]   = (char)0xa9;
+        }
+        else
+            chParam[i] = (i % 6 == 5 ? ' ' : 'a' + (char)(i % 26));
+    }
+    chParam[iLen] = '\0';
+
+    sParam = click_string_create(chParam);
+    free(chParam);
+
+    return sParam;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Main function which replays a Clickatell SMS library traffic trace            *
+ * ----------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    static const char *aCallNames[CLICK_TRACE_CALL_COUNT] = {
+        "message_send", "status_get", "balance_get", "charge_get", "coverage_get", "message_stop", "message_send_bin",
+        "batch_start", "batch_item", "batch_quicksend", "batch_end"
+    };
+    static const unsigned char aWapPushUdh[] = { 0x06, 0x05, 0x04, 0x0b, 0x84, 0x23, 0xf0 };
+    static unsigned char aBinaryData[CLICK_SEGMENT_DATA_MAX - sizeof(aWapPushUdh)];
+    const ClickSmsBinary oBinary = { aWapPushUdh, sizeof(aWapPushUdh), aBinaryData, sizeof(aBinaryData), -1 };
+    static char chBatchId[] = "8c9d6e2a81b6b8f2c4ebd2c2f76d6b1b";
+    static const char *const aFields[] = { "Anna" };
+    const ClickSmsString oBatchId = { chBatchId };
+    int i = 0, iResult = 0;
+    long aCalls[CLICK_TRACE_CALL_COUNT], aRecipients[CLICK_TRACE_CALL_COUNT];
+    long long aLibraryUs[CLICK_TRACE_CALL_COUNT];
+    long long iReplayStartUs = 0, iCallStartUs = 0, iLastRecordUs = 0, iMaxLateUs = 0, iNowUs = 0;
+    long iTotal = 0;
+    double fElapsedSec = 0.0;
+    char chMsisdn[16];
+    double fSpeed = (argc > 2 ? atof(argv[2]) : 1.0);
+    ClickTrace *oTrace = NULL;
+    ClickTraceRecord oRecord;
+    ClickSmsHandle *aHandles[CLICK_API_COUNT];
+    ClickSmsString *sParam = NULL, *sResponse = NULL;
+    ClickSmsString **aDests = NULL;
+    ClickMsisdn oMsisdns;
+    ReplayState oState;
+
+    if (argc < 2 || fSpeed < 0.0) {
+        printf("usage: %s <trace file> [speed] [emulate latency]\n", argv[0]);
+        return 2;
+    }
+
+    if ((oTrace = click_trace_reader_open(argv[1])) == NULL) {
+        printf("ERROR: %s is not a readable trace file\n", argv[1]);
+        return 1;
+    }
+
+    // start using Clickatell library, with debug output disabled
+    clickatell_sms_init();
+    click_debug_init(CLICK_DEBUG_OFF);
+
+    memset(&oState, 0, sizeof(oState));
+    memset(aCalls, 0, sizeof(aCalls));
+    memset(aRecipients, 0, sizeof(aRecipients));
+    memset(aLibraryUs, 0, sizeof(aLibraryUs));
+    oState.oRecord         = &oRecord;
+    oState.bEmulateLatency = (argc > 3 ? atoi(argv[3]) : 0);
+    for (i = 0; i < CLICK_API_COUNT; i++) {
+        oState.aApiTypes[i] = (eClickApi)i;
+        aHandles[i] = loopback_handle_create((eClickApi)i);
+        clickatell_sms_handle_transport_set(aHandles[i], replay_transport, &oState);
+    }
+
+    // destination addresses are created once; each call uses as many as it recorded
+    if ((aDests = calloc(REPLAY_MAX_DESTS, sizeof(ClickSmsString *))) == NULL) {
+        printf("ERROR: failed to allocate memory for destination addresses\n");
+        for (i = 0; i < CLICK_API_COUNT; i++)
+            clickatell_sms_handle_shutdown(aHandles[i]);
+        click_trace_close(oTrace);
+        clickatell_sms_shutdown();
+        return 1;
+    }
+    for (i = 0; i < REPLAY_MAX_DESTS; i++) {
+        snprintf(chMsisdn, sizeof(chMsisdn), "2782%07d", i);
+        aDests[i] = click_string_create(chMsisdn);
+    }
+    oMsisdns.aDests = aDests;
+
+    iReplayStartUs = click_trace_clock_us();
+
+    while ((iResult = click_trace_read(oTrace, &oRecord)) == 1) {
+        if (oRecord.eApiType < 0 || oRecord.eApiType >= CLICK_API_COUNT)
+            continue;
+
+        // wait until the call's (scaled) start time
+        if (fSpeed > 0.0) {
+            long long iDueUs = iReplayStartUs + (long long)(oRecord.iStartUs / fSpeed);
+
+            iNowUs = click_trace_clock_us();
+            if (iNowUs < iDueUs)
+                replay_sleep_us(iDueUs - iNowUs);
+            else if (iNowUs - iDueUs > iMaxLateUs)
+                iMaxLateUs = iNowUs - iDueUs;
+        }
+
+        sParam = replay_param_create(oRecord.iParamLen, oRecord.eParamShape);
+        oMsisdns.iNum = (int)(oRecord.iNumDests < REPLAY_MAX_DESTS ? oRecord.iNumDests : REPLAY_MAX_DESTS);
+        if (oMsisdns.iNum < 1)
+            oMsisdns.iNum = 1;
+
+        iCallStartUs = click_trace_clock_us();
+
+        switch (oRecord.eCall) {
+            case CLICK_TRACE_MESSAGE_SEND:
+                sResponse = clickatell_sms_message_send(aHandles[oRecord.eApiType], sParam, &oMsisdns);
+                aRecipients[oRecord.eCall] += oMsisdns.iNum;
+                break;
+            case CLICK_TRACE_MESSAGE_SEND_BINARY:
+                sResponse = clickatell_sms_message_send_binary(aHandles[oRecord.eApiType], &oBinary, &oMsisdns);
+                aRecipients[oRecord.eCall] += oMsisdns.iNum;
+                break;
+            case CLICK_TRACE_BATCH_START:
+                sResponse = clickatell_sms_batch_start(aHandles[oRecord.eApiType], (sParam != NULL ? sParam->data : "Hi #field1#"),
+                                                       (sParam != NULL ? (long)strlen(sParam->data) : 11), 0);
+                break;
+            case CLICK_TRACE_BATCH_ITEM:
+                sResponse = clickatell_sms_batch_item_send(aHandles[oRecord.eApiType], &oBatchId, aDests[0], aFields, 1);
+                aRecipients[oRecord.eCall]++;
+                break;
+            case CLICK_TRACE_BATCH_QUICKSEND:
+                sResponse = clickatell_sms_batch_quicksend(aHandles[oRecord.eApiType], &oBatchId, &oMsisdns);
+                aRecipients[oRecord.eCall] += oMsisdns.iNum;
+                break;
+            case CLICK_TRACE_BATCH_END:    sResponse = clickatell_sms_batch_end(aHandles[oRecord.eApiType], &oBatchId); break;
+            case CLICK_TRACE_STATUS_GET:   sResponse = clickatell_sms_status_get(aHandles[oRecord.eApiType], sParam); break;
+            case CLICK_TRACE_BALANCE_GET:  sResponse = clickatell_sms_balance_get(aHandles[oRecord.eApiType]); break;
+            case CLICK_TRACE_CHARGE_GET:   sResponse = clickatell_sms_charge_get(aHandles[oRecord.eApiType], sParam); break;
+            case CLICK_TRACE_COVERAGE_GET: sResponse = clickatell_sms_coverage_get(aHandles[oRecord.eApiType], sParam); break;
+            default:                       sResponse = clickatell_sms_message_stop(aHandles[oRecord.eApiType], sParam); break;
+        }
+
+        aLibraryUs[oRecord.eCall] += click_trace_clock_us() - iCallStartUs -
+                                     (oState.bEmulateLatency ? oRecord.iDurationUs : 0);
+        aCalls[oRecord.eCall]++;
+        iTotal++;
+
+        if (oRecord.iStartUs > iLastRecordUs)
+            iLastRecordUs = oRecord.iStartUs;
+
+        click_string_destroy(sResponse);
+        click_string_destroy(sParam);
+    }
+
+    fElapsedSec = (double)(click_trace_clock_us() - iReplayStartUs) / 1e6;
+
+    printf("Replayed %ld calls from %s in %.3f s (%.0f calls/sec); recorded span %.3f s\n",
+           iTotal, argv[1], fElapsedSec, (fElapsedSec > 0.0 ? iTotal / fElapsedSec : 0.0),
+           (double)iLastRecordUs / 1e6);
+    if (fSpeed > 0.0)
+        printf("Speed %.2fx, maximum lag behind the recorded schedule: %.3f ms\n", fSpeed, (double)iMaxLateUs / 1e3);
+    else
+        printf("Unpaced\n");
+
+    printf("%-16s %10s %12s %16s\n", "call", "calls", "recipients", "library us/call");
+    for (i = 0; i < CLICK_TRACE_CALL_COUNT; i++) {
+        if (aCalls[i] > 0)
+            printf("%-16s %10ld %12ld %16.2f\n", aCallNames[i], aCalls[i], aRecipients[i], (double)aLibraryUs[i] / aCalls[i]);
+    }
+
+    if (iResult < 0)
+        printf("WARNING: trace file is truncated or corrupt, replay stopped early\n");
+
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        clickatell_sms_handle_shutdown(aHandles[i]);
+
+    for (i = 0; i < REPLAY_MAX_DESTS; i++)
+        click_string_destroy(aDests[i]);
+    free(aDests);
+
+    click_trace_close(oTrace);
+
+    // finished using Clickatell library
+    clickatell_sms_shutdown();
+
+    return (iResult < 0 ? 1 : 0);
+}
@@ -0,0 +1,284 @@
+/*
+ * soak_clickatell_sms.c
+ *
+ * Long-running soak test for the Clickatell SMS library.
+ * This application runs millions of mixed HTTP and REST API calls against a loopback
+ * transport (see clickatell_sms_handle_transport_set()), so no network access or
+ * Clickatell account is required. Resident memory (RSS) and allocator statistics are
+ * sampled at fixed intervals, and the application fails if memory use grows
+ * monotonically over the run, which indicates a leak.
+ *
+ * Usage:  ./soak_clickatell_sms [iterations] [trace file]
+ *
+ * If a trace file is given, every API call is also recorded to it (see
+ * clickatell_sms_handle_trace_set()), which exercises tracing under load and produces a
+ * trace for replay_clickatell_sms.
+ *
+ * Build the library and this application with 'make SANITIZE=address' to run the soak
+ * test under AddressSanitizer/LeakSanitizer. Growth checks are skipped for sanitizer
+ * builds, since the sanitizer's allocator quarantine grows by design; leaks are then
+ * reported by LeakSanitizer at exit instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+
+#include "clickatell_sms/clickatell_debug.h"
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_trace.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "loopback_transport.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Fixed Macros/Types                                                            *
+ * ----------------------------------------------------------------------------- */
+
+#define SOAK_DEFAULT_ITERATIONS     2000000 // default number of API calls made during the soak test
+#define SOAK_NUM_SAMPLES            32      // number of memory samples taken over the run
+#define SOAK_WARMUP_SAMPLES         4       // samples ignored while allocator/heap reaches steady state
+#define SOAK_HANDLE_RECYCLE         1000    // handles are shut down and re-created after this many calls
+#define SOAK_HEAP_GROWTH_LIMIT      (64 * 1024)   // allowed monotonic heap growth (bytes)
+#define SOAK_RSS_GROWTH_LIMIT       (1024 * 1024) // allowed monotonic RSS growth (bytes)
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define SOAK_SANITIZER_BUILD 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define SOAK_SANITIZER_BUILD 1
+#endif
+#endif
+
+// memory sample taken at the end of each interval
+typedef struct SoakSample {
+    long   iIteration; // API calls made when sample was taken
+    size_t iRss;       // resident set size in bytes
+    size_t iHeap;      // bytes allocated from the heap (in use)
+} SoakSample;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static int soak_api_call(ClickSmsHandle *oClickSms, long iIteration, ClickSmsString *sText,
+                         ClickMsisdn *aMsisdns, ClickSmsString *sMsgId);
+static void soak_sample_take(SoakSample *oSample, long iIteration);
+static int soak_growth_check(const char *chName, const SoakSample *aSamples, int iNum, int bRss, size_t iLimit);
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  soak_api_call
+ * Info:      Makes one API call, cycling through all public API functions, and
+ *            through the string functions used to process responses.
+ * Inputs:    oClickSms  - handle to make API call with
+ *            iIteration - iteration number, selects the API call
+ *            sText      - message text
+ *            aMsisdns   - destination addresses
+ *            sMsgId     - message ID
+ * Return:    1 if the response was incomplete, 0 otherwise
+ */
+static int soak_api_call(ClickSmsHandle *oClickSms, long iIteration, ClickSmsString *sText,
+                         ClickMsisdn *aMsisdns, ClickSmsString *sMsgId)
+{
+    ClickSmsString *sResponse = NULL;
+    ClickSmsString *sBuf = NULL;
+    int iFailed = 0;
+
+    switch (iIteration % 8) {
+        case 0:
+            sResponse = clickatell_sms_message_send(oClickSms, sText, aMsisdns);
+
+            // process response the same way as test_clickatell_sms.c, trimming the whole string
+            if (sResponse != NULL && click_string_find_cstr(sResponse, "apiMessageId", 0) < 0)
+                click_string_trim_prefix(sResponse, strlen(sResponse->data));
+            break;
+        case 1: sResponse = clickatell_sms_status_get(oClickSms, sMsgId); break;
+        case 2:
+            sResponse = clickatell_sms_balance_get(oClickSms);
+
+            // the loopback writes the response in pieces: all of them must be kept
+            iFailed = (sResponse == NULL || strstr(sResponse->data, "1234.500") == NULL);
+            break;
+        case 3: sResponse = clickatell_sms_charge_get(oClickSms, sMsgId); break;
+        case 4: sResponse = clickatell_sms_coverage_get(oClickSms, aMsisdns->aDests[0]); break;
+        case 5: sResponse = clickatell_sms_message_stop(oClickSms, sMsgId); break;
+        case 6:
+            sBuf = click_string_duplicate(sText);
+            click_string_url_encode(sBuf);
+            click_string_append_formatted_cstr(sBuf, "&%s=%ld", "iteration", iIteration);
+            click_string_trim_prefix(sBuf, 4);
+            break;
+        default:
+            sResponse = clickatell_sms_message_send(oClickSms, sText, aMsisdns);
+            break;
+    }
+
+    click_string_destroy(sBuf);
+    click_string_destroy(sResponse);
+
+    return iFailed;
+}
+
+/*
+ * Function:  soak_sample_take
+ * Info:      Samples resident memory and allocator statistics.
+ * Inputs:    oSample    - sample to fill in
+ *            iIteration - API calls made so far
+ * Return:    void
+ */
+static void soak_sample_take(SoakSample *oSample, long iIteration)
+{
+    long iPagesTotal = 0, iPagesResident = 0;
+    FILE *fpStatm = fopen("/proc/self/statm", "r");
+
+    if (fpStatm != NULL) {
+        if (fscanf(fpStatm, "%ld %ld", &iPagesTotal, &iPagesResident) != 2)
+            iPagesResident = 0;
+        fclose(fpStatm);
+    }
+
+    oSample->iIteration = iIteration;
+    oSample->iRss       = (size_t)iPagesResident * (size_t)sysconf(_SC_PAGESIZE);
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    oSample->iHeap = mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    oSample->iHeap = (size_t)(unsigned int)mallinfo().uordblks;
+#else
+    oSample->iHeap = 0;
+#endif
+}
+
+/*
+ * Function:  soak_growth_check
+ * Info:      Checks whether a memory metric grew monotonically over all samples taken
+ *            after warmup, by more than the allowed limit.
+ * Inputs:    chName   - metric name for reporting
+ *            aSamples - samples taken
+ *            iNum     - number of samples
+ *            bRss     - 1 to check RSS, 0 to check heap usage
+ *            iLimit   - allowed growth in bytes
+ * Return:    0 if no leak detected, else 1
+ */
+static int soak_growth_check(const char *chName, const SoakSample *aSamples, int iNum, int bRss, size_t iLimit)
+{
+    int i = 0;
+    size_t iFirst = 0, iLast = 0, iPrev = 0, iCur = 0;
+
+    if (iNum - SOAK_WARMUP_SAMPLES < 2)
+        return 0;
+
+    iFirst = (bRss ? aSamples[SOAK_WARMUP_SAMPLES].iRss : aSamples[SOAK_WARMUP_SAMPLES].iHeap);
+    iLast  = (bRss ? aSamples[iNum - 1].iRss : aSamples[iNum - 1].iHeap);
+
+    for (i = SOAK_WARMUP_SAMPLES + 1; i < iNum; i++) {
+        iPrev = (bRss ? aSamples[i - 1].iRss : aSamples[i - 1].iHeap);
+        iCur  = (bRss ? aSamples[i].iRss : aSamples[i].iHeap);
+
+        // RSS is page-granular and may stay flat between samples; the heap must strictly grow
+        if (iCur < iPrev || (!bRss && iCur == iPrev))
+            return 0;
+    }
+
+    if (iLast - iFirst <= iLimit)
+        return 0;
+
+    printf("FAIL: %s grew monotonically by %zu bytes after warmup (limit %zu bytes)\n", chName, iLast - iFirst, iLimit);
+
+    return 1;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Main function which soak tests the Clickatell SMS library                     *
+ * ----------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    int i = 0, iNumSamples = 0, iFailed = 0;
+    long iIteration = 0;
+    long iIterations = (argc > 1 ? atol(argv[1]) : SOAK_DEFAULT_ITERATIONS);
+    long iInterval = 0, iIncomplete = 0;
+    ClickSmsHandle *aHandles[CLICK_API_COUNT] = { NULL, NULL };
+    ClickTrace *oTrace = NULL;
+    SoakSample aSamples[SOAK_NUM_SAMPLES];
+
+    if (iIterations < SOAK_NUM_SAMPLES) {
+        printf("usage: %s [iterations >= %d] [trace file]\n", argv[0], SOAK_NUM_SAMPLES);
+        return 2;
+    }
+    if (argc > 2 && (oTrace = click_trace_open(argv[2])) == NULL) {
+        printf("ERROR: cannot create trace file %s\n", argv[2]);
+        return 2;
+    }
+    iInterval = iIterations / SOAK_NUM_SAMPLES;
+
+    // start using Clickatell library, with debug output disabled since millions of calls are made
+    clickatell_sms_init();
+    click_debug_init(CLICK_DEBUG_OFF);
+
+    ClickSmsString *sText  = click_string_create("Soak test message with unsafe URL characters: &=?+% and a longer tail of text.");
+    ClickSmsString *sMsgId = click_string_create("205e85d0578314037a96175249fc6a2b");
+    ClickMsisdn *aMsisdns  = (ClickMsisdn *)calloc(1, sizeof(ClickMsisdn));
+    aMsisdns->iNum   = 3;
+    aMsisdns->aDests = calloc(aMsisdns->iNum, sizeof(ClickSmsString *));
+    aMsisdns->aDests[0] = click_string_create("2991000000");
+    aMsisdns->aDests[1] = click_string_create("2991000001");
+    aMsisdns->aDests[2] = click_string_create("2991000002");
+
+    printf("Soak test: %ld API calls, %d samples\n", iIterations, SOAK_NUM_SAMPLES);
+    printf("%12s %14s %14s\n", "calls", "rss (bytes)", "heap (bytes)");
+
+    for (iIteration = 0; iIteration < iIterations; iIteration++) {
+        // exercise handle create/shutdown as well as the API calls themselves
+        if (iIteration % SOAK_HANDLE_RECYCLE == 0) {
+            for (i = 0; i < CLICK_API_COUNT; i++) {
+                clickatell_sms_handle_shutdown(aHandles[i]);
+                aHandles[i] = loopback_handle_create((eClickApi)i);
+                clickatell_sms_handle_trace_set(aHandles[i], oTrace);
+            }
+        }
+
+        iIncomplete += soak_api_call(aHandles[iIteration % CLICK_API_COUNT], iIteration / CLICK_API_COUNT, sText, aMsisdns, sMsgId);
+
+        if ((iIteration + 1) % iInterval == 0 && iNumSamples < SOAK_NUM_SAMPLES) {
+            soak_sample_take(&aSamples[iNumSamples], iIteration + 1);
+            printf("%12ld %14zu %14zu\n", aSamples[iNumSamples].iIteration, aSamples[iNumSamples].iRss, aSamples[iNumSamples].iHeap);
+            iNumSamples++;
+        }
+    }
+
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        clickatell_sms_handle_shutdown(aHandles[i]);
+
+    for (i = 0; i < aMsisdns->iNum; i++)
+        click_string_destroy(aMsisdns->aDests[i]);
+    free(aMsisdns->aDests);
+    free(aMsisdns);
+    click_string_destroy(sText);
+    click_string_destroy(sMsgId);
+    click_trace_close(oTrace);
+
+    // finished using Clickatell library
+    clickatell_sms_shutdown();
+
+#ifdef SOAK_SANITIZER_BUILD
+    printf("Sanitizer build: growth checks skipped, leaks are reported by the sanitizer at exit\n");
+#else
+    iFailed |= soak_growth_check("heap", aSamples, iNumSamples, 0, SOAK_HEAP_GROWTH_LIMIT);
+    iFailed |= soak_growth_check("RSS", aSamples, iNumSamples, 1, SOAK_RSS_GROWTH_LIMIT);
+#endif
+
+    if (iIncomplete > 0) {
+        printf("FAIL: %ld incomplete responses\n", iIncomplete);
+        iFailed = 1;
+    }
+
+    printf("Soak test %s\n", (iFailed ? "FAILED" : "passed"));
+
+    return iFailed;
+}
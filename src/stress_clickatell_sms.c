@@ -0,0 +1,261 @@
+/*
+ * stress_clickatell_sms.c
+ *
+ * Multi-threaded stress harness for the Clickatell SMS library.
+ * N threads concurrently hammer library initialization, handle create/shutdown and all
+ * public API calls against a loopback transport (see loopback_transport.c), so no network
+ * access or Clickatell account is required. Two modes are run for each thread count:
+ *   - per-thread: every thread initializes, uses and shuts down its own handles
+ *   - shared:     all threads share one HTTP and one REST handle
+ * The harness reports API call throughput and its scaling from 1 thread up to the
+ * maximum thread count.
+ *
+ * Usage:  ./stress_clickatell_sms [calls per thread] [max threads]
+ *
+ * Build the library and this application with 'make SANITIZE=thread' to run the stress
+ * harness under ThreadSanitizer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "clickatell_sms/clickatell_debug.h"
+#include "clickatell_sms/clickatell_string.h"
+#include "clickatell_sms/clickatell_sms.h"
+#include "loopback_transport.h"
+
+/* ----------------------------------------------------------------------------- *
+ * Fixed Macros/Types                                                            *
+ * ----------------------------------------------------------------------------- */
+
+#define STRESS_DEFAULT_CALLS        20000 // default number of API calls made by each thread
+#define STRESS_DEFAULT_MAX_THREADS  64    // default maximum thread count
+#define STRESS_HANDLE_RECYCLE       500   // per-thread handles are re-created after this many calls
+
+// stress harness modes
+typedef enum eStressMode {
+    STRESS_MODE_PER_THREAD, // each thread uses its own handles
+    STRESS_MODE_SHARED,     // all threads share the same handles
+    STRESS_MODE_COUNT       // count of modes
+} eStressMode;
+
+// data shared by all threads of one stress run
+typedef struct StressRun {
+    eStressMode eMode;                            // stress mode
+    long iCalls;                                  // API calls per thread
+    ClickSmsHandle *aShared[CLICK_API_COUNT];     // shared handles (STRESS_MODE_SHARED only)
+    const ClickSmsString *sText;                  // message text
+    const ClickSmsString *sMsgId;                 // message ID
+    ClickMsisdn *aMsisdns;                        // destination addresses
+} StressRun;
+
+// per-thread data
+typedef struct StressThread {
+    pthread_t oThread;  // thread
+    int iIndex;         // thread index
+    long iFailures;     // API calls which returned no response
+    StressRun *oRun;    // run shared by all threads
+} StressThread;
+
+/* ----------------------------------------------------------------------------- *
+ * Forward declarations                                                          *
+ * ----------------------------------------------------------------------------- */
+
+static long stress_api_call(ClickSmsHandle *oClickSms, long iIteration, const StressRun *oRun);
+static void *stress_thread_main(void *pArg);
+static double stress_run(StressRun *oRun, int iNumThreads, long *iFailures);
+
+/* ----------------------------------------------------------------------------- *
+ * Local function definitions                                                    *
+ * ----------------------------------------------------------------------------- */
+
+/*
+ * Function:  stress_api_call
+ * Info:      Makes one API call, cycling through all public API functions.
+ * Inputs:    oClickSms  - handle to make API call with
+ *            iIteration - iteration number, selects the API call
+ *            oRun       - run parameters
+ * Return:    0 if a response was received, else 1
+ */
+static long stress_api_call(ClickSmsHandle *oClickSms, long iIteration, const StressRun *oRun)
+{
+    ClickSmsString *sResponse = NULL;
+
+    switch (iIteration % 6) {
+        case 0:  sResponse = clickatell_sms_message_send(oClickSms, oRun->sText, oRun->aMsisdns); break;
+        case 1:  sResponse = clickatell_sms_status_get(oClickSms, oRun->sMsgId); break;
+        case 2:  sResponse = clickatell_sms_balance_get(oClickSms); break;
+        case 3:  sResponse = clickatell_sms_charge_get(oClickSms, oRun->sMsgId); break;
+        case 4:  sResponse = clickatell_sms_coverage_get(oClickSms, oRun->aMsisdns->aDests[0]); break;
+        default: sResponse = clickatell_sms_message_stop(oClickSms, oRun->sMsgId); break;
+    }
+
+    if (sResponse == NULL)
+        return 1;
+
+    click_string_destroy(sResponse);
+    return 0;
+}
+
+/*
+ * Function:  stress_thread_main
+ * Info:      Thread entry point. In per-thread mode the thread initializes the library,
+ *            creates its own handles and periodically re-creates them. In shared mode the
+ *            thread uses the run's shared handles.
+ * Inputs:    pArg - StressThread
+ * Return:    NULL
+ */
+static void *stress_thread_main(void *pArg)
+{
+    StressThread *oThread = (StressThread *)pArg;
+    StressRun *oRun = oThread->oRun;
+    ClickSmsHandle *aHandles[CLICK_API_COUNT] = { NULL, NULL };
+    long iIteration = 0;
+    int i = 0;
+
+    clickatell_sms_init(); // reference counted, so this may race with other threads' init/shutdown
+
+    for (iIteration = 0; iIteration < oRun->iCalls; iIteration++) {
+        eClickApi eApiType = (eClickApi)((iIteration + oThread->iIndex) % CLICK_API_COUNT);
+
+        if (oRun->eMode == STRESS_MODE_SHARED)
+            oThread->iFailures += stress_api_call(oRun->aShared[eApiType], iIteration / CLICK_API_COUNT, oRun);
+        else {
+            if (iIteration % STRESS_HANDLE_RECYCLE == 0) {
+                for (i = 0; i < CLICK_API_COUNT; i++) {
+                    clickatell_sms_handle_shutdown(aHandles[i]);
+                    aHandles[i] = loopback_handle_create((eClickApi)i);
+                }
+            }
+
+            oThread->iFailures += stress_api_call(aHandles[eApiType], iIteration / CLICK_API_COUNT, oRun);
+        }
+    }
+
+    for (i = 0; i < CLICK_API_COUNT; i++) {
+        if (aHandles[i] != NULL)
+            clickatell_sms_handle_shutdown(aHandles[i]);
+    }
+
+    clickatell_sms_shutdown();
+
+    return NULL;
+}
+
+/*
+ * Function:  stress_run
+ * Info:      Runs all threads for one thread count and mode, and measures elapsed time.
+ * Inputs:    oRun        - run parameters
+ *            iNumThreads - number of threads to run
+ * Outputs:   iFailures   - total count of failed API calls
+ * Return:    elapsed time in seconds
+ */
+static double stress_run(StressRun *oRun, int iNumThreads, long *iFailures)
+{
+    int i = 0;
+    struct timespec tStart, tEnd;
+    StressThread *aThreads = (StressThread *)calloc(iNumThreads, sizeof(StressThread));
+
+    if (aThreads == NULL)
+        return -1.0;
+
+    clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+    for (i = 0; i < iNumThreads; i++) {
+        aThreads[i].iIndex = i;
+        aThreads[i].oRun   = oRun;
+        pthread_create(&aThreads[i].oThread, NULL, stress_thread_main, &aThreads[i]);
+    }
+
+    *iFailures = 0;
+    for (i = 0; i < iNumThreads; i++) {
+        pthread_join(aThreads[i].oThread, NULL);
+        *iFailures += aThreads[i].iFailures;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &tEnd);
+    free(aThreads);
+
+    return (double)(tEnd.tv_sec - tStart.tv_sec) + (double)(tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+}
+
+/* ----------------------------------------------------------------------------- *
+ * Main function which stress tests the Clickatell SMS library                   *
+ * ----------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    int i = 0, iNumThreads = 0, iFailed = 0;
+    long iFailures = 0;
+    double fElapsed = 0.0, aBaseRate[STRESS_MODE_COUNT] = { 0.0, 0.0 };
+    StressRun oRun;
+    long iCalls = (argc > 1 ? atol(argv[1]) : STRESS_DEFAULT_CALLS);
+    int iMaxThreads = (argc > 2 ? atoi(argv[2]) : STRESS_DEFAULT_MAX_THREADS);
+
+    if (iCalls < 1 || iMaxThreads < 1) {
+        printf("usage: %s [calls per thread] [max threads]\n", argv[0]);
+        return 2;
+    }
+
+    // hold a library reference for the whole run, with debug output disabled
+    clickatell_sms_init();
+    click_debug_init(CLICK_DEBUG_OFF);
+
+    memset(&oRun, 0, sizeof(oRun));
+    oRun.iCalls = iCalls;
+    oRun.sText  = click_string_create("Stress test message with unsafe URL characters: &=?+%");
+    oRun.sMsgId = click_string_create("205e85d0578314037a96175249fc6a2b");
+    oRun.aMsisdns = (ClickMsisdn *)calloc(1, sizeof(ClickMsisdn));
+    oRun.aMsisdns->iNum   = 2;
+    oRun.aMsisdns->aDests = calloc(oRun.aMsisdns->iNum, sizeof(ClickSmsString *));
+    oRun.aMsisdns->aDests[0] = click_string_create("2991000000");
+    oRun.aMsisdns->aDests[1] = click_string_create("2991000001");
+
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        oRun.aShared[i] = loopback_handle_create((eClickApi)i);
+
+    printf("Stress test: %ld API calls per thread, 1 to %d threads\n", iCalls, iMaxThreads);
+    printf("%-12s %8s %14s %10s %10s\n", "mode", "threads", "calls/sec", "scaling", "failures");
+
+    for (oRun.eMode = STRESS_MODE_PER_THREAD; oRun.eMode < STRESS_MODE_COUNT; oRun.eMode++) {
+        // double the thread count each time, always finishing with the maximum thread count
+        for (iNumThreads = 1; iNumThreads <= iMaxThreads;
+             iNumThreads = (iNumThreads < iMaxThreads && iNumThreads * 2 > iMaxThreads ? iMaxThreads : iNumThreads * 2)) {
+            fElapsed = stress_run(&oRun, iNumThreads, &iFailures);
+            if (fElapsed <= 0.0) {
+                iFailed = 1;
+                break;
+            }
+
+            double fRate = (double)iCalls * iNumThreads / fElapsed;
+            if (iNumThreads == 1)
+                aBaseRate[oRun.eMode] = fRate;
+
+            printf("%-12s %8d %14.0f %9.2fx %10ld\n", (oRun.eMode == STRESS_MODE_SHARED ? "shared" : "per-thread"),
+                   iNumThreads, fRate, fRate / aBaseRate[oRun.eMode], iFailures);
+
+            if (iFailures > 0)
+                iFailed = 1;
+        }
+    }
+
+    for (i = 0; i < CLICK_API_COUNT; i++)
+        clickatell_sms_handle_shutdown(oRun.aShared[i]);
+
+    for (i = 0; i < oRun.aMsisdns->iNum; i++)
+        click_string_destroy(oRun.aMsisdns->aDests[i]);
+    free(oRun.aMsisdns->aDests);
+    free(oRun.aMsisdns);
+    click_string_destroy((ClickSmsString *)oRun.sText);
+    click_string_destroy((ClickSmsString *)oRun.sMsgId);
+
+    // finished using Clickatell library
+    clickatell_sms_shutdown();
+
+    printf("Stress test %s\n", (iFailed ? "FAILED" : "passed"));
+
+    return iFailed;
+}
@@ -144,7 +144,6 @@ static void run_common_tests(eClickApi eApiType)
  */
 static void run_common_api_calls(eClickApi eApiType, ClickSmsHandle *oClickSms)
 {
-    int i = 0;
     ClickSmsString *sResponse = NULL;
     ClickSmsString *sMsgText = click_string_create(CFG_SAMPLE_MSG_TEXT);
 
@@ -165,10 +164,12 @@ static void run_common_api_calls(eClickApi eApiType, ClickSmsHandle *oClickSms)
     ClickSmsString *sMsgIds = clickatell_sms_message_send(oClickSms, sMsgText, aMsisdnsMulti);
     PRINT_SUB_TEST_SEPARATOR
 
+    int i = 0;
     for (i = 0; i < aMsisdnsMulti->iNum; i++) // free memory allocated for destination addresses
         click_string_destroy((ClickSmsString *)(aMsisdnsMulti->aDests[i]));
     free(aMsisdnsMulti->aDests);
     free(aMsisdnsMulti);  // free container
+    click_string_destroy(sMsgIds);
 */
     // ----------------------------------------------------------------------------------------
     // send a message to one handset
@@ -263,7 +264,6 @@ static void run_common_api_calls(eClickApi eApiType, ClickSmsHandle *oClickSms)
     PRINT_SUB_TEST_SEPARATOR
 
     click_string_destroy(sMsgIdResponse);
-    click_string_destroy(sMsgIds);
     click_string_destroy(sMsgId);
     click_string_destroy(sMsgText);
 }